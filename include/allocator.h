@@ -180,9 +180,6 @@ public:
     //-----------------------------
 
     static AllocLogger& instance();
-
-private:
-    bool m_recursiveGuard = false;
 };
 
 // DebugLogSink, to help to find and fix memory leaks.
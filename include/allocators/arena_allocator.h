@@ -41,7 +41,9 @@ namespace coll
  * ✅ **Fast**: No per-allocation bookkeeping, just bump pointer
  * ✅ **Cache-friendly**: Contiguous allocations
  * ✅ **Deterministic**: Predictable allocation times (except fallback)
- * ❌ **No individual arena frees**: Arena memory freed on destruction
+ * ✅ **In-place growth**: The last allocation can grow while the arena has room
+ * ✅ **Scopes**: mark()/rewind() release all the allocations of a nested scope
+ * ❌ **No individual arena frees**: Only the last allocation can be freed
  * ❌ **Fixed capacity**: Exceeds → fallback allocator
  *
  * # Constructor Parameters
@@ -69,6 +71,13 @@ namespace coll
  *
  * // Owned buffer (auto-free)
  * ArenaAllocator arena(131072, fallback);
+ *
+ * // Per-stage scope: everything allocated in the stage is released on exit
+ * {
+ *     ArenaAllocator::Scope stage(arena);
+ *     darray<int> values(arena); // Grows in place while it is the last allocation.
+ *     ...
+ * }
  * ```
  *
  * # When NOT to use ❌
@@ -77,7 +86,14 @@ namespace coll
  * - Frequent small allocations after arena exhaustion
  *
  * # Memory Management Rules
- * - **Arena allocations**: free() is no-op (memory freed on destruction)
+ * - **Arena allocations**: free() is no-op (memory freed on destruction or rewind), except for the
+ *   last allocation, which is returned to the arena
+ * - **tryExpand()**: grows the last arena allocation in place. Returns 0 for the other arena
+ *   blocks, whose size is not recorded. Fallback blocks delegate to the fallback allocator
+ * - **mark()**: seals the last block. Blocks allocated before the mark no longer grow in place or
+ *   return to the arena on free(), so the scope cannot be placed over them
+ * - **rewind(mark)**: releases the arena allocations made after mark(). Fallback allocations are
+ *   not released: their owners must free them
  * - **Fallback allocations**: free() delegates to fallback allocator
  * - **External buffers**: User responsibility to manage lifetime
  *
@@ -90,6 +106,32 @@ namespace coll
 class ArenaAllocator : public IAllocator
 {
 public:
+    // Arena position, to release all later allocations with 'rewind'.
+    struct Mark
+    {
+        byte_size usedBytes;
+        uint8_t* lastBlock;
+    };
+
+    // Rewinds the arena to its position at construction, on destruction.
+    class Scope
+    {
+    public:
+        explicit Scope(ArenaAllocator& arena)
+            : m_arena(arena)
+            , m_mark(arena.mark())
+        {
+        }
+        ~Scope() { m_arena.rewind(m_mark); }
+
+    private:
+        ArenaAllocator& m_arena;
+        Mark m_mark;
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
     ArenaAllocator(span<uint8_t> backingBuffer, IAllocator& fallback);
     ArenaAllocator(byte_size size, IAllocator& fallback);
     ~ArenaAllocator();
@@ -98,11 +140,18 @@ public:
     SAllocResult alloc(byte_size bytes, align a) override;
     byte_size tryExpand(byte_size bytes, void*) override;
     void free(void*) override;
+    ////////
+
+    Mark mark();
+    void rewind(const Mark& m);
+
+    byte_size usedBytes() const { return m_usedBytes; }
 
 private:
     IAllocator& m_fallback;
     span<uint8_t> m_buffer;
     byte_size m_usedBytes;
+    uint8_t* m_lastBlock;
     bool m_ownedBuffer;
 };
 } // namespace coll
\ No newline at end of file
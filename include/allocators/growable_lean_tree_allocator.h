@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2026 Guillermo Hernan Martin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "lean_tree_allocator.h"
+
+#include <iosfwd>
+
+/**
+ * @brief GrowableLeanTreeAllocator: 'LeanTreeAllocator' which grows and shrinks by regions
+ *
+ * DESIGN:
+ *  - A chain of 'LeanTreeAllocator' regions, all with the same parameters. Each one is a single
+ *    'totalSize' buffer taken from the backing allocator.
+ *  - A new region is added when no region can serve an allocation.
+ *  - Frees are routed to their region with a hash table, indexed by the address divided by
+ *    'totalSize'. A region buffer spans at most two of these granules, so each region has at most
+ *    two entries, and a lookup checks at most two regions.
+ *
+ * ALLOCATION POLICY:
+ *  - First fit among the regions, oldest first, and best fit inside each region. Allocations
+ *    gather on the oldest regions, so the newest ones become empty first when the load drops.
+ *  - When a region becomes empty, it is released to the backing allocator if there are more
+ *    than 'emptyRegionsKept' empty regions. This hysteresis avoids taking and releasing a region
+ *    repeatedly when the load moves around a region boundary. The last region is never released.
+ *
+ * LIMITATIONS:
+ *  - Same as 'LeanTreeAllocator', except the fixed capacity.
+ *  - Up to 'maxRegions' regions. Allocations fail beyond that.
+ *  - An allocation never spans two regions: maxAllocSize is still the largest one.
+ *
+ * CONFIGURATION:
+ *  GrowableLeanTreeAllocator alloc(
+ *      backing,
+ *      {.tree = {.totalSize = 1_MB, .maxAllocSize = 64_KB}, .maxRegions = 16}
+ *  );
+ *
+ *  tree:             'LeanTreeAllocator' parameters of every region. Each region keeps its tree
+ *                    metadata, about totalSize / (3 × basicBlockSize) bytes rounded up to a power
+ *                    of 2, in its first top level block, so it must not be larger than
+ *                    maxAllocSize. With the default basicBlockSize (16B), 1 MB regions need
+ *                    maxAllocSize ≥ 32 KB.
+ *  maxRegions:       Maximum number of regions.
+ *  emptyRegionsKept: Empty regions kept before releasing them.
+ */
+namespace coll
+{
+class GrowableLeanTreeAllocator : public IAllocator
+{
+public:
+    struct Parameters
+    {
+        LeanTreeAllocator::Parameters tree;
+        count_t maxRegions = 64;
+        count_t emptyRegionsKept = 1;
+    };
+
+    using Stats = LeanTreeAllocator::Stats;
+
+    GrowableLeanTreeAllocator(IAllocator& backing, const Parameters& params = Parameters());
+    ~GrowableLeanTreeAllocator();
+
+    // IAllocator implementation
+    SAllocResult alloc(byte_size bytes, align a) override;
+    byte_size tryExpand(byte_size bytes, void*) override;
+    void free(void*) override;
+    ////////
+
+    Stats stats() const;
+    Parameters params() const { return m_params; }
+    count_t regionCount() const { return m_regionCount; }
+
+    bool validate(std::ostream& errorLog) const;
+
+private:
+    struct SSlot
+    {
+        uintptr_t granule;
+        LeanTreeAllocator* region;
+    };
+
+    LeanTreeAllocator* addRegion();
+    void releaseRegion(count_t index);
+    LeanTreeAllocator* regionOf(const void* buffer) const;
+    bool isEmpty(const LeanTreeAllocator& region) const;
+
+    void rebuildSlots();
+    void insertSlots(LeanTreeAllocator* region);
+    count_t slotIndex(uintptr_t granule) const;
+
+    IAllocator& m_backing;
+    Parameters m_params;
+    uint8_t m_granuleLog2;
+
+    LeanTreeAllocator** m_regions;
+    count_t m_regionCount;
+
+    SSlot* m_slots;
+    Power2 m_slotCount;
+};
+} // namespace coll
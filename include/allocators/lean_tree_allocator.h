@@ -40,6 +40,11 @@
   *  - Automatic coalescing on free (checks adjacent blocks, promotes solid free blocks)
   *  - All allocations power-of-2 rounded up to basicBlockSize minimum
   *
+  * tryExpand():
+  *  - Grows a block in place while it is the left child and its right buddy is free, up to the
+  *    requested size (rounded up to a power of 2) or maxAllocSize.
+  *  - Only grows if the whole request fits. Otherwise, returns the current block size.
+  *
   * USE CASES:
   *  - Fixed-size memory pools with small-to-medium power-of-2 allocations
   *  - Object pools, particle systems, render data (16B - 8KB allocations)
@@ -56,9 +61,12 @@
   *
   * LIMITATIONS:
   *  - Power-of-2 internal fragmentation (25% average for random sizes)
-  *  - No tryExpand() support (returns 0)
-  *  - Single backing buffer: fixed capacity, OOM = hard failure
-  *  - Thread-unsafe
+  *  - tryExpand() can only grow the left buddies (blocks aligned to the new size)
+  *  - Blocks are aligned to their size, up to the buffer alignment 'a'. Over-aligned requests get a
+  *    block as large as the alignment, and alignments above 'a' fail.
+  *  - Single backing buffer: fixed capacity, OOM = hard failure. 'GrowableLeanTreeAllocator' chains
+  *    several trees to grow on demand.
+  *  - Thread-unsafe. 'RegionLockedLeanTreeAllocator' is the variant to share among threads.
   *
   * CONFIGURATION:
   *  LeanTreeAllocator alloc(backing, {.basicBlockSize = 16, .totalSize = 64_KB, .maxAllocSize = 8_KB});
@@ -135,6 +143,9 @@ public:
     void dumpToCsv(std::ostream& csv, char separator = ';') const;
 
 private:
+    friend class RegionLockedLeanTreeAllocator;
+    friend class GrowableLeanTreeAllocator;
+
     struct SHeader
     {
         uint8_t* data;
@@ -142,10 +153,20 @@ private:
         Parameters params;
     };
 
-    SAllocResult topLevelAlloc(Power2 basicBlocks);
+    LeanTreeAllocator(IAllocator& backing, const Parameters& params, bool atomicBits);
+
+    SAllocResult allocInRange(byte_size bytes, align a, count_t firstBlock, count_t endBlock);
+    count_t checkedBlockIndex(const void* buffer) const;
+    byte_size freeBlock(count_t basicBlockIndex);
+    byte_size blockBytes(count_t basicBlockIndex) const;
+    byte_size expandBlock(count_t basicBlockIndex, byte_size bytes);
+    uint8_t allocatedLevel(count_t basicBlockIndex) const;
+
+    SAllocResult topLevelAlloc(Power2 basicBlocks, count_t firstBlock, count_t endBlock);
     Power2 topLevelBlocksCount() const;
     uint8_t topLevel() const;
     uint8_t* allocAtLevel(uint8_t level, count_t index, Power2 basicBlocks);
+    uint8_t* allocAtPosition(uint8_t level, count_t index, Power2 basicBlocks, count_t basicBlockIndex);
     count_t selectFittingChild(uint8_t level, count_t index, Power2 basicBlocks);
     bool getBitLevelValue(uint8_t level, count_t index) const;
     void setBitLevelValue(uint8_t level, count_t index, bool value);
@@ -155,6 +176,7 @@ private:
     void setSolidBit(uint8_t level, count_t index);
     byte_size lowerLevelLfb(uint8_t level, count_t index) const;
     byte_size byteLevelLfb(uint8_t level, count_t index) const;
+    byte_size largestFreeBlock() const;
     void updateLargestFreeBlock(uint8_t level, count_t index);
 
     void setupHeader(uint8_t* rawMemory, const Parameters& params);
@@ -177,5 +199,6 @@ private:
     IAllocator& m_backing;
     SHeader* m_header;
     Stats m_stats;
+    bool m_atomicBits;
 };
 } // namespace coll
\ No newline at end of file
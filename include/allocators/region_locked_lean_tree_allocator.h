@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2026 Guillermo Hernan Martin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "lean_tree_allocator.h"
+
+#include <atomic>
+#include <iosfwd>
+
+/**
+ * @brief RegionLockedLeanTreeAllocator: thread-safe variant of 'LeanTreeAllocator', with a lock per
+ * region
+ *
+ * DESIGN:
+ *  - Same buddy tree and single backing buffer as 'LeanTreeAllocator'.
+ *  - The top level blocks are split into regions of contiguous blocks. Every thread has a home
+ *    region, assigned round-robin the first time it uses any of these allocators.
+ *  - Each region has a spin lock. A thread holds it while it allocates or frees on the region.
+ *    The fast paths only try the lock, with a single atomic exchange, and go elsewhere if it is
+ *    held.
+ *  - Byte nodes (levels 5+) belong to a single region, so the lock holder updates them with plain
+ *    stores. Words of the bit levels (0-4) may hold blocks of neighbouring regions, and they are
+ *    updated with atomic read-modify-write operations.
+ *  - A free of a block whose region is locked by another thread is pushed on the region's remote
+ *    free queue (a compare-and-swap stack linked through the freed blocks). The next lock holder
+ *    applies it.
+ *
+ * ALLOCATION POLICY:
+ *  - Home region first. If it is locked or has no fitting block, the other regions, in order.
+ *  - Only when every unlocked region has failed, it waits for the locked ones before failing.
+ *  - Inside a region, the same best-fit LFB search as 'LeanTreeAllocator'.
+ *  - tryExpand() waits for the block's region, as the block cannot be moved to another one.
+ *
+ * LIMITATIONS:
+ *  - Same as 'LeanTreeAllocator', except thread safety.
+ *  - It is not lock-free: a thread which needs a locked region (tryExpand(), validate(), or an
+ *    allocation after every unlocked region failed) spins on its lock, yielding. A thread
+ *    preempted while holding a lock delays them. Frees never wait.
+ *  - basicBlockSize is at least a pointer size, to link the remote frees.
+ *  - Remote frees are not reclaimed until some thread locks their region again. Until then, they
+ *    still count in 'bytesUsed'.
+ *  - Pointer checks which need the tree (a pointer to the middle of a block) are done when the
+ *    free is applied, which for remote frees happens in the next lock holder's thread.
+ *  - stats() only reads the atomic counters of the regions, so it may run concurrently with other
+ *    operations. It does not report 'largestFreeBlock', which would need the byte nodes of every
+ *    region.
+ *  - validate() must not run concurrently with any other operation.
+ *
+ * CONFIGURATION:
+ *  RegionLockedLeanTreeAllocator alloc(
+ *      backing,
+ *      {.tree = {.totalSize = 1_MB, .maxAllocSize = 64_KB}, .regions = 8}
+ *  );
+ *
+ *  tree:    'LeanTreeAllocator' parameters. The tree metadata, about
+ *           totalSize / (3 × basicBlockSize) bytes rounded up to a power of 2, is allocated in the
+ *           first top level block, so it must not be larger than maxAllocSize. With the default
+ *           basicBlockSize (16B), 1 MB trees need maxAllocSize ≥ 32 KB.
+ *  regions: Number of regions. 0 (default) is one per hardware thread. Clamped to the number of
+ *           top level blocks, which is totalSize / maxAllocSize, and to 64. Regions span several
+ *           top level blocks when there are more blocks than regions.
+ */
+namespace coll
+{
+class RegionLockedLeanTreeAllocator : public IAllocator
+{
+public:
+    struct Parameters
+    {
+        LeanTreeAllocator::Parameters tree;
+        count_t regions = 0;
+    };
+
+    using Stats = LeanTreeAllocator::Stats;
+
+    RegionLockedLeanTreeAllocator(IAllocator& backing, const Parameters& params = Parameters());
+    ~RegionLockedLeanTreeAllocator();
+
+    // IAllocator implementation
+    SAllocResult alloc(byte_size bytes, align a) override;
+    byte_size tryExpand(byte_size bytes, void*) override;
+    void free(void*) override;
+    ////////
+
+    Stats stats() const;
+    Parameters params() const { return {m_tree.params(), m_regionCount}; }
+
+    count_t regionCount() const { return m_regionCount; }
+    count_t homeRegion() const;
+
+    bool validate(std::ostream& errorLog);
+
+private:
+    struct SRemoteFree
+    {
+        SRemoteFree* next;
+    };
+
+    // On its own cache line, as every thread mostly works on its home region. 'busy' is its lock.
+    struct alignas(64) SRegion
+    {
+        std::atomic<bool> busy = false;
+        std::atomic<SRemoteFree*> remoteFrees = nullptr;
+        std::atomic<byte_size> bytesUsed = 0;
+    };
+
+    class RegionOwner;
+
+    SAllocResult allocInRegion(count_t region, byte_size bytes, align a);
+    void applyRemoteFrees(SRegion& region);
+    void pushRemoteFree(SRegion& region, void* buffer);
+
+    count_t regionOf(count_t basicBlockIndex) const;
+
+    static bool tryAcquire(SRegion& region);
+    static void acquire(SRegion& region);
+
+    IAllocator& m_backing;
+    LeanTreeAllocator m_tree;
+    SRegion* m_regions;
+    count_t m_regionCount;
+    count_t m_blocksPerRegion;
+};
+} // namespace coll
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2026 Guillermo Hernan Martin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "../allocator.h"
+
+#include <atomic>
+#include <mutex>
+
+/**
+ * @brief SizeClassAllocator: general purpose, thread-safe default allocator
+ *
+ * DESIGN:
+ *  - Blocks up to 'Limits::maxMediumSize' are served from 52 size classes: 16-byte steps up to
+ *    128 bytes, then 4 classes per power of 2.
+ *  - Small classes (up to 'Limits::maxSmallSize') carve their blocks from 64 KiB chunks, aligned to
+ *    their size, which hold a header at the start. Any block finds its header by masking its
+ *    address.
+ *  - Medium classes carve their blocks from 1 MiB spans, taken in order from a single address
+ *    range reserved on first use. A byte per span, at the start of the range, tells its class.
+ *  - Large blocks are mapped directly from the OS, reserving 8 times their size of address space,
+ *    so they can grow in place. A few freed mappings are kept, still committed, for later large
+ *    blocks.
+ *  - Every thread keeps a small cache of free blocks per size class. Blocks move between the
+ *    thread caches and the central free lists (one mutex per class) in batches.
+ *
+ * ALLOCATION POLICY:
+ *  - Smallest size class whose blocks are large enough and naturally aligned to the request
+ *    ('a'). Blocks of a class are aligned to the lowest set bit of its size.
+ *  - Requests which do not fit in any class, by size or by alignment, go to the large path.
+ *  - Large blocks reuse the smallest cached mapping which can hold them, if it does not have more
+ *    than twice the pages they need committed. Otherwise, they get a new mapping.
+ *  - 'SAllocResult::bytes' reports the real usable size: the class size or the committed pages.
+ *
+ * tryExpand():
+ *  - Small and medium blocks: succeeds while the new size fits in the block's size class.
+ *  - Large blocks: commits more of the reserved address space, without moving the block.
+ *  - Returns the usable size of the block, which may be lower than the requested one.
+ *
+ * STRENGTHS:
+ *  - Lock-free fast path on the thread cache for alloc and free.
+ *  - Honors any alignment up to 'Limits::maxAlign'.
+ *  - In-place growth of large arrays ('darray' asks 'tryExpand' before moving its items).
+ *
+ * LIMITATIONS:
+ *  - Chunks of the small size classes and spans of the medium ones are never returned to the OS.
+ *  - Once the medium range is exhausted (64 GiB; 256 MiB on 32-bit builds), or if it could not
+ *    be reserved, medium requests go to the large path.
+ *  - Cached large mappings (up to 16, and 64 MiB; 8 MiB on 32-bit builds) stay committed until
+ *    they are reused or evicted by newer ones.
+ *  - Alignments >= 'Limits::chunkSize' are not supported (alloc fails).
+ *  - Blocks freed by another thread go to that thread's cache, not back to the owner's one.
+ *
+ * USAGE:
+ *  There is a single instance, 'SizeClassAllocator::instance()', which is what
+ *  'defaultAllocator()' returns when no other allocator has been set.
+ */
+namespace coll
+{
+class SizeClassAllocator final : public IAllocator
+{
+public:
+    struct Limits
+    {
+        static constexpr byte_size chunkSize = 64 * 1024;
+        static constexpr byte_size maxSmallSize = 8 * 1024;
+        static constexpr byte_size maxMediumSize = 256 * 1024;
+        static constexpr count_t sizeClasses = 52;
+        static constexpr align maxAlign = align::from_bytes(chunkSize / 2);
+    };
+
+    struct Stats
+    {
+        byte_size chunkBytes = 0;  // Memory of the small-block chunks.
+        byte_size spanBytes = 0;   // Memory of the medium-block spans.
+        byte_size largeBytes = 0;  // Committed memory of the large blocks.
+        count_t largeBlocks = 0;
+        byte_size cachedBytes = 0; // Committed memory of the cached large mappings.
+    };
+
+    static SizeClassAllocator& instance();
+
+    // IAllocator implementation
+    SAllocResult alloc(byte_size bytes, align a) override;
+    byte_size tryExpand(byte_size bytes, void*) override;
+    void free(void*) override;
+    ////////
+
+    // Usable size of an allocated block.
+    byte_size usableSize(const void* block) const;
+
+    // Returns the free blocks cached by the calling thread to the central lists.
+    void flushThreadCache();
+
+    Stats stats() const;
+
+private:
+    struct SFreeBlock;
+    struct SChunkHeader;
+    friend struct SThreadCache;
+
+    struct SCentralList
+    {
+        std::mutex lock;
+        SFreeBlock* head = nullptr;
+        uint8_t* carveNext = nullptr;
+        uint8_t* carveEnd = nullptr;
+    };
+
+    SizeClassAllocator();
+    SizeClassAllocator(const SizeClassAllocator&) = delete;
+    SizeClassAllocator& operator=(const SizeClassAllocator&) = delete;
+
+    static SChunkHeader& chunkOf(const void* block);
+    uint32_t classOf(const void* block) const;
+
+    SAllocResult smallAlloc(count_t sizeClass);
+    SAllocResult largeAlloc(byte_size bytes, align a);
+    SChunkHeader* takeCachedLarge(byte_size committed);
+    void smallFree(count_t sizeClass, void* block);
+    void largeFree(SChunkHeader& chunk);
+    byte_size largeExpand(SChunkHeader& chunk, byte_size bytes);
+
+    count_t fetchBatch(count_t sizeClass, count_t maxBlocks, SFreeBlock*& head);
+    void releaseBatch(count_t sizeClass, SFreeBlock* head, SFreeBlock* tail);
+    bool carveChunk(count_t sizeClass, SCentralList& list);
+    bool carveSpan(count_t sizeClass, SCentralList& list);
+    uint8_t* newChunk();
+
+    SCentralList m_central[Limits::sizeClasses];
+
+    std::mutex m_segmentLock;
+    uint8_t* m_segmentNext = nullptr;
+    uint8_t* m_segmentEnd = nullptr;
+
+    // Medium range. Fixed on construction but for 'm_mediumNext', which 'm_segmentLock' guards.
+    uint8_t* m_mediumBase = nullptr;
+    uint8_t* m_mediumNext = nullptr;
+    uint8_t* m_mediumEnd = nullptr;
+    uint8_t* m_spanClasses = nullptr;
+
+    // Freed large mappings, newest first, linked through their headers.
+    std::mutex m_largeCacheLock;
+    SChunkHeader* m_largeCache = nullptr;
+    count_t m_largeCacheCount = 0;
+
+    std::atomic<byte_size> m_chunkBytes = 0;
+    std::atomic<byte_size> m_spanBytes = 0;
+    std::atomic<byte_size> m_largeBytes = 0;
+    std::atomic<count_t> m_largeBlocks = 0;
+    std::atomic<byte_size> m_cachedBytes = 0;
+};
+} // namespace coll
@@ -26,14 +26,47 @@
 
 #include <cstddef>
 #include <stdexcept>
+#include <type_traits>
 
 namespace coll
 {
 
-template <typename Key, typename Value, byte_size Order = 4>
+// Compile time options of 'bmap'.
+struct BMapOptions
+{
+    // Stores the values out of the leaves (see 'BTreeCoreParams::SeparateValues'). Pays off with big
+    // values, when most accesses only need the keys.
+    bool SeparateValues = false;
+
+    // Enables 'nth' and 'rank', and makes 'count(keyLeft, keyRight)' O(log n) (see
+    // 'BTreeCoreParams::OrderStatistics').
+    bool OrderStatistics = false;
+
+    // Enables 'snapshot' (see 'BTreeCoreParams::Snapshots'). Values must be copyable.
+    bool Snapshots = false;
+
+    // Compares key prefixes before whole keys (see 'BTreeCoreParams::KeyPrefixes'). Needs a comparator
+    // with 'prefix', like the default one for 'std::string' keys.
+    bool KeyPrefixes = false;
+};
+
+// Value kept by 'bmap::merge' for the keys found in both maps.
+enum class MergePolicy
+{
+    KeepExisting,
+    Overwrite
+};
+
+// 'Compare' orders the keys, as in 'std::map' (see 'BTreeCore').
+template <
+    typename Key,
+    typename Value,
+    byte_size Order = 4,
+    BMapOptions Options = BMapOptions {},
+    typename Compare = KeyLess<Key>>
 class bmap
 {
-    template <typename Key, typename Value, byte_size Order>
+    template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
     friend class BTreeChecker;
 
     static void destroyValue(void* valueBuffer) { reinterpret_cast<Value*>(valueBuffer)->~Value(); }
@@ -44,11 +77,29 @@ class bmap
         new (dest) Value(std::move(srcValue));
     }
 
+    // Only called by copies and snapshots, so move-only values are still accepted otherwise.
+    static void copyValue(void* dest, const void* src)
+    {
+        if constexpr (std::is_copy_constructible_v<Value>)
+            new (dest) Value(*reinterpret_cast<const Value*>(src));
+    }
+
     static constexpr BTreeCoreParams configure()
     {
-        return BTreeCoreParams {Order, sizeof(Value), alignof(Value), destroyValue, moveValue};
+        return BTreeCoreParams {
+            Order,
+            sizeof(Value),
+            alignof(Value),
+            destroyValue,
+            moveValue,
+            copyValue,
+            Options.SeparateValues,
+            Options.OrderStatistics,
+            Options.Snapshots,
+            Options.KeyPrefixes
+        };
     }
-    using BTreeCoreType = BTreeCore<Key, configure()>;
+    using BTreeCoreType = BTreeCore<Key, configure(), Compare>;
 
 public:
     struct InsertResult;
@@ -59,10 +110,18 @@ public:
     class Handle;
     class Range;
     class InvRange;
+    class SnapshotRange;
+    class Snapshot;
+
+    static_assert(
+        !Options.Snapshots || std::is_copy_constructible_v<Value>,
+        "bmap: snapshots need copyable values"
+    );
 
     // STL - compatible child types
     using key_type = Key;
     using mapped_type = Value;
+    using key_compare = Compare;
     using size_type = BTreeCoreType::size_type;
 
     bmap(IAllocator& alloc = defaultAllocator())
@@ -70,6 +129,11 @@ public:
     {
     }
 
+    explicit bmap(const Compare& comp, IAllocator& alloc = defaultAllocator())
+        : m_core(alloc, comp)
+    {
+    }
+
     bmap(std::initializer_list<Entry> init_list, IAllocator& alloc = defaultAllocator());
     ~bmap();
 
@@ -79,6 +143,17 @@ public:
     bmap& operator=(const bmap& rhs);
     bmap& operator=(bmap&& rhs) noexcept = default;
 
+    // Builds a bmap from entries sorted by key, in linear time. Entries may have 'key' / 'value' members
+    // (like bmap entries) or 'first' / 'second' (like std::pair). For repeated keys, the first entry is
+    // kept. Throws 'std::invalid_argument' if the entries are not sorted.
+    template <typename EntryRange>
+    static bmap from_sorted(
+        const EntryRange& entries,
+        float fillFactor = 1.0f,
+        IAllocator& alloc = defaultAllocator(),
+        const Compare& comp = Compare()
+    );
+
     InsertResult insert(const Key& key, const Value& value);
     InsertResult insert(const Entry& entry) { return insert(entry.key, entry.value); }
 
@@ -88,11 +163,46 @@ public:
     template <typename M>
     InsertResult insert_or_assign(const Key& key, M&& obj);
 
-    Handle find(const Key& key) const;
+    // Lookups also take types which convert to 'Key'. For a 'TransparentKey', such as 'std::string',
+    // they take any type comparable to it, such as 'std::string_view', without building a 'Key'.
+    template <LookupKeyFor<Key, Compare> K = Key>
+    Handle find(const K& key) const;
+
+    // Looks up many keys at once, storing in 'results[i]' the result of 'find(keys[i])'. Faster than
+    // calling 'find' for each key, specially on big maps, and more so if 'keys' is sorted. Throws
+    // 'std::invalid_argument' if 'results' is shorter than 'keys'.
+    void find_batch(span<const Key> keys, span<Handle> results) const;
     void clear();
 
-    bool contains(const Key& key) const { return m_core.contains(key); }
-    size_type count(const Key& key) const { return m_core.count(key); }
+    template <LookupKeyFor<Key, Compare> K = Key>
+    bool contains(const K& key) const { return m_core.contains(key); }
+    template <LookupKeyFor<Key, Compare> K = Key>
+    size_type count(const K& key) const { return m_core.count(key); }
+
+    // Number of entries whose keys are in [keyLeft, keyRight).
+    template <LookupKeyFor<Key, Compare> K = Key>
+    size_type count(const K& keyLeft, const K& keyRight) const
+    {
+        return m_core.count(keyLeft, keyRight);
+    }
+
+    // Only with 'OrderStatistics'. Entry at position 'index' in key order (empty if 'index' is not less
+    // than 'size()'), and number of entries whose keys are less than 'key'. Both are O(log n).
+    Handle nth(size_type index) const { return Handle(m_core.nth(index)); }
+    template <LookupKeyFor<Key, Compare> K = Key>
+    size_type rank(const K& key) const { return m_core.rank(key); }
+
+    // Entries from the first key not less than 'key' / whose keys are in [keyLeft, keyRight).
+    template <LookupKeyFor<Key, Compare> K = Key>
+    Range lower_bound(const K& key) const
+    {
+        return Range(typename BTreeCoreType::Range(m_core.lower_bound(key), {}));
+    }
+    template <LookupKeyFor<Key, Compare> K = Key>
+    Range range(const K& keyLeft, const K& keyRight) const
+    {
+        return Range(m_core.range(keyLeft, keyRight));
+    }
 
     Range begin() const { return Range(m_core.begin()); }
     Sentinel end() const { return Sentinel(); }
@@ -100,15 +210,73 @@ public:
     InvRange rbegin() const { return InvRange(m_core.rbegin()); }
     Sentinel rend() const { return Sentinel(); }
 
+    // Calls 'fn(keys, values)' for each leaf, in key order, with 'span<const Key>' and
+    // 'span<const Value>' of the same size. Faster than iterating entry by entry, and lets the consumer
+    // process (or vectorize over) whole runs of contiguous keys and values.
+    template <typename ChunkFn>
+    void for_each_leaf_chunk(ChunkFn&& fn) const;
+
     size_type size() const { return m_core.size(); }
     bool empty() const { return m_core.empty(); }
+    const Compare& key_comp() const { return m_core.key_comp(); }
 
     Value& operator[](const Key& key);
     const Value& operator[](const Key& key) const { return at(key); }
-    const Value& at(const Key& key) const;
+    template <LookupKeyFor<Key, Compare> K = Key>
+    const Value& at(const K& key) const;
 
     bool erase(const Key& key) { return m_core.erase(key); }
 
+    // Same as calling 'insert' for each entry / 'erase' for each key, but much faster if they are
+    // sorted by key, as each one starts from the path to the previous one instead of from the root.
+    // Entries are accepted in the same formats as 'from_sorted'. Return the number of entries inserted
+    // / erased.
+    template <typename EntryRange>
+    size_type insert_sorted(const EntryRange& entries);
+    template <typename KeyRange>
+    size_type erase_sorted(const KeyRange& keys);
+
+    // Erase the entries in [keyLeft, keyRight) / with keys less than 'key', and return how many. Whole
+    // subtrees inside the range are freed at once, so it costs O(log n) plus one step per leaf erased
+    // (see 'BTreeCore::erase_range').
+    size_type erase_range(const Key& keyLeft, const Key& keyRight)
+    {
+        return m_core.erase_range(keyLeft, keyRight);
+    }
+    size_type erase_prefix(const Key& key) { return m_core.erase_prefix(key); }
+
+    // Adds the entries of 'other', in O(n + m): both maps are walked in key order at the same time, and
+    // this one is rebuilt bottom-up. 'policy' gives the value of the keys found in both: a
+    // 'MergePolicy', or a function 'Value(const Value& existing, const Value& other)'. This map is not
+    // modified if an exception is thrown.
+    template <typename Policy = MergePolicy>
+    void merge(const bmap& other, Policy&& policy = MergePolicy::KeepExisting);
+
+    // Maps with the entries of 'left' and 'right' / of 'left' whose keys are in 'right' / of 'left'
+    // whose keys are not in 'right'. Values of 'left' are taken for keys in both. Built like 'merge',
+    // in O(n + m), with the allocator of 'left'.
+    static bmap set_union(const bmap& left, const bmap& right);
+    static bmap set_intersection(const bmap& left, const bmap& right);
+    static bmap set_difference(const bmap& left, const bmap& right);
+
+    // Moves the entries whose keys are not less than 'key' to the returned map: only the nodes on the
+    // path to 'key' are cut, and the rest change hands as they are. O(log n) with 'OrderStatistics',
+    // plus O(min(size(), returned size) / Order) otherwise, to count the entries of each map. Both maps
+    // may then be used on different threads. Without 'Snapshots', this map is not modified if an
+    // exception is thrown (see 'BTreeCore::split_at').
+    bmap split_at(const Key& key);
+
+    // Appends the entries of 'other', leaving it empty. Their keys must all be greater than those of
+    // this map, or 'std::invalid_argument' is thrown. O(log n), unless the maps use different
+    // allocators, or both share their nodes with other maps split from them (see 'BTreeCore::join').
+    void join(bmap&& other) { m_core.join(std::move(other.m_core)); }
+
+    // Only with 'Snapshots'. Read-only copy of the current contents, in O(1), which is not affected by
+    // later changes to the map. Both share their nodes until the map modifies them (see
+    // 'BTreeCore::snapshot'). Snapshots may be read and destroyed on other threads while the map is
+    // modified, if the allocator is thread safe.
+    Snapshot snapshot() const { return Snapshot(m_core.snapshot()); }
+
     struct Entry
     {
         const Key& key;
@@ -223,15 +391,122 @@ public:
         BTreeCoreType::InvRange m_range;
     }; // Class Range
 
+    class SnapshotRange
+    {
+    public:
+        SnapshotRange() = default;
+
+        Entry front() const { return {m_range.key(), *reinterpret_cast<const Value*>(m_range.value())}; }
+
+        const Key& key() const { return m_range.key(); }
+        const Value& value() const { return *reinterpret_cast<const Value*>(m_range.value()); }
+
+        bool empty() const { return m_range.empty(); }
+        SnapshotRange begin() const { return *this; }
+        Sentinel end() const { return Sentinel(); }
+
+        Entry operator*() const { return front(); }
+
+        bool operator!=(Sentinel) const { return !empty(); }
+        bool operator==(Sentinel) const { return empty(); }
+
+        SnapshotRange& operator++()
+        {
+            ++m_range;
+            return *this;
+        }
+
+        SnapshotRange operator++(int) { return SnapshotRange(m_range++); }
+
+    private:
+        friend class bmap;
+
+        SnapshotRange(const BTreeCoreType::SnapshotRange& range)
+            : m_range {range}
+        {
+        }
+
+        BTreeCoreType::SnapshotRange m_range;
+    }; // class SnapshotRange
+
+    class Snapshot
+    {
+    public:
+        Snapshot() = default;
+
+        template <LookupKeyFor<Key, Compare> K = Key>
+        Handle find(const K& key) const { return Handle(m_snapshot.find_first(key)); }
+        template <LookupKeyFor<Key, Compare> K = Key>
+        bool contains(const K& key) const { return m_snapshot.find_first(key).has_value(); }
+
+        template <LookupKeyFor<Key, Compare> K = Key>
+        const Value& at(const K& key) const
+        {
+            const auto h = find(key);
+
+            if (!h)
+                throw std::out_of_range("bmap::Snapshot: key not found");
+            return h.value();
+        }
+
+        size_type size() const { return m_snapshot.size(); }
+        bool empty() const { return m_snapshot.empty(); }
+
+        SnapshotRange begin() const { return SnapshotRange(m_snapshot.begin()); }
+        Sentinel end() const { return Sentinel(); }
+
+    private:
+        friend class bmap;
+
+        Snapshot(BTreeCoreType::Snapshot&& snapshot)
+            : m_snapshot(std::move(snapshot))
+        {
+        }
+
+        BTreeCoreType::Snapshot m_snapshot;
+    }; // class Snapshot
+
 private:
     BTreeCoreType m_core;
+
+    template <typename BothFn>
+    static bmap combine(
+        const bmap& left,
+        const bmap& right,
+        bool withLeft,
+        bool withRight,
+        bool withBoth,
+        BothFn&& constructBoth
+    );
+
+    // Entries with 'key' / 'value' members, or 'first' / 'second'.
+    template <typename SourceEntry>
+    static const auto& entryKey(const SourceEntry& entry)
+    {
+        if constexpr (requires { entry.key; })
+            return entry.key;
+        else
+            return entry.first;
+    }
+
+    template <typename SourceEntry>
+    static const auto& entryValue(const SourceEntry& entry)
+    {
+        if constexpr (requires { entry.value; })
+            return entry.value;
+        else
+            return entry.second;
+    }
 };
 
 // ------------------------------------------------------------
 // Constructores
 // ------------------------------------------------------------
-template <typename Key, typename Value, byte_size Order>
-bmap<Key, Value, Order>::bmap(std::initializer_list<Entry> init_list, IAllocator& alloc)
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+bmap<Key, Value, Order, Options, Compare>::bmap(
+    std::initializer_list<Entry> init_list,
+    IAllocator& alloc
+)
     : bmap(alloc)
 {
     for (const auto& entry : init_list)
@@ -239,41 +514,182 @@ bmap<Key, Value, Order>::bmap(std::initializer_list<Entry> init_list, IAllocator
 }
 
 // Definición del constructor de copia
-template <typename Key, typename Value, byte_size Order>
-bmap<Key, Value, Order>::bmap(const bmap& rhs)
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+bmap<Key, Value, Order, Options, Compare>::bmap(const bmap& rhs)
     : bmap(rhs.m_core.allocator())
 {
-    // Insertamos todos los pares del otro bmap
-    for (const auto& entry : rhs)
-        insert(entry);
+    static_assert(std::is_copy_constructible_v<Value>, "bmap: copies need copyable values");
+
+    // Copia nodo a nodo, con la misma forma que el original
+    m_core.copy_from(rhs.m_core);
 }
 
 // Definición del operador de copia
-template <typename Key, typename Value, byte_size Order>
-bmap<Key, Value, Order>& bmap<Key, Value, Order>::operator=(const bmap& rhs)
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+bmap<Key, Value, Order, Options, Compare>&
+bmap<Key, Value, Order, Options, Compare>::operator=(const bmap& rhs)
 {
+    static_assert(std::is_copy_constructible_v<Value>, "bmap: copies need copyable values");
+
     if (this == &rhs)
         return *this;
 
-    clear();
-    for (const auto& entry : rhs)
-        insert(entry);
+    // Se copia aparte para no perder el contenido actual si la copia falla
+    BTreeCoreType copy(m_core.allocator(), rhs.key_comp());
+    copy.copy_from(rhs.m_core);
+    m_core = std::move(copy);
 
     return *this;
 }
 
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+template <typename EntryRange>
+bmap<Key, Value, Order, Options, Compare>
+bmap<Key, Value, Order, Options, Compare>::from_sorted(
+    const EntryRange& entries,
+    float fillFactor,
+    IAllocator& alloc,
+    const Compare& comp
+)
+{
+    bmap result(comp, alloc);
+    auto loader = result.m_core.bulk_load(fillFactor);
+
+    for (const auto& entry : entries)
+    {
+        const auto& value = entryValue(entry);
+        loader.append(entryKey(entry), [&value](void* buffer) { new (buffer) Value(value); });
+    }
+
+    loader.finish();
+    return result;
+}
+
+// ------------------------------------------------------------
+// Mezcla y operaciones de conjuntos
+// ------------------------------------------------------------
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+template <typename Policy>
+void bmap<Key, Value, Order, Options, Compare>::merge(const bmap& other, Policy&& policy)
+{
+    auto constructBoth = [&policy](void* buffer, const Range& existing, const Range& added) {
+        if constexpr (std::is_same_v<std::decay_t<Policy>, MergePolicy>)
+            new (buffer) Value(policy == MergePolicy::KeepExisting ? existing.value() : added.value());
+        else
+            new (buffer) Value(policy(existing.value(), added.value()));
+    };
+
+    bmap result = combine(*this, other, true, true, true, constructBoth);
+    m_core = std::move(result.m_core);
+}
+
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+bmap<Key, Value, Order, Options, Compare>
+bmap<Key, Value, Order, Options, Compare>::set_union(const bmap& left, const bmap& right)
+{
+    return combine(left, right, true, true, true, [](void* buffer, const Range& l, const Range&) {
+        new (buffer) Value(l.value());
+    });
+}
+
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+bmap<Key, Value, Order, Options, Compare>
+bmap<Key, Value, Order, Options, Compare>::set_intersection(const bmap& left, const bmap& right)
+{
+    return combine(left, right, false, false, true, [](void* buffer, const Range& l, const Range&) {
+        new (buffer) Value(l.value());
+    });
+}
+
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+bmap<Key, Value, Order, Options, Compare>
+bmap<Key, Value, Order, Options, Compare>::set_difference(const bmap& left, const bmap& right)
+{
+    return combine(left, right, true, false, false, [](void*, const Range&, const Range&) {});
+}
+
+// Walks both maps in key order at the same time, appending to the result the entries only in 'left' /
+// only in 'right' if 'withLeft' / 'withRight' are set. For keys in both, if 'withBoth' is set,
+// 'constructBoth(buffer, l, r)' builds the value.
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+template <typename BothFn>
+bmap<Key, Value, Order, Options, Compare> bmap<Key, Value, Order, Options, Compare>::combine(
+    const bmap& left,
+    const bmap& right,
+    bool withLeft,
+    bool withRight,
+    bool withBoth,
+    BothFn&& constructBoth
+)
+{
+    bmap result(left.key_comp(), left.m_core.allocator());
+    const Compare& less = left.key_comp();
+    auto loader = result.m_core.bulk_load();
+
+    auto copyEntry = [&loader](const Range& entry) {
+        loader.append(entry.key(), [&entry](void* buffer) { new (buffer) Value(entry.value()); });
+    };
+
+    Range l = left.begin();
+    Range r = right.begin();
+
+    while (!l.empty() && !r.empty())
+    {
+        if (less(l.key(), r.key()))
+        {
+            if (withLeft)
+                copyEntry(l);
+            ++l;
+        }
+        else if (less(r.key(), l.key()))
+        {
+            if (withRight)
+                copyEntry(r);
+            ++r;
+        }
+        else
+        {
+            if (withBoth)
+                loader.append(l.key(), [&](void* buffer) { constructBoth(buffer, l, r); });
+            ++l;
+            ++r;
+        }
+    }
+
+    for (; withLeft && !l.empty(); ++l)
+        copyEntry(l);
+    for (; withRight && !r.empty(); ++r)
+        copyEntry(r);
+
+    loader.finish();
+    return result;
+}
+
+// ------------------------------------------------------------
+// División
+// ------------------------------------------------------------
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+bmap<Key, Value, Order, Options, Compare>
+bmap<Key, Value, Order, Options, Compare>::split_at(const Key& key)
+{
+    bmap result(key_comp(), m_core.allocator());
+
+    result.m_core = m_core.split_at(key);
+    return result;
+}
+
 // ------------------------------------------------------------
 // Inicialización y limpieza
 // ------------------------------------------------------------
 
-template <typename Key, typename Value, byte_size Order>
-bmap<Key, Value, Order>::~bmap()
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+bmap<Key, Value, Order, Options, Compare>::~bmap()
 {
     clear();
 }
 
-template <typename Key, typename Value, byte_size Order>
-void bmap<Key, Value, Order>::clear()
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+void bmap<Key, Value, Order, Options, Compare>::clear()
 {
     m_core.clear();
 }
@@ -281,11 +697,11 @@ void bmap<Key, Value, Order>::clear()
 // ------------------------------------------------------------
 // Inserción pública
 // ------------------------------------------------------------
-template <typename Key, typename Value, byte_size Order>
-typename bmap<Key, Value, Order>::InsertResult
-bmap<Key, Value, Order>::insert(const Key& key, const Value& value)
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+typename bmap<Key, Value, Order, Options, Compare>::InsertResult
+bmap<Key, Value, Order, Options, Compare>::insert(const Key& key, const Value& value)
 {
-    auto [location, valueBuffer, newEntry] = m_core.insert(key);
+    auto [location, valueBuffer, newEntry] = m_core.try_insert(key);
 
     // This function does not overwrite previous values.
     if (!newEntry)
@@ -295,12 +711,12 @@ bmap<Key, Value, Order>::insert(const Key& key, const Value& value)
     return {Handle(location), true};
 }
 
-template <typename Key, typename Value, byte_size Order>
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
 template <typename... Args>
-typename bmap<Key, Value, Order>::InsertResult
-bmap<Key, Value, Order>::emplace(const Key& key, Args&&... args)
+typename bmap<Key, Value, Order, Options, Compare>::InsertResult
+bmap<Key, Value, Order, Options, Compare>::emplace(const Key& key, Args&&... args)
 {
-    auto [location, valueBuffer, newEntry] = m_core.insert(key);
+    auto [location, valueBuffer, newEntry] = m_core.try_insert(key);
 
     // This function does not overwrite previous values.
     if (!newEntry)
@@ -310,10 +726,10 @@ bmap<Key, Value, Order>::emplace(const Key& key, Args&&... args)
     return {Handle(location), true};
 }
 
-template <typename Key, typename Value, byte_size Order>
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
 template <typename M>
-typename bmap<Key, Value, Order>::InsertResult
-bmap<Key, Value, Order>::insert_or_assign(const Key& key, M&& obj)
+typename bmap<Key, Value, Order, Options, Compare>::InsertResult
+bmap<Key, Value, Order, Options, Compare>::insert_or_assign(const Key& key, M&& obj)
 {
     auto [location, valueBuffer, newEntry] = m_core.insert(key);
 
@@ -330,22 +746,92 @@ bmap<Key, Value, Order>::insert_or_assign(const Key& key, M&& obj)
     }
 }
 
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+template <typename EntryRange>
+typename bmap<Key, Value, Order, Options, Compare>::size_type
+bmap<Key, Value, Order, Options, Compare>::insert_sorted(const EntryRange& entries)
+{
+    auto cursor = m_core.sorted_cursor();
+    size_type inserted = 0;
+
+    for (const auto& entry : entries)
+    {
+        auto [location, valueBuffer, newEntry] = cursor.insert(entryKey(entry));
+
+        // Like 'insert', previous values are not overwritten.
+        if (newEntry)
+        {
+            new (valueBuffer) Value(entryValue(entry));
+            ++inserted;
+        }
+    }
+
+    return inserted;
+}
+
+// ------------------------------------------------------------
+// Borrado
+// ------------------------------------------------------------
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+template <typename KeyRange>
+typename bmap<Key, Value, Order, Options, Compare>::size_type
+bmap<Key, Value, Order, Options, Compare>::erase_sorted(const KeyRange& keys)
+{
+    auto cursor = m_core.sorted_cursor();
+    size_type erased = 0;
+
+    for (const auto& key : keys)
+    {
+        if (cursor.erase(key))
+            ++erased;
+    }
+
+    return erased;
+}
+
 // ------------------------------------------------------------
 // Búsqueda
 // ------------------------------------------------------------
-template <typename Key, typename Value, byte_size Order>
-typename bmap<Key, Value, Order>::Handle bmap<Key, Value, Order>::find(const Key& key) const
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+template <LookupKeyFor<Key, Compare> K>
+typename bmap<Key, Value, Order, Options, Compare>::Handle
+bmap<Key, Value, Order, Options, Compare>::find(const K& key) const
 {
     return Handle {m_core.find_first(key)};
 }
 
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+void bmap<Key, Value, Order, Options, Compare>::find_batch(
+    span<const Key> keys,
+    span<Handle> results
+) const
+{
+    if (results.size() < keys.size())
+        throw std::invalid_argument("bmap::find_batch: results shorter than keys");
+
+    m_core.find_batch(keys, [&results](size_type i, const BTreeCoreType::Handle& handle) {
+        results[i] = Handle(handle);
+    });
+}
+
+// Leaf values are stored as 'sizeof(Value)' bytes aligned to 'alignof(Value)', so they can be
+// viewed as an array of 'Value'.
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+template <typename ChunkFn>
+void bmap<Key, Value, Order, Options, Compare>::for_each_leaf_chunk(ChunkFn&& fn) const
+{
+    m_core.for_each_leaf_chunk([&fn](span<const Key> keys, const void* values) {
+        fn(keys, span<const Value>(static_cast<const Value*>(values), keys.size()));
+    });
+}
+
 // ------------------------------------------------------------
 // Operator []
 // ------------------------------------------------------------
 
 // Definición operator[]
-template <typename Key, typename Value, byte_size Order>
-Value& bmap<Key, Value, Order>::operator[](const Key& key)
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+Value& bmap<Key, Value, Order, Options, Compare>::operator[](const Key& key)
 {
     auto [location, valueBuffer, newEntry] = m_core.insert(key);
 
@@ -356,8 +842,9 @@ Value& bmap<Key, Value, Order>::operator[](const Key& key)
 }
 
 // Devuelve referencia const a Value existente, o lanza si no está.
-template <typename Key, typename Value, byte_size Order>
-const Value& bmap<Key, Value, Order>::at(const Key& key) const
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+template <LookupKeyFor<Key, Compare> K>
+const Value& bmap<Key, Value, Order, Options, Compare>::at(const K& key) const
 {
     auto h = find(key);
 
@@ -370,8 +857,11 @@ const Value& bmap<Key, Value, Order>::at(const Key& key) const
 // ------------------------------------------------------------
 // Comparación
 // ------------------------------------------------------------
-template <typename Key, typename Value, byte_size Order>
-std::strong_ordering operator<=>(const bmap<Key, Value, Order>& lhs, const bmap<Key, Value, Order>& rhs)
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+std::strong_ordering operator<=>(
+    const bmap<Key, Value, Order, Options, Compare>& lhs,
+    const bmap<Key, Value, Order, Options, Compare>& rhs
+)
 {
     auto rhs_range = rhs.begin();
 
@@ -394,8 +884,11 @@ std::strong_ordering operator<=>(const bmap<Key, Value, Order>& lhs, const bmap<
     return rhs_range.empty() ? std::strong_ordering::equal : std::strong_ordering::less;
 }
 
-template <typename Key, typename Value, byte_size Order>
-bool operator==(const bmap<Key, Value, Order>& lhs, const bmap<Key, Value, Order>& rhs)
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+bool operator==(
+    const bmap<Key, Value, Order, Options, Compare>& lhs,
+    const bmap<Key, Value, Order, Options, Compare>& rhs
+)
 {
     return (lhs <=> rhs) == 0;
 }
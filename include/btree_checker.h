@@ -32,11 +32,11 @@ namespace coll
 {
 using ErrorReport = std::vector<std::string>;
 
-template <typename Key, BTreeCoreParams Params>
+template <typename Key, BTreeCoreParams Params, typename Compare>
 class BTreeCoreChecker
 {
 public:
-    using CoreType = BTreeCore<Key, Params>;
+    using CoreType = BTreeCore<Key, Params, Compare>;
 
     BTreeCoreChecker(const CoreType& core)
         : m_core(core)
@@ -60,17 +60,28 @@ public:
 
             checkLeaf(*leftMost);
             checkLeaf(*rightMost);
+            check(leftMost->prev == nullptr, "Leftmost leaf has a previous leaf");
+            check(rightMost->next == nullptr, "Rightmost leaf has a next leaf");
 
             if (!m_errors.empty())
                 return m_errors;
 
-            recursiveBoundsCheck(
+            const count_t entries = recursiveBoundsCheck(
                 leftMost->key(0),
                 rightMost->key(rightMost->count() - 1),
                 *m_core.m_root,
                 0
             );
 
+            check(
+                entries == m_core.size(),
+                "Tree size (",
+                m_core.size(),
+                ") does not match its entry count (",
+                entries,
+                ")"
+            );
+
             checkLeafChain();
         }
         catch (const Abort&)
@@ -143,6 +154,8 @@ private:
 
     static std::string indent(unsigned level) { return std::string(level * 2, ' '); }
 
+    bool less(const Key& a, const Key& b) const { return m_core.m_compare(a, b); }
+
     void checkLeaf(const typename CoreType::NodeLeaf& leaf)
     {
         // 1. La hoja no debe estar vacía
@@ -151,13 +164,15 @@ private:
         // 2. Las claves deben estar ordenadas estrictamente crecientes
         for (count_t i = 1; i < leaf.count(); ++i)
         {
-            if (!(leaf.key(i - 1) < leaf.key(i)))
+            if (!less(leaf.key(i - 1), leaf.key(i)))
             {
                 check(false, "Leaf keys are not strictly ordered");
                 break; // Evitar exceso de reports repetidos
             }
         }
 
+        checkPrefixes(leaf);
+
         // 3. Coherencia de punteros prev/next
         if (leaf.prev)
             check(leaf.prev->next == &leaf, "Leaf prev->next does not match current leaf");
@@ -165,7 +180,24 @@ private:
             check(leaf.next->prev == &leaf, "Leaf next->prev does not match current leaf");
     }
 
-    void recursiveBoundsCheck(
+    // With 'KeyPrefixes', the stored prefixes must be those of the keys.
+    void checkPrefixes(const typename CoreType::Node& node)
+    {
+        if constexpr (CoreType::KeyPrefixes)
+        {
+            for (count_t i = 0; i < node.count(); ++i)
+            {
+                if (node.key_prefix(i) != Compare::prefix(node.key(i)))
+                {
+                    check(false, "Key prefix (", i, ") does not match its key");
+                    break;
+                }
+            }
+        }
+    }
+
+    // Returns the number of entries of the subtree.
+    count_t recursiveBoundsCheck(
         const Key& minKey,
         const Key& maxKey,
         const typename CoreType::Node& node,
@@ -183,7 +215,7 @@ private:
 
             // Chequeo de rango global
             check(
-                !(leaf.key(0) < minKey),
+                !less(leaf.key(0), minKey),
                 "Leaf key (",
                 keyToString(leaf.key(0)),
                 ") below minimum bound (",
@@ -191,7 +223,7 @@ private:
                 ")"
             );
             check(
-                !(maxKey < leaf.key(leaf.count() - 1)),
+                !less(maxKey, leaf.key(leaf.count() - 1)),
                 "Leaf key (",
                 keyToString(leaf.key(leaf.count() - 1)),
                 ") above or equal maximum bound (",
@@ -199,7 +231,7 @@ private:
                 ")"
             );
 
-            return;
+            return leaf.count();
         }
 
         // Nodo interno
@@ -210,12 +242,14 @@ private:
         // Verifica orden de claves internas local
         for (count_t i = 1; i < internal.count(); ++i)
         {
-            if (!(internal.key(i - 1) < internal.key(i)))
+            if (!less(internal.key(i - 1), internal.key(i)))
                 check(false, "Internal node keys not strictly ordered");
         }
+        checkPrefixes(internal);
 
         // Chequea recursivamente los hijos.
         // Cada hijo debe tener claves dentro del rango de separación.
+        count_t entries = 0;
         for (count_t i = 0; i <= internal.count(); ++i)
         {
             const Key& childMin = (i == 0) ? minKey : internal.key(i - 1);
@@ -224,8 +258,23 @@ private:
             typename CoreType::Node* child = internal.children[i];
             require(child != nullptr, "Internal node has null child pointer");
 
-            recursiveBoundsCheck(childMin, childMax, *child, level + 1);
+            const count_t childEntries = recursiveBoundsCheck(childMin, childMax, *child, level + 1);
+
+            if constexpr (CoreType::OrderStatistics)
+            {
+                check(
+                    internal.child_size(i) == childEntries,
+                    "Child size (",
+                    internal.child_size(i),
+                    ") does not match its entry count (",
+                    childEntries,
+                    ")"
+                );
+            }
+            entries += childEntries;
         }
+
+        return entries;
     }
 
     bool checkLeafChain()
@@ -242,7 +291,7 @@ private:
         {
             for (count_t i = 0; i < current->count(); ++i)
             {
-                if (lastKey <= current->key(i))
+                if (!less(current->key(i), lastKey))
                     lastKey = current->key(i);
                 else
                     ok &= check(false, "Global leaf order violation across leaves");
@@ -253,7 +302,7 @@ private:
             {
                 ok &= check(next->prev == current, "Broken linkage between leaves");
                 ok &= check(
-                    current->key(current->count() - 1) < next->key(0),
+                    less(current->key(current->count() - 1), next->key(0)),
                     "Key range overlap between adjacent leaves"
                 );
             }
@@ -298,12 +347,12 @@ private:
     ErrorReport m_errors;
 };
 
-template <typename Key, typename Value, byte_size Order>
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
 class BTreeChecker
 {
 public:
-    using MapType = bmap<Key, Value, Order>;
-    using CoreCheckerType = BTreeCoreChecker<Key, MapType::configure()>;
+    using MapType = bmap<Key, Value, Order, Options, Compare>;
+    using CoreCheckerType = BTreeCoreChecker<Key, MapType::configure(), Compare>;
 
     BTreeChecker(const MapType& map)
         : m_core(map.m_core)
@@ -318,9 +367,11 @@ private:
     CoreCheckerType m_core;
 };
 
-template <typename Key, typename Value, byte_size Order>
-BTreeChecker<Key, Value, Order> makeBtreeChecker(const bmap<Key, Value, Order>& map)
+template <typename Key, typename Value, byte_size Order, BMapOptions Options, typename Compare>
+BTreeChecker<Key, Value, Order, Options, Compare> makeBtreeChecker(
+    const bmap<Key, Value, Order, Options, Compare>& map
+)
 {
-    return BTreeChecker<Key, Value, Order>(map);
+    return BTreeChecker<Key, Value, Order, Options, Compare>(map);
 }
 } // namespace coll
\ No newline at end of file
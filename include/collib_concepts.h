@@ -27,6 +27,8 @@
 #include <concepts>
 #include <cstddef>
 #include <iterator>
+#include <string>
+#include <type_traits>
 
 namespace coll
 {
@@ -53,4 +55,30 @@ concept Range = requires(T t) {
     { std::end(t) } -> SimpleSentinelFor<decltype(std::begin(t))>;
 };
 
+// Key types whose containers look up other types comparable to them as they are, as the standard
+// containers do with 'std::less<>' ('is_transparent'). Enabled for strings, so lookups with a
+// 'std::string_view' or 'const char*' do not build a 'std::string'. Other keys may specialize it.
+template <typename Key>
+struct TransparentKey : std::false_type
+{
+};
+
+template <typename Char, typename Traits, typename Alloc>
+struct TransparentKey<std::basic_string<Char, Traits, Alloc>> : std::true_type
+{
+};
+
+// Lookups by 'K' which a transparent comparator ('Compare::is_transparent') compares directly with
+// the keys, in both directions.
+template <typename K, typename Key, typename Compare>
+concept TransparentLookup = !std::same_as<K, Key> && requires { typename Compare::is_transparent; } &&
+                            std::predicate<const Compare&, const K&, const Key&> &&
+                            std::predicate<const Compare&, const Key&, const K&>;
+
+// Keys accepted by lookups on 'Key' containers ordered by 'Compare': 'Key' itself, transparent
+// lookups, and otherwise types which convert to 'Key' (a 'Key' is built once per lookup).
+template <typename K, typename Key, typename Compare>
+concept LookupKeyFor = std::same_as<K, Key> || TransparentLookup<K, Key, Compare> ||
+                       std::convertible_to<const K&, Key>;
+
 } // namespace coll
\ No newline at end of file
@@ -27,6 +27,13 @@
 #include <limits>
 #include <stdint.h>
 
+// Members of empty types which take no space. MSVC ignores the standard attribute, for ABI reasons.
+#if defined(_MSC_VER)
+#define COLL_NO_UNIQUE_ADDRESS [[msvc::no_unique_address]]
+#else
+#define COLL_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
+
 namespace coll
 {
 using byte_size = size_t;
@@ -0,0 +1,1072 @@
+/*
+ * Copyright (c) 2026 Guillermo Hernan Martin
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+ 
+#pragma once
+#include "../src/btree_node_pool.h"
+#include "../src/btree_search.h"
+#include "allocator.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+
+namespace coll
+{
+
+/**
+ * Version lock used for optimistic lock coupling.
+ *
+ * The version word holds a counter and a 'locked' bit. Readers never write it: they take a snapshot of
+ * the version before reading the node, and check it has not changed afterwards. Writers acquire the
+ * lock by upgrading a snapshot with a CAS, and increment the counter on unlock.
+ */
+class OptimisticLock
+{
+public:
+    using Version = uint64_t;
+
+    // Returns nullopt while the node is locked.
+    std::optional<Version> read_lock() const
+    {
+        const Version version = m_version.load(std::memory_order_acquire);
+
+        if ((version & LockedBit) != 0)
+            return std::nullopt;
+        else
+            return version;
+    }
+
+    // True if nothing has been written to the node since 'version' was read.
+    bool validate(Version version) const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return m_version.load(std::memory_order_relaxed) == version;
+    }
+
+    // Fails if the node has changed since 'version' was read.
+    bool try_upgrade(Version version)
+    {
+        if (!m_version.compare_exchange_strong(version, version | LockedBit, std::memory_order_acquire))
+            return false;
+
+        // Readers must not see the writes which follow without seeing the lock too.
+        std::atomic_thread_fence(std::memory_order_release);
+        return true;
+    }
+
+    void write_unlock() { m_version.fetch_add(LockedBit, std::memory_order_release); }
+
+private:
+    static constexpr Version LockedBit = 1;
+
+    std::atomic<Version> m_version {0};
+};
+
+/**
+ * Epoch based reclamation of nodes which optimistic readers may still be reading after their removal.
+ *
+ * Each operation runs inside a 'Guard', which counts it in the epoch current when it starts. A node
+ * removed in one epoch may be freed once the epoch has advanced twice, as the epoch only advances when
+ * no operation started in the previous one is still running. Every thread counts its operations in its
+ * own record, on its own cache line, so readers never write a cache line shared with other threads.
+ *
+ * A thread registers its record on its first operation, allocating it while holding the mutex which
+ * guards the allocator. Records are kept until the counter is destroyed, so there is one for each
+ * thread which has ever used the counter.
+ */
+class EpochCounter
+{
+    struct Record;
+
+public:
+    using Epoch = uint64_t;
+
+    // Epochs whose operations may be running at once, and so whose removed nodes are kept apart.
+    static constexpr unsigned Generations = 3;
+
+    class Guard
+    {
+    public:
+        explicit Guard(EpochCounter& counter)
+            : m_record(counter.thread_record())
+            , m_epoch(enter(m_record, counter))
+        {
+        }
+
+        ~Guard() { m_record.active[m_epoch % Generations].fetch_sub(1, std::memory_order_release); }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    private:
+        Record& m_record;
+        Epoch m_epoch;
+    };
+
+    EpochCounter(IAllocator& alloc, std::mutex& allocMutex)
+        : m_alloc(alloc)
+        , m_allocMutex(allocMutex)
+        , m_id(next_id())
+    {
+    }
+
+    ~EpochCounter()
+    {
+        for (Record* record = m_records.load(std::memory_order_relaxed); record != nullptr;)
+        {
+            Record* next = record->next;
+            destroy(m_alloc, record);
+            record = next;
+        }
+    }
+
+    EpochCounter(const EpochCounter&) = delete;
+    EpochCounter& operator=(const EpochCounter&) = delete;
+
+    Epoch current() const { return m_epoch.load(std::memory_order_seq_cst); }
+
+    // Advances the epoch if no operation started in the previous one is running. The nodes removed two
+    // epochs before the new one may then be freed. Calls must not overlap.
+    bool try_advance()
+    {
+        const Epoch epoch = current();
+        const unsigned previous = unsigned((epoch + Generations - 1) % Generations);
+
+        for (const Record* record = m_records.load(std::memory_order_seq_cst); record != nullptr;
+             record = record->next)
+        {
+            if (record->active[previous].load(std::memory_order_seq_cst) != 0)
+                return false;
+        }
+
+        m_epoch.store(epoch + 1, std::memory_order_seq_cst);
+        return true;
+    }
+
+private:
+    // 'next' does not change once the record is in the list.
+    struct alignas(64) Record
+    {
+        std::atomic<uint64_t> active[Generations] {};
+        Record* next = nullptr;
+        uint64_t thread = 0;
+    };
+
+    // Records of the last counters used by the thread, by counter id. Ids are never reused, so the
+    // entries of destroyed counters are just never found again.
+    struct CacheEntry
+    {
+        uint64_t counter = 0;
+        Record* record = nullptr;
+    };
+
+    static constexpr unsigned CacheSize = 8;
+
+    IAllocator& m_alloc;
+    std::mutex& m_allocMutex;
+    const uint64_t m_id;
+    std::atomic<Record*> m_records {nullptr};
+    std::atomic<Epoch> m_epoch {0};
+
+    // The operation is counted in the epoch, which is checked again in case it has advanced meanwhile.
+    static Epoch enter(Record& record, const EpochCounter& counter)
+    {
+        for (;;)
+        {
+            const Epoch epoch = counter.current();
+            auto& active = record.active[epoch % Generations];
+
+            active.fetch_add(1, std::memory_order_seq_cst);
+            if (counter.current() == epoch)
+                return epoch;
+
+            active.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    Record& thread_record()
+    {
+        thread_local CacheEntry cache[CacheSize];
+        CacheEntry& entry = cache[m_id % CacheSize];
+
+        if (entry.counter != m_id)
+            entry = {m_id, &find_or_register(thread_id())};
+
+        return *entry.record;
+    }
+
+    // Only the thread itself registers its record, so it cannot be registered meanwhile by another one.
+    Record& find_or_register(uint64_t thread)
+    {
+        for (Record* record = m_records.load(std::memory_order_acquire); record != nullptr;
+             record = record->next)
+        {
+            if (record->thread == thread)
+                return *record;
+        }
+
+        std::lock_guard guard(m_allocMutex);
+
+        // Published with a sequentially consistent store, so 'try_advance' sees it before any
+        // operation the record counts.
+        Record* record = create<Record>(m_alloc);
+        record->thread = thread;
+        record->next = m_records.load(std::memory_order_relaxed);
+        m_records.store(record, std::memory_order_seq_cst);
+
+        return *record;
+    }
+
+    // Ids start at 1, as 0 marks the empty cache entries.
+    static uint64_t next_id()
+    {
+        static std::atomic<uint64_t> next {1};
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static uint64_t thread_id()
+    {
+        static std::atomic<uint64_t> next {1};
+        thread_local const uint64_t id = next.fetch_add(1, std::memory_order_relaxed);
+
+        return id;
+    }
+};
+
+/**
+ * B-Tree map which can be read and modified by many threads at once.
+ *
+ * It uses the same node layout as 'bmap' (sorted keys, values stored in the leaves), with a version
+ * lock per node. Lookups are optimistic: they only write the epoch record of their thread (see
+ * 'EpochCounter'), and restart from the root if a node changes while they read it. Writers lock only
+ * the leaf they modify, plus its parent if it must be split. Full nodes are split on the way down, so
+ * a split never propagates upwards.
+ *
+ * An erase which leaves a node less than a quarter full merges it afterwards with a sibling, if both
+ * fit in one node (empty nodes always do), locking both and their parent. A root left with a single
+ * child is replaced by it. Removed nodes go back to the pools once no operation may be reading them.
+ *
+ * Restrictions, which keep optimistic reads safe:
+ * - 'Key' and 'Value' must be trivially copyable, as readers may copy them while they are being
+ *   written (the copy is discarded in that case).
+ * - 'clear' and the destructor require exclusive access.
+ */
+template <typename Key, typename Value, byte_size Order = 16>
+class concurrent_bmap
+{
+    static_assert(std::is_trivially_copyable_v<Key>, "concurrent_bmap: Key not trivially copyable");
+    static_assert(std::is_trivially_copyable_v<Value>, "concurrent_bmap: Value not trivially copyable");
+    static_assert(Order >= 3, "concurrent_bmap order must be at least 3");
+
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using size_type = count_t;
+
+    concurrent_bmap(IAllocator& alloc = defaultAllocator());
+    ~concurrent_bmap() = default;
+
+    concurrent_bmap(const concurrent_bmap&) = delete;
+    concurrent_bmap& operator=(const concurrent_bmap&) = delete;
+
+    std::optional<Value> find(const Key& key) const;
+    bool contains(const Key& key) const { return find(key).has_value(); }
+
+    // Does not overwrite previous values. Returns true if the key was not in the map.
+    bool insert(const Key& key, const Value& value) { return insert_impl(key, value, false); }
+    bool insert_or_assign(const Key& key, const Value& value) { return insert_impl(key, value, true); }
+
+    bool erase(const Key& key);
+
+    // Approximate while other threads are writing.
+    size_type size() const { return m_size.load(std::memory_order_relaxed); }
+    bool empty() const { return size() == 0; }
+
+    // Not thread safe.
+    void clear();
+
+private:
+    struct Node
+    {
+        mutable OptimisticLock lock;
+        const bool isLeaf;
+        size_type count = 0;
+        Node* nextRetired = nullptr; // Never read by other operations.
+        alignas(alignof(Key)) std::byte keyStore[sizeof(Key) * Order];
+
+        Node(bool leaf)
+            : isLeaf(leaf)
+        {
+        }
+
+        Key* keys() { return reinterpret_cast<Key*>(keyStore); }
+        const Key* keys() const { return reinterpret_cast<const Key*>(keyStore); }
+
+        // 'count' may be read while being modified. Clamping it keeps the search inside the node,
+        // and the version check discards the result.
+        size_type safe_count() const { return std::min(count, size_type(Order)); }
+    };
+
+    struct NodeLeaf : public Node
+    {
+        alignas(alignof(Value)) std::byte valueStore[sizeof(Value) * Order];
+
+        NodeLeaf()
+            : Node(true)
+        {
+        }
+
+        Value* values() { return reinterpret_cast<Value*>(valueStore); }
+        const Value* values() const { return reinterpret_cast<const Value*>(valueStore); }
+
+        bool is_full() const { return this->count == Order; }
+
+        size_type lower_bound(const Key& key) const
+        {
+            return Search::lower_bound(this->keys(), this->safe_count(), key);
+        }
+
+        bool contains(const Key& key) const
+        {
+            const size_type i = lower_bound(key);
+            return i < this->safe_count() && this->keys()[i] == key;
+        }
+
+        void insert(size_type index, const Key& key, const Value& value);
+        void remove(size_type index);
+        Key split(NodeLeaf* right, size_type mid);
+        void merge(const NodeLeaf* right);
+    };
+
+    struct NodeInternal : public Node
+    {
+        Node* children[Order + 1];
+
+        NodeInternal()
+            : Node(false)
+        {
+        }
+
+        bool is_full() const { return this->count == Order; }
+
+        size_type child_index(const Key& key) const
+        {
+            return Search::upper_bound(this->keys(), this->safe_count(), key);
+        }
+
+        Node* child_for(const Key& key) const { return children[child_index(key)]; }
+
+        void insert(const Key& separator, Node* right);
+        void remove(size_type index);
+        Key split(NodeInternal* right, size_type mid);
+        void merge(const Key& separator, const NodeInternal* right);
+    };
+
+    // Outcome of trying to merge a node with a sibling.
+    enum class MergeResult
+    {
+        Merged,
+        Skipped,  // They do not fit in one node, or the node has no sibling.
+        Conflict, // Another thread changed them. The operation must restart.
+    };
+
+    // A node with fewer keys is merged with a sibling, if both fit in this many keys (or the node is
+    // empty), so that the merged node still has room for later inserts.
+    static constexpr size_type MinKeys = size_type(std::max<byte_size>(Order / 4, 1));
+    static constexpr size_type MergeLimit = Order * 3 / 4;
+
+    using Search = NodeSearch<Key, Order>;
+
+    std::atomic<Node*> m_root;
+    std::atomic<size_type> m_size {0};
+
+    // Nodes, and the epoch records of new threads, are allocated and freed while holding 'm_allocMutex'.
+    // Splits, merges and new threads are rare, and this keeps the allocator, which may not be thread
+    // safe, out of the concurrent path.
+    std::mutex m_allocMutex;
+    NodePool m_leafPool;
+    NodePool m_internalPool;
+
+    // Nodes removed from the tree, linked by 'nextRetired', by epoch modulo 'Generations'. Only used
+    // while holding 'm_allocMutex'.
+    mutable EpochCounter m_epochs;
+    Node* m_retired[EpochCounter::Generations] = {};
+
+    bool insert_impl(const Key& key, const Value& value, bool assign);
+    void compact(const Key& key);
+    MergeResult try_merge(
+        NodeInternal* parent,
+        OptimisticLock::Version parentVersion,
+        size_type index,
+        Node* child,
+        OptimisticLock::Version childVersion
+    );
+
+    template <typename NodeType>
+    static bool descend(NodeType*& node, OptimisticLock::Version& version, const Key& key);
+
+    // Called before each attempt of an operation. After a few restarts, gives way to the thread which
+    // holds the lock, in case it has been preempted.
+    static void backoff(unsigned attempt)
+    {
+        if (attempt > 8)
+            std::this_thread::yield();
+    }
+
+    void split_child(Node* node, NodeInternal* parent, const Key& key);
+
+    template <typename T>
+    T* create_node();
+    void retire(Node* node);
+    void free_nodes(Node* list);
+};
+
+// ------------------------------------------------------------
+// Constructores
+// ------------------------------------------------------------
+template <typename Key, typename Value, byte_size Order>
+concurrent_bmap<Key, Value, Order>::concurrent_bmap(IAllocator& alloc)
+    : m_leafPool(alloc, sizeof(NodeLeaf), align::of<NodeLeaf>())
+    , m_internalPool(alloc, sizeof(NodeInternal), align::of<NodeInternal>())
+    , m_epochs(alloc, m_allocMutex)
+{
+    m_root.store(create_node<NodeLeaf>(), std::memory_order_release);
+}
+
+// ------------------------------------------------------------
+// Gestión de memoria
+// ------------------------------------------------------------
+template <typename Key, typename Value, byte_size Order>
+template <typename T>
+T* concurrent_bmap<Key, Value, Order>::create_node()
+{
+    std::lock_guard guard(m_allocMutex);
+
+    if constexpr (std::is_same_v<T, NodeLeaf>)
+        return new (m_leafPool.alloc()) NodeLeaf;
+    else
+        return new (m_internalPool.alloc()) NodeInternal;
+}
+
+// Frees 'node', which has been removed from the tree, once no operation may be reading it anymore.
+// The epoch is read after the removal, so it is not older than the operations which may have seen it.
+template <typename Key, typename Value, byte_size Order>
+void concurrent_bmap<Key, Value, Order>::retire(Node* node)
+{
+    std::lock_guard guard(m_allocMutex);
+
+    Node*& list = m_retired[m_epochs.current() % EpochCounter::Generations];
+    node->nextRetired = list;
+    list = node;
+
+    // The list which the next epoch will use holds the nodes retired two epochs before it.
+    if (m_epochs.try_advance())
+    {
+        Node*& oldest = m_retired[(m_epochs.current() + 1) % EpochCounter::Generations];
+        free_nodes(oldest);
+        oldest = nullptr;
+    }
+}
+
+// Returns the nodes of a list of retired ones to their pools. Must hold 'm_allocMutex'.
+template <typename Key, typename Value, byte_size Order>
+void concurrent_bmap<Key, Value, Order>::free_nodes(Node* list)
+{
+    while (list != nullptr)
+    {
+        Node* next = list->nextRetired;
+
+        if (list->isLeaf)
+            m_leafPool.free(static_cast<NodeLeaf*>(list));
+        else
+            m_internalPool.free(static_cast<NodeInternal*>(list));
+        list = next;
+    }
+}
+
+// Keys and values are trivially destructible, so releasing the pools is enough.
+template <typename Key, typename Value, byte_size Order>
+void concurrent_bmap<Key, Value, Order>::clear()
+{
+    m_leafPool.release();
+    m_internalPool.release();
+    for (Node*& list : m_retired)
+        list = nullptr;
+    m_size.store(0, std::memory_order_relaxed);
+    m_root.store(create_node<NodeLeaf>(), std::memory_order_release);
+}
+
+// ------------------------------------------------------------
+// Búsqueda
+// ------------------------------------------------------------
+
+// Moves from the internal node 'node' to the child which covers 'key', following the lock coupling
+// protocol. Fails if any of both changes meanwhile.
+template <typename Key, typename Value, byte_size Order>
+template <typename NodeType>
+bool concurrent_bmap<Key, Value, Order>::descend(
+    NodeType*& node,
+    OptimisticLock::Version& version,
+    const Key& key
+)
+{
+    NodeType* child = static_cast<const NodeInternal*>(node)->child_for(key);
+
+    // 'child' may be garbage until the parent is validated.
+    if (!node->lock.validate(version))
+        return false;
+
+    const auto childVersion = child->lock.read_lock();
+
+    // The parent is checked again: if the child has been split since the first check, the key may be
+    // in its new sibling now.
+    if (!childVersion || !node->lock.validate(version))
+        return false;
+
+    node = child;
+    version = *childVersion;
+    return true;
+}
+
+template <typename Key, typename Value, byte_size Order>
+std::optional<Value> concurrent_bmap<Key, Value, Order>::find(const Key& key) const
+{
+    EpochCounter::Guard epoch(m_epochs);
+
+    for (unsigned attempt = 0;; ++attempt)
+    {
+        backoff(attempt);
+
+        const Node* node = m_root.load(std::memory_order_acquire);
+        auto version = node->lock.read_lock();
+
+        if (!version || node != m_root.load(std::memory_order_acquire))
+            continue;
+
+        bool restart = false;
+        while (!node->isLeaf && !restart)
+            restart = !descend(node, *version, key);
+
+        if (restart)
+            continue;
+
+        const auto* leaf = static_cast<const NodeLeaf*>(node);
+        const size_type i = leaf->lower_bound(key);
+        std::optional<Value> result;
+
+        if (i < leaf->safe_count() && leaf->keys()[i] == key)
+            result = leaf->values()[i];
+
+        if (leaf->lock.validate(*version))
+            return result;
+    }
+}
+
+// ------------------------------------------------------------
+// Inserción
+// ------------------------------------------------------------
+template <typename Key, typename Value, byte_size Order>
+bool concurrent_bmap<Key, Value, Order>::insert_impl(const Key& key, const Value& value, bool assign)
+{
+    EpochCounter::Guard epoch(m_epochs);
+
+    for (unsigned attempt = 0;; ++attempt)
+    {
+        backoff(attempt);
+
+        Node* node = m_root.load(std::memory_order_acquire);
+        auto version = node->lock.read_lock();
+
+        if (!version || node != m_root.load(std::memory_order_acquire))
+            continue;
+
+        NodeInternal* parent = nullptr;
+        OptimisticLock::Version parentVersion = 0;
+        bool restart = false;
+
+        for (;;)
+        {
+            // A leaf which already holds the key is not split, as no entry is added to it.
+            const bool full = node->isLeaf
+                ? static_cast<NodeLeaf*>(node)->is_full() && !static_cast<NodeLeaf*>(node)->contains(key)
+                : static_cast<NodeInternal*>(node)->is_full();
+
+            // Full nodes are split on the way down, so the parent always has room for the separator.
+            if (full)
+            {
+                if (parent != nullptr && !parent->lock.try_upgrade(parentVersion))
+                {
+                    restart = true;
+                    break;
+                }
+
+                if (!node->lock.try_upgrade(*version))
+                {
+                    if (parent != nullptr)
+                        parent->lock.write_unlock();
+                    restart = true;
+                    break;
+                }
+
+                // Splitting the root also requires it to still be the root.
+                if (parent == nullptr && node != m_root.load(std::memory_order_acquire))
+                {
+                    node->lock.write_unlock();
+                    restart = true;
+                    break;
+                }
+
+                try
+                {
+                    split_child(node, parent, key);
+                }
+                catch (...)
+                {
+                    node->lock.write_unlock();
+                    if (parent != nullptr)
+                        parent->lock.write_unlock();
+                    throw;
+                }
+
+                node->lock.write_unlock();
+                if (parent != nullptr)
+                    parent->lock.write_unlock();
+
+                restart = true;
+                break;
+            }
+
+            if (node->isLeaf)
+                break;
+
+            parent = static_cast<NodeInternal*>(node);
+            parentVersion = *version;
+
+            if (!descend(node, *version, key))
+            {
+                restart = true;
+                break;
+            }
+        }
+
+        if (restart)
+            continue;
+
+        auto* leaf = static_cast<NodeLeaf*>(node);
+        if (!leaf->lock.try_upgrade(*version))
+            continue;
+
+        // The parent is not modified, but it must still be the one which led to this leaf.
+        if (parent != nullptr && !parent->lock.validate(parentVersion))
+        {
+            leaf->lock.write_unlock();
+            continue;
+        }
+
+        const size_type i = leaf->lower_bound(key);
+        bool inserted = false;
+
+        if (i < leaf->count && leaf->keys()[i] == key)
+        {
+            if (assign)
+                leaf->values()[i] = value;
+        }
+        else if (leaf->is_full())
+        {
+            // The key was erased after the leaf was found full with it. It must be split now.
+            leaf->lock.write_unlock();
+            continue;
+        }
+        else
+        {
+            leaf->insert(i, key, value);
+            inserted = true;
+        }
+
+        leaf->lock.write_unlock();
+
+        if (inserted)
+            m_size.fetch_add(1, std::memory_order_relaxed);
+
+        return inserted;
+    }
+}
+
+// Splits 'node', which must be full, on the way to insert 'key'. Both 'node' and 'parent' must be
+// write-locked by the caller.
+template <typename Key, typename Value, byte_size Order>
+void concurrent_bmap<Key, Value, Order>::split_child(Node* node, NodeInternal* parent, const Key& key)
+{
+    // Allocations go first: if they fail, the tree is left untouched. (A node allocated before the
+    // failure stays in the pool until 'clear', like any other node.)
+    Node* right = node->isLeaf ? static_cast<Node*>(create_node<NodeLeaf>())
+                               : static_cast<Node*>(create_node<NodeInternal>());
+    NodeInternal* newRoot = parent == nullptr ? create_node<NodeInternal>() : nullptr;
+
+    // Like 'bmap', keys appended at the end of a leaf (ascending inserts) leave it full instead of
+    // splitting it in halves. Internal nodes are split in halves, as splitting them at the end would
+    // leave the new one with no keys.
+    const size_type count = node->count;
+    const size_type mid = node->isLeaf && node->keys()[count - 1] < key ? count - 1 : count / 2;
+
+    const Key separator = node->isLeaf
+        ? static_cast<NodeLeaf*>(node)->split(static_cast<NodeLeaf*>(right), mid)
+        : static_cast<NodeInternal*>(node)->split(static_cast<NodeInternal*>(right), mid);
+
+    if (parent != nullptr)
+        parent->insert(separator, right);
+    else
+    {
+        newRoot->keys()[0] = separator;
+        newRoot->children[0] = node;
+        newRoot->children[1] = right;
+        newRoot->count = 1;
+        m_root.store(newRoot, std::memory_order_release);
+    }
+}
+
+// ------------------------------------------------------------
+// Borrado
+// ------------------------------------------------------------
+template <typename Key, typename Value, byte_size Order>
+bool concurrent_bmap<Key, Value, Order>::erase(const Key& key)
+{
+    EpochCounter::Guard epoch(m_epochs);
+
+    for (unsigned attempt = 0;; ++attempt)
+    {
+        backoff(attempt);
+
+        Node* node = m_root.load(std::memory_order_acquire);
+        auto version = node->lock.read_lock();
+
+        if (!version || node != m_root.load(std::memory_order_acquire))
+            continue;
+
+        NodeInternal* parent = nullptr;
+        OptimisticLock::Version parentVersion = 0;
+        bool restart = false;
+
+        while (!node->isLeaf && !restart)
+        {
+            parent = static_cast<NodeInternal*>(node);
+            parentVersion = *version;
+            restart = !descend(node, *version, key);
+        }
+
+        if (restart)
+            continue;
+
+        auto* leaf = static_cast<NodeLeaf*>(node);
+        if (!leaf->lock.try_upgrade(*version))
+            continue;
+
+        if (parent != nullptr && !parent->lock.validate(parentVersion))
+        {
+            leaf->lock.write_unlock();
+            continue;
+        }
+
+        const size_type i = leaf->lower_bound(key);
+        const bool found = i < leaf->count && leaf->keys()[i] == key;
+
+        if (found)
+            leaf->remove(i);
+
+        const bool underfull = leaf->count < MinKeys;
+        leaf->lock.write_unlock();
+
+        if (found)
+            m_size.fetch_sub(1, std::memory_order_relaxed);
+        if (found && underfull && parent != nullptr)
+            compact(key);
+
+        return found;
+    }
+}
+
+// Merges the nodes on the path to 'key' which have fewer than 'MinKeys' keys with a sibling, from the
+// top down, and replaces the root while it has a single child. Merges take a key from the parent, so
+// the path is walked again after each one. Other threads may undo the work at any time, so it gives up
+// after a few conflicts: a later erase on the same nodes will try again.
+template <typename Key, typename Value, byte_size Order>
+void concurrent_bmap<Key, Value, Order>::compact(const Key& key)
+{
+    for (unsigned conflicts = 0; conflicts < 16;)
+    {
+        backoff(conflicts);
+
+        Node* node = m_root.load(std::memory_order_acquire);
+        auto version = node->lock.read_lock();
+
+        if (!version || node != m_root.load(std::memory_order_acquire))
+        {
+            ++conflicts;
+            continue;
+        }
+        if (node->isLeaf)
+            return;
+
+        auto* parent = static_cast<NodeInternal*>(node);
+        OptimisticLock::Version parentVersion = *version;
+
+        if (parent->count == 0)
+        {
+            Node* child = parent->children[0];
+
+            if (!parent->lock.try_upgrade(parentVersion))
+            {
+                ++conflicts;
+                continue;
+            }
+
+            m_root.store(child, std::memory_order_release);
+            parent->lock.write_unlock();
+            retire(parent);
+            continue;
+        }
+
+        MergeResult result = MergeResult::Skipped;
+
+        for (;;)
+        {
+            const size_type i = parent->child_index(key);
+            Node* child = parent->children[i];
+
+            if (!parent->lock.validate(parentVersion))
+            {
+                result = MergeResult::Conflict;
+                break;
+            }
+
+            const auto childVersion = child->lock.read_lock();
+            if (!childVersion || !parent->lock.validate(parentVersion))
+            {
+                result = MergeResult::Conflict;
+                break;
+            }
+
+            if (child->count < MinKeys)
+            {
+                result = try_merge(parent, parentVersion, i, child, *childVersion);
+                if (result != MergeResult::Skipped)
+                    break;
+            }
+
+            if (child->isLeaf)
+                break;
+
+            parent = static_cast<NodeInternal*>(child);
+            parentVersion = *childVersion;
+        }
+
+        if (result == MergeResult::Conflict)
+            ++conflicts;
+        else if (result == MergeResult::Skipped)
+            return;
+    }
+}
+
+// Merges 'child', at 'index' in 'parent', with its right sibling, or its left one if it is the last
+// child, if both fit in one node. The versions are those read on the way down. Everything is read
+// optimistically first, so that the nodes are left untouched if they are not merged. Locking them then
+// validates what was read.
+template <typename Key, typename Value, byte_size Order>
+typename concurrent_bmap<Key, Value, Order>::MergeResult concurrent_bmap<Key, Value, Order>::try_merge(
+    NodeInternal* parent,
+    OptimisticLock::Version parentVersion,
+    size_type index,
+    Node* child,
+    OptimisticLock::Version childVersion
+)
+{
+    // A single child is left to be merged along with its parent.
+    const size_type count = parent->safe_count();
+    if (count == 0)
+        return MergeResult::Skipped;
+
+    const size_type leftIndex = index < count ? index : index - 1;
+    Node* left = parent->children[leftIndex];
+    Node* right = parent->children[leftIndex + 1];
+
+    if (!parent->lock.validate(parentVersion))
+        return MergeResult::Conflict;
+
+    Node* sibling = left == child ? right : left;
+    const auto siblingVersion = sibling->lock.read_lock();
+
+    if (!siblingVersion || !parent->lock.validate(parentVersion))
+        return MergeResult::Conflict;
+
+    const size_type total = left->count + right->count + (left->isLeaf ? 0 : 1);
+    if (total > (child->count == 0 ? Order : MergeLimit))
+        return MergeResult::Skipped;
+
+    if (!parent->lock.try_upgrade(parentVersion))
+        return MergeResult::Conflict;
+    if (!child->lock.try_upgrade(childVersion))
+    {
+        parent->lock.write_unlock();
+        return MergeResult::Conflict;
+    }
+    if (!sibling->lock.try_upgrade(*siblingVersion))
+    {
+        child->lock.write_unlock();
+        parent->lock.write_unlock();
+        return MergeResult::Conflict;
+    }
+
+    if (left->isLeaf)
+        static_cast<NodeLeaf*>(left)->merge(static_cast<NodeLeaf*>(right));
+    else
+    {
+        auto* leftInternal = static_cast<NodeInternal*>(left);
+        leftInternal->merge(parent->keys()[leftIndex], static_cast<NodeInternal*>(right));
+    }
+    parent->remove(leftIndex);
+
+    // Unlocking 'right' changes its version, so that the operations still reading it restart.
+    right->lock.write_unlock();
+    left->lock.write_unlock();
+    parent->lock.write_unlock();
+
+    retire(right);
+    return MergeResult::Merged;
+}
+
+// ------------------------------------------------------------
+// Operaciones sobre nodos
+// ------------------------------------------------------------
+template <typename Key, typename Value, byte_size Order>
+void concurrent_bmap<Key, Value, Order>::NodeLeaf::insert(
+    size_type index,
+    const Key& key,
+    const Value& value
+)
+{
+    assert(this->count < Order);
+
+    const size_type tail = this->count - index;
+    std::memmove(this->keys() + index + 1, this->keys() + index, tail * sizeof(Key));
+    std::memmove(values() + index + 1, values() + index, tail * sizeof(Value));
+
+    this->keys()[index] = key;
+    values()[index] = value;
+    ++this->count;
+}
+
+template <typename Key, typename Value, byte_size Order>
+void concurrent_bmap<Key, Value, Order>::NodeLeaf::remove(size_type index)
+{
+    const size_type tail = this->count - index - 1;
+    std::memmove(this->keys() + index, this->keys() + index + 1, tail * sizeof(Key));
+    std::memmove(values() + index, values() + index + 1, tail * sizeof(Value));
+
+    --this->count;
+}
+
+// Moves the entries from 'mid' onwards to 'right', and returns its first key.
+template <typename Key, typename Value, byte_size Order>
+Key concurrent_bmap<Key, Value, Order>::NodeLeaf::split(NodeLeaf* right, size_type mid)
+{
+    const size_type rightCount = this->count - mid;
+
+    std::memcpy(right->keys(), this->keys() + mid, rightCount * sizeof(Key));
+    std::memcpy(right->values(), values() + mid, rightCount * sizeof(Value));
+    right->count = rightCount;
+    this->count = mid;
+
+    return right->keys()[0];
+}
+
+// Appends the entries of 'right'. They must fit.
+template <typename Key, typename Value, byte_size Order>
+void concurrent_bmap<Key, Value, Order>::NodeLeaf::merge(const NodeLeaf* right)
+{
+    assert(this->count + right->count <= Order);
+
+    std::memcpy(this->keys() + this->count, right->keys(), right->count * sizeof(Key));
+    std::memcpy(values() + this->count, right->values(), right->count * sizeof(Value));
+    this->count += right->count;
+}
+
+template <typename Key, typename Value, byte_size Order>
+void concurrent_bmap<Key, Value, Order>::NodeInternal::insert(const Key& separator, Node* right)
+{
+    assert(this->count < Order);
+
+    const size_type index = Search::upper_bound(this->keys(), this->count, separator);
+    const size_type tail = this->count - index;
+
+    std::memmove(this->keys() + index + 1, this->keys() + index, tail * sizeof(Key));
+    std::memmove(children + index + 2, children + index + 1, tail * sizeof(Node*));
+
+    this->keys()[index] = separator;
+    children[index + 1] = right;
+    ++this->count;
+}
+
+// Moves the keys after 'mid' (and their children) to 'right'. Key 'mid' is removed and returned.
+template <typename Key, typename Value, byte_size Order>
+Key concurrent_bmap<Key, Value, Order>::NodeInternal::split(NodeInternal* right, size_type mid)
+{
+    const size_type rightCount = this->count - mid - 1;
+    const Key separator = this->keys()[mid];
+
+    std::memcpy(right->keys(), this->keys() + mid + 1, rightCount * sizeof(Key));
+    std::memcpy(right->children, children + mid + 1, (rightCount + 1) * sizeof(Node*));
+    right->count = rightCount;
+    this->count = mid;
+
+    return separator;
+}
+
+// Removes key 'index' and the child after it.
+template <typename Key, typename Value, byte_size Order>
+void concurrent_bmap<Key, Value, Order>::NodeInternal::remove(size_type index)
+{
+    const size_type tail = this->count - index - 1;
+
+    std::memmove(this->keys() + index, this->keys() + index + 1, tail * sizeof(Key));
+    std::memmove(children + index + 1, children + index + 2, tail * sizeof(Node*));
+    --this->count;
+}
+
+// Appends 'separator' and the keys and children of 'right'. They must fit.
+template <typename Key, typename Value, byte_size Order>
+void concurrent_bmap<Key, Value, Order>::NodeInternal::merge(
+    const Key& separator,
+    const NodeInternal* right
+)
+{
+    assert(this->count + right->count + 1 <= Order);
+
+    this->keys()[this->count] = separator;
+    std::memcpy(this->keys() + this->count + 1, right->keys(), right->count * sizeof(Key));
+    std::memcpy(children + this->count + 1, right->children, (right->count + 1) * sizeof(Node*));
+    this->count += right->count + 1;
+}
+} // namespace coll
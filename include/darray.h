@@ -737,11 +737,16 @@ void darray<Item>::reallocate_if_needed(size_type required_size)
     if (required_size <= m_capacity)
         return;
 
-    // Intenta expandir sin mover si la memoria ya está asignada
+    // Intenta expandir sin mover si la memoria ya está asignada. Pide el mismo crecimiento que
+    // una reasignación, pero le basta con alcanzar el tamaño requerido. Como los asignadores sólo
+    // expanden si cabe todo lo pedido, si no cabe el doble se vuelve a intentar con lo requerido.
     if (m_data)
     {
-        const byte_size expanded_size_bytes
-            = m_allocator->tryExpand(required_size * sizeof(Item), m_data);
+        const size_type wanted_size = m_capacity * 2 > required_size ? m_capacity * 2 : required_size;
+        byte_size expanded_size_bytes = m_allocator->tryExpand(wanted_size * sizeof(Item), m_data);
+
+        if (expanded_size_bytes < required_size * sizeof(Item) && wanted_size > required_size)
+            expanded_size_bytes = m_allocator->tryExpand(required_size * sizeof(Item), m_data);
 
         if (expanded_size_bytes >= required_size * sizeof(Item))
         {
@@ -0,0 +1,647 @@
+/*
+ * Copyright (c) 2026 Guillermo Hernan Martin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include "../src/btree_search.h"
+#include "allocator.h"
+#include "bmap.h"
+#include "collib_concepts.h"
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace coll
+{
+
+/**
+ * Read-only map, built once from sorted entries, for data which is only queried after loading it
+ * (routing tables, reference data...).
+ *
+ * Keys and values are kept in two sorted arrays, with no nodes nor pointers. Searches are guided by an
+ * implicit B+ tree (a static search tree) laid out over the keys:
+ * - The keys are split in blocks of 'BlockKeys', which fill one cache line for small keys.
+ * - Each index layer holds the greatest key of each block of the layer below, and is split in blocks
+ *   the same way, up to a top layer of a single block.
+ * - The children of block 'j' are the blocks which start at 'j * BlockKeys' in the layer below, so
+ *   they are found by arithmetic. Every step of a search reads one block, with 'NodeSearch' (and SIMD
+ *   compares for arithmetic keys).
+ *
+ * The index takes about 1 / (BlockKeys - 1) more keys, plus the padding which makes each layer start on
+ * a cache line. There are no half-empty nodes, so the whole map is usually smaller than a 'bmap' with
+ * the same entries.
+ *
+ * It has the lookup and scan interface of 'bmap'. Entries are sorted by 'Compare', and also accessible
+ * by position ('nth', 'rank') in O(1) / O(log n).
+ */
+template <typename Key, typename Value, typename Compare = KeyLess<Key>>
+class frozen_bmap
+{
+public:
+    struct Entry;
+    struct Sentinel
+    {
+    };
+    class Handle;
+    class Range;
+
+    using key_type = Key;
+    using mapped_type = Value;
+    using key_compare = Compare;
+    using size_type = count_t;
+
+    static constexpr size_type BlockKeys = size_type(std::max<byte_size>(64 / sizeof(Key), 8));
+
+    explicit frozen_bmap(IAllocator& alloc = defaultAllocator(), const Compare& comp = Compare())
+        : m_alloc(&alloc)
+        , m_compare(comp)
+    {
+    }
+
+    // Builds the map from entries sorted by key, with no repeated keys. Entries may have 'key' /
+    // 'value' members (like 'bmap' entries) or 'first' / 'second' (like std::pair). Throws
+    // 'std::invalid_argument' if the entries are not strictly ascending.
+    template <coll::Range EntryRange>
+    explicit frozen_bmap(
+        const EntryRange& entries,
+        IAllocator& alloc = defaultAllocator(),
+        const Compare& comp = Compare()
+    );
+
+    // Freezes the contents of a 'bmap'.
+    template <byte_size Order, BMapOptions Options>
+    explicit frozen_bmap(
+        const bmap<Key, Value, Order, Options, Compare>& map,
+        IAllocator& alloc = defaultAllocator()
+    )
+        : frozen_bmap(map, alloc, map.key_comp())
+    {
+    }
+
+    ~frozen_bmap() { clear(); }
+
+    frozen_bmap(const frozen_bmap& rhs);
+    frozen_bmap(frozen_bmap&& rhs) noexcept;
+
+    frozen_bmap& operator=(const frozen_bmap& rhs);
+    frozen_bmap& operator=(frozen_bmap&& rhs) noexcept;
+
+    // Lookups accept the same key types as 'bmap' (see 'BTreeCore').
+    template <LookupKeyFor<Key, Compare> K = Key>
+    Handle find(const K& key) const;
+
+    template <LookupKeyFor<Key, Compare> K = Key>
+    bool contains(const K& key) const
+    {
+        return find(key).has_value();
+    }
+    template <LookupKeyFor<Key, Compare> K = Key>
+    size_type count(const K& key) const
+    {
+        return contains(key) ? 1 : 0;
+    }
+
+    // Number of keys in [keyLeft, keyRight).
+    template <LookupKeyFor<Key, Compare> K = Key>
+    size_type count(const K& keyLeft, const K& keyRight) const;
+
+    // Entries from the first key not less than / greater than 'key'.
+    template <LookupKeyFor<Key, Compare> K = Key>
+    Range lower_bound(const K& key) const
+    {
+        return Range(*this, lower_index(lookup_key(key)), m_size);
+    }
+    template <LookupKeyFor<Key, Compare> K = Key>
+    Range upper_bound(const K& key) const
+    {
+        return Range(*this, upper_index(lookup_key(key)), m_size);
+    }
+
+    // Entries with keys in [keyLeft, keyRight).
+    template <LookupKeyFor<Key, Compare> K = Key>
+    Range range(const K& keyLeft, const K& keyRight) const;
+
+    // Entry at position 'index' / Position of the first key not less than 'key'.
+    Handle nth(size_type index) const { return index < m_size ? Handle(*this, index) : Handle(); }
+    template <LookupKeyFor<Key, Compare> K = Key>
+    size_type rank(const K& key) const
+    {
+        return lower_index(lookup_key(key));
+    }
+
+    Range begin() const { return Range(*this, 0, m_size); }
+    Sentinel end() const { return Sentinel(); }
+
+    size_type size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    template <LookupKeyFor<Key, Compare> K = Key>
+    const Value& operator[](const K& key) const
+    {
+        return at(key);
+    }
+    template <LookupKeyFor<Key, Compare> K = Key>
+    const Value& at(const K& key) const;
+
+    IAllocator& allocator() const { return *m_alloc; }
+    const Compare& key_comp() const { return m_compare; }
+
+    void clear();
+
+    struct Entry
+    {
+        const Key& key;
+        const Value& value;
+    };
+
+    class Handle
+    {
+    public:
+        Handle() = default;
+
+        const Key& key() const { return m_keys[m_index]; }
+        const Value& value() const { return m_values[m_index]; }
+
+        bool has_value() const { return m_keys != nullptr; }
+
+        bool operator!=(const Handle& rhs) const = default;
+        bool operator==(const Handle& rhs) const = default;
+
+        operator bool() const { return has_value(); }
+
+    private:
+        friend class frozen_bmap;
+
+        Handle(const frozen_bmap& map, size_type index)
+            : m_keys(map.m_keys)
+            , m_values(map.m_values)
+            , m_index(index)
+        {
+        }
+
+        const Key* m_keys = nullptr;
+        const Value* m_values = nullptr;
+        size_type m_index = 0;
+    }; // class Handle
+
+    // Entries in positions [index, end).
+    class Range
+    {
+    public:
+        Range() = default;
+
+        Entry front() const { return {key(), value()}; }
+
+        const Key& key() const { return m_keys[m_index]; }
+        const Value& value() const { return m_values[m_index]; }
+
+        bool empty() const { return m_index >= m_end; }
+        size_type size() const { return empty() ? 0 : m_end - m_index; }
+        Range begin() const { return *this; }
+        Sentinel end() const { return Sentinel(); }
+
+        Entry operator*() const { return front(); }
+
+        bool operator!=(Sentinel) const { return !empty(); }
+        bool operator==(Sentinel) const { return empty(); }
+
+        Range& operator++()
+        {
+            ++m_index;
+            return *this;
+        }
+
+        Range operator++(int)
+        {
+            Range prev = *this;
+            ++(*this);
+            return prev;
+        }
+
+    private:
+        friend class frozen_bmap;
+
+        Range(const frozen_bmap& map, size_type index, size_type end)
+            : m_keys(map.m_keys)
+            , m_values(map.m_values)
+            , m_index(index)
+            , m_end(end)
+        {
+        }
+
+        const Key* m_keys = nullptr;
+        const Value* m_values = nullptr;
+        size_type m_index = 0;
+        size_type m_end = 0;
+    }; // class Range
+
+private:
+    using Search = NodeSearch<Key, BlockKeys, Compare>;
+
+    // Arrays are aligned to cache lines, and so are their blocks (see 'buildIndex').
+    static constexpr byte_size CacheLine = 64;
+
+    // Each index layer has at most an eighth of the keys of the layer below.
+    static constexpr unsigned MaxLayers = sizeof(size_type) * 8 / 3 + 1;
+
+    template <typename K>
+    static decltype(auto) lookup_key(const K& key)
+    {
+        if constexpr (std::is_same_v<K, Key> || TransparentLookup<K, Key, Compare>)
+            return key;
+        else
+            return Key(key);
+    }
+
+    template <typename SourceEntry>
+    static const auto& entryKey(const SourceEntry& entry)
+    {
+        if constexpr (requires { entry.key; })
+            return entry.key;
+        else
+            return entry.first;
+    }
+
+    template <typename SourceEntry>
+    static const auto& entryValue(const SourceEntry& entry)
+    {
+        if constexpr (requires { entry.value; })
+            return entry.value;
+        else
+            return entry.second;
+    }
+
+    // Rounds 'size' up to whole blocks.
+    static size_type padded_size(size_type size)
+    {
+        return (size + BlockKeys - 1) / BlockKeys * BlockKeys;
+    }
+
+    template <typename K>
+    size_type lower_index(const K& key) const
+    {
+        return search<false>(key);
+    }
+    template <typename K>
+    size_type upper_index(const K& key) const
+    {
+        return search<true>(key);
+    }
+
+    template <bool Upper, typename K>
+    size_type search(const K& key) const;
+
+    template <typename T>
+    static T* allocArray(IAllocator& alloc, size_type count);
+
+    template <typename T>
+    static void freeArray(IAllocator& alloc, T* items, size_type count);
+
+    template <typename EntryRange>
+    void load(const EntryRange& entries);
+    void buildIndex();
+
+    IAllocator* m_alloc;
+    Key* m_keys = nullptr;
+    Value* m_values = nullptr;
+    Key* m_index = nullptr; // Index layers, from the bottom one up.
+    size_type m_size = 0;
+    size_type m_indexSize = 0;
+    size_type m_layerStart[MaxLayers] {};
+    size_type m_layerSize[MaxLayers] {};
+    unsigned m_layers = 0;
+    COLL_NO_UNIQUE_ADDRESS Compare m_compare;
+};
+
+// ------------------------------------------------------------
+// Construcción
+// ------------------------------------------------------------
+template <typename Key, typename Value, typename Compare>
+template <coll::Range EntryRange>
+frozen_bmap<Key, Value, Compare>::frozen_bmap(
+    const EntryRange& entries,
+    IAllocator& alloc,
+    const Compare& comp
+)
+    : m_alloc(&alloc)
+    , m_compare(comp)
+{
+    try
+    {
+        load(entries);
+        buildIndex();
+    }
+    catch (...)
+    {
+        clear();
+        throw;
+    }
+}
+
+template <typename Key, typename Value, typename Compare>
+frozen_bmap<Key, Value, Compare>::frozen_bmap(const frozen_bmap& rhs)
+    : frozen_bmap(rhs, *rhs.m_alloc, rhs.m_compare)
+{
+}
+
+template <typename Key, typename Value, typename Compare>
+frozen_bmap<Key, Value, Compare>::frozen_bmap(frozen_bmap&& rhs) noexcept
+    : m_alloc(rhs.m_alloc)
+    , m_keys(std::exchange(rhs.m_keys, nullptr))
+    , m_values(std::exchange(rhs.m_values, nullptr))
+    , m_index(std::exchange(rhs.m_index, nullptr))
+    , m_size(std::exchange(rhs.m_size, 0))
+    , m_indexSize(std::exchange(rhs.m_indexSize, 0))
+    , m_layers(std::exchange(rhs.m_layers, 0))
+    , m_compare(rhs.m_compare)
+{
+    std::copy(rhs.m_layerStart, rhs.m_layerStart + MaxLayers, m_layerStart);
+    std::copy(rhs.m_layerSize, rhs.m_layerSize + MaxLayers, m_layerSize);
+}
+
+template <typename Key, typename Value, typename Compare>
+frozen_bmap<Key, Value, Compare>& frozen_bmap<Key, Value, Compare>::operator=(const frozen_bmap& rhs)
+{
+    if (this != &rhs)
+    {
+        // Se copia aparte para no perder el contenido actual si la copia falla
+        frozen_bmap copy(rhs, *m_alloc, rhs.m_compare);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+template <typename Key, typename Value, typename Compare>
+frozen_bmap<Key, Value, Compare>& frozen_bmap<Key, Value, Compare>::operator=(frozen_bmap&& rhs) noexcept
+{
+    if (this != &rhs)
+    {
+        clear();
+        m_alloc = rhs.m_alloc;
+        m_keys = std::exchange(rhs.m_keys, nullptr);
+        m_values = std::exchange(rhs.m_values, nullptr);
+        m_index = std::exchange(rhs.m_index, nullptr);
+        m_size = std::exchange(rhs.m_size, 0);
+        m_indexSize = std::exchange(rhs.m_indexSize, 0);
+        m_layers = std::exchange(rhs.m_layers, 0);
+        m_compare = rhs.m_compare;
+        std::copy(rhs.m_layerStart, rhs.m_layerStart + MaxLayers, m_layerStart);
+        std::copy(rhs.m_layerSize, rhs.m_layerSize + MaxLayers, m_layerSize);
+    }
+    return *this;
+}
+
+template <typename Key, typename Value, typename Compare>
+void frozen_bmap<Key, Value, Compare>::clear()
+{
+    freeArray(*m_alloc, m_index, m_indexSize);
+    freeArray(*m_alloc, m_values, m_size);
+    freeArray(*m_alloc, m_keys, m_size);
+
+    m_index = nullptr;
+    m_values = nullptr;
+    m_keys = nullptr;
+    m_size = 0;
+    m_indexSize = 0;
+    m_layers = 0;
+}
+
+// Copies the entries to the key and value arrays. On failure, the entries copied so far are counted in
+// 'm_size', so that 'clear' destroys them.
+template <typename Key, typename Value, typename Compare>
+template <typename EntryRange>
+void frozen_bmap<Key, Value, Compare>::load(const EntryRange& entries)
+{
+    size_type count = 0;
+    if constexpr (HasSize<EntryRange>)
+        count = size_type(entries.size());
+    else
+    {
+        for (auto it = std::begin(entries); it != std::end(entries); ++it)
+            ++count;
+    }
+
+    if (count == 0)
+        return;
+
+    m_keys = allocArray<Key>(*m_alloc, count);
+    try
+    {
+        m_values = allocArray<Value>(*m_alloc, count);
+    }
+    catch (...)
+    {
+        freeArray(*m_alloc, m_keys, 0);
+        m_keys = nullptr;
+        throw;
+    }
+
+    for (const auto& entry : entries)
+    {
+        const Key& key = entryKey(entry);
+        if (m_size > 0 && !m_compare(m_keys[m_size - 1], key))
+            throw std::invalid_argument("frozen_bmap: keys are not in ascending order");
+
+        new (m_keys + m_size) Key(key);
+        try
+        {
+            new (m_values + m_size) Value(entryValue(entry));
+        }
+        catch (...)
+        {
+            m_keys[m_size].~Key();
+            throw;
+        }
+        ++m_size;
+    }
+}
+
+// Builds the index layers from the bottom up. Layers are numbered from the top one, which is the
+// order searches read them, but stored from the bottom one, so that the keys built so far are always at
+// the start of 'm_index' (counted in 'm_indexSize' for 'clear').
+// Each layer is padded to a whole number of blocks, repeating its last key, so that every layer, and so
+// every block, starts on a cache line like 'm_index'.
+template <typename Key, typename Value, typename Compare>
+void frozen_bmap<Key, Value, Compare>::buildIndex()
+{
+    size_type sizes[MaxLayers];
+    unsigned layers = 0;
+    size_type total = 0;
+
+    for (size_type size = m_size; size > BlockKeys; ++layers)
+    {
+        size = (size + BlockKeys - 1) / BlockKeys;
+        sizes[layers] = size;
+        total += padded_size(size);
+    }
+
+    if (layers == 0)
+        return;
+
+    m_index = allocArray<Key>(*m_alloc, total);
+
+    // Entries of each layer are the greatest key of each block of the layer below.
+    const Key* below = m_keys;
+    size_type belowSize = m_size;
+
+    for (unsigned i = 0; i < layers; ++i)
+    {
+        const unsigned layer = layers - 1 - i;
+        Key* keys = m_index + m_indexSize;
+
+        m_layerStart[layer] = m_indexSize;
+        m_layerSize[layer] = sizes[i];
+
+        for (size_type j = 0; j < sizes[i]; ++j)
+        {
+            const size_type last = std::min((j + 1) * BlockKeys, belowSize) - 1;
+            new (keys + j) Key(below[last]);
+            ++m_indexSize;
+        }
+        for (size_type j = sizes[i]; j < padded_size(sizes[i]); ++j)
+        {
+            new (keys + j) Key(keys[sizes[i] - 1]);
+            ++m_indexSize;
+        }
+
+        below = keys;
+        belowSize = sizes[i];
+    }
+
+    m_layers = layers;
+}
+
+template <typename Key, typename Value, typename Compare>
+template <typename T>
+T* frozen_bmap<Key, Value, Compare>::allocArray(IAllocator& alloc, size_type count)
+{
+    const SAllocResult r =
+        alloc.alloc(sizeof(T) * count, std::max(align::of<T>(), align::from_bytes(CacheLine)));
+
+    if (r.buffer == nullptr)
+        throw std::bad_alloc();
+
+    return static_cast<T*>(r.buffer);
+}
+
+template <typename Key, typename Value, typename Compare>
+template <typename T>
+void frozen_bmap<Key, Value, Compare>::freeArray(IAllocator& alloc, T* items, size_type count)
+{
+    if (items == nullptr)
+        return;
+
+    if constexpr (!std::is_trivially_destructible_v<T>)
+    {
+        for (size_type i = 0; i < count; ++i)
+            items[i].~T();
+    }
+    alloc.free(items);
+}
+
+// ------------------------------------------------------------
+// Búsqueda
+// ------------------------------------------------------------
+
+// Descends the index one block per layer. The block searched in each layer is the first one whose
+// greatest key is not less than (greater than, if 'Upper') 'key'; it is the child of the position found
+// in the layer above.
+template <typename Key, typename Value, typename Compare>
+template <bool Upper, typename K>
+count_t frozen_bmap<Key, Value, Compare>::search(const K& key) const
+{
+    auto searchBlock = [this, &key](const Key* keys, size_type first, size_type size)
+    {
+        const size_type count = std::min(BlockKeys, size - first);
+
+        if constexpr (Upper)
+            return first + Search::upper_bound(keys + first, count, key, m_compare);
+        else
+            return first + Search::lower_bound(keys + first, count, key, m_compare);
+    };
+
+    size_type position = 0;
+
+    for (unsigned layer = 0; layer < m_layers; ++layer)
+    {
+        const size_type size = m_layerSize[layer];
+
+        position = searchBlock(m_index + m_layerStart[layer], position * BlockKeys, size);
+
+        // Only possible in the top layer: every key is below 'key'.
+        if (position == size)
+            return m_size;
+    }
+
+    return m_size == 0 ? 0 : searchBlock(m_keys, position * BlockKeys, m_size);
+}
+
+template <typename Key, typename Value, typename Compare>
+template <LookupKeyFor<Key, Compare> K>
+typename frozen_bmap<Key, Value, Compare>::Handle
+frozen_bmap<Key, Value, Compare>::find(const K& key) const
+{
+    const auto& k = lookup_key(key);
+    const size_type index = lower_index(k);
+
+    if (index == m_size || m_compare(k, m_keys[index]))
+        return {};
+    else
+        return Handle(*this, index);
+}
+
+template <typename Key, typename Value, typename Compare>
+template <LookupKeyFor<Key, Compare> K>
+count_t frozen_bmap<Key, Value, Compare>::count(const K& keyLeft, const K& keyRight) const
+{
+    return range(keyLeft, keyRight).size();
+}
+
+template <typename Key, typename Value, typename Compare>
+template <LookupKeyFor<Key, Compare> K>
+typename frozen_bmap<Key, Value, Compare>::Range
+frozen_bmap<Key, Value, Compare>::range(const K& keyLeft, const K& keyRight) const
+{
+    const auto& left = lookup_key(keyLeft);
+    const auto& right = lookup_key(keyRight);
+
+    if (!m_compare(left, right))
+        return Range();
+
+    return Range(*this, lower_index(left), lower_index(right));
+}
+
+template <typename Key, typename Value, typename Compare>
+template <LookupKeyFor<Key, Compare> K>
+const Value& frozen_bmap<Key, Value, Compare>::at(const K& key) const
+{
+    auto h = find(key);
+
+    if (!h)
+        throw std::out_of_range("frozen_bmap: key not found");
+    else
+        return h.value();
+}
+
+} // namespace coll
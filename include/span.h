@@ -24,6 +24,7 @@
 
 #include "collib_types.h"
 
+#include <cassert>
 #include <cstddef>
 #include <limits>
 
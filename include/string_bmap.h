@@ -0,0 +1,1326 @@
+/*
+ * Copyright (c) 2026 Guillermo Hernan Martin
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+ 
+#pragma once
+#include "../src/btree_node_pool.h"
+#include "allocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace coll
+{
+
+/**
+ * B-Tree map with string keys, stored in compressed form inside the nodes.
+ *
+ * Each node keeps its keys in an inline byte heap, indexed by an array of (offset, length) slots, so
+ * comparisons read the node memory instead of following a pointer per key:
+ * - Leaves store once the prefix common to every key they may hold (the common prefix of the
+ *   separators which bound the leaf), and only the suffixes of the keys.
+ * - Internal nodes store the shortest separators which tell both halves of a split apart, instead of
+ *   whole keys.
+ *
+ * It is meant for key sets with long shared prefixes, like URL paths or hierarchical identifiers.
+ *
+ * Differences with 'bmap':
+ * - Keys are not stored as 'std::string' objects, so 'Handle::key' and 'Range::key' build a new string.
+ * - Keys longer than 'InlineKeyBytes' are stored whole in a block of their own, and the nodes keep a
+ *   pointer to it. Comparing them follows that pointer.
+ * - Deletion is relaxed: nodes are merged with a sibling when they fall below a quarter of their
+ *   capacity and the result fits in one node, but never rebalanced. Nodes may stay underfull.
+ */
+template <typename Value, byte_size Order = 64, byte_size HeapBytes = 4096>
+class string_bmap
+{
+    static_assert(Order >= 3, "string_bmap order must be at least 3");
+    static_assert(Order <= 0xFFFF, "string_bmap order must fit in 16 bits");
+    static_assert(HeapBytes >= 64, "string_bmap: key heap too small");
+    static_assert(HeapBytes <= 0xFFFF, "string_bmap: key heap offsets must fit in 16 bits");
+    static_assert(Order * sizeof(void*) <= HeapBytes / 2, "string_bmap: key heap too small for order");
+
+public:
+    struct InsertResult;
+    struct Entry;
+    struct Sentinel
+    {
+    };
+    class Handle;
+    class Range;
+
+    using key_type = std::string;
+    using mapped_type = Value;
+    using size_type = count_t;
+
+    // Longer keys are stored out of the nodes. Every node can hold at least 8 keys of this length, so
+    // splits always leave room for the new key.
+    static constexpr byte_size InlineKeyBytes = HeapBytes / 8;
+
+    string_bmap(IAllocator& alloc = defaultAllocator());
+    ~string_bmap() { clear(); }
+
+    string_bmap(const string_bmap&) = delete;
+    string_bmap& operator=(const string_bmap&) = delete;
+
+    string_bmap(string_bmap&& rhs) noexcept;
+    string_bmap& operator=(string_bmap&& rhs) noexcept;
+
+    // Does not overwrite previous values.
+    InsertResult insert(std::string_view key, const Value& value) { return emplace(key, value); }
+
+    template <typename... Args>
+    InsertResult emplace(std::string_view key, Args&&... args);
+
+    template <typename M>
+    InsertResult insert_or_assign(std::string_view key, M&& obj);
+
+    Handle find(std::string_view key) const;
+    bool contains(std::string_view key) const { return find(key).has_value(); }
+
+    // Entries from the first key not less than 'key'.
+    Range lower_bound(std::string_view key) const;
+
+    Range begin() const { return Range(first_leaf(), 0); }
+    Sentinel end() const { return Sentinel(); }
+
+    size_type size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    Value& operator[](std::string_view key);
+    const Value& operator[](std::string_view key) const { return at(key); }
+    const Value& at(std::string_view key) const;
+
+    bool erase(std::string_view key);
+    void clear();
+
+private:
+    struct Node;
+    struct NodeLeaf;
+
+public:
+    struct Entry
+    {
+        std::string key;
+        const Value& value;
+    };
+
+    class Handle
+    {
+    public:
+        Handle() = default;
+
+        std::string key() const { return m_leaf->keys.key(m_index).str(); }
+        const Value& value() const { return m_leaf->values()[m_index]; }
+
+        bool has_value() const { return m_leaf != nullptr; }
+
+        bool operator!=(const Handle& rhs) const = default;
+        bool operator==(const Handle& rhs) const = default;
+
+        operator bool() const { return has_value(); }
+
+    private:
+        friend class string_bmap;
+
+        Handle(const NodeLeaf* leaf, size_type index)
+            : m_leaf(leaf)
+            , m_index(index)
+        {
+        }
+
+        const NodeLeaf* m_leaf = nullptr;
+        size_type m_index = 0;
+    }; // class Handle
+
+    struct InsertResult
+    {
+        Handle location;
+        bool inserted;
+    };
+
+    class Range
+    {
+    public:
+        Range() = default;
+
+        Entry front() const { return {key(), value()}; }
+
+        std::string key() const { return m_leaf->keys.key(m_index).str(); }
+        const Value& value() const { return m_leaf->values()[m_index]; }
+
+        bool empty() const { return m_leaf == nullptr; }
+        Range begin() const { return *this; }
+        Sentinel end() const { return Sentinel(); }
+
+        Entry operator*() const { return front(); }
+
+        bool operator!=(Sentinel) const { return !empty(); }
+        bool operator==(Sentinel) const { return empty(); }
+
+        Range& operator++()
+        {
+            ++m_index;
+            skip_exhausted();
+            return *this;
+        }
+
+        Range operator++(int)
+        {
+            Range prev = *this;
+            ++(*this);
+            return prev;
+        }
+
+    private:
+        friend class string_bmap;
+
+        Range(const NodeLeaf* leaf, size_type index)
+            : m_leaf(leaf)
+            , m_index(index)
+        {
+            skip_exhausted();
+        }
+
+        // Leaves may be empty after deletions.
+        void skip_exhausted()
+        {
+            while (m_leaf != nullptr && m_index >= m_leaf->keys.count)
+            {
+                m_leaf = m_leaf->next;
+                m_index = 0;
+            }
+        }
+
+        const NodeLeaf* m_leaf = nullptr;
+        size_type m_index = 0;
+    }; // class Range
+
+private:
+    // Key longer than 'InlineKeyBytes', followed by its bytes. Nodes share it by reference count, so
+    // splits and merges do not allocate.
+    struct LongKey
+    {
+        IAllocator* alloc;
+        size_type refs;
+        byte_size length;
+
+        std::string_view view() const { return {reinterpret_cast<const char*>(this + 1), length}; }
+    };
+
+    // Owns a reference to a 'LongKey', if any.
+    class LongKeyRef
+    {
+    public:
+        LongKeyRef() = default;
+        explicit LongKeyRef(LongKey* key)
+            : m_key(key)
+        {
+        }
+        ~LongKeyRef() { release(m_key); }
+
+        LongKeyRef(const LongKeyRef&) = delete;
+        LongKeyRef& operator=(LongKeyRef&& rhs) noexcept
+        {
+            std::swap(m_key, rhs.m_key);
+            return *this;
+        }
+
+        LongKey* get() const { return m_key; }
+
+    private:
+        LongKey* m_key = nullptr;
+    };
+
+    // A key split in two pieces: the prefix of its node and its suffix. Long keys are whole in 'tail',
+    // and 'block' points to their storage.
+    struct KeyRef
+    {
+        std::string_view head;
+        std::string_view tail;
+        LongKey* block = nullptr;
+
+        byte_size size() const { return head.size() + tail.size(); }
+        char operator[](byte_size i) const { return i < head.size() ? head[i] : tail[i - head.size()]; }
+
+        std::string str() const
+        {
+            std::string result;
+            result.reserve(size());
+            result.append(head);
+            result.append(tail);
+            return result;
+        }
+    };
+
+    // Length of the slots of long keys, whose heap bytes are a 'LongKey' pointer.
+    static constexpr uint16_t LongLength = 0xFFFF;
+
+    struct Slot
+    {
+        uint16_t offset;
+        uint16_t length;
+
+        bool is_long() const { return length == LongLength; }
+        byte_size bytes() const { return is_long() ? sizeof(LongKey*) : length; }
+    };
+
+    // Keys of a node. Bytes are appended to 'heap'; the space of removed keys is counted in 'garbage'
+    // and recovered by 'compact' when needed. The prefix is never a long key.
+    struct KeyStore
+    {
+        uint16_t count = 0;
+        uint16_t heapUsed = 0;
+        uint16_t garbage = 0;
+        Slot prefixSlot {0, 0};
+        Slot slots[Order];
+        char heap[HeapBytes];
+
+        std::string_view prefix() const { return {heap + prefixSlot.offset, prefixSlot.length}; }
+
+        std::string_view suffix(size_type i) const
+        {
+            if (slots[i].is_long())
+                return long_key(i)->view().substr(prefixSlot.length);
+            return {heap + slots[i].offset, slots[i].length};
+        }
+
+        KeyRef key(size_type i) const
+        {
+            if (slots[i].is_long())
+            {
+                LongKey* block = long_key(i);
+                return {{}, block->view(), block};
+            }
+            return {prefix(), suffix(i)};
+        }
+
+        LongKey* long_key(size_type i) const
+        {
+            LongKey* block;
+            std::memcpy(&block, heap + slots[i].offset, sizeof(block));
+            return block;
+        }
+
+        // Heap bytes that 'key' needs in this node.
+        byte_size stored_size(const KeyRef& key) const { return key_bytes(key, prefixSlot.length); }
+
+        byte_size live_bytes() const { return byte_size(heapUsed) - garbage; }
+
+        bool has_room(byte_size bytes) const
+        {
+            return count < Order && live_bytes() + bytes <= HeapBytes;
+        }
+
+        size_type lower_bound(std::string_view suffix) const;
+        size_type upper_bound(std::string_view suffix) const;
+
+        // Removes every key, and stores 'newPrefix' as the prefix. Long keys are not released, so the
+        // caller must keep a copy of the store and 'release' it once the keys have been appended again.
+        void reset(std::string_view newPrefix);
+
+        // Appends 'key' after the last one. 'key' must start with the prefix, which is not stored again.
+        void append(const KeyRef& key) { slots[count++] = put(key); }
+
+        void insert(size_type index, const KeyRef& key);
+        void remove(size_type index);
+        void compact();
+
+        // Drops the references of the node to its long keys.
+        void release() const;
+
+    private:
+        // Stores the bytes of 'key' after the used heap, retaining its block if it is long.
+        Slot put(const KeyRef& key);
+    };
+
+    struct Node
+    {
+        const bool isLeaf;
+        KeyStore keys;
+
+        Node(bool leaf)
+            : isLeaf(leaf)
+        {
+        }
+    };
+
+    struct NodeLeaf : public Node
+    {
+        NodeLeaf* next = nullptr;
+        alignas(alignof(Value)) std::byte valueStore[sizeof(Value) * Order];
+
+        NodeLeaf()
+            : Node(true)
+        {
+        }
+
+        Value* values() { return reinterpret_cast<Value*>(valueStore); }
+        const Value* values() const { return reinterpret_cast<const Value*>(valueStore); }
+
+        // Position of the first key not less than 'key'.
+        size_type lower_bound(std::string_view key, bool& found) const;
+
+        // Moves values in [index, end) one position up, leaving 'index' uninitialized.
+        void open_value(size_type index, size_type end);
+        // Destroys the value at 'index', and moves the values in (index, end) one position down.
+        void close_value(size_type index, size_type end);
+    };
+
+    struct NodeInternal : public Node
+    {
+        Node* children[Order + 1];
+
+        NodeInternal()
+            : Node(false)
+        {
+        }
+
+        size_type child_index(std::string_view key) const { return this->keys.upper_bound(key); }
+    };
+
+    // Separators which bound the keys of a subtree: 'low' <= key < 'high'. They point to the keys of the
+    // ancestors, so they are only valid until those are modified.
+    struct Fences
+    {
+        std::string_view low;
+        std::string_view high;
+        bool hasLow = false;
+        bool hasHigh = false;
+
+        Fences child(const NodeInternal* node, size_type index) const;
+
+        // Every key in ['low', 'high') starts with the common prefix of both.
+        byte_size common_prefix() const { return hasLow && hasHigh ? common_length(low, high) : 0; }
+    };
+
+    // Produced by a node split: the new right node and the separator to insert in the parent.
+    struct Split
+    {
+        std::string separator;
+        LongKeyRef block;
+        Node* right = nullptr;
+
+        KeyRef key() const { return {{}, separator, block.get()}; }
+    };
+
+    struct InsertPos
+    {
+        NodeLeaf* leaf;
+        size_type index;
+        bool inserted;
+    };
+
+    Node* m_root = nullptr;
+    size_type m_size = 0;
+    NodePool m_leafPool;
+    NodePool m_internalPool;
+
+    static byte_size common_length(const KeyRef& a, const KeyRef& b);
+    static byte_size common_length(std::string_view a, std::string_view b)
+    {
+        return common_length(KeyRef {{}, a}, KeyRef {{}, b});
+    }
+
+    // Shortest string 's' so that 'a' < 's' <= 'b'.
+    static std::string shortest_separator(const KeyRef& a, const KeyRef& b)
+    {
+        return b.str().substr(0, common_length(a, b) + 1);
+    }
+
+    // Heap bytes that 'key' needs in a node with a prefix of 'prefix' bytes.
+    static byte_size key_bytes(const KeyRef& key, byte_size prefix)
+    {
+        return key.block != nullptr ? sizeof(LongKey*) : key.size() - prefix;
+    }
+
+    // Copies 'key' out of the nodes if it is longer than 'InlineKeyBytes'. Otherwise returns no block.
+    LongKeyRef make_long_key(std::string_view key);
+
+    static LongKey* retain(LongKey* key)
+    {
+        if (key != nullptr)
+            ++key->refs;
+        return key;
+    }
+
+    static void release(LongKey* key)
+    {
+        if (key != nullptr && --key->refs == 0)
+            key->alloc->free(key);
+    }
+
+    static void move_value(Value* dest, Value* src)
+    {
+        new (dest) Value(std::move(*src));
+        src->~Value();
+    }
+
+    const NodeLeaf* find_leaf(std::string_view key) const;
+    const NodeLeaf* first_leaf() const;
+
+    InsertPos insert_key(std::string_view key);
+    InsertPos insert_rec(Node* node, const Fences& fences, std::string_view key, Split& split);
+    InsertPos split_leaf(
+        NodeLeaf* leaf,
+        const Fences& fences,
+        size_type index,
+        const KeyRef& key,
+        Split& split
+    );
+    void insert_child(NodeInternal* node, size_type index, const Split& childSplit, Split& split);
+
+    bool erase_rec(Node* node, const Fences& fences, std::string_view key);
+    static bool is_underfull(const Node* node)
+    {
+        return node->keys.count <= Order / 4 && node->keys.live_bytes() <= HeapBytes / 4;
+    }
+    void merge_children(NodeInternal* node, const Fences& fences, size_type index);
+    bool merge_leaves(NodeInternal* node, const Fences& fences, size_type index);
+    bool merge_internals(NodeInternal* node, size_type index);
+
+    template <typename T>
+    T* create_node();
+    void free_subtree(Node* node);
+};
+
+// ------------------------------------------------------------
+// Constructores
+// ------------------------------------------------------------
+template <typename Value, byte_size Order, byte_size HeapBytes>
+string_bmap<Value, Order, HeapBytes>::string_bmap(IAllocator& alloc)
+    : m_leafPool(alloc, sizeof(NodeLeaf), align::of<NodeLeaf>())
+    , m_internalPool(alloc, sizeof(NodeInternal), align::of<NodeInternal>())
+{
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+string_bmap<Value, Order, HeapBytes>::string_bmap(string_bmap&& rhs) noexcept
+    : m_root(rhs.m_root)
+    , m_size(rhs.m_size)
+    , m_leafPool(std::move(rhs.m_leafPool))
+    , m_internalPool(std::move(rhs.m_internalPool))
+{
+    rhs.m_root = nullptr;
+    rhs.m_size = 0;
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+string_bmap<Value, Order, HeapBytes>& string_bmap<Value, Order, HeapBytes>::operator=(
+    string_bmap&& rhs
+) noexcept
+{
+    if (this != &rhs)
+    {
+        clear();
+        m_root = rhs.m_root;
+        m_size = rhs.m_size;
+        m_leafPool = std::move(rhs.m_leafPool);
+        m_internalPool = std::move(rhs.m_internalPool);
+        rhs.m_root = nullptr;
+        rhs.m_size = 0;
+    }
+    return *this;
+}
+
+// ------------------------------------------------------------
+// Gestión de memoria
+// ------------------------------------------------------------
+template <typename Value, byte_size Order, byte_size HeapBytes>
+template <typename T>
+T* string_bmap<Value, Order, HeapBytes>::create_node()
+{
+    if constexpr (std::is_same_v<T, NodeLeaf>)
+        return new (m_leafPool.alloc()) NodeLeaf;
+    else
+        return new (m_internalPool.alloc()) NodeInternal;
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+void string_bmap<Value, Order, HeapBytes>::free_subtree(Node* node)
+{
+    if (node->isLeaf)
+    {
+        auto leaf = static_cast<NodeLeaf*>(node);
+
+        if constexpr (!std::is_trivially_destructible_v<Value>)
+        {
+            for (size_type i = 0; i < leaf->keys.count; ++i)
+                leaf->values()[i].~Value();
+        }
+        leaf->keys.release();
+        m_leafPool.free(leaf);
+    }
+    else
+    {
+        auto internal = static_cast<NodeInternal*>(node);
+
+        for (size_type i = 0; i <= internal->keys.count; ++i)
+            free_subtree(internal->children[i]);
+        internal->keys.release();
+        m_internalPool.free(internal);
+    }
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+void string_bmap<Value, Order, HeapBytes>::clear()
+{
+    if (m_root != nullptr)
+        free_subtree(m_root);
+
+    m_leafPool.release();
+    m_internalPool.release();
+    m_root = nullptr;
+    m_size = 0;
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+typename string_bmap<Value, Order, HeapBytes>::LongKeyRef
+string_bmap<Value, Order, HeapBytes>::make_long_key(std::string_view key)
+{
+    if (key.size() <= InlineKeyBytes)
+        return LongKeyRef();
+
+    IAllocator& alloc = m_leafPool.allocator();
+    const SAllocResult r = alloc.alloc(sizeof(LongKey) + key.size(), align::of<LongKey>());
+
+    if (r.buffer == nullptr)
+        throw std::bad_alloc();
+
+    auto block = new (r.buffer) LongKey {&alloc, 1, key.size()};
+    std::copy(key.begin(), key.end(), reinterpret_cast<char*>(block + 1));
+    return LongKeyRef(block);
+}
+
+// ------------------------------------------------------------
+// Almacenamiento de claves
+// ------------------------------------------------------------
+template <typename Value, byte_size Order, byte_size HeapBytes>
+byte_size string_bmap<Value, Order, HeapBytes>::common_length(const KeyRef& a, const KeyRef& b)
+{
+    const byte_size limit = std::min(a.size(), b.size());
+    byte_size i = 0;
+
+    while (i < limit && a[i] == b[i])
+        ++i;
+    return i;
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+typename string_bmap<Value, Order, HeapBytes>::size_type
+string_bmap<Value, Order, HeapBytes>::KeyStore::lower_bound(std::string_view suffix) const
+{
+    size_type first = 0;
+    size_type len = count;
+
+    while (len > 0)
+    {
+        const size_type half = len / 2;
+
+        if (this->suffix(first + half) < suffix)
+        {
+            first += half + 1;
+            len -= half + 1;
+        }
+        else
+            len = half;
+    }
+    return first;
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+typename string_bmap<Value, Order, HeapBytes>::size_type
+string_bmap<Value, Order, HeapBytes>::KeyStore::upper_bound(std::string_view suffix) const
+{
+    size_type first = 0;
+    size_type len = count;
+
+    while (len > 0)
+    {
+        const size_type half = len / 2;
+
+        if (!(suffix < this->suffix(first + half)))
+        {
+            first += half + 1;
+            len -= half + 1;
+        }
+        else
+            len = half;
+    }
+    return first;
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+void string_bmap<Value, Order, HeapBytes>::KeyStore::reset(std::string_view newPrefix)
+{
+    std::copy(newPrefix.begin(), newPrefix.end(), heap);
+    prefixSlot = {0, uint16_t(newPrefix.size())};
+    heapUsed = uint16_t(newPrefix.size());
+    garbage = 0;
+    count = 0;
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+typename string_bmap<Value, Order, HeapBytes>::Slot
+string_bmap<Value, Order, HeapBytes>::KeyStore::put(const KeyRef& key)
+{
+    assert(count < Order && heapUsed + stored_size(key) <= HeapBytes);
+
+    const uint16_t offset = heapUsed;
+
+    if (key.block != nullptr)
+    {
+        LongKey* block = retain(key.block);
+
+        std::memcpy(heap + offset, &block, sizeof(block));
+        heapUsed += uint16_t(sizeof(block));
+        return {offset, LongLength};
+    }
+
+    // Skips the bytes of 'key' which are already in the prefix. They may come from both pieces.
+    const byte_size skip = prefixSlot.length;
+    const std::string_view head = key.head.substr(std::min(skip, key.head.size()));
+    const std::string_view tail = key.tail.substr(skip - std::min(skip, key.head.size()));
+    const byte_size length = head.size() + tail.size();
+
+    assert(length <= InlineKeyBytes);
+
+    std::copy(tail.begin(), tail.end(), std::copy(head.begin(), head.end(), heap + offset));
+    heapUsed += uint16_t(length);
+    return {offset, uint16_t(length)};
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+void string_bmap<Value, Order, HeapBytes>::KeyStore::insert(size_type index, const KeyRef& key)
+{
+    assert(has_room(stored_size(key)));
+
+    if (heapUsed + stored_size(key) > HeapBytes)
+        compact();
+
+    std::memmove(slots + index + 1, slots + index, (count - index) * sizeof(Slot));
+    slots[index] = put(key);
+    ++count;
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+void string_bmap<Value, Order, HeapBytes>::KeyStore::remove(size_type index)
+{
+    if (slots[index].is_long())
+        string_bmap::release(long_key(index));
+
+    garbage += uint16_t(slots[index].bytes());
+    std::memmove(slots + index, slots + index + 1, (count - index - 1) * sizeof(Slot));
+    --count;
+}
+
+// Copies the stored bytes of every key, so long keys keep their references.
+template <typename Value, byte_size Order, byte_size HeapBytes>
+void string_bmap<Value, Order, HeapBytes>::KeyStore::compact()
+{
+    const KeyStore source = *this;
+
+    reset(source.prefix());
+    for (size_type i = 0; i < source.count; ++i)
+    {
+        const Slot slot = source.slots[i];
+
+        std::memcpy(heap + heapUsed, source.heap + slot.offset, slot.bytes());
+        slots[i] = {heapUsed, slot.length};
+        heapUsed += uint16_t(slot.bytes());
+    }
+    count = source.count;
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+void string_bmap<Value, Order, HeapBytes>::KeyStore::release() const
+{
+    for (size_type i = 0; i < count; ++i)
+    {
+        if (slots[i].is_long())
+            string_bmap::release(long_key(i));
+    }
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+typename string_bmap<Value, Order, HeapBytes>::size_type
+string_bmap<Value, Order, HeapBytes>::NodeLeaf::lower_bound(std::string_view key, bool& found) const
+{
+    const std::string_view prefix = this->keys.prefix();
+    found = false;
+
+    // Keys routed to a leaf always start with its prefix. The check keeps the search correct anyway.
+    if (key.substr(0, prefix.size()) != prefix)
+        return key < prefix ? 0 : this->keys.count;
+
+    const std::string_view suffix = key.substr(prefix.size());
+    const size_type index = this->keys.lower_bound(suffix);
+
+    found = index < this->keys.count && this->keys.suffix(index) == suffix;
+    return index;
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+void string_bmap<Value, Order, HeapBytes>::NodeLeaf::open_value(size_type index, size_type end)
+{
+    for (size_type i = end; i > index; --i)
+        move_value(values() + i, values() + i - 1);
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+void string_bmap<Value, Order, HeapBytes>::NodeLeaf::close_value(size_type index, size_type end)
+{
+    values()[index].~Value();
+    for (size_type i = index + 1; i < end; ++i)
+        move_value(values() + i - 1, values() + i);
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+typename string_bmap<Value, Order, HeapBytes>::Fences
+string_bmap<Value, Order, HeapBytes>::Fences::child(const NodeInternal* node, size_type index) const
+{
+    Fences result = *this;
+
+    if (index > 0)
+    {
+        result.low = node->keys.suffix(index - 1);
+        result.hasLow = true;
+    }
+    if (index < node->keys.count)
+    {
+        result.high = node->keys.suffix(index);
+        result.hasHigh = true;
+    }
+    return result;
+}
+
+// ------------------------------------------------------------
+// Búsqueda
+// ------------------------------------------------------------
+template <typename Value, byte_size Order, byte_size HeapBytes>
+const typename string_bmap<Value, Order, HeapBytes>::NodeLeaf*
+string_bmap<Value, Order, HeapBytes>::find_leaf(std::string_view key) const
+{
+    const Node* node = m_root;
+
+    if (node == nullptr)
+        return nullptr;
+
+    while (!node->isLeaf)
+    {
+        auto internal = static_cast<const NodeInternal*>(node);
+        node = internal->children[internal->child_index(key)];
+    }
+    return static_cast<const NodeLeaf*>(node);
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+const typename string_bmap<Value, Order, HeapBytes>::NodeLeaf*
+string_bmap<Value, Order, HeapBytes>::first_leaf() const
+{
+    const Node* node = m_root;
+
+    if (node == nullptr)
+        return nullptr;
+
+    while (!node->isLeaf)
+        node = static_cast<const NodeInternal*>(node)->children[0];
+    return static_cast<const NodeLeaf*>(node);
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+typename string_bmap<Value, Order, HeapBytes>::Handle
+string_bmap<Value, Order, HeapBytes>::find(std::string_view key) const
+{
+    const NodeLeaf* leaf = find_leaf(key);
+
+    if (leaf == nullptr)
+        return Handle();
+
+    bool found;
+    const size_type index = leaf->lower_bound(key, found);
+
+    return found ? Handle(leaf, index) : Handle();
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+typename string_bmap<Value, Order, HeapBytes>::Range
+string_bmap<Value, Order, HeapBytes>::lower_bound(std::string_view key) const
+{
+    const NodeLeaf* leaf = find_leaf(key);
+
+    if (leaf == nullptr)
+        return Range();
+
+    // If every key of the leaf is lower, the next leaf starts at a separator greater than 'key'.
+    bool found;
+    return Range(leaf, leaf->lower_bound(key, found));
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+const Value& string_bmap<Value, Order, HeapBytes>::at(std::string_view key) const
+{
+    const Handle handle = find(key);
+
+    if (!handle)
+        throw std::out_of_range("string_bmap: key not found");
+
+    return handle.value();
+}
+
+// ------------------------------------------------------------
+// Inserción
+// ------------------------------------------------------------
+template <typename Value, byte_size Order, byte_size HeapBytes>
+template <typename... Args>
+typename string_bmap<Value, Order, HeapBytes>::InsertResult
+string_bmap<Value, Order, HeapBytes>::emplace(std::string_view key, Args&&... args)
+{
+    const InsertPos pos = insert_key(key);
+    Value* value = pos.leaf->values() + pos.index;
+
+    if (pos.inserted)
+    {
+        // The slot for the value is already in the leaf. If the constructor throws, the key is removed.
+        try
+        {
+            new (value) Value(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            pos.leaf->keys.remove(pos.index);
+            for (size_type i = pos.index; i < pos.leaf->keys.count; ++i)
+                move_value(value + i - pos.index, value + i - pos.index + 1);
+            throw;
+        }
+        ++m_size;
+    }
+
+    return {Handle(pos.leaf, pos.index), pos.inserted};
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+template <typename M>
+typename string_bmap<Value, Order, HeapBytes>::InsertResult
+string_bmap<Value, Order, HeapBytes>::insert_or_assign(std::string_view key, M&& obj)
+{
+    const InsertResult result = emplace(key, std::forward<M>(obj));
+
+    if (!result.inserted)
+        const_cast<NodeLeaf*>(result.location.m_leaf)->values()[result.location.m_index] =
+            std::forward<M>(obj);
+
+    return result;
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+Value& string_bmap<Value, Order, HeapBytes>::operator[](std::string_view key)
+{
+    const Handle handle = emplace(key).location;
+    return const_cast<Value&>(handle.value());
+}
+
+// Inserts the key, leaving its value uninitialized. If already present, returns its position.
+template <typename Value, byte_size Order, byte_size HeapBytes>
+typename string_bmap<Value, Order, HeapBytes>::InsertPos
+string_bmap<Value, Order, HeapBytes>::insert_key(std::string_view key)
+{
+    if (m_root == nullptr)
+        m_root = create_node<NodeLeaf>();
+
+    Split split;
+    const InsertPos pos = insert_rec(m_root, Fences(), key, split);
+
+    if (split.right != nullptr)
+    {
+        auto root = create_node<NodeInternal>();
+
+        root->keys.append(split.key());
+        root->children[0] = m_root;
+        root->children[1] = split.right;
+        m_root = root;
+    }
+    return pos;
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+typename string_bmap<Value, Order, HeapBytes>::InsertPos
+string_bmap<Value, Order, HeapBytes>::insert_rec(
+    Node* node,
+    const Fences& fences,
+    std::string_view key,
+    Split& split
+)
+{
+    if (node->isLeaf)
+    {
+        auto leaf = static_cast<NodeLeaf*>(node);
+        bool found;
+        const size_type index = leaf->lower_bound(key, found);
+
+        if (found)
+            return {leaf, index, false};
+
+        const LongKeyRef block = make_long_key(key);
+        const KeyRef entry {{}, key, block.get()};
+
+        if (!leaf->keys.has_room(leaf->keys.stored_size(entry)))
+            return split_leaf(leaf, fences, index, entry, split);
+
+        leaf->open_value(index, leaf->keys.count);
+        leaf->keys.insert(index, entry);
+        return {leaf, index, true};
+    }
+
+    auto internal = static_cast<NodeInternal*>(node);
+    const size_type index = internal->child_index(key);
+    Split childSplit;
+
+    const InsertPos pos =
+        insert_rec(internal->children[index], fences.child(internal, index), key, childSplit);
+
+    if (childSplit.right != nullptr)
+        insert_child(internal, index, childSplit, split);
+
+    return pos;
+}
+
+// Splits a full leaf while inserting 'key' at 'index'. The keys are distributed as if the new key were
+// already in the leaf, and each half gets the longest prefix allowed by its new fences.
+template <typename Value, byte_size Order, byte_size HeapBytes>
+typename string_bmap<Value, Order, HeapBytes>::InsertPos
+string_bmap<Value, Order, HeapBytes>::split_leaf(
+    NodeLeaf* leaf,
+    const Fences& fences,
+    size_type index,
+    const KeyRef& key,
+    Split& split
+)
+{
+    const KeyStore source = leaf->keys;
+    const size_type total = source.count + 1;
+
+    auto entry = [&](size_type i) -> KeyRef
+    {
+        if (i < index)
+            return source.key(i);
+        else if (i == index)
+            return key;
+        else
+            return source.key(i - 1);
+    };
+
+    // Appending after the last key of the map leaves the left leaf full, as keys probably keep coming
+    // in order. Otherwise, both halves get about the same number of suffix bytes.
+    const byte_size prefixLength = source.prefixSlot.length;
+    size_type mid = total - 1;
+
+    if (index != source.count || leaf->next != nullptr)
+    {
+        byte_size bytes = 0;
+        for (size_type i = 0; i < total; ++i)
+            bytes += key_bytes(entry(i), prefixLength);
+
+        byte_size leftBytes = 0;
+        for (mid = 0; mid < total - 1 && leftBytes * 2 < bytes; ++mid)
+            leftBytes += key_bytes(entry(mid), prefixLength);
+        mid = std::max(mid, size_type(1));
+    }
+
+    split.separator = shortest_separator(entry(mid - 1), entry(mid));
+    split.block = make_long_key(split.separator);
+
+    // Prefixes are kept inline. Keys which would need a longer one are long keys anyway.
+    const std::string_view separator = split.separator;
+    const byte_size leftPrefix =
+        fences.hasLow ? std::min(common_length(fences.low, separator), InlineKeyBytes) : 0;
+    const byte_size rightPrefix =
+        fences.hasHigh ? std::min(common_length(separator, fences.high), InlineKeyBytes) : 0;
+
+    auto right = create_node<NodeLeaf>();
+
+    right->keys.reset(separator.substr(0, rightPrefix));
+    for (size_type i = mid; i < total; ++i)
+        right->keys.append(entry(i));
+
+    leaf->keys.reset(separator.substr(0, leftPrefix));
+    for (size_type i = 0; i < mid; ++i)
+        leaf->keys.append(entry(i));
+    source.release();
+
+    for (size_type i = mid; i < total; ++i)
+    {
+        if (i != index)
+            move_value(right->values() + i - mid, leaf->values() + (i < index ? i : i - 1));
+    }
+    if (index < mid)
+        leaf->open_value(index, mid - 1);
+
+    right->next = leaf->next;
+    leaf->next = right;
+    split.right = right;
+
+    if (index < mid)
+        return {leaf, index, true};
+    else
+        return {right, index - mid, true};
+}
+
+// Inserts in 'node' the separator and the new child produced by splitting its child 'index'. If there
+// is no room, 'node' is split too, promoting its middle separator.
+template <typename Value, byte_size Order, byte_size HeapBytes>
+void string_bmap<Value, Order, HeapBytes>::insert_child(
+    NodeInternal* node,
+    size_type index,
+    const Split& childSplit,
+    Split& split
+)
+{
+    const size_type count = node->keys.count;
+
+    if (node->keys.has_room(node->keys.stored_size(childSplit.key())))
+    {
+        node->keys.insert(index, childSplit.key());
+        std::memmove(
+            node->children + index + 2,
+            node->children + index + 1,
+            (count - index) * sizeof(Node*)
+        );
+        node->children[index + 1] = childSplit.right;
+        return;
+    }
+
+    const KeyStore source = node->keys;
+    const size_type total = count + 1;
+    Node* children[Order + 2];
+
+    std::memcpy(children, node->children, (index + 1) * sizeof(Node*));
+    children[index + 1] = childSplit.right;
+    std::memcpy(children + index + 2, node->children + index + 1, (count - index) * sizeof(Node*));
+
+    auto entry = [&](size_type i) -> KeyRef
+    {
+        if (i < index)
+            return source.key(i);
+        else if (i == index)
+            return childSplit.key();
+        else
+            return source.key(i - 1);
+    };
+
+    byte_size bytes = 0;
+    for (size_type i = 0; i < total; ++i)
+        bytes += key_bytes(entry(i), 0);
+
+    size_type mid = 0;
+    byte_size leftBytes = 0;
+
+    while (mid < total - 2 && leftBytes * 2 < bytes)
+        leftBytes += key_bytes(entry(mid++), 0);
+    mid = std::max(mid, size_type(1));
+
+    split.separator = entry(mid).str();
+    split.block = LongKeyRef(retain(entry(mid).block));
+
+    auto right = create_node<NodeInternal>();
+
+    right->keys.reset({});
+    for (size_type i = mid + 1; i < total; ++i)
+        right->keys.append(entry(i));
+    std::memcpy(right->children, children + mid + 1, (total - mid) * sizeof(Node*));
+
+    node->keys.reset({});
+    for (size_type i = 0; i < mid; ++i)
+        node->keys.append(entry(i));
+    std::memcpy(node->children, children, (mid + 1) * sizeof(Node*));
+    source.release();
+
+    split.right = right;
+}
+
+// ------------------------------------------------------------
+// Borrado
+// ------------------------------------------------------------
+template <typename Value, byte_size Order, byte_size HeapBytes>
+bool string_bmap<Value, Order, HeapBytes>::erase(std::string_view key)
+{
+    if (m_root == nullptr || !erase_rec(m_root, Fences(), key))
+        return false;
+
+    --m_size;
+
+    while (!m_root->isLeaf && m_root->keys.count == 0)
+    {
+        auto root = static_cast<NodeInternal*>(m_root);
+        m_root = root->children[0];
+        m_internalPool.free(root);
+    }
+
+    if (m_size == 0)
+        clear();
+
+    return true;
+}
+
+template <typename Value, byte_size Order, byte_size HeapBytes>
+bool string_bmap<Value, Order, HeapBytes>::erase_rec(
+    Node* node,
+    const Fences& fences,
+    std::string_view key
+)
+{
+    if (node->isLeaf)
+    {
+        auto leaf = static_cast<NodeLeaf*>(node);
+        bool found;
+        const size_type index = leaf->lower_bound(key, found);
+
+        if (!found)
+            return false;
+
+        leaf->close_value(index, leaf->keys.count);
+        leaf->keys.remove(index);
+        return true;
+    }
+
+    auto internal = static_cast<NodeInternal*>(node);
+    const size_type index = internal->child_index(key);
+
+    if (!erase_rec(internal->children[index], fences.child(internal, index), key))
+        return false;
+
+    if (is_underfull(internal->children[index]))
+        merge_children(internal, fences, index);
+
+    return true;
+}
+
+// Tries to merge the underfull child 'index' with its right sibling, or with the left one if it is the
+// last child.
+template <typename Value, byte_size Order, byte_size HeapBytes>
+void string_bmap<Value, Order, HeapBytes>::merge_children(
+    NodeInternal* node,
+    const Fences& fences,
+    size_type index
+)
+{
+    if (node->keys.count == 0)
+        return;
+
+    const size_type left = index < node->keys.count ? index : index - 1;
+    const bool merged = node->children[left]->isLeaf ? merge_leaves(node, fences, left)
+                                                     : merge_internals(node, left);
+
+    if (merged)
+    {
+        const size_type count = node->keys.count;
+
+        node->keys.remove(left);
+        std::memmove(
+            node->children + left + 1,
+            node->children + left + 2,
+            (count - left - 1) * sizeof(Node*)
+        );
+    }
+}
+
+// Moves the keys of the leaf 'index + 1' to the leaf 'index', if they fit. The merged leaf has wider
+// fences, so its prefix may be shorter.
+template <typename Value, byte_size Order, byte_size HeapBytes>
+bool string_bmap<Value, Order, HeapBytes>::merge_leaves(
+    NodeInternal* node,
+    const Fences& fences,
+    size_type index
+)
+{
+    auto left = static_cast<NodeLeaf*>(node->children[index]);
+    auto right = static_cast<NodeLeaf*>(node->children[index + 1]);
+    const size_type leftCount = left->keys.count;
+    const size_type rightCount = right->keys.count;
+
+    if (leftCount + rightCount > Order)
+        return false;
+
+    const Fences leftFences = fences.child(node, index);
+    const Fences rightFences = fences.child(node, index + 1);
+    const Fences merged {leftFences.low, rightFences.high, leftFences.hasLow, rightFences.hasHigh};
+    const byte_size prefix = std::min(merged.common_prefix(), InlineKeyBytes);
+
+    byte_size bytes = prefix;
+    for (size_type i = 0; i < leftCount; ++i)
+        bytes += key_bytes(left->keys.key(i), prefix);
+    for (size_type i = 0; i < rightCount; ++i)
+        bytes += key_bytes(right->keys.key(i), prefix);
+
+    if (bytes > HeapBytes)
+        return false;
+
+    const KeyStore source = left->keys;
+
+    left->keys.reset(merged.low.substr(0, prefix));
+    for (size_type i = 0; i < leftCount; ++i)
+        left->keys.append(source.key(i));
+    for (size_type i = 0; i < rightCount; ++i)
+    {
+        left->keys.append(right->keys.key(i));
+        move_value(left->values() + leftCount + i, right->values() + i);
+    }
+    source.release();
+    right->keys.release();
+
+    left->next = right->next;
+    m_leafPool.free(right);
+    return true;
+}
+
+// Moves the separator 'index' and the contents of the child 'index + 1' to the child 'index', if they
+// fit.
+template <typename Value, byte_size Order, byte_size HeapBytes>
+bool string_bmap<Value, Order, HeapBytes>::merge_internals(NodeInternal* node, size_type index)
+{
+    auto left = static_cast<NodeInternal*>(node->children[index]);
+    auto right = static_cast<NodeInternal*>(node->children[index + 1]);
+    const size_type leftCount = left->keys.count;
+    const size_type rightCount = right->keys.count;
+    const KeyRef separator = node->keys.key(index);
+
+    if (leftCount + rightCount + 1 > Order
+        || left->keys.live_bytes() + key_bytes(separator, 0) + right->keys.live_bytes() > HeapBytes)
+        return false;
+
+    left->keys.compact();
+    left->keys.append(separator);
+    for (size_type i = 0; i < rightCount; ++i)
+        left->keys.append(right->keys.key(i));
+    std::memcpy(left->children + leftCount + 1, right->children, (rightCount + 1) * sizeof(Node*));
+    right->keys.release();
+
+    m_internalPool.free(right);
+    return true;
+}
+
+} // namespace coll
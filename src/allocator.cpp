@@ -22,19 +22,22 @@
 
 #include "allocator.h"
 
+#include "allocators/size_class_allocator.h"
 #include "collib_version.h"
 #include "bmap.h"
 #include "darray.h"
 
 #include <iostream>
 #include <functional>
-#include <malloc.h>
 
 namespace coll
 {
 thread_local darray<IAllocator*> tl_defaultAllocators;
 thread_local darray<IAllocLogger*> tl_loggers;
 
+// Avoids logging the allocations made by the log sinks. Per thread, as the loggers.
+thread_local bool tl_loggingGuard = false;
+
 // TODO: Make public??
 class AtExit
 {
@@ -50,34 +53,10 @@ private:
     std::function<void()> m_fn;
 };
 
-struct MallocAllocator : public IAllocator
-{
-    SAllocResult alloc(byte_size bytes, align a) override
-    {
-        SAllocResult result {malloc(bytes), bytes};
-        AllocLogger::instance().alloc(*this, bytes, bytes, result.buffer, a);
-        return result;
-    }
-
-    byte_size tryExpand(byte_size requestedBytes, void* buffer) override
-    {
-        AllocLogger::instance().tryExpand(*this, requestedBytes, 0, buffer);
-        return 0;
-    }
-
-    void free(void* buffer) override
-    {
-        AllocLogger::instance().free(*this, buffer);
-        ::free(buffer);
-    }
-};
-
 IAllocator& defaultAllocator()
 {
-    static MallocAllocator sillyMallocAllocator;
-
     if (tl_defaultAllocators.empty())
-        return sillyMallocAllocator;
+        return SizeClassAllocator::instance();
     else
         return *tl_defaultAllocators.back();
 }
@@ -205,11 +184,11 @@ void AllocLogger::alloc(
     align a
 )
 {
-    if (m_recursiveGuard)
+    if (tl_loggingGuard)
         return;
 
-    m_recursiveGuard = true;
-    AtExit ex([this]() { m_recursiveGuard = false; });
+    tl_loggingGuard = true;
+    AtExit ex([]() { tl_loggingGuard = false; });
 
     for (auto* sink : tl_loggers)
         sink->alloc(allocator, requestedBytes, allocBytes, buffer, a);
@@ -222,11 +201,11 @@ void AllocLogger::tryExpand(
     const void* buffer
 )
 {
-    if (m_recursiveGuard)
+    if (tl_loggingGuard)
         return;
 
-    m_recursiveGuard = true;
-    AtExit ex([this]() { m_recursiveGuard = false; });
+    tl_loggingGuard = true;
+    AtExit ex([]() { tl_loggingGuard = false; });
 
     for (auto* sink : tl_loggers)
         sink->tryExpand(allocator, requestedBytes, allocBytes, buffer);
@@ -234,11 +213,11 @@ void AllocLogger::tryExpand(
 
 void AllocLogger::free(const IAllocator& allocator, const void* buffer)
 {
-    if (m_recursiveGuard)
+    if (tl_loggingGuard)
         return;
 
-    m_recursiveGuard = true;
-    AtExit ex([this]() { m_recursiveGuard = false; });
+    tl_loggingGuard = true;
+    AtExit ex([]() { tl_loggingGuard = false; });
 
     for (auto* sink : tl_loggers)
         sink->free(allocator, buffer);
@@ -1,5 +1,7 @@
 #include "allocators/arena_allocator.h"
 
+#include <algorithm>
+
 namespace coll
 {
 
@@ -7,6 +9,7 @@ ArenaAllocator::ArenaAllocator(span<uint8_t> backingBuffer, IAllocator& fallback
     : m_fallback(fallback)
     , m_buffer(backingBuffer)
     , m_usedBytes(0)
+    , m_lastBlock(nullptr)
     , m_ownedBuffer(false)
 {
 }
@@ -14,6 +17,7 @@ ArenaAllocator::ArenaAllocator(span<uint8_t> backingBuffer, IAllocator& fallback
 ArenaAllocator::ArenaAllocator(byte_size size, IAllocator& fallback)
     : m_fallback(fallback)
     , m_usedBytes(0)
+    , m_lastBlock(nullptr)
     , m_ownedBuffer(true)
 {
     auto [buffer, bufferSize] = fallback.alloc(size, align::system());
@@ -42,6 +46,7 @@ SAllocResult ArenaAllocator::alloc(byte_size bytes, align a)
 
     const byte_size offset = m_usedBytes + padding;
     m_usedBytes += totalSize;
+    m_lastBlock = m_buffer.data() + offset;
 
     SAllocResult result{m_buffer.data() + offset, correctedSize};
     AllocLogger::instance().alloc(*this, bytes, correctedSize, result.buffer, a);
@@ -49,10 +54,31 @@ SAllocResult ArenaAllocator::alloc(byte_size bytes, align a)
     return result;
 }
 
-byte_size ArenaAllocator::tryExpand(byte_size bytes, void* buffer) 
-{ 
-    AllocLogger::instance().tryExpand(*this, bytes, 0, buffer);
-    return 0;
+// Only the last block can grow, as it is the only one whose size is known: it ends at the top of
+// the arena.
+byte_size ArenaAllocator::tryExpand(byte_size bytes, void* buffer)
+{
+    if (buffer == nullptr)
+        return 0;
+
+    if (!m_buffer.contains(reinterpret_cast<uint8_t*>(buffer)))
+        return m_fallback.tryExpand(bytes, buffer);
+
+    byte_size result = 0;
+
+    if (buffer == m_lastBlock)
+    {
+        const byte_size offset = m_lastBlock - m_buffer.data();
+
+        result = std::max(m_usedBytes - offset, bytes);
+        if (result > m_buffer.size() - offset)
+            result = m_usedBytes - offset;
+
+        m_usedBytes = offset + result;
+    }
+
+    AllocLogger::instance().tryExpand(*this, bytes, result, buffer);
+    return result;
 }
 
 void ArenaAllocator::free(void* block)
@@ -62,7 +88,30 @@ void ArenaAllocator::free(void* block)
     else
         AllocLogger::instance().free(*this, block);
 
-    // If the block is within the Arena, nothing is done. All memory is freed at the end.
+    // The last block returns to the arena. Other blocks in the arena are freed at the end, or when
+    // the arena is rewound.
+    if (block == m_lastBlock)
+    {
+        m_usedBytes = m_lastBlock - m_buffer.data();
+        m_lastBlock = nullptr;
+    }
+}
+
+// The last block is sealed while the mark is active: if it could grow or be freed, the top of the
+// arena would no longer match the mark, and the scope would overlap it or leak.
+ArenaAllocator::Mark ArenaAllocator::mark()
+{
+    const Mark result{m_usedBytes, m_lastBlock};
+
+    m_lastBlock = nullptr;
+    return result;
+}
+
+// The sealed block ends at the mark again, so it becomes the last block.
+void ArenaAllocator::rewind(const Mark& m)
+{
+    m_usedBytes = m.usedBytes;
+    m_lastBlock = m.lastBlock;
 }
 
 } // namespace coll
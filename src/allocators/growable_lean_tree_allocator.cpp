@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2026 Guillermo Hernan Martin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "allocators/growable_lean_tree_allocator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace coll
+{
+GrowableLeanTreeAllocator::GrowableLeanTreeAllocator(IAllocator& backing, const Parameters& params)
+    : m_backing(backing)
+    , m_params(params)
+    , m_regionCount(0)
+{
+    m_params.maxRegions = std::max(m_params.maxRegions, count_t(1));
+
+    // Two slots per region, and a table at most half full.
+    m_slotCount = Power2::round_up(byte_size(m_params.maxRegions) * 4);
+
+    auto [regions, _r] = m_backing.alloc(sizeof(LeanTreeAllocator*) * m_params.maxRegions, align::system());
+    auto [slots, _s] = m_backing.alloc(sizeof(SSlot) * m_slotCount.value(), align::of<SSlot>());
+    if (regions == nullptr || slots == nullptr)
+    {
+        if (regions != nullptr)
+            m_backing.free(regions);
+        if (slots != nullptr)
+            m_backing.free(slots);
+        throw std::bad_alloc();
+    }
+
+    m_regions = static_cast<LeanTreeAllocator**>(regions);
+    m_slots = static_cast<SSlot*>(slots);
+
+    // The first region fixes the parameters, as LeanTreeAllocator corrects them.
+    LeanTreeAllocator* first = nullptr;
+    try
+    {
+        first = create<LeanTreeAllocator>(m_backing, m_backing, m_params.tree);
+    }
+    catch (...)
+    {
+        m_backing.free(m_regions);
+        m_backing.free(m_slots);
+        throw;
+    }
+
+    m_params.tree = first->params();
+    m_granuleLog2 = m_params.tree.totalSize.log2();
+
+    m_regions[m_regionCount++] = first;
+    rebuildSlots();
+}
+
+GrowableLeanTreeAllocator::~GrowableLeanTreeAllocator()
+{
+    for (count_t i = 0; i < m_regionCount; ++i)
+        destroy(m_backing, m_regions[i]);
+
+    m_backing.free(m_regions);
+    m_backing.free(m_slots);
+}
+
+SAllocResult GrowableLeanTreeAllocator::alloc(byte_size bytes, align a)
+{
+    // Fails before adding a region which could not serve it either.
+    if (bytes > m_params.tree.maxAllocSize.value() || a > m_params.tree.a)
+        return {nullptr, 0};
+
+    const count_t topBlocks = count_t((m_params.tree.totalSize / m_params.tree.maxAllocSize).value());
+    SAllocResult result {nullptr, 0};
+
+    for (count_t i = 0; i < m_regionCount && result.buffer == nullptr; ++i)
+    {
+        LeanTreeAllocator& region = *m_regions[i];
+
+        result = region.allocInRange(bytes, a, 0, topBlocks);
+        if (result.buffer != nullptr)
+            region.m_stats.bytesUsed += result.bytes;
+    }
+
+    if (result.buffer == nullptr && m_regionCount < m_params.maxRegions)
+    {
+        LeanTreeAllocator* region = addRegion();
+
+        if (region != nullptr)
+        {
+            result = region->allocInRange(bytes, a, 0, topBlocks);
+
+            // It does not fit even in an empty region (the one which holds the metadata).
+            if (result.buffer == nullptr)
+                releaseRegion(m_regionCount - 1);
+            else
+                region->m_stats.bytesUsed += result.bytes;
+        }
+    }
+
+    if (result.buffer != nullptr)
+        AllocLogger::instance().alloc(*this, bytes, result.bytes, result.buffer, a);
+
+    return result;
+}
+
+byte_size GrowableLeanTreeAllocator::tryExpand(byte_size bytes, void* buffer)
+{
+    if (buffer == nullptr)
+        return 0;
+
+    LeanTreeAllocator* region = regionOf(buffer);
+    if (region == nullptr)
+        throw std::runtime_error("LeanTreeAllocator: Pointer outside managed area");
+
+    const count_t basicBlockIndex = region->checkedBlockIndex(buffer);
+    const byte_size current = region->blockBytes(basicBlockIndex);
+    const byte_size result = region->expandBlock(basicBlockIndex, bytes);
+
+    region->m_stats.bytesUsed += result - current;
+    AllocLogger::instance().tryExpand(*this, bytes, result, buffer);
+
+    return result;
+}
+
+void GrowableLeanTreeAllocator::free(void* buffer)
+{
+    LeanTreeAllocator* region = regionOf(buffer);
+    if (region == nullptr)
+        throw std::runtime_error("LeanTreeAllocator: Pointer outside managed area");
+
+    region->free(buffer);
+    AllocLogger::instance().free(*this, buffer);
+
+    if (!isEmpty(*region))
+        return;
+
+    count_t emptyRegions = 0;
+    count_t index = 0;
+
+    for (count_t i = 0; i < m_regionCount; ++i)
+    {
+        if (isEmpty(*m_regions[i]))
+            ++emptyRegions;
+        if (m_regions[i] == region)
+            index = i;
+    }
+
+    if (emptyRegions > m_params.emptyRegionsKept && m_regionCount > 1)
+        releaseRegion(index);
+}
+
+GrowableLeanTreeAllocator::Stats GrowableLeanTreeAllocator::stats() const
+{
+    Stats result;
+
+    for (count_t i = 0; i < m_regionCount; ++i)
+    {
+        const Stats regionStats = m_regions[i]->stats();
+
+        result.totalBytes += regionStats.totalBytes;
+        result.bytesUsed += regionStats.bytesUsed;
+        result.largestFreeBlock = std::max(result.largestFreeBlock, regionStats.largestFreeBlock);
+        result.metaDataSize += regionStats.metaDataSize;
+    }
+
+    return result;
+}
+
+bool GrowableLeanTreeAllocator::validate(std::ostream& log) const
+{
+    bool allOk = true;
+
+    for (count_t i = 0; i < m_regionCount; ++i)
+    {
+        const LeanTreeAllocator* region = m_regions[i];
+
+        allOk &= region->validate(log);
+
+        // Both ends of the region buffer must lead to it.
+        const uint8_t* data = region->m_header->data;
+        const uint8_t* last = data + m_params.tree.totalSize.value() - 1;
+
+        if (regionOf(data) != region || regionOf(last) != region)
+        {
+            log << "[ERROR] Region " << i << " is not reachable from its addresses\n";
+            allOk = false;
+        }
+    }
+
+    return allOk;
+}
+
+// Returns nullptr if the backing allocator fails.
+LeanTreeAllocator* GrowableLeanTreeAllocator::addRegion()
+{
+    LeanTreeAllocator* region = nullptr;
+
+    try
+    {
+        region = create<LeanTreeAllocator>(m_backing, m_backing, m_params.tree);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return nullptr;
+    }
+
+    m_regions[m_regionCount++] = region;
+    insertSlots(region);
+
+    return region;
+}
+
+// Keeps the order of the remaining regions, oldest first.
+void GrowableLeanTreeAllocator::releaseRegion(count_t index)
+{
+    destroy(m_backing, m_regions[index]);
+
+    std::copy(m_regions + index + 1, m_regions + m_regionCount, m_regions + index);
+    --m_regionCount;
+
+    // Regions are seldom released: rebuilding is simpler than deleting from an open addressing table.
+    rebuildSlots();
+}
+
+LeanTreeAllocator* GrowableLeanTreeAllocator::regionOf(const void* buffer) const
+{
+    const uintptr_t address = reinterpret_cast<uintptr_t>(buffer);
+    const uintptr_t granule = address >> m_granuleLog2;
+    const byte_size size = m_params.tree.totalSize.value();
+
+    for (count_t i = slotIndex(granule); m_slots[i].region != nullptr; i = count_t((i + 1) % m_slotCount))
+    {
+        const SSlot& slot = m_slots[i];
+
+        if (slot.granule == granule)
+        {
+            const uintptr_t start = reinterpret_cast<uintptr_t>(slot.region->m_header->data);
+
+            if (address >= start && address - start < size)
+                return slot.region;
+        }
+    }
+
+    return nullptr;
+}
+
+bool GrowableLeanTreeAllocator::isEmpty(const LeanTreeAllocator& region) const
+{
+    return region.m_stats.bytesUsed == 0;
+}
+
+void GrowableLeanTreeAllocator::rebuildSlots()
+{
+    std::fill(m_slots, m_slots + m_slotCount.value(), SSlot {0, nullptr});
+
+    for (count_t i = 0; i < m_regionCount; ++i)
+        insertSlots(m_regions[i]);
+}
+
+// One slot for each granule the region buffer touches.
+void GrowableLeanTreeAllocator::insertSlots(LeanTreeAllocator* region)
+{
+    const uintptr_t first = reinterpret_cast<uintptr_t>(region->m_header->data);
+    const uintptr_t last = first + m_params.tree.totalSize.value() - 1;
+
+    for (uintptr_t granule = first >> m_granuleLog2; granule <= last >> m_granuleLog2; ++granule)
+    {
+        count_t i = slotIndex(granule);
+
+        while (m_slots[i].region != nullptr)
+            i = count_t((i + 1) % m_slotCount);
+
+        m_slots[i] = {granule, region};
+    }
+}
+
+// Fibonacci hashing: regions taken one after another have consecutive granules.
+count_t GrowableLeanTreeAllocator::slotIndex(uintptr_t granule) const
+{
+    const uint64_t hash = uint64_t(granule) * 0x9E3779B97F4A7C15ull;
+    return count_t(hash >> (64 - m_slotCount.log2()));
+}
+
+} // namespace coll
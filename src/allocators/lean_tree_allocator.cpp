@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <iostream>
 #include <stdexcept>
 
@@ -20,12 +21,20 @@ enum class ByteNode : uint8_t
     FullFragmented = 0x03
 };
 
+// Words of the bit levels may hold blocks of regions locked by different threads, in
+// 'RegionLockedLeanTreeAllocator'. So they are always read atomically, which is just a plain load
+// on every target.
+static unsigned loadWord(const unsigned* word)
+{
+    return std::atomic_ref<unsigned>(*const_cast<unsigned*>(word)).load(std::memory_order_relaxed);
+}
+
 static bool getBit(unsigned* bitData, count_t index)
 {
     constexpr size_t wordSize = sizeof(*bitData) * 8;
     const size_t wordOffset = index / wordSize;
     const size_t bitOffset = index % wordSize;
-    return (bitData[wordOffset] & (size_t(1) << bitOffset)) != 0;
+    return (loadWord(bitData + wordOffset) & (size_t(1) << bitOffset)) != 0;
 }
 
 static unsigned getBits(const unsigned* bitData, count_t index, size_t nBits)
@@ -37,19 +46,20 @@ static unsigned getBits(const unsigned* bitData, count_t index, size_t nBits)
     if (nBits == wordSize)
     {
         assert(bitOffset == 0);
-        return bitData[wordOffset];
+        return loadWord(bitData + wordOffset);
     }
     else
     {
         const unsigned mask = (unsigned(1) << nBits) - 1;
-        return (bitData[wordOffset] >> bitOffset) & mask;
+        return (loadWord(bitData + wordOffset) >> bitOffset) & mask;
     }
 }
 
 // Note that 'unsigned' is used on purpose to let the compiler use the most appropiate word size
 // for the target architecture.
 // Endianness shouldn't be a problem, since The bitfields are always treated a word (unsigned) arrays.
-static void setBits(unsigned* bitData, count_t index, size_t nBits)
+// 'atomic' makes the update a single read-modify-write, for the words shared between threads.
+static void setBits(unsigned* bitData, count_t index, size_t nBits, bool atomic)
 {
     constexpr size_t wordSize = sizeof(*bitData) * 8;
 
@@ -58,10 +68,16 @@ static void setBits(unsigned* bitData, count_t index, size_t nBits)
     size_t bitMask = (size_t(1) << nBits) - 1;
     bitMask <<= bitOffset;
 
-    bitData[wordOffset] |= bitMask;
+    if (atomic)
+    {
+        std::atomic_ref<unsigned> word(bitData[wordOffset]);
+        word.fetch_or(unsigned(bitMask), std::memory_order_relaxed);
+    }
+    else
+        bitData[wordOffset] |= bitMask;
 }
 
-static void clearBits(unsigned* bitData, count_t index, size_t nBits)
+static void clearBits(unsigned* bitData, count_t index, size_t nBits, bool atomic)
 {
     constexpr size_t wordSize = sizeof(*bitData) * 8;
 
@@ -70,7 +86,13 @@ static void clearBits(unsigned* bitData, count_t index, size_t nBits)
     size_t bitMask = (size_t(1) << nBits) - 1;
     bitMask <<= bitOffset;
 
-    bitData[wordOffset] &= ~bitMask;
+    if (atomic)
+    {
+        std::atomic_ref<unsigned> word(bitData[wordOffset]);
+        word.fetch_and(unsigned(~bitMask), std::memory_order_relaxed);
+    }
+    else
+        bitData[wordOffset] &= ~bitMask;
 }
 
 static LeanTreeAllocator::Parameters validateAndCorrectParams(LeanTreeAllocator::Parameters params)
@@ -171,8 +193,14 @@ static uint8_t levelCount(const LeanTreeAllocator::Parameters& params)
     return (params.maxAllocSize / params.basicBlockSize).log2() + 1;
 }
 
-LeanTreeAllocator::LeanTreeAllocator(IAllocator& backing, const Parameters& params_)
+LeanTreeAllocator::LeanTreeAllocator(IAllocator& backing, const Parameters& params)
+    : LeanTreeAllocator(backing, params, false)
+{
+}
+
+LeanTreeAllocator::LeanTreeAllocator(IAllocator& backing, const Parameters& params_, bool atomicBits)
     : m_backing(backing)
+    , m_atomicBits(atomicBits)
 {
     // 1. Fix allocator parameters
     Parameters params = validateAndCorrectParams(params_);
@@ -207,37 +235,68 @@ LeanTreeAllocator::~LeanTreeAllocator() { m_backing.free(m_header->data); }
 
 SAllocResult LeanTreeAllocator::alloc(byte_size bytes, align a)
 {
-    const Parameters& params = m_header->params;
-
-    Power2 correctedSize = Power2::round_up(bytes);
-    correctedSize = std::max(correctedSize, params.basicBlockSize);
-
-    if (correctedSize > params.maxAllocSize)
-        return {nullptr, 0};
-
-    const SAllocResult result = topLevelAlloc(correctedSize / params.basicBlockSize);
+    const SAllocResult result = allocInRange(bytes, a, 0, (count_t)topLevelBlocksCount().value());
     if (result.buffer != nullptr)
     {
-        AllocLogger::instance().alloc(*this, bytes, correctedSize.value(), result.buffer, a);
-        m_stats.bytesUsed += correctedSize.value();
+        AllocLogger::instance().alloc(*this, bytes, result.bytes, result.buffer, a);
+        m_stats.bytesUsed += result.bytes;
     }
 
     return result;
 }
 
-byte_size LeanTreeAllocator::tryExpand(byte_size bytes, void*)
+byte_size LeanTreeAllocator::tryExpand(byte_size bytes, void* buffer)
 {
-    // TODO: Not implemented, by the moment. In theory, it could try to expand in some cases,
-    // but it is somewhat complex.
-    // I may try to implement it once the rest is working fine.
-    return 0;
+    if (buffer == nullptr)
+        return 0;
+
+    const count_t basicBlockIndex = checkedBlockIndex(buffer);
+    const byte_size current = blockBytes(basicBlockIndex);
+    const byte_size result = expandBlock(basicBlockIndex, bytes);
+
+    m_stats.bytesUsed += result - current;
+    AllocLogger::instance().tryExpand(*this, bytes, result, buffer);
+
+    return result;
 }
 
 void LeanTreeAllocator::free(void* buffer)
+{
+    m_stats.bytesUsed -= freeBlock(checkedBlockIndex(buffer));
+}
+
+// Allocates a block in one of the top level blocks in ['firstBlock', 'endBlock'). Does not update
+// the stats.
+// Blocks are aligned to their size, up to the buffer alignment. So the block is made at least as
+// large as the alignment, and larger alignments fail.
+SAllocResult LeanTreeAllocator::allocInRange(
+    byte_size bytes,
+    align a,
+    count_t firstBlock,
+    count_t endBlock
+)
+{
+    const Parameters& params = m_header->params;
+
+    if (a > params.a)
+        return {nullptr, 0};
+
+    Power2 correctedSize = Power2::round_up(std::max(bytes, a.bytes()));
+    correctedSize = std::max(correctedSize, params.basicBlockSize);
+
+    if (correctedSize > params.maxAllocSize)
+        return {nullptr, 0};
+
+    return topLevelAlloc(correctedSize / params.basicBlockSize, firstBlock, endBlock);
+}
+
+// Returns the index of the first basic block of an allocated block. Throws if the pointer cannot
+// be an allocated block.
+count_t LeanTreeAllocator::checkedBlockIndex(const void* buffer) const
 {
     auto error = [](const char* message) { throw std::runtime_error(message); };
 
-    uint8_t* blockPtr = reinterpret_cast<uint8_t*>(buffer);
+    const uint8_t* blockPtr = reinterpret_cast<const uint8_t*>(buffer);
     const auto& params = m_header->params;
 
     if (blockPtr < m_header->data)
@@ -250,36 +309,134 @@ void LeanTreeAllocator::free(void* buffer)
         error("LeanTreeAllocator: Trying to release metadata");
 
     // Check that is within the managed area
-    if (offset > params.totalSize.value())
+    if (offset >= params.totalSize.value())
         error("LeanTreeAllocator: Pointer outside managed area");
 
     // Check basic block alignment
     if (offset % params.basicBlockSize != 0)
         error("LeanTreeAllocator: Bad alignment");
 
-    const Power2 freed = freeAtBlock(count_t(offset / params.basicBlockSize), topLevel());
-    m_stats.bytesUsed -= (freed * params.basicBlockSize).value();
+    return count_t(offset / params.basicBlockSize);
 }
 
-LeanTreeAllocator::Stats LeanTreeAllocator::stats() const
+// Size, in bytes, of the allocated block which starts at a given basic block.
+byte_size LeanTreeAllocator::blockBytes(count_t basicBlockIndex) const
 {
-    // Calculate largest free block.
-    const count_t nBlocks = (count_t)topLevelBlocksCount().value();
-    const uint8_t level = topLevel();
-    byte_size selectedLfb = 0;
+    const Power2 blocks = Power2::from_log2(allocatedLevel(basicBlockIndex));
+    return (blocks * m_header->params.basicBlockSize).value();
+}
 
-    for (count_t i = 0; i < nBlocks; ++i)
+// Grows in place the allocated block which starts at a given basic block, to hold at least 'bytes'.
+// The block is promoted level by level while it is the left child and its right buddy is free.
+// Only grows if the whole request fits. Returns the block size, in bytes, grown or not. Does not
+// update the stats.
+byte_size LeanTreeAllocator::expandBlock(count_t basicBlockIndex, byte_size bytes)
+{
+    const Parameters& params = m_header->params;
+    const uint8_t level = allocatedLevel(basicBlockIndex);
+    const byte_size current = (Power2::from_log2(level) * params.basicBlockSize).value();
+
+    if (bytes <= current)
+        return current;
+
+    const Power2 targetSize = Power2::round_up(bytes);
+    if (targetSize > params.maxAllocSize)
+        return current;
+
+    const Power2 targetBlocks = targetSize / params.basicBlockSize;
+    for (uint8_t i = level; i < targetBlocks.log2(); ++i)
     {
-        const byte_size lfb = byteLevelLfb(0, i);
+        const count_t index = basicBlockIndex >> i;
+        if ((index & 1) != 0)
+            return current;
 
-        if (lfb > selectedLfb)
-            selectedLfb = lfb;
+        const byte_size buddyLfb
+            = i < kBitLevelCount ? lowerLevelLfb(i, index + 1) : byteLevelLfb(i, index + 1);
+
+        if (buddyLfb != byte_size(1) << i)
+            return current;
+    }
+
+    // Releasing the block coalesces it with its buddies. The data is not touched, as metadata is
+    // kept apart.
+    const uint8_t top = topLevel();
+    freeAtBlock(basicBlockIndex, top);
+    allocAtPosition(top, basicBlockIndex >> top, targetBlocks, basicBlockIndex);
+
+    return targetSize.value();
+}
+
+// Level of the allocated block which starts at a given basic block. Throws if there is none.
+uint8_t LeanTreeAllocator::allocatedLevel(count_t basicBlockIndex) const
+{
+    auto notAllocated = []()
+    {
+        throw std::runtime_error(
+            "LeanTreeAllocator: Pointer does not address the start of an allocated block"
+        );
+    };
+
+    for (uint8_t level = topLevel(); level > 0; --level)
+    {
+        const count_t index = basicBlockIndex >> level;
+        bool solid;
+        bool used;
+
+        if (level >= kBitLevelCount)
+        {
+            const uint8_t node = m_header->levels[level][index];
+
+            solid = node == uint8_t(ByteNode::FreeSolid) || node == uint8_t(ByteNode::FullSolid);
+            used = node == uint8_t(ByteNode::FullSolid);
+        }
+        else
+        {
+            solid = getBitLevelValue(level, index);
+            used = getBitLevelValue(0, basicBlockIndex);
+        }
+
+        if (solid)
+        {
+            if (!used || basicBlockIndex % Power2::from_log2(level) != 0)
+                notAllocated();
+
+            return level;
+        }
     }
 
+    if (!getBitLevelValue(0, basicBlockIndex))
+        notAllocated();
+
+    return 0;
+}
+
+// Releases the block which starts at a given basic block. Returns its size, in bytes. Does not
+// update the stats.
+byte_size LeanTreeAllocator::freeBlock(count_t basicBlockIndex)
+{
+    const Power2 freed = freeAtBlock(basicBlockIndex, topLevel());
+    return (freed * m_header->params.basicBlockSize).value();
+}
+
+LeanTreeAllocator::Stats LeanTreeAllocator::stats() const
+{
     Stats result(m_stats);
-    result.largestFreeBlock = selectedLfb;
+    result.largestFreeBlock = largestFreeBlock();
+
+    return result;
+}
+
+// Largest free block, in bytes, read from the top level nodes.
+byte_size LeanTreeAllocator::largestFreeBlock() const
+{
+    const count_t nBlocks = (count_t)topLevelBlocksCount().value();
+    const uint8_t level = topLevel();
+    byte_size selectedLfb = 0;
+
+    for (count_t i = 0; i < nBlocks; ++i)
+        selectedLfb = std::max(selectedLfb, byteLevelLfb(level, i));
 
-    return m_stats;
+    return selectedLfb * m_header->params.basicBlockSize.value();
 }
 
 bool LeanTreeAllocator::canCoalesce(count_t levelIndex, uint8_t level) const
@@ -373,14 +530,13 @@ void LeanTreeAllocator::dumpToCsv(std::ostream& csv, char separator) const
         dumpSolidBlocks(topLevelIdx, root, separator, csv);
 }
 
-SAllocResult LeanTreeAllocator::topLevelAlloc(Power2 basicBlocks)
+SAllocResult LeanTreeAllocator::topLevelAlloc(Power2 basicBlocks, count_t firstBlock, count_t endBlock)
 {
-    const count_t nBlocks = (count_t)topLevelBlocksCount().value();
     const uint8_t level = topLevel();
     byte_size selectedLfb = m_header->params.totalSize.value();
-    count_t selectedIndex = nBlocks;
+    count_t selectedIndex = endBlock;
 
-    for (count_t i = 0; i < nBlocks; ++i)
+    for (count_t i = firstBlock; i < endBlock; ++i)
     {
         const byte_size lfb = byteLevelLfb(level, i);
 
@@ -391,7 +547,7 @@ SAllocResult LeanTreeAllocator::topLevelAlloc(Power2 basicBlocks)
         }
     }
 
-    if (selectedIndex >= nBlocks)
+    if (selectedIndex >= endBlock)
         return {nullptr, 0};
 
     // uint8_t* blockStart = m_header->data + (byte_size(selectedIndex) << level);
@@ -438,6 +594,25 @@ uint8_t* LeanTreeAllocator::allocAtLevel(uint8_t level, count_t index, Power2 ba
     }
 }
 
+// Like 'allocAtLevel', but allocates the block which starts at a given basic block, which must be
+// free.
+uint8_t* LeanTreeAllocator::allocAtPosition(
+    uint8_t level,
+    count_t index,
+    Power2 basicBlocks,
+    count_t basicBlockIndex
+)
+{
+    if (basicBlocks.log2() == level)
+        return allocAtLevel(level, index, basicBlocks);
+
+    preSplitCheck(level, index);
+    const count_t childIndex = (basicBlockIndex >> (level - 1)) & 1;
+    uint8_t* result = allocAtPosition(level - 1, (index * 2) + childIndex, basicBlocks, basicBlockIndex);
+    updateLargestFreeBlock(level, index);
+    return result;
+}
+
 count_t LeanTreeAllocator::selectFittingChild(uint8_t level, count_t index, Power2 basicBlocks)
 {
     byte_size leftLfb;
@@ -483,9 +658,9 @@ void LeanTreeAllocator::setBitLevelValue(uint8_t level, count_t index, bool valu
     unsigned* bits = reinterpret_cast<unsigned*>(m_header->levels[level]);
 
     if (value)
-        setBits(bits, index, 1);
+        setBits(bits, index, 1, m_atomicBits);
     else
-        clearBits(bits, index, 1);
+        clearBits(bits, index, 1, m_atomicBits);
 }
 
 void LeanTreeAllocator::preSplitCheck(uint8_t level, count_t index)
@@ -518,7 +693,7 @@ void LeanTreeAllocator::preSplitCheck(uint8_t level, count_t index)
                 unsigned* level0 = reinterpret_cast<unsigned*>(m_header->levels[0]);
                 count_t bitCount = count_t(1) << level;
                 index <<= level;
-                clearBits(level0, index, bitCount);
+                clearBits(level0, index, bitCount, m_atomicBits);
 
                 // Set solid for all intermediate 1 bit blocks
                 for (uint8_t i = 1; i < level; ++i)
@@ -526,7 +701,7 @@ void LeanTreeAllocator::preSplitCheck(uint8_t level, count_t index)
                     index >>= 1;
                     bitCount >>= 1;
                     unsigned* childLevel = reinterpret_cast<unsigned*>(m_header->levels[i]);
-                    setBits(childLevel, index, bitCount);
+                    setBits(childLevel, index, bitCount, m_atomicBits);
                 }
             }
 
@@ -539,7 +714,7 @@ void LeanTreeAllocator::setUsedBits(count_t index, Power2 size)
 {
     // Level zero contains the used / free information of individual basic blocks. 1 bit per block
     unsigned* level0 = reinterpret_cast<unsigned*>(m_header->levels[0]);
-    setBits(level0, index, size.value());
+    setBits(level0, index, size.value(), m_atomicBits);
 }
 
 void LeanTreeAllocator::setSolidBit(uint8_t level, count_t index)
@@ -547,7 +722,7 @@ void LeanTreeAllocator::setSolidBit(uint8_t level, count_t index)
     assert(level > 0 && level < kBitLevelCount);
 
     unsigned* levelBits = reinterpret_cast<unsigned*>(m_header->levels[level]);
-    setBits(levelBits, index, 1);
+    setBits(levelBits, index, 1, m_atomicBits);
 }
 
 byte_size LeanTreeAllocator::lowerLevelLfb(uint8_t level, count_t index) const
@@ -673,7 +848,7 @@ Power2 LeanTreeAllocator::freeAtBlock(count_t basicBlockIndex, uint8_t level)
                 );
 
             unsigned* level0 = reinterpret_cast<unsigned*>(m_header->levels[0]);
-            clearBits(level0, basicBlockIndex, byte_size(1) << level);
+            clearBits(level0, basicBlockIndex, byte_size(1) << level, m_atomicBits);
             return Power2::from_log2(level);
         }
     }
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2026 Guillermo Hernan Martin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "allocators/region_locked_lean_tree_allocator.h"
+
+#include <algorithm>
+#include <new>
+#include <thread>
+
+namespace coll
+{
+constexpr count_t kMaxRegions = 64;
+
+// Threads get their home region in order of arrival, the same for every allocator.
+static std::atomic<count_t> s_nextThreadSlot = 0;
+
+static LeanTreeAllocator::Parameters treeParams(LeanTreeAllocator::Parameters params)
+{
+    // Remote frees are linked through the freed blocks.
+    params.basicBlockSize = std::max(params.basicBlockSize, Power2::round_up(sizeof(void*)));
+    return params;
+}
+
+// Owns an already acquired region for its scope.
+class RegionLockedLeanTreeAllocator::RegionOwner
+{
+public:
+    explicit RegionOwner(SRegion& region)
+        : m_region(region)
+    {
+    }
+
+    ~RegionOwner() { m_region.busy.store(false, std::memory_order_release); }
+
+private:
+    SRegion& m_region;
+
+    RegionOwner(const RegionOwner&) = delete;
+    RegionOwner& operator=(const RegionOwner&) = delete;
+};
+
+RegionLockedLeanTreeAllocator::RegionLockedLeanTreeAllocator(
+    IAllocator& backing,
+    const Parameters& params
+)
+    : m_backing(backing)
+    , m_tree(backing, treeParams(params.tree), true)
+{
+    const count_t topBlocks = (count_t)m_tree.topLevelBlocksCount().value();
+
+    // Up to 'kMaxRegions' regions, so the busy ones can be tracked in a 64 bit mask. A region may
+    // then span several top level blocks.
+    count_t regions = params.regions;
+    if (regions == 0)
+        regions = count_t(std::thread::hardware_concurrency());
+    regions = std::clamp(regions, count_t(1), std::min(topBlocks, kMaxRegions));
+
+    // All regions but the last one have the same number of top level blocks, so the region of a
+    // block is just a division.
+    m_blocksPerRegion = (topBlocks + regions - 1) / regions;
+    m_regionCount = (topBlocks + m_blocksPerRegion - 1) / m_blocksPerRegion;
+
+    auto [buffer, _] = m_backing.alloc(sizeof(SRegion) * m_regionCount, align::of<SRegion>());
+    if (buffer == nullptr)
+        throw std::bad_alloc();
+
+    m_regions = static_cast<SRegion*>(buffer);
+    for (count_t i = 0; i < m_regionCount; ++i)
+        new (m_regions + i) SRegion();
+}
+
+RegionLockedLeanTreeAllocator::~RegionLockedLeanTreeAllocator()
+{
+    for (count_t i = 0; i < m_regionCount; ++i)
+        m_regions[i].~SRegion();
+
+    m_backing.free(m_regions);
+}
+
+SAllocResult RegionLockedLeanTreeAllocator::alloc(byte_size bytes, align a)
+{
+    const count_t home = homeRegion();
+    uint64_t busyRegions = 0;
+    SAllocResult result {nullptr, 0};
+
+    for (count_t i = 0; i < m_regionCount && result.buffer == nullptr; ++i)
+    {
+        const count_t region = (home + i) % m_regionCount;
+
+        if (tryAcquire(m_regions[region]))
+            result = allocInRegion(region, bytes, a);
+        else
+            busyRegions |= uint64_t(1) << region;
+    }
+
+    // All free regions failed. Waits for the busy ones before giving up.
+    for (count_t i = 0; i < m_regionCount && result.buffer == nullptr; ++i)
+    {
+        const count_t region = (home + i) % m_regionCount;
+
+        if (busyRegions & (uint64_t(1) << region))
+        {
+            acquire(m_regions[region]);
+            result = allocInRegion(region, bytes, a);
+        }
+    }
+
+    if (result.buffer != nullptr)
+        AllocLogger::instance().alloc(*this, bytes, result.bytes, result.buffer, a);
+
+    return result;
+}
+
+byte_size RegionLockedLeanTreeAllocator::tryExpand(byte_size bytes, void* buffer)
+{
+    if (buffer == nullptr)
+        return 0;
+
+    // A block never grows beyond its top level block, so it stays in its region.
+    const count_t basicBlock = m_tree.checkedBlockIndex(buffer);
+    SRegion& region = m_regions[regionOf(basicBlock)];
+    byte_size result;
+
+    acquire(region);
+    {
+        RegionOwner owner(region);
+
+        applyRemoteFrees(region);
+
+        const byte_size current = m_tree.blockBytes(basicBlock);
+        result = m_tree.expandBlock(basicBlock, bytes);
+        region.bytesUsed.fetch_add(result - current, std::memory_order_relaxed);
+    }
+
+    AllocLogger::instance().tryExpand(*this, bytes, result, buffer);
+    return result;
+}
+
+void RegionLockedLeanTreeAllocator::free(void* buffer)
+{
+    const count_t basicBlock = m_tree.checkedBlockIndex(buffer);
+    SRegion& region = m_regions[regionOf(basicBlock)];
+
+    AllocLogger::instance().free(*this, buffer);
+
+    if (tryAcquire(region))
+    {
+        RegionOwner owner(region);
+
+        applyRemoteFrees(region);
+        region.bytesUsed.fetch_sub(m_tree.freeBlock(basicBlock), std::memory_order_relaxed);
+    }
+    else
+        pushRemoteFree(region, buffer);
+}
+
+RegionLockedLeanTreeAllocator::Stats RegionLockedLeanTreeAllocator::stats() const
+{
+    // 'm_tree.stats()' would read the byte nodes, which region owners write with plain stores. The
+    // tree stats hold just the sizes fixed on construction.
+    Stats result = m_tree.m_stats;
+
+    result.bytesUsed = 0;
+    for (count_t i = 0; i < m_regionCount; ++i)
+        result.bytesUsed += m_regions[i].bytesUsed.load(std::memory_order_relaxed);
+
+    return result;
+}
+
+count_t RegionLockedLeanTreeAllocator::homeRegion() const
+{
+    static thread_local const count_t threadSlot
+        = s_nextThreadSlot.fetch_add(1, std::memory_order_relaxed);
+
+    return threadSlot % m_regionCount;
+}
+
+bool RegionLockedLeanTreeAllocator::validate(std::ostream& errorLog)
+{
+    byte_size bytesUsed = 0;
+
+    for (count_t i = 0; i < m_regionCount; ++i)
+    {
+        SRegion& region = m_regions[i];
+
+        acquire(region);
+        RegionOwner owner(region);
+
+        applyRemoteFrees(region);
+        bytesUsed += region.bytesUsed.load(std::memory_order_relaxed);
+    }
+
+    // The tree does not keep its own 'bytesUsed' in this mode.
+    m_tree.m_stats.bytesUsed = bytesUsed;
+    return m_tree.validate(errorLog);
+}
+
+// Called with the region acquired. Releases it.
+SAllocResult RegionLockedLeanTreeAllocator::allocInRegion(count_t index, byte_size bytes, align a)
+{
+    SRegion& region = m_regions[index];
+    RegionOwner owner(region);
+
+    applyRemoteFrees(region);
+
+    const count_t topBlocks = (count_t)m_tree.topLevelBlocksCount().value();
+    const count_t firstBlock = index * m_blocksPerRegion;
+    const count_t endBlock = std::min(firstBlock + m_blocksPerRegion, topBlocks);
+    const SAllocResult result = m_tree.allocInRange(bytes, a, firstBlock, endBlock);
+
+    if (result.buffer != nullptr)
+        region.bytesUsed.fetch_add(result.bytes, std::memory_order_relaxed);
+
+    return result;
+}
+
+// Called by the owner of the region.
+void RegionLockedLeanTreeAllocator::applyRemoteFrees(SRegion& region)
+{
+    if (region.remoteFrees.load(std::memory_order_relaxed) == nullptr)
+        return;
+
+    SRemoteFree* node = region.remoteFrees.exchange(nullptr, std::memory_order_acquire);
+
+    while (node != nullptr)
+    {
+        SRemoteFree* next = node->next;
+        const byte_size freed = m_tree.freeBlock(m_tree.checkedBlockIndex(node));
+
+        region.bytesUsed.fetch_sub(freed, std::memory_order_relaxed);
+        node = next;
+    }
+}
+
+void RegionLockedLeanTreeAllocator::pushRemoteFree(SRegion& region, void* buffer)
+{
+    SRemoteFree* node = new (buffer) SRemoteFree;
+    node->next = region.remoteFrees.load(std::memory_order_relaxed);
+
+    while (!region.remoteFrees.compare_exchange_weak(
+        node->next,
+        node,
+        std::memory_order_release,
+        std::memory_order_relaxed
+    ))
+    {
+    }
+}
+
+count_t RegionLockedLeanTreeAllocator::regionOf(count_t basicBlockIndex) const
+{
+    const count_t topBlock = basicBlockIndex >> m_tree.topLevel();
+    return topBlock / m_blocksPerRegion;
+}
+
+bool RegionLockedLeanTreeAllocator::tryAcquire(SRegion& region)
+{
+    if (region.busy.load(std::memory_order_relaxed))
+        return false;
+
+    return !region.busy.exchange(true, std::memory_order_acquire);
+}
+
+void RegionLockedLeanTreeAllocator::acquire(SRegion& region)
+{
+    while (!tryAcquire(region))
+        std::this_thread::yield();
+}
+
+} // namespace coll
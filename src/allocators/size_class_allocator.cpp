@@ -0,0 +1,728 @@
+/*
+ * Copyright (c) 2026 Guillermo Hernan Martin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "allocators/size_class_allocator.h"
+
+#include <algorithm>
+#include <array>
+#include <assert.h>
+#include <bit>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace coll
+{
+using Limits = SizeClassAllocator::Limits;
+
+static constexpr byte_size kChunkSize = Limits::chunkSize;
+static constexpr count_t kClassCount = Limits::sizeClasses;
+static constexpr count_t kSmallClassCount = 32;
+static constexpr uint32_t kLargeClass = ~uint32_t(0);
+
+// Small chunks are taken from the OS in segments of this size.
+static constexpr byte_size kSegmentSize = 16 * kChunkSize;
+
+// Medium blocks are carved from spans of this size, taken in order from a single reserved range.
+static constexpr byte_size kSpanSize = 1024 * 1024;
+static constexpr byte_size kMediumRangeSize =
+    sizeof(void*) >= 8 ? byte_size(64) * 1024 * 1024 * 1024 : 256 * 1024 * 1024;
+
+// Blocks moved at once between a thread cache and the central lists. About 32 KiB per batch.
+static constexpr byte_size kBatchBytes = 32 * 1024;
+static constexpr count_t kMaxBatchBlocks = 32;
+
+// Minimum alignment of every block.
+static constexpr align kMinAlign = align::from_bytes(16);
+
+// Address space reserved for a large block, as a multiple of its committed size, to let it grow in
+// place. The extra space is limited to 'kMaxReserveSlack'.
+static constexpr byte_size kReserveGrowth = 8;
+static constexpr byte_size kMaxReserveSlack = sizeof(void*) >= 8 ? 1024 * 1024 * 1024 : 16 * 1024 * 1024;
+
+// Freed large mappings kept for reuse. Larger mappings than a quarter of the limit are not kept.
+static constexpr count_t kLargeCacheEntries = 16;
+static constexpr byte_size kLargeCacheBytes = sizeof(void*) >= 8 ? 64 * 1024 * 1024 : 8 * 1024 * 1024;
+
+struct SizeClassAllocator::SFreeBlock
+{
+    SFreeBlock* next;
+};
+
+// Lives at the start of every chunk (small blocks) or OS mapping (large blocks).
+struct SizeClassAllocator::SChunkHeader
+{
+    uint32_t sizeClass;      // 'kLargeClass' for large blocks.
+    uint32_t blockOffset;    // Offset of the first block, from the chunk start.
+    byte_size blockBytes;    // Block size. For large blocks, its committed usable size.
+    byte_size reservedBytes; // Large blocks only: reserved address space.
+    SChunkHeader* nextCached; // Cached large mappings only.
+};
+
+static constexpr auto kClassSizes = []()
+{
+    std::array<uint32_t, kClassCount> sizes {};
+    count_t i = 0;
+
+    for (uint32_t size = 16; size <= 128; size += 16)
+        sizes[i++] = size;
+
+    for (uint32_t base = 128; base < Limits::maxMediumSize; base *= 2)
+    {
+        for (uint32_t step = 1; step <= 4; ++step)
+            sizes[i++] = base + step * (base / 4);
+    }
+
+    return sizes;
+}();
+
+static_assert(kClassSizes.back() == Limits::maxMediumSize, "Size class table does not fit its limits");
+static_assert(kClassSizes[kSmallClassCount - 1] == Limits::maxSmallSize, "Wrong small class count");
+
+// Blocks of a class are aligned to the lowest set bit of its size.
+static constexpr byte_size classAlign(count_t sizeClass)
+{
+    const uint32_t size = kClassSizes[sizeClass];
+    return size & (~size + 1);
+}
+
+static count_t classForSize(byte_size bytes)
+{
+    if (bytes <= 128)
+        return count_t(std::max(bytes, byte_size(1)) + 15) / 16 - 1;
+
+    // Four classes in (base, 2 * base].
+    const byte_size n = bytes - 1;
+    const int log = std::bit_width(n) - 1;
+    const byte_size base = byte_size(1) << log;
+    const count_t step = count_t((n - base) >> (log - 2));
+
+    return 8 + count_t(log - 7) * 4 + step;
+}
+
+// Returns 'kClassCount' if the request does not fit in a size class.
+static count_t selectClass(byte_size bytes, align a)
+{
+    if (bytes > Limits::maxMediumSize || a.bytes() > Limits::maxAlign.bytes())
+        return kClassCount;
+
+    count_t sizeClass = classForSize(bytes);
+    while (sizeClass < kClassCount && classAlign(sizeClass) < a.bytes())
+        ++sizeClass;
+
+    return sizeClass;
+}
+
+static count_t batchBlocks(count_t sizeClass)
+{
+    const byte_size blocks = kBatchBytes / kClassSizes[sizeClass];
+    return count_t(std::clamp(blocks, byte_size(1), byte_size(kMaxBatchBlocks)));
+}
+
+// OS memory
+//*****************
+static byte_size pageSize()
+{
+    static const byte_size size = []()
+    {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return byte_size(info.dwPageSize);
+#else
+        return byte_size(sysconf(_SC_PAGESIZE));
+#endif
+    }();
+
+    return size;
+}
+
+static byte_size roundUp(byte_size bytes, byte_size granularity)
+{
+    return (bytes + granularity - 1) / granularity * granularity;
+}
+
+// Reserves address space aligned to 'kChunkSize', without committing it.
+static uint8_t* reservePages(byte_size bytes)
+{
+#ifdef _WIN32
+    // Reservations are aligned to the allocation granularity, which is 64 KiB.
+    void* p = VirtualAlloc(nullptr, bytes, MEM_RESERVE, PAGE_NOACCESS);
+    if (p != nullptr && (reinterpret_cast<uintptr_t>(p) & (kChunkSize - 1)) != 0)
+    {
+        VirtualFree(p, 0, MEM_RELEASE);
+        p = nullptr;
+    }
+    return static_cast<uint8_t*>(p);
+#else
+    // Reserves an extra chunk and trims both ends to get the alignment.
+    const byte_size total = bytes + kChunkSize;
+    void* p = mmap(nullptr, total, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+        return nullptr;
+
+    uint8_t* raw = static_cast<uint8_t*>(p);
+    uint8_t* aligned = reinterpret_cast<uint8_t*>(
+        roundUp(reinterpret_cast<uintptr_t>(raw), kChunkSize)
+    );
+    const byte_size head = aligned - raw;
+    const byte_size tail = total - head - bytes;
+
+    if (head > 0)
+        munmap(raw, head);
+    if (tail > 0)
+        munmap(aligned + bytes, tail);
+
+    return aligned;
+#endif
+}
+
+static bool commitPages(uint8_t* p, byte_size bytes)
+{
+#ifdef _WIN32
+    return VirtualAlloc(p, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+    return mprotect(p, bytes, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+static void releasePages(uint8_t* p, byte_size bytes)
+{
+#ifdef _WIN32
+    VirtualFree(p, 0, MEM_RELEASE);
+#else
+    munmap(p, bytes);
+#endif
+}
+//*****************
+
+// Thread caches
+//*****************
+// Trivially destructible, so it stays usable while the thread is being destroyed. Once the
+// thread has flushed it on exit ('retired'), blocks go straight to the central lists.
+struct SThreadCache
+{
+    SizeClassAllocator::SFreeBlock* heads[kClassCount];
+    count_t counts[kClassCount];
+    bool registered;
+    bool retired;
+};
+
+static thread_local SThreadCache tl_cache;
+
+struct SThreadCacheFlusher
+{
+    bool active = false;
+
+    ~SThreadCacheFlusher()
+    {
+        SizeClassAllocator::instance().flushThreadCache();
+        tl_cache.retired = true;
+    }
+};
+
+static thread_local SThreadCacheFlusher tl_flusher;
+
+// On first use, makes sure that the cache is flushed when the thread exits.
+static SThreadCache& threadCache()
+{
+    SThreadCache& cache = tl_cache;
+
+    if (!cache.registered && !cache.retired)
+    {
+        tl_flusher.active = true;
+        cache.registered = true;
+    }
+
+    return cache;
+}
+//*****************
+
+SizeClassAllocator& SizeClassAllocator::instance()
+{
+    // Never destroyed: blocks may still be released from other static or thread-local destructors.
+    alignas(SizeClassAllocator) static uint8_t storage[sizeof(SizeClassAllocator)];
+    static SizeClassAllocator* allocator = new (storage) SizeClassAllocator();
+
+    return *allocator;
+}
+
+SizeClassAllocator::SizeClassAllocator()
+{
+    // The first span of the medium range holds the class of every span, one byte each.
+    const byte_size mapBytes = roundUp(kMediumRangeSize / kSpanSize, pageSize());
+    uint8_t* base = reservePages(kMediumRangeSize);
+
+    if (base == nullptr)
+        return;
+
+    if (!commitPages(base, mapBytes))
+    {
+        releasePages(base, kMediumRangeSize);
+        return;
+    }
+
+    m_spanClasses = base;
+    m_mediumBase = base;
+    m_mediumNext = base + kSpanSize;
+    m_mediumEnd = base + kMediumRangeSize;
+}
+
+SizeClassAllocator::SChunkHeader& SizeClassAllocator::chunkOf(const void* block)
+{
+    const uintptr_t address = reinterpret_cast<uintptr_t>(block) & ~uintptr_t(kChunkSize - 1);
+    return *reinterpret_cast<SChunkHeader*>(address);
+}
+
+// Size class of an allocated block, or 'kLargeClass'.
+uint32_t SizeClassAllocator::classOf(const void* block) const
+{
+    const uintptr_t address = reinterpret_cast<uintptr_t>(block);
+    const uintptr_t mediumBase = reinterpret_cast<uintptr_t>(m_mediumBase);
+
+    if (address >= mediumBase && address < reinterpret_cast<uintptr_t>(m_mediumEnd))
+        return m_spanClasses[(address - mediumBase) / kSpanSize];
+
+    return chunkOf(block).sizeClass;
+}
+
+SAllocResult SizeClassAllocator::alloc(byte_size bytes, align a)
+{
+    const count_t sizeClass = selectClass(bytes, a);
+    SAllocResult result = sizeClass < kClassCount ? smallAlloc(sizeClass) : SAllocResult {nullptr, 0};
+
+    // Medium requests go to the large path once the medium range is exhausted.
+    if (result.buffer == nullptr && sizeClass >= kSmallClassCount)
+        result = largeAlloc(bytes, a);
+
+    if (result.buffer != nullptr)
+        AllocLogger::instance().alloc(*this, bytes, result.bytes, result.buffer, a);
+
+    return result;
+}
+
+byte_size SizeClassAllocator::tryExpand(byte_size bytes, void* block)
+{
+    byte_size result = 0;
+
+    if (block != nullptr)
+    {
+        const uint32_t sizeClass = classOf(block);
+
+        if (sizeClass == kLargeClass)
+            result = largeExpand(chunkOf(block), bytes);
+        else
+            result = kClassSizes[sizeClass];
+    }
+
+    AllocLogger::instance().tryExpand(*this, bytes, result, block);
+    return result;
+}
+
+void SizeClassAllocator::free(void* block)
+{
+    AllocLogger::instance().free(*this, block);
+
+    if (block == nullptr)
+        return;
+
+    const uint32_t sizeClass = classOf(block);
+
+    if (sizeClass == kLargeClass)
+        largeFree(chunkOf(block));
+    else
+        smallFree(sizeClass, block);
+}
+
+byte_size SizeClassAllocator::usableSize(const void* block) const
+{
+    if (block == nullptr)
+        return 0;
+
+    const uint32_t sizeClass = classOf(block);
+    return sizeClass == kLargeClass ? chunkOf(block).blockBytes : kClassSizes[sizeClass];
+}
+
+void SizeClassAllocator::flushThreadCache()
+{
+    SThreadCache& cache = tl_cache;
+
+    for (count_t sizeClass = 0; sizeClass < kClassCount; ++sizeClass)
+    {
+        SFreeBlock* head = cache.heads[sizeClass];
+        if (head == nullptr)
+            continue;
+
+        SFreeBlock* tail = head;
+        while (tail->next != nullptr)
+            tail = tail->next;
+
+        releaseBatch(sizeClass, head, tail);
+        cache.heads[sizeClass] = nullptr;
+        cache.counts[sizeClass] = 0;
+    }
+}
+
+SizeClassAllocator::Stats SizeClassAllocator::stats() const
+{
+    Stats result;
+
+    result.chunkBytes = m_chunkBytes.load(std::memory_order_relaxed);
+    result.spanBytes = m_spanBytes.load(std::memory_order_relaxed);
+    result.largeBytes = m_largeBytes.load(std::memory_order_relaxed);
+    result.largeBlocks = m_largeBlocks.load(std::memory_order_relaxed);
+    result.cachedBytes = m_cachedBytes.load(std::memory_order_relaxed);
+
+    return result;
+}
+
+SAllocResult SizeClassAllocator::smallAlloc(count_t sizeClass)
+{
+    SThreadCache& cache = threadCache();
+    const byte_size size = kClassSizes[sizeClass];
+
+    if (cache.retired)
+    {
+        SFreeBlock* block = nullptr;
+        if (fetchBatch(sizeClass, 1, block) == 0)
+            return {nullptr, 0};
+
+        return {block, size};
+    }
+
+    if (cache.heads[sizeClass] == nullptr)
+    {
+        cache.counts[sizeClass] = fetchBatch(sizeClass, batchBlocks(sizeClass), cache.heads[sizeClass]);
+        if (cache.counts[sizeClass] == 0)
+            return {nullptr, 0};
+    }
+
+    SFreeBlock* block = cache.heads[sizeClass];
+    cache.heads[sizeClass] = block->next;
+    --cache.counts[sizeClass];
+
+    return {block, size};
+}
+
+SAllocResult SizeClassAllocator::largeAlloc(byte_size bytes, align a)
+{
+    if (a.bytes() >= kChunkSize || bytes > ~byte_size(0) / 4)
+        return {nullptr, 0};
+
+    const byte_size offset = std::max(a, kMinAlign).round_up(sizeof(SChunkHeader));
+    byte_size committed = roundUp(offset + bytes, pageSize());
+    SChunkHeader* chunk = takeCachedLarge(committed);
+
+    if (chunk != nullptr)
+        committed = std::max(committed, chunk->blockOffset + chunk->blockBytes);
+    else
+    {
+        const byte_size slack = std::min(committed * (kReserveGrowth - 1), kMaxReserveSlack);
+        const byte_size reserved = roundUp(committed + slack, kChunkSize);
+
+        uint8_t* base = reservePages(reserved);
+        if (base == nullptr)
+            return {nullptr, 0};
+
+        if (!commitPages(base, committed))
+        {
+            releasePages(base, reserved);
+            return {nullptr, 0};
+        }
+
+        chunk = new (base) SChunkHeader;
+        chunk->reservedBytes = reserved;
+    }
+
+    chunk->sizeClass = kLargeClass;
+    chunk->blockOffset = uint32_t(offset);
+    chunk->blockBytes = committed - offset;
+
+    m_largeBytes += committed;
+    ++m_largeBlocks;
+
+    return {reinterpret_cast<uint8_t*>(chunk) + offset, chunk->blockBytes};
+}
+
+// Takes the cached mapping with the smallest reservation which can hold 'committed' bytes, and
+// commits the pages it lacks. Mappings with more than twice those bytes committed are not taken.
+// The header keeps the committed size of its previous block.
+SizeClassAllocator::SChunkHeader* SizeClassAllocator::takeCachedLarge(byte_size committed)
+{
+    SChunkHeader* chunk = nullptr;
+
+    {
+        std::lock_guard<std::mutex> guard(m_largeCacheLock);
+        SChunkHeader** best = nullptr;
+
+        for (SChunkHeader** link = &m_largeCache; *link != nullptr; link = &(*link)->nextCached)
+        {
+            const SChunkHeader& cached = **link;
+            const byte_size cachedCommitted = cached.blockOffset + cached.blockBytes;
+
+            if (cached.reservedBytes >= committed && cachedCommitted <= 2 * committed
+                && (best == nullptr || cached.reservedBytes < (*best)->reservedBytes))
+                best = link;
+        }
+
+        if (best == nullptr)
+            return nullptr;
+
+        chunk = *best;
+        *best = chunk->nextCached;
+        --m_largeCacheCount;
+        m_cachedBytes -= chunk->blockOffset + chunk->blockBytes;
+    }
+
+    uint8_t* base = reinterpret_cast<uint8_t*>(chunk);
+    const byte_size cachedCommitted = chunk->blockOffset + chunk->blockBytes;
+
+    if (cachedCommitted < committed && !commitPages(base + cachedCommitted, committed - cachedCommitted))
+    {
+        releasePages(base, chunk->reservedBytes);
+        return nullptr;
+    }
+
+    return chunk;
+}
+
+void SizeClassAllocator::smallFree(count_t sizeClass, void* block)
+{
+    SThreadCache& cache = threadCache();
+    SFreeBlock* freed = new (block) SFreeBlock {nullptr};
+
+    if (cache.retired)
+        return releaseBatch(sizeClass, freed, freed);
+
+    freed->next = cache.heads[sizeClass];
+    cache.heads[sizeClass] = freed;
+
+    // Keeps up to two batches. Beyond that, one batch goes back to the central list.
+    const count_t batch = batchBlocks(sizeClass);
+    if (++cache.counts[sizeClass] > 2 * batch)
+    {
+        SFreeBlock* head = cache.heads[sizeClass];
+        SFreeBlock* tail = head;
+
+        for (count_t i = 1; i < batch; ++i)
+            tail = tail->next;
+
+        cache.heads[sizeClass] = tail->next;
+        cache.counts[sizeClass] -= batch;
+        tail->next = nullptr;
+        releaseBatch(sizeClass, head, tail);
+    }
+}
+
+void SizeClassAllocator::largeFree(SChunkHeader& chunk)
+{
+    const byte_size committed = chunk.blockOffset + chunk.blockBytes;
+
+    m_largeBytes -= committed;
+    --m_largeBlocks;
+
+    if (committed > kLargeCacheBytes / 4)
+        return releasePages(reinterpret_cast<uint8_t*>(&chunk), chunk.reservedBytes);
+
+    // Keeps the mapping, evicting the oldest ones beyond the cache limits.
+    SChunkHeader* evicted = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(m_largeCacheLock);
+
+        chunk.nextCached = m_largeCache;
+        m_largeCache = &chunk;
+        ++m_largeCacheCount;
+        m_cachedBytes += committed;
+
+        while (m_largeCacheCount > kLargeCacheEntries || m_cachedBytes > kLargeCacheBytes)
+        {
+            SChunkHeader** link = &m_largeCache;
+            while ((*link)->nextCached != nullptr)
+                link = &(*link)->nextCached;
+
+            SChunkHeader* oldest = *link;
+            *link = nullptr;
+            --m_largeCacheCount;
+            m_cachedBytes -= oldest->blockOffset + oldest->blockBytes;
+
+            oldest->nextCached = evicted;
+            evicted = oldest;
+        }
+    }
+
+    while (evicted != nullptr)
+    {
+        SChunkHeader* next = evicted->nextCached;
+        releasePages(reinterpret_cast<uint8_t*>(evicted), evicted->reservedBytes);
+        evicted = next;
+    }
+}
+
+byte_size SizeClassAllocator::largeExpand(SChunkHeader& chunk, byte_size bytes)
+{
+    const byte_size current = chunk.blockBytes;
+    if (bytes <= current)
+        return current;
+
+    // Only commits more memory if the whole request fits. Otherwise, the caller is going to move
+    // the block anyway.
+    const byte_size committed = chunk.blockOffset + current;
+    if (bytes > chunk.reservedBytes - chunk.blockOffset)
+        return current;
+
+    const byte_size target = std::min(roundUp(chunk.blockOffset + bytes, pageSize()), chunk.reservedBytes);
+    uint8_t* base = reinterpret_cast<uint8_t*>(&chunk);
+
+    if (!commitPages(base + committed, target - committed))
+        return current;
+
+    chunk.blockBytes = target - chunk.blockOffset;
+    m_largeBytes += target - committed;
+
+    return chunk.blockBytes;
+}
+
+// Takes up to 'maxBlocks' free blocks from the central list, carving new ones when it is empty.
+// Returns the number of blocks linked from 'head'.
+count_t SizeClassAllocator::fetchBatch(count_t sizeClass, count_t maxBlocks, SFreeBlock*& head)
+{
+    SCentralList& list = m_central[sizeClass];
+    const byte_size size = kClassSizes[sizeClass];
+    count_t count = 0;
+
+    std::lock_guard<std::mutex> guard(list.lock);
+
+    head = nullptr;
+    while (count < maxBlocks)
+    {
+        SFreeBlock* block = list.head;
+
+        if (block != nullptr)
+            list.head = block->next;
+        else
+        {
+            if (byte_size(list.carveEnd - list.carveNext) < size)
+            {
+                const bool carved = sizeClass < kSmallClassCount ? carveChunk(sizeClass, list)
+                                                                 : carveSpan(sizeClass, list);
+                if (!carved)
+                    break;
+            }
+
+            block = reinterpret_cast<SFreeBlock*>(list.carveNext);
+            list.carveNext += size;
+        }
+
+        block->next = head;
+        head = block;
+        ++count;
+    }
+
+    return count;
+}
+
+void SizeClassAllocator::releaseBatch(count_t sizeClass, SFreeBlock* head, SFreeBlock* tail)
+{
+    SCentralList& list = m_central[sizeClass];
+    std::lock_guard<std::mutex> guard(list.lock);
+
+    tail->next = list.head;
+    list.head = head;
+}
+
+// Starts carving a new chunk for a size class. Called with the central list locked.
+bool SizeClassAllocator::carveChunk(count_t sizeClass, SCentralList& list)
+{
+    uint8_t* chunkStart = newChunk();
+    if (chunkStart == nullptr)
+        return false;
+
+    const byte_size offset = align::from_bytes(classAlign(sizeClass)).round_up(sizeof(SChunkHeader));
+
+    SChunkHeader* chunk = new (chunkStart) SChunkHeader;
+    chunk->sizeClass = sizeClass;
+    chunk->blockOffset = uint32_t(offset);
+    chunk->blockBytes = kClassSizes[sizeClass];
+    chunk->reservedBytes = kChunkSize;
+
+    list.carveNext = chunkStart + offset;
+    list.carveEnd = chunkStart + kChunkSize;
+
+    return true;
+}
+
+// Starts carving a new span for a medium class. Called with the central list locked.
+bool SizeClassAllocator::carveSpan(count_t sizeClass, SCentralList& list)
+{
+    std::lock_guard<std::mutex> guard(m_segmentLock);
+
+    if (m_mediumNext == m_mediumEnd || !commitPages(m_mediumNext, kSpanSize))
+        return false;
+
+    uint8_t* span = m_mediumNext;
+    m_mediumNext += kSpanSize;
+    m_spanClasses[(span - m_mediumBase) / kSpanSize] = uint8_t(sizeClass);
+    m_spanBytes += kSpanSize;
+
+    // Spans are aligned to 'kChunkSize', so their blocks get the alignment of their class, up to
+    // 'Limits::maxAlign'.
+    list.carveNext = span;
+    list.carveEnd = span + kSpanSize;
+
+    return true;
+}
+
+uint8_t* SizeClassAllocator::newChunk()
+{
+    std::lock_guard<std::mutex> guard(m_segmentLock);
+
+    if (m_segmentNext == m_segmentEnd)
+    {
+        uint8_t* segment = reservePages(kSegmentSize);
+        if (segment == nullptr)
+            return nullptr;
+
+        if (!commitPages(segment, kSegmentSize))
+        {
+            releasePages(segment, kSegmentSize);
+            return nullptr;
+        }
+
+        m_segmentNext = segment;
+        m_segmentEnd = segment + kSegmentSize;
+    }
+
+    uint8_t* chunk = m_segmentNext;
+    m_segmentNext += kChunkSize;
+    m_chunkBytes += kChunkSize;
+
+    return chunk;
+}
+
+} // namespace coll
@@ -23,9 +23,19 @@
 #pragma once
 
 #include "allocator.h"
+#include "btree_node_pool.h"
+#include "btree_search.h"
+#include "darray.h"
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <mutex>
 #include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 namespace coll
 {
@@ -36,24 +46,65 @@ struct BTreeCoreParams
     byte_size ValueAlign = 1; // Valor mínimo por defecto
     void (*DestroyValueFn)(void*) = nullptr;
     void (*MoveValueFn)(void* dest, void* src) = nullptr;
+    void (*CopyValueFn)(void* dest, const void* src) = nullptr; // For 'copy_from' and 'Snapshots'.
+
+    // Keeps the values of each leaf in a separate block, so the leaves only hold keys and links. Scans
+    // and lookups then touch fewer cache lines, at the cost of one more indirection to reach a value.
+    bool SeparateValues = false;
+
+    // Keeps in each internal node the number of entries under each child, which makes positional
+    // queries ('nth', 'rank') O(log n). Costs one counter per child, updated on every change.
+    bool OrderStatistics = false;
+
+    // Enables 'snapshot', which shares the nodes with the tree instead of copying them. Nodes get an
+    // atomic reference count, and are allocated straight from the allocator instead of the pools, as
+    // snapshots may release them from other threads.
+    bool Snapshots = false;
+
+    // Stores beside the keys of each node an 8 byte order-preserving prefix of each one (see
+    // 'KeyPrefixCompare'). Searches compare the prefixes first, with integer (SIMD) compares, and only
+    // compare whole keys when prefixes are equal. Pays off with string and composite keys.
+    bool KeyPrefixes = false;
 };
 
-template <typename Key, BTreeCoreParams Params>
+// Keys are ordered by 'Compare', a strict weak order with 'bool operator()(const Key&, const Key&)'. A
+// stateless comparator takes no space; a stateful one is stored once in each tree (and snapshot).
+template <typename Key, BTreeCoreParams Params, typename Compare = KeyLess<Key>>
 class BTreeCore
 {
 public:
     static constexpr byte_size ValueSize = Params.ValueSize;
     static constexpr byte_size ValueAlign = Params.ValueAlign;
     static constexpr byte_size Order = Params.Order;
+    static constexpr bool SeparateValues = Params.SeparateValues && ValueSize > 0;
+    static constexpr bool OrderStatistics = Params.OrderStatistics;
+    static constexpr bool Snapshots = Params.Snapshots;
+    static constexpr bool KeyPrefixes = Params.KeyPrefixes;
+
+    static_assert(
+        !Snapshots || ValueSize == 0 || Params.CopyValueFn != nullptr,
+        "BTreeCore: 'Snapshots' needs 'CopyValueFn'"
+    );
+    static_assert(
+        !KeyPrefixes || KeyPrefixCompare<Compare, Key>,
+        "BTreeCore: 'KeyPrefixes' needs a comparator with a static 'prefix(key)'"
+    );
 
     using size_type = count_t;
 
+    // Every internal node has at least two children, so the tree cannot be any higher.
+    static constexpr unsigned MaxHeight = sizeof(size_type) * 8 + 1;
+
     struct InsertResult;
     class Handle;
     class Range;
     class InvRange;
+    class SnapshotRange;
+    class BulkLoader;
+    class SortedCursor;
+    class Snapshot;
 
-    BTreeCore(IAllocator& alloc);
+    BTreeCore(IAllocator& alloc, const Compare& comp = Compare());
     ~BTreeCore();
 
     BTreeCore(const BTreeCore& rhs) = delete;
@@ -66,22 +117,50 @@ public:
     bool empty() const { return m_size == 0; }
 
     IAllocator& allocator() const { return *m_alloc; }
+    const Compare& key_comp() const { return m_compare; }
 
-    Handle find_first(const Key& key) const
+    // Lookups also accept types which convert to 'Key', or, if 'Compare' is transparent, any type it
+    // compares with 'Key', which is then used as it is ('std::string_view' for 'std::string' keys).
+    template <LookupKeyFor<Key, Compare> K = Key>
+    Handle find_first(const K& key) const
     {
-        const Handle h = lower_bound(key);
+        const auto& k = lookup_key(key);
+        const Handle h = lower_bound(k);
 
-        if (!h.has_value() || h.key() != key)
+        if (!h.has_value() || m_compare(k, h.key()))
             return {};
         else
             return h;
     }
 
-    Handle lower_bound(const Key& key) const;
-    Range range(const Key& key) const;
-    Range range(const Key& keyLeft, const Key& keyRight) const;
-    bool contains(const Key& key) const { return find_first(key).has_value(); }
-    size_type count(const Key& key) const;
+    // Looks up all the keys of 'keys', calling 'output(index, handle)' with the result 'find_first'
+    // would give for each one, in order. Groups of keys descend the tree together, one level at a time,
+    // so the node loads of the different keys overlap. Dense sorted batches walk the leaves instead.
+    template <typename OutputFn>
+    void find_batch(span<const Key> keys, OutputFn&& output) const;
+
+    template <LookupKeyFor<Key, Compare> K = Key>
+    Handle lower_bound(const K& key) const;
+    template <LookupKeyFor<Key, Compare> K = Key>
+    Handle upper_bound(const K& key) const;
+    template <LookupKeyFor<Key, Compare> K = Key>
+    Range range(const K& key) const;
+    template <LookupKeyFor<Key, Compare> K = Key>
+    Range range(const K& keyLeft, const K& keyRight) const;
+    template <LookupKeyFor<Key, Compare> K = Key>
+    bool contains(const K& key) const { return find_first(key).has_value(); }
+    template <LookupKeyFor<Key, Compare> K = Key>
+    size_type count(const K& key) const;
+
+    // Entries in [keyLeft, keyRight). O(log n) with 'OrderStatistics', one step per leaf otherwise.
+    template <LookupKeyFor<Key, Compare> K = Key>
+    size_type count(const K& keyLeft, const K& keyRight) const;
+
+    // Only with 'OrderStatistics'. Entry at position 'index' in key order (empty handle if out of
+    // range), and number of entries whose keys are less than 'key'.
+    Handle nth(size_type index) const;
+    template <LookupKeyFor<Key, Compare> K = Key>
+    size_type rank(const K& key) const;
 
     Range begin() const;
     Range end() const { return Range(); }
@@ -89,11 +168,56 @@ public:
     InvRange rbegin() const;
     InvRange rend() const { return InvRange(); }
 
+    // Calls 'fn(keys, values)' for each leaf, in key order, with the span of its keys and a pointer to
+    // the first of its values, which are contiguous, 'sizeof(AlignedValueStorage)' bytes apart. The
+    // leaves ahead are prefetched, as in 'Range'.
+    template <typename ChunkFn>
+    void for_each_leaf_chunk(ChunkFn&& fn) const;
+
     InsertResult insert(const Key& key);
+    // Like 'insert', but an entry already in the tree is only looked up. With snapshots, nothing is
+    // unshared then, so its value buffer must not be written.
+    InsertResult try_insert(const Key& key);
     bool erase(const Key& key);
 
+    // Erases the entries in [keyLeft, keyRight) / with keys less than 'key', and returns how many.
+    // Subtrees entirely inside the range are freed whole, and only the nodes on the paths to both ends
+    // of the range are refilled afterwards, so the cost is O(log n) plus one step per leaf erased.
+    size_type erase_range(const Key& keyLeft, const Key& keyRight);
+    size_type erase_prefix(const Key& key);
+
+    BulkLoader bulk_load(float fillFactor = 1.0f) { return BulkLoader(*this, fillFactor); }
+    SortedCursor sorted_cursor() { return SortedCursor(*this); }
+
+    // Only with 'Snapshots'. O(1), as the snapshot shares all the nodes with the tree. From then on,
+    // the tree copies every shared node before modifying it, which only happens along the paths to the
+    // entries modified. Must be called from the thread which modifies the tree.
+    Snapshot snapshot() const;
+
     void clear();
 
+    // Replaces the contents by a copy of 'rhs', made node by node in O(n), so it has the same shape and
+    // occupancy. Values are copied with 'CopyValueFn'. If a copy throws, the tree is left empty.
+    void copy_from(const BTreeCore& rhs);
+
+    // Moves the entries whose keys are not less than 'key' to the returned tree. Only the nodes on the
+    // path to 'key' are cut in two, and then refilled from their siblings; the rest change hands as they
+    // are. That is O(log n) with 'OrderStatistics'. Otherwise the size of each tree is counted walking
+    // the leaves of the smaller one, which adds O(min(left, right) / Order). Each tree frees nodes to its
+    // own pools, and the chunks of both are kept until neither needs them, so they may then be used on
+    // different threads. Without 'Snapshots', the tree is not modified if an exception is thrown. With
+    // them, refilling may copy nodes shared with snapshots after the cut. If that throws, both trees
+    // keep their entries, but some nodes on the path to 'key' may stay below their minimum fill.
+    BTreeCore split_at(const Key& key);
+
+    // Appends the entries of 'rhs', whose keys must all be greater than those of this tree (throws
+    // 'std::invalid_argument' otherwise), leaving it empty. The shorter tree is hung from the spine of
+    // the taller one, at the level which keeps all the leaves at the same depth, in O(log n). That
+    // needs both trees to use the same allocator, and node chunks which can be kept together (they can,
+    // unless both trees share theirs with other trees split from them); otherwise the entries of 'rhs'
+    // are moved to new nodes first, in O(size of rhs), and are left unspecified if that throws.
+    void join(BTreeCore&& rhs);
+
     class Handle
     {
     public:
@@ -161,14 +285,19 @@ public:
             : m_leaf(leaf)
             , m_endLeaf(endLeaf)
             , m_index(index)
-            , m_endIndex(0)
+            , m_endIndex(endIndex)
+        {
+        }
+        Range(const Handle& first, const Handle& last)
+            : Range(first.m_leaf, first.m_index, last.m_leaf, last.m_index)
         {
         }
 
         const Key& key() const { return m_leaf->key(m_index); }
         const void* value() const { return m_leaf->values[m_index].data; }
 
-        bool empty() const { return m_leaf == nullptr; }
+        // A null end leaf means the range runs to the end of the tree.
+        bool empty() const { return m_leaf == nullptr || (m_leaf == m_endLeaf && m_index == m_endIndex); }
 
         Range& operator++()
         {
@@ -180,6 +309,9 @@ public:
             {
                 m_leaf = m_leaf->next;
                 m_index = 0;
+
+                if (m_leaf != nullptr)
+                    BTreeCore::prefetch_scan_ahead(m_leaf, true);
             }
             return *this;
         }
@@ -218,7 +350,10 @@ public:
             {
                 this->m_leaf = this->m_leaf->prev;
                 if (this->m_leaf != nullptr)
+                {
                     this->m_index = this->m_leaf->count() - 1;
+                    BTreeCore::prefetch_scan_ahead(this->m_leaf, false);
+                }
             }
             else
                 --this->m_index;
@@ -234,8 +369,168 @@ public:
         }
     }; // class InvRange
 
+    // Scan of a snapshot. The leaf links belong to the tree, which may have changed since, so the next
+    // leaf is found descending again from the root of the snapshot.
+    class SnapshotRange : public Range
+    {
+    public:
+        SnapshotRange() = default;
+        SnapshotRange(
+            typename BTreeCore::NodeLeaf* leaf,
+            size_type index,
+            typename BTreeCore::Node* root,
+            unsigned height,
+            const Compare& comp
+        )
+            : Range(leaf, index)
+            , m_root(root)
+            , m_height(height)
+            , m_compare(comp)
+        {
+        }
+
+        SnapshotRange& operator++()
+        {
+            if (this->m_leaf == nullptr)
+                return *this;
+
+            ++this->m_index;
+            if (this->m_index >= this->m_leaf->count())
+            {
+                const Key& lastKey = this->m_leaf->key(this->m_index - 1);
+
+                this->m_leaf = BTreeCore::next_leaf(m_root, m_height, lastKey, m_compare);
+                this->m_index = 0;
+            }
+            return *this;
+        }
+
+        SnapshotRange operator++(int)
+        {
+            SnapshotRange old(*this);
+            ++(*this);
+            return old;
+        }
+
+    private:
+        typename BTreeCore::Node* m_root = nullptr;
+        unsigned m_height = 0;
+        COLL_NO_UNIQUE_ADDRESS Compare m_compare {};
+    }; // class SnapshotRange
+
+    // Builds the tree from entries appended in ascending key order. Leaves are filled left to right up
+    // to 'fillFactor' (0..1] of their capacity, and 'finish' builds the internal levels bottom-up.
+    // The tree is cleared when the loader is created, and stays empty until 'finish' is called. Entries
+    // appended to an unfinished loader are discarded on destruction, which is the only valid operation
+    // after an exception. Nodes are never left below the minimum fill, so the tree can be modified
+    // normally afterwards.
+    class BulkLoader
+    {
+    public:
+        BulkLoader(BTreeCore& core, float fillFactor);
+        ~BulkLoader() { discard(); }
+
+        BulkLoader(const BulkLoader&) = delete;
+        BulkLoader& operator=(const BulkLoader&) = delete;
+
+        // 'constructValue(void* buffer)' must build the value in place. Returns false (and does not
+        // call 'constructValue') if 'key' is equal to the previous one. Throws 'std::invalid_argument'
+        // if it is smaller.
+        template <typename ConstructFn>
+        bool append(const Key& key, ConstructFn&& constructValue);
+
+        void finish();
+
+    private:
+        BTreeCore& m_core;
+        typename BTreeCore::NodeLeaf* m_first = nullptr;
+        typename BTreeCore::NodeLeaf* m_last = nullptr;
+        size_type m_size = 0;
+        size_type m_leafCount = 0;
+        size_type m_leafFill;
+        size_type m_childrenFill;
+
+        void balance_last_leaf();
+        void build_level(darray<typename BTreeCore::Node*>& level, unsigned childHeight, darray<typename BTreeCore::Node*>& created);
+        void discard();
+
+        static size_type fill_count(float fillFactor, size_type minCount, size_type maxCount);
+        static const Key& first_key(const typename BTreeCore::Node* node, unsigned height);
+    }; // class BulkLoader
+
+    // Inserts and erases keys, keeping the path from the root to the last leaf visited. A key only
+    // climbs that path up to the lowest node whose separators bound it, and descends from there, so
+    // runs of ascending keys, which mostly land in the same leaf or a close one, skip most of the
+    // descent. Any key order gives the same results as 'insert' / 'erase', only slower. Splits and
+    // merges are propagated through the stored path, which is rebuilt below the highest changed node.
+    // Modifying the tree by other means (or taking a snapshot of it) invalidates the cursor.
+    class SortedCursor
+    {
+    public:
+        explicit SortedCursor(BTreeCore& core)
+            : m_core(core)
+        {
+        }
+
+        InsertResult insert(const Key& key);
+        bool erase(const Key& key);
+
+    private:
+        BTreeCore& m_core;
+        bool m_valid = false;
+        typename BTreeCore::Node* m_path[MaxHeight];
+        size_type m_indices[MaxHeight]; // Child taken at each internal node of the path.
+
+        typename BTreeCore::NodeLeaf* locate(const Key& key);
+        typename BTreeCore::NodeLeaf* descend(unsigned level, const Key& key);
+        unsigned lowest_covering_level(const Key& key) const;
+        unsigned leaf_level() const { return m_core.m_height - 1; }
+        void update_path_sizes(bool added);
+    }; // class SortedCursor
+
+    // Read-only view of the tree as it was when it was taken, which keeps its nodes alive. It does not
+    // depend on the tree, which may be modified or destroyed meanwhile. Snapshots can be read, copied
+    // and destroyed on other threads than the one modifying the tree, if the allocator is thread safe.
+    class Snapshot
+    {
+    public:
+        Snapshot() = default;
+        Snapshot(const Snapshot& rhs);
+        Snapshot(Snapshot&& rhs) noexcept;
+        ~Snapshot() { reset(); }
+
+        Snapshot& operator=(const Snapshot& rhs);
+        Snapshot& operator=(Snapshot&& rhs) noexcept;
+
+        size_type size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+
+        template <LookupKeyFor<Key, Compare> K = Key>
+        Handle find_first(const K& key) const;
+        template <LookupKeyFor<Key, Compare> K = Key>
+        Handle lower_bound(const K& key) const;
+        SnapshotRange begin() const;
+
+        // Releases the nodes, leaving the snapshot empty.
+        void reset();
+
+    private:
+        friend class BTreeCore;
+
+        explicit Snapshot(const Compare& comp)
+            : m_compare(comp)
+        {
+        }
+
+        typename BTreeCore::Node* m_root = nullptr;
+        unsigned m_height = 0;
+        size_type m_size = 0;
+        IAllocator* m_alloc = nullptr;
+        COLL_NO_UNIQUE_ADDRESS Compare m_compare {};
+    }; // class Snapshot
+
 private:
-    template <typename Key, BTreeCoreParams Params>
+    template <typename Key, BTreeCoreParams Params, typename Compare>
     friend class BTreeCoreChecker;
 
     union alignas(ValueAlign) AlignedValueStorage
@@ -243,6 +538,23 @@ private:
         std::byte data[ValueSize];
     };
 
+    // Values of a leaf: inline, or a pointer to their own block. Both are indexed the same way.
+    using LeafValues =
+        std::conditional_t<SeparateValues, AlignedValueStorage*, AlignedValueStorage[Order]>;
+
+    struct RefCount
+    {
+        std::atomic<uint32_t> value {1};
+    };
+    struct NoRefCount
+    {
+    };
+
+    struct NoKeyPrefixes
+    {
+    };
+    using KeyPrefixArray = std::conditional_t<KeyPrefixes, uint64_t[Order], NoKeyPrefixes>;
+
     class Node
     {
     public:
@@ -254,6 +566,61 @@ private:
             return reinterpret_cast<const Key*>(m_key_store)[index];
         }
         size_type count() const { return m_count; }
+        const Key* keys() const { return reinterpret_cast<const Key*>(m_key_store); }
+
+        uint64_t key_prefix(size_type index) const
+            requires KeyPrefixes
+        {
+            assert(index < m_count);
+            return m_prefixes[index];
+        }
+
+        // References to the node from parents and snapshots, only counted with 'Snapshots'. A shared
+        // node must be copied before being modified. 'release_ref' returns true for the last one.
+        bool shared() const
+        {
+            if constexpr (Snapshots)
+                return m_refs.value.load(std::memory_order_acquire) > 1;
+            else
+                return false;
+        }
+        void add_ref() const
+        {
+            if constexpr (Snapshots)
+                m_refs.value.fetch_add(1, std::memory_order_relaxed);
+        }
+        bool release_ref() const
+        {
+            if constexpr (Snapshots)
+                return m_refs.value.fetch_sub(1, std::memory_order_acq_rel) == 1;
+            else
+                return true;
+        }
+
+        // Index of the first key not less than 'key' / greater than 'key'. With 'KeyPrefixes', only
+        // the keys with the same prefix as 'key' are compared.
+        template <typename K>
+        size_type lower_bound(const K& key, const Compare& comp) const
+        {
+            if constexpr (HasPrefix<K>)
+            {
+                const auto [first, last] = prefix_window(Compare::prefix(key));
+                return first + Search::lower_bound(keys() + first, last - first, key, comp);
+            }
+            else
+                return Search::lower_bound(keys(), m_count, key, comp);
+        }
+        template <typename K>
+        size_type upper_bound(const K& key, const Compare& comp) const
+        {
+            if constexpr (HasPrefix<K>)
+            {
+                const auto [first, last] = prefix_window(Compare::prefix(key));
+                return first + Search::upper_bound(keys() + first, last - first, key, comp);
+            }
+            else
+                return Search::upper_bound(keys(), m_count, key, comp);
+        }
 
         Key change_key(size_type index, const Key& key)
         {
@@ -261,6 +628,7 @@ private:
             auto* keys = reinterpret_cast<Key*>(m_key_store);
             Key old = keys[index];
             keys[index] = key;
+            set_prefix(index, key);
             return old;
         }
 
@@ -270,6 +638,7 @@ private:
             assert(m_count < Order);
             auto* keys = reinterpret_cast<Key*>(m_key_store);
             new (keys + m_count) Key(key);
+            set_prefix(m_count, key);
             ++m_count;
         }
 
@@ -277,6 +646,7 @@ private:
         {
             assert(m_count < Order);
             auto* keys = reinterpret_cast<Key*>(m_key_store);
+            set_prefix(m_count, key);
             new (keys + m_count) Key(std::move(key));
             ++m_count;
         }
@@ -296,6 +666,12 @@ private:
                 keys[j] = std::move(keys[j - 1]);
 
             keys[index] = key;
+            if constexpr (KeyPrefixes)
+            {
+                for (size_type j = m_count; j > index; --j)
+                    m_prefixes[j] = m_prefixes[j - 1];
+                set_prefix(index, key);
+            }
             ++m_count;
         }
 
@@ -308,12 +684,34 @@ private:
 
             size_type i = index;
             for (; i < m_count - 1; ++i)
+            {
                 keys[i] = std::move(keys[i + 1]);
+                if constexpr (KeyPrefixes)
+                    m_prefixes[i] = m_prefixes[i + 1];
+            }
             keys[i].~Key();
 
             --m_count;
         }
 
+        // Removes the keys in [first, last).
+        void remove_keys(size_type first, size_type last)
+        {
+            assert(first <= last && last <= m_count);
+
+            auto* keys = reinterpret_cast<Key*>(m_key_store);
+            const size_type removed = last - first;
+
+            for (size_type i = last; i < m_count; ++i)
+            {
+                keys[i - removed] = std::move(keys[i]);
+                if constexpr (KeyPrefixes)
+                    m_prefixes[i - removed] = m_prefixes[i];
+            }
+
+            resize_keys(m_count - removed);
+        }
+
         void resize_keys(size_type size)
         {
             if (size >= m_count)
@@ -327,8 +725,37 @@ private:
         }
 
     private:
+        using Search = NodeSearch<Key, Order, Compare>;
+        using PrefixSearch = NodeSearch<uint64_t, Order>;
+
+        // Lookups by 'K' which can use the key prefixes.
+        template <typename K>
+        static constexpr bool HasPrefix =
+            KeyPrefixes && requires(const K& k) {
+                { Compare::prefix(k) } -> std::same_as<uint64_t>;
+            };
+
+        void set_prefix(size_type index, const Key& key)
+        {
+            if constexpr (KeyPrefixes)
+                m_prefixes[index] = Compare::prefix(key);
+        }
+
+        // Range of the keys whose prefix is 'prefix'. The keys before it are less than any key with
+        // that prefix, and the keys after it are greater.
+        std::pair<size_type, size_type> prefix_window(uint64_t prefix) const
+        {
+            const size_type first = PrefixSearch::lower_bound(m_prefixes, m_count, prefix);
+            const size_type last =
+                first + PrefixSearch::upper_bound(m_prefixes + first, m_count - first, prefix);
+
+            return {first, last};
+        }
+
+        COLL_NO_UNIQUE_ADDRESS KeyPrefixArray m_prefixes;
         alignas(alignof(Key)) std::byte m_key_store[sizeof(Key) * Order];
         size_type m_count = 0;
+        mutable std::conditional_t<Snapshots, RefCount, NoRefCount> m_refs;
     }; // class Node
 
     struct SplitInternalResult
@@ -336,13 +763,22 @@ private:
         Node* left;
         Node* right;
         Key separator;
+
+        // Entries under each half. Only computed with 'OrderStatistics'.
+        size_type leftSize = 0;
+        size_type rightSize = 0;
+    };
+
+    struct NoChildSizes
+    {
     };
+    using ChildSizes = std::conditional_t<OrderStatistics, size_type[Order + 1], NoChildSizes>;
 
     struct NodeLeaf : public Node
     {
         NodeLeaf* prev = nullptr;
         NodeLeaf* next = nullptr;
-        AlignedValueStorage values[Order];
+        LeafValues values;
 
         NodeLeaf() = default;
 
@@ -421,26 +857,30 @@ private:
             return right;
         }
 
-        NodeLeaf* split(void* mem_block)
+        NodeLeaf* split(NodeLeaf* sibling)
+        {
+            move_tail(this->count() / 2, sibling);
+            sibling->insert_after(this);
+
+            return sibling;
+        }
+
+        // Moves the entries from 'index' on to the empty 'sibling', without linking it.
+        void move_tail(size_type index, NodeLeaf* sibling)
         {
-            size_type mid = this->count() / 2;
-            NodeLeaf* sibling = new (mem_block) NodeLeaf;
-            const size_type sibling_count = this->count() - mid;
+            assert(sibling->count() == 0);
 
-            for (size_type i = 0; i < sibling_count; ++i)
+            for (size_type i = index; i < this->count(); ++i)
             {
-                sibling->add_key(std::move(this->key(mid + i)));
+                sibling->add_key(std::move(this->key(i)));
 
                 if constexpr (Params.MoveValueFn != nullptr)
                 {
-                    Params.MoveValueFn(sibling->values[i].data, this->values[mid + i].data);
-                    Params.DestroyValueFn(this->values[mid + i].data);
+                    Params.MoveValueFn(sibling->values[i - index].data, this->values[i].data);
+                    Params.DestroyValueFn(this->values[i].data);
                 }
             }
-            this->resize_keys(mid);
-            sibling->insert_after(this);
-
-            return sibling;
+            this->resize_keys(index);
         }
 
         void* insert(size_type index, const Key& key)
@@ -479,6 +919,28 @@ private:
             this->remove_key(index);
         }
 
+        // Removes the entries in [first, last).
+        void remove_range(size_type first, size_type last)
+        {
+            // The entries after an empty range would be moved onto themselves.
+            if (first == last)
+                return;
+
+            if constexpr (Params.MoveValueFn != nullptr)
+            {
+                for (size_type j = first; j < last; ++j)
+                    Params.DestroyValueFn(this->values[j].data);
+
+                for (size_type j = last; j < this->count(); ++j)
+                {
+                    Params.MoveValueFn(this->values[j - (last - first)].data, this->values[j].data);
+                    Params.DestroyValueFn(this->values[j].data);
+                }
+            }
+
+            this->remove_keys(first, last);
+        }
+
         void rotate_left()
         {
             assert(this->prev != nullptr);
@@ -493,6 +955,27 @@ private:
             this->remove(0);
         }
 
+        // Appends 'key' after the last entry. The value is built by 'constructValue'. The leaf is not
+        // modified if the key copy or 'constructValue' throw.
+        template <typename ConstructFn>
+        void append(const Key& key, ConstructFn&& constructValue)
+        {
+            assert(this->count() < Order);
+
+            const size_type index = this->count();
+            this->add_key(key);
+
+            try
+            {
+                constructValue(values[index].data);
+            }
+            catch (...)
+            {
+                this->remove_key(index);
+                throw;
+            }
+        }
+
         void rotate_right()
         {
             assert(this->next != nullptr);
@@ -510,12 +993,19 @@ private:
 
     }; // struct NodeLeaf
 
+    // Child sizes are the number of entries under each child. They are only stored with
+    // 'OrderStatistics'; otherwise they read as 0 and writes are ignored.
     struct NodeInternal : public Node
     {
         Node* children[Order + 1];
+        ChildSizes sizes;
 
         NodeInternal() = default;
-        NodeInternal(Node* left) { children[0] = left; }
+        NodeInternal(Node* left, size_type leftSize)
+        {
+            children[0] = left;
+            set_child_size(0, leftSize);
+        }
         NodeInternal(Node* left, Key&& key, Node* right)
         {
             children[0] = left;
@@ -523,22 +1013,59 @@ private:
             this->add_key(std::move(key));
         }
 
-        void insert_left(size_type index, Node* child, const Key& key)
+        size_type child_size(size_type index) const
+        {
+            if constexpr (OrderStatistics)
+                return sizes[index];
+            else
+                return 0;
+        }
+
+        void set_child_size(size_type index, size_type size)
+        {
+            if constexpr (OrderStatistics)
+                sizes[index] = size;
+        }
+
+        // Moves 'size' entries from the count of child 'from' to that of child 'to'.
+        void move_size(size_type from, size_type to, size_type size)
+        {
+            if constexpr (OrderStatistics)
+            {
+                sizes[from] -= size;
+                sizes[to] += size;
+            }
+        }
+
+        size_type total_size() const
+        {
+            size_type result = 0;
+
+            if constexpr (OrderStatistics)
+            {
+                for (size_type i = 0; i <= this->count(); ++i)
+                    result += sizes[i];
+            }
+            return result;
+        }
+
+        void insert_left(size_type index, Node* child, const Key& key, size_type size)
         {
             this->insert_key(index, key);
-            this->insert_child(index, child);
+            this->insert_child(index, child, size);
         }
 
-        void insert_right(size_type index, const Key& key, Node* child)
+        void insert_right(size_type index, const Key& key, Node* child, size_type size)
         {
             this->insert_key(index, key);
-            this->insert_child(index + 1, child);
+            this->insert_child(index + 1, child, size);
         }
 
-        void add(const Key& key, Node* child)
+        void add(const Key& key, Node* child, size_type size)
         {
             this->add_key(key);
             this->children[this->count()] = child;
+            set_child_size(this->count(), size);
         }
 
         void remove_left(size_type index)
@@ -558,7 +1085,8 @@ private:
             assert(this->children[0] != nullptr);
 
             size_type mid_index = this->count() / 2;
-            NodeInternal* sibling = new (mem_block) NodeInternal(this->children[mid_index + 1]);
+            NodeInternal* sibling = new (mem_block)
+                NodeInternal(this->children[mid_index + 1], child_size(mid_index + 1));
             SplitInternalResult result {this, sibling, this->key(mid_index)};
 
             // Move keys. Keys re divided like this:
@@ -566,9 +1094,11 @@ private:
             // - Next 1 (one) key is returned, will be used as separator in parent node.
             // - The rest go into 'sibling' node.
             for (size_type i = mid_index + 1; i < this->count(); ++i)
-                sibling->add(this->key(i), this->children[i + 1]);
+                sibling->add(this->key(i), this->children[i + 1], child_size(i + 1));
 
             this->resize_keys(mid_index);
+            result.leftSize = total_size();
+            result.rightSize = sibling->total_size();
 
             assert(sibling->children[0] != nullptr);
             assert(this->children[0] != nullptr);
@@ -578,29 +1108,114 @@ private:
 
         void merge(NodeInternal* right, const Key& separator)
         {
-            this->add(separator, right->children[0]);
+            this->add(separator, right->children[0], right->child_size(0));
 
             for (size_type i = 0; i < right->count(); ++i)
-                this->add(right->key(i), right->children[i + 1]);
+                this->add(right->key(i), right->children[i + 1], right->child_size(i + 1));
+        }
+
+        // Removes the children in [first, last), which cannot be all of them, along with the key at
+        // the left of each one (at the right, if 'first' is 0).
+        void remove_children(size_type first, size_type last)
+        {
+            assert(first <= last && last - first <= this->count());
+            const size_type removed = last - first;
+
+            for (size_type i = last; i <= this->count(); ++i)
+            {
+                children[i - removed] = children[i];
+                set_child_size(i - removed, child_size(i));
+            }
+
+            if (first > 0)
+                this->remove_keys(first - 1, last - 1);
+            else
+                this->remove_keys(0, removed);
         }
 
+        // Keeps the first 'count' keys, and the children around them.
+        void truncate(size_type count) { this->resize_keys(count); }
+
     private:
         void remove_child(size_type index)
         {
             for (size_type i = index; i < this->count(); ++i)
+            {
                 children[i] = children[i + 1];
+                set_child_size(i, child_size(i + 1));
+            }
         }
 
-        void insert_child(size_type index, Node* child)
+        void insert_child(size_type index, Node* child, size_type size)
         {
             assert(index <= this->count());
             for (size_type i = this->count(); i > index; --i)
+            {
                 children[i] = children[i - 1];
+                set_child_size(i, child_size(i - 1));
+            }
 
             children[index] = child;
+            set_child_size(index, size);
+        }
+    };
+
+    // Node pools of a tree. Only that tree allocates from them and frees to them.
+    struct Pools
+    {
+        NodePool leaves;
+        NodePool internals;
+        NodePool values; // Value blocks of the leaves, only with 'SeparateValues'.
+
+        explicit Pools(IAllocator& alloc)
+            : leaves(alloc, sizeof(NodeLeaf), align::of<NodeLeaf>())
+            , internals(alloc, sizeof(NodeInternal), align::of<NodeInternal>())
+            , values(alloc, sizeof(AlignedValueStorage) * Order, align::of<AlignedValueStorage>())
+        {
+        }
+
+        void absorb(Pools& other)
+        {
+            leaves.absorb(other.leaves);
+            internals.absorb(other.internals);
+            values.absorb(other.values);
+        }
+    };
+
+    // Keeps the chunks of the pools of the trees split from each other. 'split_at' hands nodes over as
+    // they are, so each of those trees may have nodes in the pools of the others, which it frees to its
+    // own. Pools are handed over to the keeper when their tree releases them, and the last tree to let
+    // go of the keeper destroys it. The trees may be used on different threads, so 'retired' is only
+    // used under 'mutex', and 'owners' is atomic.
+    struct PoolKeeper
+    {
+        Pools retired;
+        std::atomic<size_type> owners = 1;
+        std::mutex mutex;
+
+        explicit PoolKeeper(IAllocator& alloc)
+            : retired(alloc)
+        {
         }
     };
 
+    // Tree hung by 'join' from the spine of a taller one.
+    struct Graft
+    {
+        Node* root;
+        size_type size;
+        const Key& separator; // First key of the right one of both trees.
+        unsigned parentLevel; // Level of the spine node which receives 'root'.
+        bool atRight;         // Right spine (last children), or left spine (first children).
+    };
+
+    // Outcome of erasing a range under a node.
+    struct RangeErase
+    {
+        size_type erased; // Only counted with 'OrderStatistics'.
+        bool empty;       // Nothing is left under the node, whose children have been freed.
+    };
+
     struct LeafPos
     {
         NodeLeaf* leaf;
@@ -612,27 +1227,108 @@ private:
         std::optional<SplitInternalResult> split;
     };
 
+    // A node may not have fewer keys than this, except the root.
+    static constexpr size_type MinKeys = (Order + 1) / 2 - 1;
+
+    // Number of keys which descend the tree together in 'find_batch'.
+    static constexpr size_type BatchGroupSize = 32;
+
     Node* m_root;
     IAllocator* m_alloc;
     size_type m_size = 0;
     unsigned m_height;
-
+    COLL_NO_UNIQUE_ADDRESS Compare m_compare;
+
+    // Nodes are allocated from these pools, which take their memory from 'm_alloc'. They are created
+    // along with the first node, and dropped by 'clear'. 'm_keeper' is shared with the trees which may
+    // have nodes in the chunks of this tree, or this one in theirs.
+    Pools* m_pools = nullptr;
+    PoolKeeper* m_keeper = nullptr;
+
+    Pools& pools();
+    void release_pools();
+    bool drop_keeper();
+    BTreeCore sharing_pools();
+    void adopt_nodes(BTreeCore& rhs);
+    template <typename T>
+    NodePool& nodePool();
+    template <typename T>
+    void reserve_nodes(size_type count);
+    template <typename T>
+    void* allocNode();
+    template <typename T, typename... Args>
+    T* createNode(Args&&... args);
     template <typename T>
     void freeNode(T* ptr);
+    template <typename T>
+    static void freeUnpooledNode(IAllocator& alloc, T* ptr);
+    void* allocValues();
     void createInitialRootIfNeeded();
 
+    static void destroy_values(NodeLeaf* leaf);
+    static void release_subtree(IAllocator& alloc, Node* node, unsigned depth);
+
+    void unshare_root();
+    Node* unshare_child(NodeInternal* parent, size_type index, unsigned childLevel);
+    Node* unshare(Node* node, unsigned level);
+    NodeLeaf* clone_leaf(const NodeLeaf* leaf);
+    NodeInternal* clone_internal(const NodeInternal* node);
+    NodeLeaf* copy_leaf(const NodeLeaf* leaf);
+    Node* copy_subtree(const Node* node, unsigned depth, NodeLeaf*& lastLeaf);
+
     InsertResultInternal insert_recursive(Node* node, const Key& key, unsigned level);
     InsertResultInternal insert_at_leaf(NodeLeaf* leaf, const Key& key);
     InsertResultInternal insert_at_internal(NodeInternal* node, const Key& key, unsigned level);
+    void absorb_split(NodeInternal* node, size_type index, InsertResultInternal& result);
+    void grow_root(SplitInternalResult& split);
+    bool shrink_root();
+
+    void graft_spine(const Graft& graft);
+    std::optional<SplitInternalResult> graft_into(NodeInternal* node, unsigned level,
+                                                  const Graft& graft);
+    void refill_child(NodeInternal* parent, size_type idx, unsigned level);
+    void repair_path(const Key& key);
+    static size_type count_left_side(const NodeLeaf* leftLast, const NodeLeaf* rightFirst,
+                                     size_type total);
 
     NodeLeaf* split_leaf(NodeLeaf* leaf);
     SplitInternalResult split_internal(NodeInternal* node);
 
     void delete_subtree(Node* node, unsigned level);
+    template <typename K>
+    static decltype(auto) lookup_key(const K& key);
+    template <typename K>
+    NodeLeaf* find_leaf(const K& key) const
+    {
+        return descend_to_leaf(m_root, m_height, key, m_compare);
+    }
+    template <typename K>
+    static NodeLeaf* descend_to_leaf(
+        Node* root,
+        unsigned height,
+        const K& key,
+        const Compare& comp
+    );
+    template <typename K>
+    static NodeLeaf* next_leaf(Node* root, unsigned height, const K& key, const Compare& comp);
     NodeLeaf* leftmost_leaf() const;
     NodeLeaf* rightmost_leaf() const;
+    static size_type distance(const Handle& first, const Handle& last);
+    static size_type subtree_size(const Node* node, bool isLeaf);
+
+    template <typename OutputFn>
+    void find_group(const Key* keys, size_type count, size_type firstIndex, OutputFn& output) const;
+    template <typename OutputFn>
+    void find_sorted(span<const Key> keys, OutputFn& output) const;
+    Handle find_in_leaf(NodeLeaf* leaf, const Key& key) const;
+    static void prefetch(const Node* node);
+    static void prefetch_scan_ahead(const NodeLeaf* leaf, bool forward);
+    static void prefetch_bytes(const void* address, byte_size bytes, byte_size maxLines);
 
     bool erase_recursive(Node* node, const Key& key, unsigned level);
+    RangeErase erase_range_recursive(Node* node, unsigned level, const Key* keyLeft,
+                                     const Key* keyRight);
+    NodeLeaf* unshare_path(const Key& key);
     bool erase_from_leaf(NodeLeaf* leaf, const Key& key);
     void fix_underflow(NodeInternal* parent, size_type idx, unsigned level);
     void rotate_left_leaf(NodeInternal* parent, size_type parentIndex);
@@ -656,37 +1352,55 @@ private:
 // ------------------------------------------------------------
 // Constructores
 // ------------------------------------------------------------
-template <typename Key, BTreeCoreParams Params>
-BTreeCore<Key, Params>::BTreeCore(IAllocator& alloc)
+template <typename Key, BTreeCoreParams Params, typename Compare>
+BTreeCore<Key, Params, Compare>::BTreeCore(IAllocator& alloc, const Compare& comp)
     : m_alloc(&alloc)
     , m_root(nullptr)
     , m_size(0)
     , m_height(0)
+    , m_compare(comp)
 {
 }
 
 // Definición del constructor de movimiento
-template <typename Key, BTreeCoreParams Params>
-BTreeCore<Key, Params>::BTreeCore(BTreeCore&& rhs) noexcept
+template <typename Key, BTreeCoreParams Params, typename Compare>
+BTreeCore<Key, Params, Compare>::BTreeCore(BTreeCore&& rhs) noexcept
     : m_root(rhs.m_root)
     , m_alloc(rhs.m_alloc)
     , m_size(rhs.m_size)
     , m_height(rhs.m_height)
+    , m_compare(std::move(rhs.m_compare))
+    , m_pools(rhs.m_pools)
+    , m_keeper(rhs.m_keeper)
 {
+    rhs.m_pools = nullptr;
+    rhs.m_keeper = nullptr;
     rhs.m_root = nullptr;
     rhs.m_height = 0;
     rhs.m_size = 0;
 }
 
 // Definición del operador de movimiento
-template <typename Key, BTreeCoreParams Params>
-BTreeCore<Key, Params>& BTreeCore<Key, Params>::operator=(BTreeCore&& rhs) noexcept
+template <typename Key, BTreeCoreParams Params, typename Compare>
+BTreeCore<Key, Params, Compare>&
+BTreeCore<Key, Params, Compare>::operator=(BTreeCore&& rhs) noexcept
 {
+    if (this == &rhs)
+        return *this;
+
+    // The nodes of this tree live in the pools, so they must be destroyed before replacing them.
+    clear();
+
     m_root = rhs.m_root;
     m_alloc = rhs.m_alloc;
     m_size = rhs.m_size;
     m_height = rhs.m_height;
+    m_compare = std::move(rhs.m_compare);
+    m_pools = rhs.m_pools;
+    m_keeper = rhs.m_keeper;
 
+    rhs.m_pools = nullptr;
+    rhs.m_keeper = nullptr;
     rhs.m_root = nullptr;
     rhs.m_height = 0;
     rhs.m_size = 0;
@@ -697,64 +1411,280 @@ BTreeCore<Key, Params>& BTreeCore<Key, Params>::operator=(BTreeCore&& rhs) noexc
 // ------------------------------------------------------------
 // Gestión de memoria
 // ------------------------------------------------------------
-template <typename Key, BTreeCoreParams Params>
-template <typename T>
-void BTreeCore<Key, Params>::freeNode(T* ptr)
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::Pools& BTreeCore<Key, Params, Compare>::pools()
 {
-    if (ptr)
-    {
-        ptr->~T();
-        m_alloc->free(ptr);
-    }
+    if (m_pools == nullptr)
+        m_pools = create<Pools>(*m_alloc, *m_alloc);
+
+    return *m_pools;
 }
 
-template <typename Key, BTreeCoreParams Params>
-void BTreeCore<Key, Params>::createInitialRootIfNeeded()
+// Drops the pools, which must not hold any node of this tree anymore. If other trees may still have
+// nodes in them, they are handed over to the keeper instead.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::release_pools()
 {
-    if (m_root != nullptr)
-        return;
+    if (m_keeper != nullptr)
+    {
+        if (m_pools != nullptr)
+        {
+            std::lock_guard<std::mutex> guard(m_keeper->mutex);
+            m_keeper->retired.absorb(*m_pools);
+        }
 
-    assert(m_height == 0);
+        if (m_keeper->owners.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            destroy(*m_alloc, m_keeper);
+        m_keeper = nullptr;
+    }
 
-    void* mem_block = checked_alloc<NodeLeaf>(*m_alloc);
-    m_root = new (mem_block) NodeLeaf;
-    m_height = 1;
+    if (m_pools != nullptr)
+        destroy(*m_alloc, m_pools);
+    m_pools = nullptr;
 }
 
-// ------------------------------------------------------------
-// Inicialización y limpieza
-// ------------------------------------------------------------
-
-template <typename Key, BTreeCoreParams Params>
-BTreeCore<Key, Params>::~BTreeCore()
+// Drops the keeper if no other tree shares it, taking the chunks it kept. Returns whether this tree
+// has no keeper now, so that its nodes are only in its own pools.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+bool BTreeCore<Key, Params, Compare>::drop_keeper()
 {
-    clear();
+    if (m_keeper != nullptr && m_keeper->owners.load(std::memory_order_acquire) == 1)
+    {
+        pools().absorb(m_keeper->retired);
+        destroy(*m_alloc, m_keeper);
+        m_keeper = nullptr;
+    }
+
+    return m_keeper == nullptr;
 }
 
-template <typename Key, BTreeCoreParams Params>
-void BTreeCore<Key, Params>::clear()
+// Empty tree which may be given nodes of this one, as both share the keeper of their chunks. Its pools
+// are created now, as freeing those nodes must not fail.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+BTreeCore<Key, Params, Compare> BTreeCore<Key, Params, Compare>::sharing_pools()
 {
-    if (m_root != nullptr)
+    BTreeCore result(*m_alloc, m_compare);
+
+    if constexpr (!Snapshots)
+    {
+        result.pools();
+        if (m_keeper == nullptr)
+            m_keeper = create<PoolKeeper>(*m_alloc, *m_alloc);
+
+        result.m_keeper = m_keeper;
+        m_keeper->owners.fetch_add(1, std::memory_order_relaxed);
+    }
+    return result;
+}
+
+// Makes the nodes of 'rhs' nodes which this tree can free: they must come from the same allocator and,
+// without 'Snapshots', from chunks which live as long as this tree. The pools of 'rhs' are merged with
+// these, or its keeper shared, if no other tree would be affected. Otherwise its entries are moved to
+// new nodes.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::adopt_nodes(BTreeCore& rhs)
+{
+    if (m_alloc == rhs.m_alloc)
+    {
+        if constexpr (Snapshots)
+            return;
+
+        // The nodes of 'rhs' will be freed to these pools.
+        pools();
+
+        if (rhs.drop_keeper())
+        {
+            if (rhs.m_pools != nullptr)
+                m_pools->absorb(*rhs.m_pools);
+            return;
+        }
+
+        if (rhs.m_keeper == m_keeper)
+            return;
+
+        if (drop_keeper())
+        {
+            m_keeper = rhs.m_keeper;
+            m_keeper->owners.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    BTreeCore moved(*m_alloc, m_compare);
+    auto loader = moved.bulk_load();
+
+    for (NodeLeaf* leaf = rhs.leftmost_leaf(); leaf != nullptr; leaf = leaf->next)
+    {
+        for (size_type i = 0; i < leaf->count(); ++i)
+        {
+            loader.append(leaf->key(i), [leaf, i](void* buffer) {
+                if constexpr (Params.MoveValueFn != nullptr)
+                    Params.MoveValueFn(buffer, leaf->values[i].data);
+            });
+        }
+    }
+    loader.finish();
+
+    // Its pools are only its own now.
+    rhs = std::move(moved);
+    adopt_nodes(rhs);
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <typename T>
+NodePool& BTreeCore<Key, Params, Compare>::nodePool()
+{
+    static_assert(std::is_same_v<T, NodeLeaf> || std::is_same_v<T, NodeInternal>);
+
+    if constexpr (std::is_same_v<T, NodeLeaf>)
+        return pools().leaves;
+    else
+        return pools().internals;
+}
+
+// Makes sure that the next 'count' nodes of type 'T' can be allocated, for changes which cannot fail
+// halfway. Only the pools can make sure of it, so it does nothing with 'Snapshots'.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <typename T>
+void BTreeCore<Key, Params, Compare>::reserve_nodes(size_type count)
+{
+    if constexpr (!Snapshots)
+        nodePool<T>().reserve(count);
+}
+
+// With 'Snapshots', the last reference to a node may be released by a snapshot on another thread, so
+// nodes cannot come from the pools, which are not thread safe.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <typename T>
+void* BTreeCore<Key, Params, Compare>::allocNode()
+{
+    if constexpr (Snapshots)
+        return checked_alloc<T>(*m_alloc);
+    else
+        return nodePool<T>().alloc();
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void* BTreeCore<Key, Params, Compare>::allocValues()
+{
+    if constexpr (Snapshots)
+    {
+        const SAllocResult r =
+            m_alloc->alloc(sizeof(AlignedValueStorage) * Order, align::of<AlignedValueStorage>());
+
+        if (r.buffer == nullptr)
+            throw std::bad_alloc();
+        return r.buffer;
+    }
+    else
+        return pools().values.alloc();
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <typename T, typename... Args>
+T* BTreeCore<Key, Params, Compare>::createNode(Args&&... args)
+{
+    T* node = new (allocNode<T>()) T(std::forward<Args>(args)...);
+
+    if constexpr (std::is_same_v<T, NodeLeaf> && SeparateValues)
+    {
+        try
+        {
+            node->values = static_cast<AlignedValueStorage*>(allocValues());
+        }
+        catch (...)
+        {
+            node->~T();
+            if constexpr (Snapshots)
+                m_alloc->free(node);
+            else
+                nodePool<T>().free(node);
+            throw;
+        }
+    }
+
+    return node;
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <typename T>
+void BTreeCore<Key, Params, Compare>::freeNode(T* ptr)
+{
+    if constexpr (Snapshots)
+        freeUnpooledNode(*m_alloc, ptr);
+    else if (ptr)
+    {
+        if constexpr (std::is_same_v<T, NodeLeaf> && SeparateValues)
+            m_pools->values.free(ptr->values);
+
+        ptr->~T();
+        nodePool<T>().free(ptr);
+    }
+}
+
+// Frees a node allocated with 'Snapshots', without the tree (snapshots release nodes by themselves).
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <typename T>
+void BTreeCore<Key, Params, Compare>::freeUnpooledNode(IAllocator& alloc, T* ptr)
+{
+    if (ptr)
+    {
+        if constexpr (std::is_same_v<T, NodeLeaf> && SeparateValues)
+            alloc.free(ptr->values);
+
+        ptr->~T();
+        alloc.free(ptr);
+    }
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::createInitialRootIfNeeded()
+{
+    if (m_root != nullptr)
+        return;
+
+    assert(m_height == 0);
+
+    m_root = createNode<NodeLeaf>();
+    m_height = 1;
+}
+
+// ------------------------------------------------------------
+// Inicialización y limpieza
+// ------------------------------------------------------------
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+BTreeCore<Key, Params, Compare>::~BTreeCore()
+{
+    clear();
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::clear()
+{
+    if (m_root != nullptr)
         delete_subtree(m_root, 0);
 
+    // Other trees may still have nodes in the pools, if they are shared.
+    release_pools();
+
     m_root = nullptr;
     m_height = 0;
     m_size = 0;
 }
 
-template <typename Key, BTreeCoreParams Params>
-void BTreeCore<Key, Params>::delete_subtree(Node* node, unsigned level)
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::delete_subtree(Node* node, unsigned level)
 {
+    // Nodes still referenced by snapshots are kept.
+    if constexpr (Snapshots)
+        return release_subtree(*m_alloc, node, m_height - 1 - level);
+
     if (level == m_height - 1)
     {
         NodeLeaf* leaf = static_cast<NodeLeaf*>(node);
 
-        if constexpr (Params.DestroyValueFn != nullptr)
-        {
-            for (size_type i = 0; i < leaf->count(); ++i)
-                Params.DestroyValueFn(leaf->values[i].data);
-        }
-
+        destroy_values(leaf);
         freeNode(leaf);
     }
     else
@@ -766,65 +1696,315 @@ void BTreeCore<Key, Params>::delete_subtree(Node* node, unsigned level)
     }
 }
 
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::destroy_values(NodeLeaf* leaf)
+{
+    if constexpr (Params.DestroyValueFn != nullptr)
+    {
+        for (size_type i = 0; i < leaf->count(); ++i)
+            Params.DestroyValueFn(leaf->values[i].data);
+    }
+}
+
+// Only with 'Snapshots'. Drops a reference to 'node', which has 'depth' levels below it, and destroys
+// it if it was the last one, releasing its children in turn.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::release_subtree(IAllocator& alloc, Node* node, unsigned depth)
+{
+    if (!node->release_ref())
+        return;
+
+    if (depth == 0)
+    {
+        NodeLeaf* leaf = static_cast<NodeLeaf*>(node);
+
+        destroy_values(leaf);
+        freeUnpooledNode(alloc, leaf);
+    }
+    else
+    {
+        NodeInternal* internal = static_cast<NodeInternal*>(node);
+        for (size_type i = 0; i <= internal->count(); ++i)
+            release_subtree(alloc, internal->children[i], depth - 1);
+        freeUnpooledNode(alloc, internal);
+    }
+}
+
+// ------------------------------------------------------------
+// Copia de nodos compartidos
+// ------------------------------------------------------------
+
+// Before modifying a node, the tree makes sure that it is its only owner. The path from the root is
+// unshared top-down, so a node with a single reference, whose parent is not shared, can only be
+// reached from this tree.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::unshare_root()
+{
+    if constexpr (Snapshots)
+    {
+        if (m_root != nullptr && m_root->shared())
+            m_root = unshare(m_root, 0);
+    }
+}
+
+// Makes child 'index' of 'parent', which must not be shared, owned only by it, and returns it.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::Node*
+BTreeCore<Key, Params, Compare>::unshare_child(
+    NodeInternal* parent,
+    size_type index,
+    unsigned childLevel
+)
+{
+    if constexpr (Snapshots)
+    {
+        if (parent->children[index]->shared())
+            parent->children[index] = unshare(parent->children[index], childLevel);
+    }
+
+    return parent->children[index];
+}
+
+// Copy of the shared 'node', at 'level', which replaces the reference of this tree to it.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::Node*
+BTreeCore<Key, Params, Compare>::unshare(Node* node, unsigned level)
+{
+    const unsigned depth = m_height - 1 - level;
+    Node* copy;
+
+    if (depth == 0)
+        copy = clone_leaf(static_cast<NodeLeaf*>(node));
+    else
+        copy = clone_internal(static_cast<NodeInternal*>(node));
+
+    // Snapshots may have released theirs meanwhile, so this one may be the last.
+    release_subtree(*m_alloc, node, depth);
+    return copy;
+}
+
+// The copy takes the place of 'leaf' in the leaf chain, which only links the leaves of this tree.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::NodeLeaf*
+BTreeCore<Key, Params, Compare>::clone_leaf(const NodeLeaf* leaf)
+{
+    NodeLeaf* copy = copy_leaf(leaf);
+
+    copy->prev = leaf->prev;
+    copy->next = leaf->next;
+    if (copy->prev != nullptr)
+        copy->prev->next = copy;
+    if (copy->next != nullptr)
+        copy->next->prev = copy;
+
+    return copy;
+}
+
+// The children become shared by the node and its copy.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::NodeInternal*
+BTreeCore<Key, Params, Compare>::clone_internal(const NodeInternal* node)
+{
+    NodeInternal* copy = createNode<NodeInternal>(node->children[0], node->child_size(0));
+
+    try
+    {
+        for (size_type i = 0; i < node->count(); ++i)
+            copy->add(node->key(i), node->children[i + 1], node->child_size(i + 1));
+    }
+    catch (...)
+    {
+        freeNode(copy);
+        throw;
+    }
+
+    for (size_type i = 0; i <= copy->count(); ++i)
+        copy->children[i]->add_ref();
+
+    return copy;
+}
+
+// ------------------------------------------------------------
+// Copia completa
+// ------------------------------------------------------------
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::copy_from(const BTreeCore& rhs)
+{
+    static_assert(
+        ValueSize == 0 || Params.CopyValueFn != nullptr,
+        "BTreeCore: copies need 'CopyValueFn'"
+    );
+
+    if (this == &rhs)
+        return;
+
+    clear();
+    m_compare = rhs.m_compare;
+    if (rhs.m_root == nullptr)
+        return;
+
+    // 'copy_subtree' destroys what it has copied on failure, which needs the height.
+    m_height = rhs.m_height;
+    NodeLeaf* lastLeaf = nullptr;
+
+    try
+    {
+        m_root = copy_subtree(rhs.m_root, m_height - 1, lastLeaf);
+    }
+    catch (...)
+    {
+        m_height = 0;
+        throw;
+    }
+
+    m_size = rhs.m_size;
+}
+
+// Copy of the subtree of 'node', which has 'depth' levels below it. Its leaves are linked after
+// 'lastLeaf', which is updated. Internal nodes get each key along with the copy of the child to its
+// right, so they can be destroyed as they are if a later copy throws.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::Node*
+BTreeCore<Key, Params, Compare>::copy_subtree(const Node* node, unsigned depth, NodeLeaf*& lastLeaf)
+{
+    if (depth == 0)
+    {
+        NodeLeaf* copy = copy_leaf(static_cast<const NodeLeaf*>(node));
+
+        if (lastLeaf != nullptr)
+            copy->insert_after(lastLeaf);
+        lastLeaf = copy;
+
+        return copy;
+    }
+
+    const NodeInternal* internal = static_cast<const NodeInternal*>(node);
+    Node* first = copy_subtree(internal->children[0], depth - 1, lastLeaf);
+    NodeInternal* copy;
+
+    try
+    {
+        copy = createNode<NodeInternal>(first, internal->child_size(0));
+    }
+    catch (...)
+    {
+        delete_subtree(first, m_height - depth);
+        throw;
+    }
+
+    try
+    {
+        for (size_type i = 0; i < internal->count(); ++i)
+        {
+            Node* child = copy_subtree(internal->children[i + 1], depth - 1, lastLeaf);
+
+            try
+            {
+                copy->add(internal->key(i), child, internal->child_size(i + 1));
+            }
+            catch (...)
+            {
+                delete_subtree(child, m_height - depth);
+                throw;
+            }
+        }
+    }
+    catch (...)
+    {
+        delete_subtree(copy, m_height - 1 - depth);
+        throw;
+    }
+
+    return copy;
+}
+
+// Copy of the entries of 'leaf', not linked to any other leaf.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::NodeLeaf*
+BTreeCore<Key, Params, Compare>::copy_leaf(const NodeLeaf* leaf)
+{
+    NodeLeaf* copy = createNode<NodeLeaf>();
+
+    try
+    {
+        for (size_type i = 0; i < leaf->count(); ++i)
+        {
+            copy->append(leaf->key(i), [leaf, i](void* buffer) {
+                if constexpr (Params.CopyValueFn != nullptr)
+                    Params.CopyValueFn(buffer, leaf->values[i].data);
+            });
+        }
+    }
+    catch (...)
+    {
+        destroy_values(copy);
+        freeNode(copy);
+        throw;
+    }
+
+    return copy;
+}
+
 // ------------------------------------------------------------
 // División de nodos
 // ------------------------------------------------------------
-template <typename Key, BTreeCoreParams Params>
-typename BTreeCore<Key, Params>::NodeLeaf* BTreeCore<Key, Params>::split_leaf(NodeLeaf* leaf)
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::NodeLeaf*
+BTreeCore<Key, Params, Compare>::split_leaf(NodeLeaf* leaf)
 {
-    return leaf->split(checked_alloc<NodeLeaf>(*m_alloc));
+    return leaf->split(createNode<NodeLeaf>());
 }
 
-template <typename Key, BTreeCoreParams Params>
-typename BTreeCore<Key, Params>::SplitInternalResult
-BTreeCore<Key, Params>::split_internal(NodeInternal* node)
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::SplitInternalResult
+BTreeCore<Key, Params, Compare>::split_internal(NodeInternal* node)
 {
-    void* mem_block = checked_alloc<NodeInternal>(*m_alloc);
+    void* mem_block = allocNode<NodeInternal>();
     return node->split(mem_block);
 }
 
 // ------------------------------------------------------------
 // Inserción
 // ------------------------------------------------------------
-template <typename Key, BTreeCoreParams Params>
-typename BTreeCore<Key, Params>::InsertResultInternal
-BTreeCore<Key, Params>::insert_at_leaf(NodeLeaf* leaf, const Key& key)
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::InsertResultInternal
+BTreeCore<Key, Params, Compare>::insert_at_leaf(NodeLeaf* leaf, const Key& key)
 {
-    size_type i = 0;
-    while (i < leaf->count() && leaf->key(i) < key)
-        ++i;
-
+    const size_type i = leaf->lower_bound(key, m_compare);
     const Handle location(leaf, i);
 
-    if (i < leaf->count() && leaf->key(i) == key)
+    if (i < leaf->count() && !m_compare(key, leaf->key(i)))
         return {location, leaf->values[i].data, false, {}};
 
     if (leaf->count() >= Order)
     {
+        InsertResultInternal result;
+
         if (i == leaf->count())
         {
-            NodeLeaf* right = create<NodeLeaf>(*m_alloc);
+            NodeLeaf* right = createNode<NodeLeaf>();
             right->insert_after(leaf);
-            auto result = insert_at_leaf(right, key);
+            result = insert_at_leaf(right, key);
             result.split = SplitInternalResult {leaf, right, key};
-            return result;
         }
         else if (i == 0)
         {
-            NodeLeaf* left = create<NodeLeaf>(*m_alloc);
+            NodeLeaf* left = createNode<NodeLeaf>();
             left->insert_before(leaf);
-            auto result = insert_at_leaf(left, key);
+            result = insert_at_leaf(left, key);
             result.split = SplitInternalResult {left, leaf, leaf->key(0)};
-            return result;
         }
         else
         {
             NodeLeaf* right = split_leaf(leaf);
             NodeLeaf* target_leaf = i < leaf->count() ? leaf : right;
-            auto result = insert_at_leaf(target_leaf, key);
+            result = insert_at_leaf(target_leaf, key);
             result.split = SplitInternalResult {leaf, right, right->key(0)};
-            return result;
         }
+
+        result.split->leftSize = subtree_size(result.split->left, true);
+        result.split->rightSize = subtree_size(result.split->right, true);
+        return result;
     }
 
     void* valuePtr = leaf->insert(i, key);
@@ -832,33 +2012,60 @@ BTreeCore<Key, Params>::insert_at_leaf(NodeLeaf* leaf, const Key& key)
     return {location, valuePtr, true, {}};
 }
 
-template <typename Key, BTreeCoreParams Params>
-typename BTreeCore<Key, Params>::InsertResultInternal
-BTreeCore<Key, Params>::insert_at_internal(NodeInternal* node, const Key& key, unsigned level)
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::InsertResultInternal
+BTreeCore<Key, Params, Compare>::insert_at_internal(
+    NodeInternal* node,
+    const Key& key,
+    unsigned level
+)
 {
-    size_type i = 0;
-    while (i < node->count() && !(key < node->key(i)))
-        ++i;
+    const size_type i = node->upper_bound(key, m_compare);
 
-    auto result = insert_recursive(node->children[i], key, level + 1);
-    if (!result.split.has_value())
-        return result;
+    auto result = insert_recursive(unshare_child(node, i, level + 1), key, level + 1);
+    if (result.split.has_value())
+        absorb_split(node, i, result);
+    else if (result.newEntry)
+        node->set_child_size(i, node->child_size(i) + 1);
+
+    return result;
+}
 
+// Links the nodes of the split of child 'index' into 'node'. If 'node' fills up, it is split in turn
+// and 'result.split' describes it. Otherwise, 'result.split' is cleared.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::absorb_split(
+    NodeInternal* node,
+    size_type index,
+    InsertResultInternal& result
+)
+{
     assert(node->children[0] != nullptr);
-    node->insert_right(i, result.split->separator, result.split->right);
-    node->children[i] = result.split->left;
+    node->insert_right(index, result.split->separator, result.split->right, result.split->rightSize);
+    node->children[index] = result.split->left;
+    node->set_child_size(index, result.split->leftSize);
 
     if (node->count() < Order)
         result.split = std::nullopt;
     else
         result.split = split_internal(node);
+}
 
-    return result;
+// Adds a new root above the two halves of the old one.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::grow_root(SplitInternalResult& split)
+{
+    NodeInternal* root = createNode<NodeInternal>(split.left, std::move(split.separator), split.right);
+    root->set_child_size(0, split.leftSize);
+    root->set_child_size(1, split.rightSize);
+
+    m_root = root;
+    ++m_height;
 }
 
-template <typename Key, BTreeCoreParams Params>
-typename BTreeCore<Key, Params>::InsertResultInternal
-BTreeCore<Key, Params>::insert_recursive(Node* node, const Key& key, unsigned level)
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::InsertResultInternal
+BTreeCore<Key, Params, Compare>::insert_recursive(Node* node, const Key& key, unsigned level)
 {
     if (level == m_height - 1)
         return insert_at_leaf(static_cast<NodeLeaf*>(node), key);
@@ -869,22 +2076,17 @@ BTreeCore<Key, Params>::insert_recursive(Node* node, const Key& key, unsigned le
 // ------------------------------------------------------------
 // Inserción pública
 // ------------------------------------------------------------
-template <typename Key, BTreeCoreParams Params>
-typename BTreeCore<Key, Params>::InsertResult BTreeCore<Key, Params>::insert(const Key& key)
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::InsertResult
+BTreeCore<Key, Params, Compare>::insert(const Key& key)
 {
     createInitialRootIfNeeded();
+    unshare_root();
 
     auto result = insert_recursive(m_root, key, 0);
 
     if (result.split.has_value())
-    {
-        void* mem_block = checked_alloc<NodeInternal>(*m_alloc);
-        NodeInternal* new_root = new (mem_block)
-            NodeInternal(result.split->left, std::move(result.split->separator), result.split->right);
-
-        m_root = new_root;
-        ++m_height;
-    }
+        grow_root(*result.split);
 
     if (result.newEntry)
         ++m_size;
@@ -892,74 +2094,437 @@ typename BTreeCore<Key, Params>::InsertResult BTreeCore<Key, Params>::insert(con
     return result;
 }
 
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::InsertResult
+BTreeCore<Key, Params, Compare>::try_insert(const Key& key)
+{
+    // 'insert' unshares the path on the way down, before knowing whether the key is new.
+    if constexpr (Snapshots)
+    {
+        if (m_root != nullptr)
+        {
+            NodeLeaf* leaf = find_leaf(key);
+            const size_type i = leaf->lower_bound(key, m_compare);
+
+            if (i < leaf->count() && !m_compare(key, leaf->key(i)))
+                return {Handle(leaf, i), leaf->values[i].data, false};
+        }
+    }
+
+    return insert(key);
+}
+
 // ------------------------------------------------------------
 // Búsqueda
 // ------------------------------------------------------------
-template <typename Key, BTreeCoreParams Params>
-typename BTreeCore<Key, Params>::Handle BTreeCore<Key, Params>::lower_bound(const Key& key) const
+
+// Key with which a lookup by 'key' searches the nodes: 'key' itself if it is a 'Key' or a transparent
+// lookup, or a 'Key' built from it otherwise, so that it is converted once and not on each comparison.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <typename K>
+decltype(auto) BTreeCore<Key, Params, Compare>::lookup_key(const K& key)
 {
-    if (m_root == nullptr)
-        return {};
+    if constexpr (std::is_same_v<K, Key> || TransparentLookup<K, Key, Compare>)
+        return key;
+    else
+        return Key(key);
+}
 
-    void* node = m_root;
-    unsigned level = 0;
+// Leaf which would contain 'key', in the tree (or snapshot) with that root and height, which must not
+// be empty.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <typename K>
+typename BTreeCore<Key, Params, Compare>::NodeLeaf*
+BTreeCore<Key, Params, Compare>::descend_to_leaf(
+    Node* root,
+    unsigned height,
+    const K& key,
+    const Compare& comp
+)
+{
+    assert(root != nullptr);
 
-    while (level < m_height - 1)
+    Node* node = root;
+    for (unsigned level = 0; level < height - 1; ++level)
+    {
+        NodeInternal* internal = static_cast<NodeInternal*>(node);
+        node = internal->children[internal->upper_bound(key, comp)];
+    }
+
+    return static_cast<NodeLeaf*>(node);
+}
+
+// Leaf after the one which would contain 'key', without following the leaf links. It is the leftmost
+// leaf of the nearest subtree to the right of the path to 'key'. Null if there is none.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <typename K>
+typename BTreeCore<Key, Params, Compare>::NodeLeaf*
+BTreeCore<Key, Params, Compare>::next_leaf(
+    Node* root,
+    unsigned height,
+    const K& key,
+    const Compare& comp
+)
+{
+    Node* branch = nullptr;
+    unsigned branchLevel = 0;
+
+    Node* node = root;
+    for (unsigned level = 0; level < height - 1; ++level)
     {
         NodeInternal* internal = static_cast<NodeInternal*>(node);
+        const size_type i = internal->upper_bound(key, comp);
+
+        if (i < internal->count())
+        {
+            branch = internal->children[i + 1];
+            branchLevel = level + 1;
+        }
+        node = internal->children[i];
+    }
+
+    if (branch == nullptr)
+        return nullptr;
+
+    for (; branchLevel < height - 1; ++branchLevel)
+        branch = static_cast<NodeInternal*>(branch)->children[0];
+
+    return static_cast<NodeLeaf*>(branch);
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <LookupKeyFor<Key, Compare> K>
+typename BTreeCore<Key, Params, Compare>::Handle
+BTreeCore<Key, Params, Compare>::lower_bound(const K& key) const
+{
+    if (m_root == nullptr)
+        return {};
+
+    const auto& k = lookup_key(key);
+    NodeLeaf* leaf = find_leaf(k);
+    const size_type i = leaf->lower_bound(k, m_compare);
+
+    if (i < leaf->count())
+        return Handle(leaf, i);
+    else
+        return Handle(leaf->next, 0);
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <LookupKeyFor<Key, Compare> K>
+typename BTreeCore<Key, Params, Compare>::Handle
+BTreeCore<Key, Params, Compare>::upper_bound(const K& key) const
+{
+    if (m_root == nullptr)
+        return {};
+
+    const auto& k = lookup_key(key);
+    NodeLeaf* leaf = find_leaf(k);
+    const size_type i = leaf->upper_bound(k, m_compare);
+
+    if (i < leaf->count())
+        return Handle(leaf, i);
+    else
+        return Handle(leaf->next, 0);
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <LookupKeyFor<Key, Compare> K>
+typename BTreeCore<Key, Params, Compare>::Range
+BTreeCore<Key, Params, Compare>::range(const K& key) const
+{
+    const auto& k = lookup_key(key);
+    const Handle first = lower_bound(k);
+    if (!first || m_compare(k, first.key()))
+        return {};
+
+    return Range(first, upper_bound(k));
+}
+
+// Entries in [keyLeft, keyRight).
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <LookupKeyFor<Key, Compare> K>
+typename BTreeCore<Key, Params, Compare>::Range
+BTreeCore<Key, Params, Compare>::range(const K& keyLeft, const K& keyRight) const
+{
+    const auto& kLeft = lookup_key(keyLeft);
+    const auto& kRight = lookup_key(keyRight);
+    if (!m_compare(kLeft, kRight))
+        return {};
+
+    return Range(lower_bound(kLeft), lower_bound(kRight));
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <LookupKeyFor<Key, Compare> K>
+count_t BTreeCore<Key, Params, Compare>::count(const K& key) const
+{
+    const auto& k = lookup_key(key);
+    const Handle first = lower_bound(k);
+    if (!first || m_compare(k, first.key()))
+        return 0;
+
+    return distance(first, upper_bound(k));
+}
+
+// Number of entries between two positions of the leaf chain. Whole leaves are counted at once, so it
+// costs one step per leaf, not per entry.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+count_t BTreeCore<Key, Params, Compare>::distance(const Handle& first, const Handle& last)
+{
+    size_type result = 0;
+    const NodeLeaf* leaf = first.m_leaf;
+    size_type index = first.m_index;
+
+    while (leaf != last.m_leaf)
+    {
+        result += leaf->count() - index;
+        leaf = leaf->next;
+        index = 0;
+    }
+
+    return result + last.m_index - index;
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <LookupKeyFor<Key, Compare> K>
+count_t BTreeCore<Key, Params, Compare>::count(const K& keyLeft, const K& keyRight) const
+{
+    const auto& kLeft = lookup_key(keyLeft);
+    const auto& kRight = lookup_key(keyRight);
+    if (!m_compare(kLeft, kRight))
+        return 0;
+
+    if constexpr (OrderStatistics)
+        return rank(kRight) - rank(kLeft);
+    else
+        return distance(lower_bound(kLeft), lower_bound(kRight));
+}
+
+// Entries under 'node'. Always 0 without 'OrderStatistics'.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+count_t BTreeCore<Key, Params, Compare>::subtree_size(const Node* node, bool isLeaf)
+{
+    if constexpr (!OrderStatistics)
+        return 0;
+    else if (isLeaf)
+        return node->count();
+    else
+        return static_cast<const NodeInternal*>(node)->total_size();
+}
+
+// ------------------------------------------------------------
+// Estadísticos de orden
+// ------------------------------------------------------------
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::Handle
+BTreeCore<Key, Params, Compare>::nth(size_type index) const
+{
+    static_assert(OrderStatistics, "BTreeCore::nth requires 'OrderStatistics'");
+
+    if (index >= m_size)
+        return {};
 
+    Node* node = m_root;
+    for (unsigned level = 0; level < m_height - 1; ++level)
+    {
+        NodeInternal* internal = static_cast<NodeInternal*>(node);
         size_type i = 0;
-        while (i < internal->count() && !(key < internal->key(i)))
+
+        while (index >= internal->child_size(i))
+        {
+            index -= internal->child_size(i);
             ++i;
+            assert(i <= internal->count());
+        }
+        node = internal->children[i];
+    }
+
+    return Handle(static_cast<NodeLeaf*>(node), index);
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <LookupKeyFor<Key, Compare> K>
+count_t BTreeCore<Key, Params, Compare>::rank(const K& key) const
+{
+    static_assert(OrderStatistics, "BTreeCore::rank requires 'OrderStatistics'");
+
+    if (m_root == nullptr)
+        return 0;
+
+    const auto& k = lookup_key(key);
+    size_type result = 0;
+    Node* node = m_root;
+
+    // The children at the left of the one which covers 'key' only hold smaller keys.
+    for (unsigned level = 0; level < m_height - 1; ++level)
+    {
+        NodeInternal* internal = static_cast<NodeInternal*>(node);
+        const size_type i = internal->upper_bound(k, m_compare);
 
+        for (size_type j = 0; j < i; ++j)
+            result += internal->child_size(j);
         node = internal->children[i];
-        ++level;
     }
 
-    NodeLeaf* leaf = static_cast<NodeLeaf*>(node);
-    for (size_type i = 0; i < leaf->count(); ++i)
+    return result + node->lower_bound(k, m_compare);
+}
+
+// ------------------------------------------------------------
+// Búsqueda por lotes
+// ------------------------------------------------------------
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <typename OutputFn>
+void BTreeCore<Key, Params, Compare>::find_batch(span<const Key> keys, OutputFn&& output) const
+{
+    const size_type count = keys.size();
+
+    if (m_root == nullptr)
     {
-        if (!(leaf->key(i) < key))
-            return Handle(leaf, i);
+        for (size_type i = 0; i < count; ++i)
+            output(i, Handle());
+        return;
     }
 
-    return Handle(leaf->next, 0);
+    // Walking the leaves only pays off if the keys are dense enough to hit most of them. Otherwise each
+    // key would load a leaf just to learn that it has to descend again.
+    if (count * Order >= m_size && std::is_sorted(keys.data(), keys.data() + count, m_compare))
+        return find_sorted(keys, output);
+
+    for (size_type first = 0; first < count; first += BatchGroupSize)
+        find_group(keys.data() + first, std::min(BatchGroupSize, count - first), first, output);
 }
 
-template <typename Key, BTreeCoreParams Params>
-typename BTreeCore<Key, Params>::Range BTreeCore<Key, Params>::range(const Key& key) const
+// Descends the tree with all the keys of the group at once. The next node of each key is prefetched
+// when it is found, and not used until the rest of the group has been processed, so the cache misses
+// of the whole group overlap instead of being paid one after another.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <typename OutputFn>
+void BTreeCore<Key, Params, Compare>::find_group(
+    const Key* keys,
+    size_type count,
+    size_type firstIndex,
+    OutputFn& output
+) const
 {
-    // TODO: Try to make a better, O(log(n)) implementation.
-    auto first = find_first(key);
-    if (!first)
-        return {};
+    assert(count <= BatchGroupSize);
+    Node* nodes[BatchGroupSize];
+
+    for (size_type i = 0; i < count; ++i)
+        nodes[i] = m_root;
+
+    for (unsigned level = 0; level < m_height - 1; ++level)
+    {
+        for (size_type i = 0; i < count; ++i)
+        {
+            NodeInternal* internal = static_cast<NodeInternal*>(nodes[i]);
+            nodes[i] = internal->children[internal->upper_bound(keys[i], m_compare)];
+            prefetch(nodes[i]);
+        }
+    }
+
+    for (size_type i = 0; i < count; ++i)
+        output(firstIndex + i, find_in_leaf(static_cast<NodeLeaf*>(nodes[i]), keys[i]));
+}
 
-    Range it(first.m_leaf, first.m_index);
+// Ascending keys mostly fall in the same leaf as the previous one, or in the next. The tree is only
+// descended again when a key skips over a whole leaf.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <typename OutputFn>
+void BTreeCore<Key, Params, Compare>::find_sorted(span<const Key> keys, OutputFn& output) const
+{
+    NodeLeaf* leaf = nullptr;
 
-    for (; !it.empty() && it.key() == key; ++it)
+    for (size_type i = 0; i < keys.size(); ++i)
     {
+        const Key& key = keys[i];
+
+        if (leaf == nullptr)
+            leaf = find_leaf(key);
+        else if (leaf->next != nullptr && m_compare(leaf->key(leaf->count() - 1), key))
+        {
+            NodeLeaf* next = leaf->next;
+            leaf = m_compare(next->key(next->count() - 1), key) ? find_leaf(key) : next;
+
+            if (leaf->next != nullptr)
+                prefetch(leaf->next);
+        }
+
+        output(i, find_in_leaf(leaf, key));
     }
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::Handle
+BTreeCore<Key, Params, Compare>::find_in_leaf(NodeLeaf* leaf, const Key& key) const
+{
+    const size_type i = leaf->lower_bound(key, m_compare);
+
+    if (i < leaf->count() && !m_compare(key, leaf->key(i)))
+        return Handle(leaf, i);
+    else
+        return {};
+}
 
-    return Range {first.m_leaf, first.m_index, it.m_leaf, it.m_index};
+// Requests the cache lines of the keys of 'node', which are the first ones to be read.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::prefetch(const Node* node)
+{
+    prefetch_bytes(node, sizeof(Node), 4);
 }
 
-template <typename Key, BTreeCoreParams Params>
-count_t BTreeCore<Key, Params>::count(const Key& key) const
+// Called by the scans when they step into 'leaf'. Every leaf boundary would be a cache miss otherwise,
+// as the hardware prefetcher cannot follow the leaf links. The leaf after the next one (in the scan
+// direction) gets its keys and links prefetched, and the next one, whose links were prefetched on the
+// previous step, gets its values, which may live in their own block with 'SeparateValues'.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::prefetch_scan_ahead(const NodeLeaf* leaf, bool forward)
 {
-    // TODO: We should aim to make an O(log(n)) implementation.
-    size_type counter = 0;
+    constexpr byte_size MaxLines = 16;
+    const NodeLeaf* next = forward ? leaf->next : leaf->prev;
+
+    if (next == nullptr)
+        return;
 
-    for (auto r = range(key); !r.empty(); ++r)
-        ++counter;
+    if constexpr (ValueSize > 0)
+        prefetch_bytes(&next->values[0], sizeof(AlignedValueStorage) * next->count(), MaxLines);
 
-    return counter;
+    if (const NodeLeaf* after = forward ? next->next : next->prev; after != nullptr)
+    {
+        const auto* linksEnd = reinterpret_cast<const char*>(&after->values) + sizeof(LeafValues);
+        prefetch_bytes(after, linksEnd - reinterpret_cast<const char*>(after), MaxLines);
+    }
+}
+
+// Requests the cache lines of [address, address + bytes), up to 'maxLines' of them.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void
+BTreeCore<Key, Params, Compare>::prefetch_bytes(
+    const void* address,
+    byte_size bytes,
+    byte_size maxLines
+)
+{
+    constexpr byte_size CacheLine = 64;
+    const char* first = reinterpret_cast<const char*>(address);
+    const byte_size lines = std::min<byte_size>((bytes + CacheLine - 1) / CacheLine, maxLines);
+
+    for (byte_size i = 0; i < lines; ++i)
+    {
+#if defined(COLL_SEARCH_SSE2)
+        _mm_prefetch(first + i * CacheLine, _MM_HINT_T0);
+#elif defined(__GNUC__)
+        __builtin_prefetch(first + i * CacheLine);
+#endif
+    }
 }
 
 // ------------------------------------------------------------
 // Buscar extremos
 // ------------------------------------------------------------
-template <typename Key, BTreeCoreParams Params>
-typename BTreeCore<Key, Params>::NodeLeaf* BTreeCore<Key, Params>::leftmost_leaf() const
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::NodeLeaf*
+BTreeCore<Key, Params, Compare>::leftmost_leaf() const
 {
     if (m_root == nullptr)
         return nullptr;
@@ -975,8 +2540,9 @@ typename BTreeCore<Key, Params>::NodeLeaf* BTreeCore<Key, Params>::leftmost_leaf
     return static_cast<NodeLeaf*>(node);
 }
 
-template <typename Key, BTreeCoreParams Params>
-typename BTreeCore<Key, Params>::NodeLeaf* BTreeCore<Key, Params>::rightmost_leaf() const
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::NodeLeaf*
+BTreeCore<Key, Params, Compare>::rightmost_leaf() const
 {
     if (m_root == nullptr)
         return nullptr;
@@ -999,8 +2565,8 @@ typename BTreeCore<Key, Params>::NodeLeaf* BTreeCore<Key, Params>::rightmost_lea
 // ------------------------------------------------------------
 // Iteración
 // ------------------------------------------------------------
-template <typename Key, BTreeCoreParams Params>
-typename BTreeCore<Key, Params>::Range BTreeCore<Key, Params>::begin() const
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::Range BTreeCore<Key, Params, Compare>::begin() const
 {
     NodeLeaf* leaf = leftmost_leaf();
     if (!leaf || leaf->count() == 0)
@@ -1008,8 +2574,8 @@ typename BTreeCore<Key, Params>::Range BTreeCore<Key, Params>::begin() const
     return Range(leaf, 0);
 }
 
-template <typename Key, BTreeCoreParams Params>
-typename BTreeCore<Key, Params>::InvRange BTreeCore<Key, Params>::rbegin() const
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::InvRange BTreeCore<Key, Params, Compare>::rbegin() const
 {
     NodeLeaf* leaf = rightmost_leaf();
     if (!leaf || leaf->count() == 0)
@@ -1017,19 +2583,186 @@ typename BTreeCore<Key, Params>::InvRange BTreeCore<Key, Params>::rbegin() const
     return InvRange(leaf, leaf->count() - 1);
 }
 
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <typename ChunkFn>
+void BTreeCore<Key, Params, Compare>::for_each_leaf_chunk(ChunkFn&& fn) const
+{
+    for (const NodeLeaf* leaf = leftmost_leaf(); leaf != nullptr; leaf = leaf->next)
+    {
+        if (leaf->count() == 0)
+            continue;
+
+        prefetch_scan_ahead(leaf, true);
+        fn(span<const Key>(leaf->keys(), leaf->count()), static_cast<const void*>(&leaf->values[0]));
+    }
+}
+
+// ------------------------------------------------------------
+// Instantáneas
+// ------------------------------------------------------------
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::Snapshot BTreeCore<Key, Params, Compare>::snapshot() const
+{
+    static_assert(Snapshots, "BTreeCore::snapshot needs 'Snapshots'");
+
+    Snapshot result(m_compare);
+
+    if (m_root != nullptr)
+    {
+        m_root->add_ref();
+        result.m_root = m_root;
+        result.m_height = m_height;
+        result.m_size = m_size;
+        result.m_alloc = m_alloc;
+    }
+    return result;
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+BTreeCore<Key, Params, Compare>::Snapshot::Snapshot(const Snapshot& rhs)
+    : m_root(rhs.m_root)
+    , m_height(rhs.m_height)
+    , m_size(rhs.m_size)
+    , m_alloc(rhs.m_alloc)
+    , m_compare(rhs.m_compare)
+{
+    if (m_root != nullptr)
+        m_root->add_ref();
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+BTreeCore<Key, Params, Compare>::Snapshot::Snapshot(Snapshot&& rhs) noexcept
+    : m_root(rhs.m_root)
+    , m_height(rhs.m_height)
+    , m_size(rhs.m_size)
+    , m_alloc(rhs.m_alloc)
+    , m_compare(rhs.m_compare)
+{
+    rhs.m_root = nullptr;
+    rhs.m_height = 0;
+    rhs.m_size = 0;
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::Snapshot&
+BTreeCore<Key, Params, Compare>::Snapshot::operator=(const Snapshot& rhs)
+{
+    if (this != &rhs)
+        *this = Snapshot(rhs);
+
+    return *this;
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::Snapshot&
+BTreeCore<Key, Params, Compare>::Snapshot::operator=(Snapshot&& rhs) noexcept
+{
+    if (this == &rhs)
+        return *this;
+
+    reset();
+
+    m_root = rhs.m_root;
+    m_height = rhs.m_height;
+    m_size = rhs.m_size;
+    m_alloc = rhs.m_alloc;
+    m_compare = rhs.m_compare;
+
+    rhs.m_root = nullptr;
+    rhs.m_height = 0;
+    rhs.m_size = 0;
+
+    return *this;
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::Snapshot::reset()
+{
+    if (m_root != nullptr)
+        release_subtree(*m_alloc, m_root, m_height - 1);
+
+    m_root = nullptr;
+    m_height = 0;
+    m_size = 0;
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <LookupKeyFor<Key, Compare> K>
+typename BTreeCore<Key, Params, Compare>::Handle
+BTreeCore<Key, Params, Compare>::Snapshot::find_first(const K& key) const
+{
+    const auto& k = lookup_key(key);
+    const Handle h = lower_bound(k);
+
+    if (!h.has_value() || m_compare(k, h.key()))
+        return {};
+    else
+        return h;
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <LookupKeyFor<Key, Compare> K>
+typename BTreeCore<Key, Params, Compare>::Handle
+BTreeCore<Key, Params, Compare>::Snapshot::lower_bound(const K& key) const
+{
+    if (m_root == nullptr)
+        return {};
+
+    const auto& k = lookup_key(key);
+    NodeLeaf* leaf = descend_to_leaf(m_root, m_height, k, m_compare);
+    const size_type i = leaf->lower_bound(k, m_compare);
+
+    if (i < leaf->count())
+        return Handle(leaf, i);
+    else
+        return Handle(next_leaf(m_root, m_height, k, m_compare), 0);
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::SnapshotRange
+BTreeCore<Key, Params, Compare>::Snapshot::begin() const
+{
+    if (m_size == 0)
+        return SnapshotRange(nullptr, 0, nullptr, 0, m_compare);
+
+    Node* node = m_root;
+    for (unsigned level = 0; level < m_height - 1; ++level)
+        node = static_cast<NodeInternal*>(node)->children[0];
+
+    return SnapshotRange(static_cast<NodeLeaf*>(node), 0, m_root, m_height, m_compare);
+}
+
 // ------------------------------------------------------------
 // Borrado con redistribución y fusión
 // ------------------------------------------------------------
 
-template <typename Key, BTreeCoreParams Params>
-bool BTreeCore<Key, Params>::erase(const Key& key)
+template <typename Key, BTreeCoreParams Params, typename Compare>
+bool BTreeCore<Key, Params, Compare>::erase(const Key& key)
 {
     if (!m_root)
         return false;
 
+    // Otherwise a missing key would copy the shared nodes of its path for nothing.
+    if constexpr (Snapshots)
+    {
+        if (!contains(key))
+            return false;
+    }
+
+    unshare_root();
     if (!erase_recursive(m_root, key, 0))
         return false;
 
+    shrink_root();
+
+    --m_size;
+    return true;
+}
+
+// Removes the root if it has been left without keys. Returns true if the root has changed.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+bool BTreeCore<Key, Params, Compare>::shrink_root()
+{
     // Si la raíz se quedó sin claves y tiene un solo hijo, lo promovemos.
     if (m_height > 1)
     {
@@ -1040,6 +2773,7 @@ bool BTreeCore<Key, Params>::erase(const Key& key)
             m_root = newRoot;
             freeNode(rootInternal);
             --m_height;
+            return true;
         }
     }
     else if (m_height == 1)
@@ -1050,76 +2784,236 @@ bool BTreeCore<Key, Params>::erase(const Key& key)
             freeNode(rootLeaf);
             m_root = nullptr;
             m_height = 0;
+            return true;
         }
     }
 
-    --m_size;
-    return true;
+    return false;
 }
 
 // ------------------------------------------------------------
 // Función auxiliar recursiva de borrado
 // ------------------------------------------------------------
 
-template <typename Key, BTreeCoreParams Params>
-bool BTreeCore<Key, Params>::erase_recursive(Node* node, const Key& key, unsigned level)
+template <typename Key, BTreeCoreParams Params, typename Compare>
+bool BTreeCore<Key, Params, Compare>::erase_recursive(Node* node, const Key& key, unsigned level)
 {
     if (level == m_height - 1)
         return erase_from_leaf(static_cast<NodeLeaf*>(node), key);
 
     NodeInternal* internal = static_cast<NodeInternal*>(node);
-    size_type i = 0;
-    while (i < internal->count() && !(key < internal->key(i)))
-        ++i;
+    const size_type i = internal->upper_bound(key, m_compare);
 
-    bool erased = erase_recursive(internal->children[i], key, level + 1);
+    bool erased = erase_recursive(unshare_child(internal, i, level + 1), key, level + 1);
     if (!erased)
         return false;
 
+    internal->set_child_size(i, internal->child_size(i) - 1);
     fix_underflow(internal, i, level);
     return true;
 }
 
 // ------------------------------------------------------------
-// Borrado dentro de una hoja
+// Borrado de rangos
 // ------------------------------------------------------------
 
-template <typename Key, BTreeCoreParams Params>
-bool BTreeCore<Key, Params>::erase_from_leaf(NodeLeaf* leaf, const Key& key)
+template <typename Key, BTreeCoreParams Params, typename Compare>
+count_t BTreeCore<Key, Params, Compare>::erase_range(const Key& keyLeft, const Key& keyRight)
 {
-    size_type i = 0;
-    while (i < leaf->count() && leaf->key(i) < key)
-        ++i;
+    const size_type erased = count(keyLeft, keyRight);
 
-    if (i == leaf->count() || leaf->key(i) != key)
-        return false;
+    if (erased == 0)
+        return 0;
+    if (erased == m_size)
+    {
+        clear();
+        return erased;
+    }
 
-    leaf->remove(i);
+    // The leaves just before and after the range are found before the paths to both ends are modified,
+    // and linked to each other at the end. They keep some entries, so they are not freed meanwhile.
+    NodeLeaf* firstLeaf = unshare_path(keyLeft);
+    NodeLeaf* lastLeaf = unshare_path(keyRight);
+    NodeLeaf* before = firstLeaf->lower_bound(keyLeft, m_compare) > 0 ? firstLeaf : firstLeaf->prev;
+    NodeLeaf* after =
+        lastLeaf->lower_bound(keyRight, m_compare) < lastLeaf->count() ? lastLeaf : lastLeaf->next;
 
-    return true;
-}
+    erase_range_recursive(m_root, 0, &keyLeft, &keyRight);
 
-// ------------------------------------------------------------
-// Corrección de underflow (redistribución o fusión)
-// ------------------------------------------------------------
+    if (before != nullptr)
+        before->next = after;
+    if (after != nullptr)
+        after->prev = before;
 
-template <typename Key, BTreeCoreParams Params>
-void BTreeCore<Key, Params>::fix_underflow(NodeInternal* parent, size_type idx, unsigned level)
+    m_size -= erased;
+
+    repair_path(keyLeft);
+    repair_path(keyRight);
+
+    return erased;
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+count_t BTreeCore<Key, Params, Compare>::erase_prefix(const Key& key)
 {
-    Node* child = parent->children[idx];
-    bool isLeaf = (level == m_height - 2);
+    if (m_root == nullptr)
+        return 0;
 
-    // Si el nodo no está por debajo del mínimo, no hacemos nada
-    size_type minKeys = (Order + 1) / 2 - 1;
-    if (child->count() >= minKeys)
-        return;
+    // Copied, as the leaf which holds it may be freed.
+    const Key first = leftmost_leaf()->key(0);
 
-    Node* leftSibling = (idx > 0) ? parent->children[idx - 1] : nullptr;
-    Node* rightSibling = (idx + 1 <= parent->count()) ? parent->children[idx + 1] : nullptr;
+    return m_compare(first, key) ? erase_range(first, key) : 0;
+}
 
-    // Intentar redistribuir
-    if (leftSibling && leftSibling->count() > minKeys)
+// Unshares the path to 'key', and returns its leaf.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::NodeLeaf*
+BTreeCore<Key, Params, Compare>::unshare_path(const Key& key)
+{
+    unshare_root();
+
+    Node* node = m_root;
+    for (unsigned level = 0; level + 1 < m_height; ++level)
     {
+        NodeInternal* internal = static_cast<NodeInternal*>(node);
+        node = unshare_child(internal, internal->upper_bound(key, m_compare), level + 1);
+    }
+
+    return static_cast<NodeLeaf*>(node);
+}
+
+// Erases the entries in [keyLeft, keyRight) under 'node', which must not be shared. A null bound means
+// that all the keys under 'node' are on that side of it. The children entirely inside the range are
+// freed whole, and those at its ends are processed recursively, on the paths to 'keyLeft' and
+// 'keyRight'. Emptied children are freed, so nodes may be left with any number of keys, but not empty,
+// unless the result says so. The leaf chain is left for the caller to fix.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::RangeErase
+BTreeCore<Key, Params, Compare>::erase_range_recursive(
+    Node* node,
+    unsigned level,
+    const Key* keyLeft,
+    const Key* keyRight
+)
+{
+    if (level == m_height - 1)
+    {
+        NodeLeaf* leaf = static_cast<NodeLeaf*>(node);
+        const size_type first = keyLeft != nullptr ? leaf->lower_bound(*keyLeft, m_compare) : 0;
+        const size_type last =
+            keyRight != nullptr ? leaf->lower_bound(*keyRight, m_compare) : leaf->count();
+
+        leaf->remove_range(first, last);
+        return {last - first, leaf->count() == 0};
+    }
+
+    NodeInternal* internal = static_cast<NodeInternal*>(node);
+    const size_type first = keyLeft != nullptr ? internal->upper_bound(*keyLeft, m_compare) : 0;
+    const size_type last =
+        keyRight != nullptr ? internal->upper_bound(*keyRight, m_compare) : internal->count();
+    size_type erased = 0;
+
+    // Children processed recursively, the right end first, so that the index of the left one does not
+    // change. All the keys under each end are on the inner side of the other bound.
+    struct End
+    {
+        size_type index;
+        const Key* keyLeft;
+        const Key* keyRight;
+    };
+    End ends[2];
+    unsigned endCount = 0;
+
+    if (keyLeft != nullptr && keyRight != nullptr && first == last)
+        ends[endCount++] = {first, keyLeft, keyRight};
+    else
+    {
+        const size_type coveredFirst = keyLeft != nullptr ? first + 1 : first;
+        const size_type coveredLast = keyRight != nullptr ? last : last + 1;
+
+        for (size_type i = coveredFirst; i < coveredLast; ++i)
+        {
+            erased += internal->child_size(i);
+            delete_subtree(internal->children[i], level + 1);
+        }
+        internal->remove_children(coveredFirst, coveredLast);
+
+        if (keyRight != nullptr)
+            ends[endCount++] = {coveredFirst, nullptr, keyRight};
+        if (keyLeft != nullptr)
+            ends[endCount++] = {first, keyLeft, nullptr};
+    }
+
+    for (unsigned e = 0; e < endCount; ++e)
+    {
+        const End& end = ends[e];
+        const size_type i = end.index;
+        Node* child = unshare_child(internal, i, level + 1);
+        const RangeErase result = erase_range_recursive(child, level + 1, end.keyLeft, end.keyRight);
+
+        erased += result.erased;
+        if (!result.empty)
+        {
+            internal->set_child_size(i, internal->child_size(i) - result.erased);
+            continue;
+        }
+
+        if (level + 2 == m_height)
+            freeNode(static_cast<NodeLeaf*>(child));
+        else
+            freeNode(static_cast<NodeInternal*>(child));
+
+        if (internal->count() == 0)
+            return {erased, true};
+        else if (i < internal->count())
+            internal->remove_left(i);
+        else
+            internal->remove_right(i - 1);
+    }
+
+    return {erased, false};
+}
+
+// ------------------------------------------------------------
+// Borrado dentro de una hoja
+// ------------------------------------------------------------
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+bool BTreeCore<Key, Params, Compare>::erase_from_leaf(NodeLeaf* leaf, const Key& key)
+{
+    const size_type i = leaf->lower_bound(key, m_compare);
+
+    if (i == leaf->count() || m_compare(key, leaf->key(i)))
+        return false;
+
+    leaf->remove(i);
+
+    return true;
+}
+
+// ------------------------------------------------------------
+// Corrección de underflow (redistribución o fusión)
+// ------------------------------------------------------------
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void
+BTreeCore<Key, Params, Compare>::fix_underflow(NodeInternal* parent, size_type idx, unsigned level)
+{
+    Node* child = parent->children[idx];
+    bool isLeaf = (level == m_height - 2);
+
+    // Si el nodo no está por debajo del mínimo, no hacemos nada
+    const size_type minKeys = MinKeys;
+    if (child->count() >= minKeys)
+        return;
+
+    Node* leftSibling = (idx > 0) ? parent->children[idx - 1] : nullptr;
+    Node* rightSibling = (idx + 1 <= parent->count()) ? parent->children[idx + 1] : nullptr;
+
+    // Intentar redistribuir. El hermano que cambia puede estar compartido con una instantánea.
+    if (leftSibling && leftSibling->count() > minKeys)
+    {
+        leftSibling = unshare_child(parent, idx - 1, level + 1);
         if (isLeaf)
             rotate_right_leaf(parent, idx - 1);
         else
@@ -1134,6 +3028,7 @@ void BTreeCore<Key, Params>::fix_underflow(NodeInternal* parent, size_type idx,
     }
     else if (rightSibling && rightSibling->count() > minKeys)
     {
+        rightSibling = unshare_child(parent, idx + 1, level + 1);
         if (isLeaf)
             rotate_left_leaf(parent, idx);
         else
@@ -1151,6 +3046,7 @@ void BTreeCore<Key, Params>::fix_underflow(NodeInternal* parent, size_type idx,
         // Si no se puede redistribuir, fusionar
         if (leftSibling)
         {
+            unshare_child(parent, idx - 1, level + 1);
             if (isLeaf)
                 merge_leaf(parent, idx - 1);
             else
@@ -1158,6 +3054,7 @@ void BTreeCore<Key, Params>::fix_underflow(NodeInternal* parent, size_type idx,
         }
         else if (rightSibling)
         {
+            unshare_child(parent, idx + 1, level + 1);
             if (isLeaf)
                 merge_leaf(parent, idx);
             else
@@ -1170,29 +3067,31 @@ void BTreeCore<Key, Params>::fix_underflow(NodeInternal* parent, size_type idx,
 // Redistribución entre hojas
 // ------------------------------------------------------------
 
-template <typename Key, BTreeCoreParams Params>
-void BTreeCore<Key, Params>::rotate_left_leaf(NodeInternal* parent, size_type parentIndex)
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::rotate_left_leaf(NodeInternal* parent, size_type parentIndex)
 {
     NodeLeaf* right = static_cast<NodeLeaf*>(parent->children[parentIndex + 1]);
     right->rotate_left();
     parent->change_key(parentIndex, right->key(0));
+    parent->move_size(parentIndex + 1, parentIndex, 1);
 }
 
-template <typename Key, BTreeCoreParams Params>
-void BTreeCore<Key, Params>::rotate_right_leaf(NodeInternal* parent, size_type parentIndex)
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::rotate_right_leaf(NodeInternal* parent, size_type parentIndex)
 {
     NodeLeaf* left = static_cast<NodeLeaf*>(parent->children[parentIndex]);
     NodeLeaf* right = static_cast<NodeLeaf*>(parent->children[parentIndex + 1]);
     left->rotate_right();
     parent->change_key(parentIndex, right->key(0));
+    parent->move_size(parentIndex, parentIndex + 1, 1);
 }
 
 // ------------------------------------------------------------
 // Redistribución entre nodos internos
 // ------------------------------------------------------------
 
-template <typename Key, BTreeCoreParams Params>
-void BTreeCore<Key, Params>::rotate_left_internal(
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::rotate_left_internal(
     NodeInternal* left,
     NodeInternal* right,
     NodeInternal* parent,
@@ -1201,13 +3100,16 @@ void BTreeCore<Key, Params>::rotate_left_internal(
 {
     assert(right->count() > 1);
 
-    left->add(parent->key(parentIndex), right->children[0]);
+    const size_type moved = right->child_size(0);
+
+    left->add(parent->key(parentIndex), right->children[0], moved);
     parent->change_key(parentIndex, right->key(0));
+    parent->move_size(parentIndex + 1, parentIndex, moved);
     right->remove_left(0);
 }
 
-template <typename Key, BTreeCoreParams Params>
-void BTreeCore<Key, Params>::rotate_right_internal(
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::rotate_right_internal(
     NodeInternal* left,
     NodeInternal* right,
     NodeInternal* parent,
@@ -1216,8 +3118,11 @@ void BTreeCore<Key, Params>::rotate_right_internal(
 {
     assert(left->count() > 1);
 
-    right->insert_left(0, left->children[left->count()], parent->key(parentIndex));
+    const size_type moved = left->child_size(left->count());
+
+    right->insert_left(0, left->children[left->count()], parent->key(parentIndex), moved);
     parent->change_key(parentIndex, left->key(left->count() - 1));
+    parent->move_size(parentIndex, parentIndex + 1, moved);
     left->remove_right(left->count() - 1);
 }
 
@@ -1225,26 +3130,769 @@ void BTreeCore<Key, Params>::rotate_right_internal(
 // Fusión de nodos
 // ------------------------------------------------------------
 
-template <typename Key, BTreeCoreParams Params>
-void BTreeCore<Key, Params>::merge_leaf(NodeInternal* parent, size_type parentIndex)
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::merge_leaf(NodeInternal* parent, size_type parentIndex)
 {
     auto* left = static_cast<NodeLeaf*>(parent->children[parentIndex]);
 
     auto* right = left->merge_right();
     freeNode(right);
 
+    parent->move_size(parentIndex + 1, parentIndex, parent->child_size(parentIndex + 1));
     parent->remove_right(parentIndex);
 }
 
-template <typename Key, BTreeCoreParams Params>
-void BTreeCore<Key, Params>::merge_internal(NodeInternal* parent, size_type parentIndex)
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::merge_internal(NodeInternal* parent, size_type parentIndex)
 {
     auto* left = static_cast<NodeInternal*>(parent->children[parentIndex]);
     auto* right = static_cast<NodeInternal*>(parent->children[parentIndex + 1]);
 
     left->merge(right, parent->key(parentIndex));
+    parent->move_size(parentIndex + 1, parentIndex, parent->child_size(parentIndex + 1));
     parent->remove_right(parentIndex);
 
     freeNode(right);
 }
-} // namespace coll
\ No newline at end of file
+
+// ------------------------------------------------------------
+// División y unión de árboles
+// ------------------------------------------------------------
+template <typename Key, BTreeCoreParams Params, typename Compare>
+BTreeCore<Key, Params, Compare> BTreeCore<Key, Params, Compare>::split_at(const Key& key)
+{
+    BTreeCore right = sharing_pools();
+
+    if (m_root == nullptr)
+        return right;
+
+    // The path is unshared, and the nodes which may be needed are created, before changing anything.
+    Node* path[MaxHeight];
+    size_type indices[MaxHeight];
+    const unsigned leafLevel = m_height - 1;
+
+    unshare_root();
+    path[0] = m_root;
+    for (unsigned level = 0; level < leafLevel; ++level)
+    {
+        NodeInternal* internal = static_cast<NodeInternal*>(path[level]);
+        indices[level] = internal->upper_bound(key, m_compare);
+        path[level + 1] = unshare_child(internal, indices[level], level + 1);
+    }
+
+    NodeLeaf* spareLeaf = createNode<NodeLeaf>();
+    NodeInternal* spares[MaxHeight];
+    unsigned spareCount = 0;
+
+    try
+    {
+        for (; spareCount < leafLevel; ++spareCount)
+            spares[spareCount] = createNode<NodeInternal>();
+    }
+    catch (...)
+    {
+        while (spareCount > 0)
+            freeNode(spares[--spareCount]);
+        freeNode(spareLeaf);
+        throw;
+    }
+
+    // The leaf of the path is cut at 'key', and so is the leaf chain.
+    NodeLeaf* leaf = static_cast<NodeLeaf*>(path[leafLevel]);
+    const size_type cut = leaf->lower_bound(key, m_compare);
+    Node* leftPart = cut > 0 ? leaf : nullptr;
+    Node* rightPart = cut == 0 ? leaf : nullptr;
+    NodeLeaf* leftLast = cut > 0 ? leaf : leaf->prev;
+    NodeLeaf* rightFirst = cut == 0 ? leaf : leaf->next;
+
+    if (cut > 0 && cut < leaf->count())
+    {
+        leaf->move_tail(cut, spareLeaf);
+        spareLeaf->next = leaf->next;
+        if (spareLeaf->next != nullptr)
+            spareLeaf->next->prev = spareLeaf;
+
+        rightPart = rightFirst = spareLeaf;
+        spareLeaf = nullptr;
+    }
+
+    if (leftLast != nullptr)
+        leftLast->next = nullptr;
+    if (rightFirst != nullptr)
+        rightFirst->prev = nullptr;
+
+    // Then each node of the path, bottom-up. The left part keeps the node, with the left part of the
+    // child on the path as its last child. The right part gets a new node, starting with the right part
+    // of that child. Empty parts are dropped. Sizes are only counted with 'OrderStatistics'.
+    size_type leftSize = cut;
+    size_type rightSize = rightPart != nullptr ? rightPart->count() : 0;
+
+    for (unsigned level = leafLevel; level-- > 0;)
+    {
+        NodeInternal* node = static_cast<NodeInternal*>(path[level]);
+        const size_type i = indices[level];
+        size_type nodeLeftSize = leftSize;
+        size_type nodeRightSize = rightSize;
+
+        for (size_type j = 0; j < i; ++j)
+            nodeLeftSize += node->child_size(j);
+        for (size_type j = i + 1; j <= node->count(); ++j)
+            nodeRightSize += node->child_size(j);
+
+        const bool hasLeft = i > 0 || leftPart != nullptr;
+        const bool hasRight = i < node->count() || rightPart != nullptr;
+        NodeInternal* rightNode = nullptr;
+
+        if (!hasLeft)
+        {
+            rightNode = node;
+            if (rightPart != nullptr)
+            {
+                node->children[0] = rightPart;
+                node->set_child_size(0, rightSize);
+            }
+            else
+                node->remove_left(0);
+        }
+        else
+        {
+            if (hasRight)
+            {
+                rightNode = spares[--spareCount];
+                size_type first = i + 1;
+
+                if (rightPart != nullptr)
+                {
+                    rightNode->children[0] = rightPart;
+                    rightNode->set_child_size(0, rightSize);
+                    first = i;
+                }
+                else
+                {
+                    rightNode->children[0] = node->children[i + 1];
+                    rightNode->set_child_size(0, node->child_size(i + 1));
+                }
+
+                for (size_type k = first; k < node->count(); ++k)
+                    rightNode->add(node->key(k), node->children[k + 1], node->child_size(k + 1));
+            }
+
+            if (leftPart != nullptr)
+            {
+                node->children[i] = leftPart;
+                node->set_child_size(i, leftSize);
+                node->truncate(i);
+            }
+            else
+                node->truncate(i - 1);
+        }
+
+        leftPart = hasLeft ? node : nullptr;
+        rightPart = rightNode;
+        leftSize = nodeLeftSize;
+        rightSize = nodeRightSize;
+    }
+
+    while (spareCount > 0)
+        freeNode(spares[--spareCount]);
+    freeNode(spareLeaf);
+
+    if constexpr (!OrderStatistics)
+    {
+        leftSize = count_left_side(leftLast, rightFirst, m_size);
+        rightSize = m_size - leftSize;
+    }
+
+    right.m_root = rightPart;
+    right.m_height = rightPart != nullptr ? m_height : 0;
+    right.m_size = rightSize;
+
+    m_root = leftPart;
+    m_height = leftPart != nullptr ? m_height : 0;
+    m_size = leftSize;
+
+    // Only the nodes on the path to 'key' may be below the minimum now, on both sides.
+    repair_path(key);
+    right.repair_path(key);
+
+    return right;
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::join(BTreeCore&& rhs)
+{
+    if (this == &rhs || rhs.m_root == nullptr)
+        return;
+
+    if (m_root != nullptr)
+    {
+        const NodeLeaf* last = rightmost_leaf();
+
+        if (!m_compare(last->key(last->count() - 1), rhs.leftmost_leaf()->key(0)))
+            throw std::invalid_argument("BTreeCore::join: keys must be greater than those of the tree");
+    }
+
+    adopt_nodes(rhs);
+
+    // Splits along the spine, and a new root, cannot fail halfway.
+    reserve_nodes<NodeInternal>(std::max(m_height, rhs.m_height) + 1);
+
+    Node* root = rhs.m_root;
+    NodeLeaf* first = rhs.leftmost_leaf();
+    const unsigned height = rhs.m_height;
+    const size_type size = rhs.m_size;
+
+    rhs.m_root = nullptr;
+    rhs.m_height = 0;
+    rhs.m_size = 0;
+
+    if (m_root == nullptr)
+    {
+        m_root = root;
+        m_height = height;
+        m_size = size;
+        return;
+    }
+
+    NodeLeaf* last = rightmost_leaf();
+    last->next = first;
+    first->prev = last;
+
+    const Key separator = first->key(0);
+    const size_type leftSize = m_size;
+
+    if (m_height == height)
+    {
+        SplitInternalResult halves {m_root, root, separator, leftSize, size};
+        grow_root(halves);
+
+        NodeInternal* newRoot = static_cast<NodeInternal*>(m_root);
+        refill_child(newRoot, 0, 0);
+        if (newRoot->count() > 0)
+            refill_child(newRoot, 1, 0);
+        shrink_root();
+    }
+    else if (m_height > height)
+        graft_spine(Graft {root, size, separator, m_height - height - 1, true});
+    else
+    {
+        Node* left = m_root;
+        const unsigned leftHeight = m_height;
+
+        m_root = root;
+        m_height = height;
+        graft_spine(Graft {left, leftSize, separator, height - leftHeight - 1, false});
+    }
+
+    m_size = leftSize + size;
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::graft_spine(const Graft& graft)
+{
+    unshare_root();
+
+    auto split = graft_into(static_cast<NodeInternal*>(m_root), 0, graft);
+    if (split.has_value())
+        grow_root(*split);
+}
+
+// Hangs 'graft.root' below the spine node at 'level' ('node') or its descendants. The grafted root may
+// have any number of keys, so it is refilled from its new sibling. Returns the split of 'node' if it
+// fills up, as in an insertion.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+std::optional<typename BTreeCore<Key, Params, Compare>::SplitInternalResult>
+BTreeCore<Key, Params, Compare>::graft_into(NodeInternal* node, unsigned level, const Graft& graft)
+{
+    if (level == graft.parentLevel)
+    {
+        if (graft.atRight)
+            node->add(graft.separator, graft.root, graft.size);
+        else
+            node->insert_left(0, graft.root, graft.separator, graft.size);
+
+        refill_child(node, graft.atRight ? node->count() : 0, level);
+
+        if (node->count() < Order)
+            return std::nullopt;
+        else
+            return split_internal(node);
+    }
+
+    const size_type index = graft.atRight ? node->count() : 0;
+    NodeInternal* child = static_cast<NodeInternal*>(unshare_child(node, index, level + 1));
+    InsertResultInternal result {};
+
+    result.split = graft_into(child, level + 1, graft);
+    if (result.split.has_value())
+        absorb_split(node, index, result);
+    else
+        node->set_child_size(index, node->child_size(index) + graft.size);
+
+    return result.split;
+}
+
+// Rotates entries into child 'idx' of 'parent' from its siblings until it has 'MinKeys' keys, or
+// merges it with one of them. Unlike after an erase, the child may be several keys short.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void
+BTreeCore<Key, Params, Compare>::refill_child(NodeInternal* parent, size_type idx, unsigned level)
+{
+    const Node* child = unshare_child(parent, idx, level + 1);
+
+    while (child->count() < MinKeys && parent->count() > 0)
+    {
+        const size_type parentCount = parent->count();
+
+        fix_underflow(parent, idx, level);
+        if (parent->count() < parentCount)
+            return;
+    }
+}
+
+// Restores the minimum fill of the nodes on the path to 'key', which may have any number of keys (or
+// none, if internal) while the rest of the tree is valid. Each pass refills the path top-down, but
+// merges take a key from the parent, which may leave it short again, so passes are repeated until
+// nothing changes. Each one makes the path valid from one more level up, so there are O(height).
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::repair_path(const Key& key)
+{
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+
+        unshare_root();
+        while (shrink_root())
+            unshare_root();
+
+        Node* node = m_root;
+        for (unsigned level = 0; level + 1 < m_height; ++level)
+        {
+            NodeInternal* parent = static_cast<NodeInternal*>(node);
+            const size_type idx = parent->upper_bound(key, m_compare);
+
+            if (parent->children[idx]->count() < MinKeys && parent->count() > 0)
+            {
+                refill_child(parent, idx, level);
+                changed = true;
+            }
+
+            node = unshare_child(parent, parent->upper_bound(key, m_compare), level + 1);
+        }
+    }
+}
+
+// Entries of the left one of two trees whose leaf chains end at 'leftLast' / start at 'rightFirst', and
+// whose sizes add up to 'total'. Both chains are walked outwards at the same time, so it costs one step
+// per leaf of the smaller tree.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+count_t BTreeCore<Key, Params, Compare>::count_left_side(
+    const NodeLeaf* leftLast,
+    const NodeLeaf* rightFirst,
+    size_type total
+)
+{
+    size_type left = 0;
+    size_type right = 0;
+
+    while (leftLast != nullptr && rightFirst != nullptr)
+    {
+        left += leftLast->count();
+        right += rightFirst->count();
+        leftLast = leftLast->prev;
+        rightFirst = rightFirst->next;
+    }
+
+    return leftLast == nullptr ? left : total - right;
+}
+
+// ------------------------------------------------------------
+// Carga masiva
+// ------------------------------------------------------------
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+BTreeCore<Key, Params, Compare>::BulkLoader::BulkLoader(BTreeCore& core, float fillFactor)
+    : m_core(core)
+    , m_leafFill(fill_count(fillFactor, MinKeys + 1, Order))
+    , m_childrenFill(fill_count(fillFactor, MinKeys + 2, Order))
+{
+    m_core.clear();
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+template <typename ConstructFn>
+bool
+BTreeCore<Key, Params, Compare>::BulkLoader::append(const Key& key, ConstructFn&& constructValue)
+{
+    // The last leaf is empty if the first value built on it threw.
+    if (m_last != nullptr && m_last->count() > 0)
+    {
+        const Key& lastKey = m_last->key(m_last->count() - 1);
+
+        if (m_core.m_compare(key, lastKey))
+            throw std::invalid_argument("BTreeCore::BulkLoader: keys are not in ascending order");
+        if (!m_core.m_compare(lastKey, key))
+            return false;
+    }
+
+    if (m_last == nullptr || m_last->count() >= m_leafFill)
+    {
+        NodeLeaf* leaf = m_core.template createNode<NodeLeaf>();
+
+        if (m_last != nullptr)
+            leaf->insert_after(m_last);
+        else
+            m_first = leaf;
+
+        m_last = leaf;
+        ++m_leafCount;
+    }
+
+    m_last->append(key, std::forward<ConstructFn>(constructValue));
+    ++m_size;
+    return true;
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::BulkLoader::finish()
+{
+    // The loader shares the node pools with the tree, so the tree cannot be cleared here. It is only
+    // non empty if the loader is reused after a previous 'finish'.
+    if (m_core.m_root != nullptr)
+    {
+        m_core.delete_subtree(m_core.m_root, 0);
+        m_core.m_root = nullptr;
+        m_core.m_height = 0;
+        m_core.m_size = 0;
+    }
+
+    if (m_first == nullptr)
+        return;
+
+    balance_last_leaf();
+
+    // All the memory needed to track the nodes is reserved up front, so only node allocation can
+    // fail while building the levels. Each internal node has at least two children, so there are
+    // fewer internal nodes than leaves.
+    darray<Node*> level(m_core.allocator());
+    darray<Node*> created(m_core.allocator());
+    level.reserve(m_leafCount);
+    created.reserve(m_leafCount);
+
+    for (NodeLeaf* leaf = m_first; leaf != nullptr; leaf = leaf->next)
+        level.push_back(leaf);
+
+    unsigned height = 1;
+    try
+    {
+        for (; level.size() > 1; ++height)
+            build_level(level, height, created);
+    }
+    catch (...)
+    {
+        for (Node* node : created)
+            m_core.freeNode(static_cast<NodeInternal*>(node));
+        throw;
+    }
+
+    m_core.m_root = level[0];
+    m_core.m_height = height;
+    m_core.m_size = m_size;
+
+    m_first = nullptr;
+    m_last = nullptr;
+    m_size = 0;
+    m_leafCount = 0;
+}
+
+// The last leaf may be almost empty. It is merged with its left sibling if both fit in one leaf, or
+// both share their entries evenly otherwise.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::BulkLoader::balance_last_leaf()
+{
+    NodeLeaf* left = m_last->prev;
+
+    if (left == nullptr || m_last->count() >= MinKeys + 1)
+        return;
+
+    if (left->count() + m_last->count() <= Order)
+    {
+        m_core.freeNode(left->merge_right());
+        m_last = left;
+        --m_leafCount;
+    }
+    else
+    {
+        while (left->count() > m_last->count() + 1)
+            left->rotate_right();
+    }
+}
+
+// Groups the nodes of 'level' (whose height is 'childHeight') under new internal nodes, which
+// replace them in 'level'. The last two nodes of the new level share their children evenly, so none
+// of them is left below the minimum.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::BulkLoader::build_level(
+    darray<Node*>& level,
+    unsigned childHeight,
+    darray<Node*>& created
+)
+{
+    const size_type total = level.size();
+    size_type parentCount = 0;
+
+    for (size_type i = 0; i < total;)
+    {
+        size_type count = std::min(m_childrenFill, total - i);
+        const size_type rest = total - i - count;
+
+        if (rest > 0 && rest < MinKeys + 1)
+        {
+            const size_type both = count + rest;
+            count = both <= Order ? both : both / 2;
+        }
+
+        const bool isLeaf = childHeight == 1;
+        NodeInternal* node =
+            m_core.template createNode<NodeInternal>(level[i], subtree_size(level[i], isLeaf));
+        created.push_back(node);
+
+        for (size_type j = 1; j < count; ++j)
+        {
+            Node* child = level[i + j];
+            node->add(first_key(child, childHeight), child, subtree_size(child, isLeaf));
+        }
+
+        // Parents are always behind their children in 'level', so it can be overwritten.
+        level[parentCount++] = node;
+        i += count;
+    }
+
+    level.resize(parentCount);
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::BulkLoader::discard()
+{
+    for (NodeLeaf* leaf = m_first; leaf != nullptr;)
+    {
+        NodeLeaf* next = leaf->next;
+
+        if constexpr (Params.DestroyValueFn != nullptr)
+        {
+            for (size_type i = 0; i < leaf->count(); ++i)
+                Params.DestroyValueFn(leaf->values[i].data);
+        }
+
+        m_core.freeNode(leaf);
+        leaf = next;
+    }
+
+    m_first = nullptr;
+    m_last = nullptr;
+    m_size = 0;
+    m_leafCount = 0;
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::size_type
+BTreeCore<Key, Params, Compare>::BulkLoader::fill_count(
+    float fillFactor,
+    size_type minCount,
+    size_type maxCount
+)
+{
+    fillFactor = std::clamp(fillFactor, 0.0f, 1.0f);
+
+    const auto count = size_type(float(maxCount) * fillFactor + 0.5f);
+    return std::clamp(count, std::min(minCount, maxCount), maxCount);
+}
+
+// First key of the subtree rooted at 'node', whose height is 'height' (1 for leaves).
+template <typename Key, BTreeCoreParams Params, typename Compare>
+const Key& BTreeCore<Key, Params, Compare>::BulkLoader::first_key(const Node* node, unsigned height)
+{
+    for (; height > 1; --height)
+        node = static_cast<const NodeInternal*>(node)->children[0];
+
+    return node->key(0);
+}
+
+// ------------------------------------------------------------
+// Cursor de modificaciones ordenadas
+// ------------------------------------------------------------
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::InsertResult
+BTreeCore<Key, Params, Compare>::SortedCursor::insert(const Key& key)
+{
+    if (m_core.m_root == nullptr)
+    {
+        m_core.createInitialRootIfNeeded();
+        m_valid = false;
+    }
+
+    NodeLeaf* leaf = locate(key);
+    auto result = m_core.insert_at_leaf(leaf, key);
+
+    // Counted before absorbing the splits, which set the exact sizes of the nodes they create.
+    if (result.newEntry)
+        update_path_sizes(true);
+
+    if (result.split.has_value())
+    {
+        unsigned level = leaf_level();
+        while (result.split.has_value() && level > 0)
+        {
+            --level;
+            m_core.absorb_split(static_cast<NodeInternal*>(m_path[level]), m_indices[level], result);
+        }
+
+        if (result.split.has_value())
+        {
+            m_core.grow_root(*result.split);
+            m_path[0] = m_core.m_root;
+        }
+
+        descend(level, key);
+    }
+
+    if (result.newEntry)
+        ++m_core.m_size;
+
+    return result;
+}
+
+template <typename Key, BTreeCoreParams Params, typename Compare>
+bool BTreeCore<Key, Params, Compare>::SortedCursor::erase(const Key& key)
+{
+    if (m_core.m_root == nullptr)
+        return false;
+
+    NodeLeaf* leaf = locate(key);
+    if (!m_core.erase_from_leaf(leaf, key))
+        return false;
+
+    --m_core.m_size;
+    update_path_sizes(false);
+
+    // Only the nodes of the path can underflow, and only while their children do.
+    const unsigned leafLevel = leaf_level();
+    unsigned level = leafLevel;
+    while (level > 0 && m_path[level]->count() < MinKeys)
+    {
+        --level;
+        m_core.fix_underflow(static_cast<NodeInternal*>(m_path[level]), m_indices[level], level);
+    }
+
+    if (m_core.shrink_root())
+    {
+        if (m_core.m_root == nullptr)
+        {
+            m_valid = false;
+            return true;
+        }
+
+        level = 0;
+        m_path[0] = m_core.m_root;
+    }
+
+    if (level < leafLevel)
+        descend(level, key);
+
+    return true;
+}
+
+// Leaf which would contain 'key', updating the path to reach it. The tree must not be empty.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::NodeLeaf*
+BTreeCore<Key, Params, Compare>::SortedCursor::locate(const Key& key)
+{
+    if (!m_valid)
+    {
+        m_core.unshare_root();
+        m_path[0] = m_core.m_root;
+        m_valid = true;
+        return descend(0, key);
+    }
+
+    const unsigned level = lowest_covering_level(key);
+    if (level == leaf_level())
+        return static_cast<NodeLeaf*>(m_path[level]);
+    else
+        return descend(level, key);
+}
+
+// Rebuilds the path below 'level', following 'key'.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+typename BTreeCore<Key, Params, Compare>::NodeLeaf*
+BTreeCore<Key, Params, Compare>::SortedCursor::descend(unsigned level, const Key& key)
+{
+    for (; level < leaf_level(); ++level)
+    {
+        NodeInternal* internal = static_cast<NodeInternal*>(m_path[level]);
+        m_indices[level] = internal->upper_bound(key, m_core.m_compare);
+        m_path[level + 1] = m_core.unshare_child(internal, m_indices[level], level + 1);
+    }
+
+    return static_cast<NodeLeaf*>(m_path[leaf_level()]);
+}
+
+// Counts an entry added to / removed from the leaf of the path in the child sizes along the path.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+void BTreeCore<Key, Params, Compare>::SortedCursor::update_path_sizes(bool added)
+{
+    if constexpr (OrderStatistics)
+    {
+        for (unsigned level = 0; level < leaf_level(); ++level)
+        {
+            NodeInternal* node = static_cast<NodeInternal*>(m_path[level]);
+            const size_type index = m_indices[level];
+
+            const size_type size = node->child_size(index);
+
+            node->set_child_size(index, added ? size + 1 : size - 1);
+        }
+    }
+}
+
+// Level of the deepest node of the path whose key range contains 'key'. The range of a node is bounded
+// on each side by the nearest ancestor which has a separator on that side, so the path is climbed
+// until both sides have been checked.
+template <typename Key, BTreeCoreParams Params, typename Compare>
+unsigned BTreeCore<Key, Params, Compare>::SortedCursor::lowest_covering_level(const Key& key) const
+{
+    unsigned result = leaf_level();
+    bool lowChecked = false;
+    bool highChecked = false;
+
+    for (unsigned level = result; level-- > 0 && !(lowChecked && highChecked);)
+    {
+        const Node* node = m_path[level];
+        const size_type index = m_indices[level];
+        bool inside = true;
+
+        if (!lowChecked && index > 0)
+        {
+            lowChecked = true;
+            inside = !m_core.m_compare(key, node->key(index - 1));
+        }
+
+        if (!highChecked && index < node->count())
+        {
+            highChecked = true;
+            inside = inside && m_core.m_compare(key, node->key(index));
+        }
+
+        // 'key' is out of the child. Check the range of this node instead.
+        if (!inside)
+        {
+            result = level;
+            lowChecked = false;
+            highChecked = false;
+        }
+    }
+
+    return result;
+}
+} // namespace coll
@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2026 Guillermo Hernan Martin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "allocator.h"
+#include <algorithm>
+#include <assert.h>
+#include <cstddef>
+#include <new>
+
+namespace coll
+{
+
+/**
+ * Fixed-size slot pool for B-Tree nodes.
+ *
+ * Slots are carved from chunks obtained from the backing allocator, and released slots are kept in
+ * a free list to be reused. Chunks start small and double their size up to a memory page, so small
+ * trees do not pay for a whole page while large trees make one allocation per page and keep their
+ * nodes close together.
+ *
+ * Chunks are only returned to the backing allocator by 'release' (or on destruction), which must
+ * happen once no slot is in use anymore.
+ */
+class NodePool
+{
+public:
+    static constexpr byte_size ChunkBytes = 4096;
+
+    NodePool(IAllocator& alloc, byte_size slotSize, align slotAlign)
+        : m_alloc(&alloc)
+        , m_align(std::max(slotAlign, align::of<FreeSlot>()))
+        , m_slotSize(m_align.round_up(std::max(slotSize, byte_size(sizeof(FreeSlot)))))
+        , m_headerSize(m_align.round_up(sizeof(Chunk)))
+        , m_maxChunkSlots(std::max(byte_size(1), (ChunkBytes - m_headerSize) / m_slotSize))
+    {
+    }
+
+    ~NodePool() { release(); }
+
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    NodePool(NodePool&& rhs) noexcept
+        : m_alloc(rhs.m_alloc)
+        , m_align(rhs.m_align)
+        , m_slotSize(rhs.m_slotSize)
+        , m_headerSize(rhs.m_headerSize)
+        , m_maxChunkSlots(rhs.m_maxChunkSlots)
+    {
+        take(rhs);
+    }
+
+    NodePool& operator=(NodePool&& rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            release();
+
+            m_alloc = rhs.m_alloc;
+            m_align = rhs.m_align;
+            m_slotSize = rhs.m_slotSize;
+            m_headerSize = rhs.m_headerSize;
+            m_maxChunkSlots = rhs.m_maxChunkSlots;
+            take(rhs);
+        }
+        return *this;
+    }
+
+    IAllocator& allocator() const { return *m_alloc; }
+
+    // Returns an uninitialized slot. Throws 'std::bad_alloc' if the backing allocator fails.
+    void* alloc()
+    {
+        if (m_freeList != nullptr)
+        {
+            FreeSlot* slot = m_freeList;
+            m_freeList = slot->next;
+            if (m_freeList == nullptr)
+                m_freeTail = nullptr;
+            return slot;
+        }
+
+        if (m_next == m_end)
+            add_chunk();
+
+        void* slot = m_next;
+        m_next += m_slotSize;
+        return slot;
+    }
+
+    void free(void* slot)
+    {
+        if (slot == nullptr)
+            return;
+
+        m_freeList = new (slot) FreeSlot {m_freeList};
+        if (m_freeTail == nullptr)
+            m_freeTail = m_freeList;
+    }
+
+    // Makes sure that the next 'count' calls to 'alloc' will not fail, taking the memory they need now.
+    void reserve(byte_size count)
+    {
+        FreeSlot* taken = nullptr;
+
+        try
+        {
+            for (byte_size i = 0; i < count; ++i)
+                taken = new (alloc()) FreeSlot {taken};
+        }
+        catch (...)
+        {
+            free_all(taken);
+            throw;
+        }
+        free_all(taken);
+    }
+
+    // Takes the chunks of 'other', which must have the same slot size and backing allocator, and its
+    // free slots. Slots allocated from 'other' can then be freed to this pool, and live as long as it.
+    // 'other' is left empty. O(1), but for the unused slots of the newest chunk of 'other'.
+    void absorb(NodePool& other)
+    {
+        assert(other.m_alloc == m_alloc && other.m_slotSize == m_slotSize);
+
+        if (&other == this || other.m_chunks == nullptr)
+            return;
+
+        for (; other.m_next != other.m_end; other.m_next += m_slotSize)
+            other.free(other.m_next);
+
+        other.m_chunksTail->next = m_chunks;
+        m_chunks = other.m_chunks;
+        if (m_chunksTail == nullptr)
+            m_chunksTail = other.m_chunksTail;
+
+        if (other.m_freeList != nullptr)
+        {
+            other.m_freeTail->next = m_freeList;
+            m_freeList = other.m_freeList;
+            if (m_freeTail == nullptr)
+                m_freeTail = other.m_freeTail;
+        }
+
+        other.reset();
+    }
+
+    // Returns all the chunks to the backing allocator. Every slot is invalidated.
+    void release()
+    {
+        for (Chunk* chunk = m_chunks; chunk != nullptr;)
+        {
+            Chunk* next = chunk->next;
+            m_alloc->free(chunk);
+            chunk = next;
+        }
+
+        reset();
+    }
+
+private:
+    struct FreeSlot
+    {
+        FreeSlot* next;
+    };
+
+    struct Chunk
+    {
+        Chunk* next;
+    };
+
+    IAllocator* m_alloc;
+    align m_align;
+    byte_size m_slotSize;
+    byte_size m_headerSize;
+    byte_size m_maxChunkSlots;
+
+    Chunk* m_chunks = nullptr;
+    Chunk* m_chunksTail = nullptr; // Oldest chunk. Tails are kept so 'absorb' can splice the lists.
+    FreeSlot* m_freeList = nullptr;
+    FreeSlot* m_freeTail = nullptr;
+    std::byte* m_next = nullptr; // Next never used slot of the newest chunk.
+    std::byte* m_end = nullptr;
+    byte_size m_chunkSlots = 0;
+
+    void add_chunk()
+    {
+        const byte_size slots = std::min(std::max(m_chunkSlots * 2, byte_size(1)), m_maxChunkSlots);
+        const SAllocResult r = m_alloc->alloc(m_headerSize + slots * m_slotSize, m_align);
+
+        if (r.buffer == nullptr)
+            throw std::bad_alloc();
+
+        m_chunks = new (r.buffer) Chunk {m_chunks};
+        if (m_chunksTail == nullptr)
+            m_chunksTail = m_chunks;
+        m_chunkSlots = slots;
+        m_next = static_cast<std::byte*>(r.buffer) + m_headerSize;
+        m_end = m_next + slots * m_slotSize;
+    }
+
+    void take(NodePool& rhs)
+    {
+        m_chunks = rhs.m_chunks;
+        m_chunksTail = rhs.m_chunksTail;
+        m_freeList = rhs.m_freeList;
+        m_freeTail = rhs.m_freeTail;
+        m_next = rhs.m_next;
+        m_end = rhs.m_end;
+        m_chunkSlots = rhs.m_chunkSlots;
+
+        rhs.reset();
+    }
+
+    // Forgets all the chunks, without freeing them.
+    void reset()
+    {
+        m_chunks = nullptr;
+        m_chunksTail = nullptr;
+        m_freeList = nullptr;
+        m_freeTail = nullptr;
+        m_next = nullptr;
+        m_end = nullptr;
+        m_chunkSlots = 0;
+    }
+
+    void free_all(FreeSlot* slots)
+    {
+        while (slots != nullptr)
+        {
+            FreeSlot* next = slots->next;
+            free(slots);
+            slots = next;
+        }
+    }
+};
+} // namespace coll
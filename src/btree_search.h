@@ -0,0 +1,430 @@
+/*
+ * Copyright (c) 2026 Guillermo Hernan Martin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "collib_concepts.h"
+#include "collib_types.h"
+
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Instruction sets available for the SIMD search path. MSVC does not define __SSE2__, so it is
+// deduced from the target architecture.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COLL_SEARCH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__SSE4_2__) || defined(__AVX__)
+#define COLL_SEARCH_SSE42 1
+#include <nmmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define COLL_SEARCH_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace coll
+{
+
+// Default order of B-Tree keys: 'operator<'. Transparent for 'TransparentKey' types.
+template <typename Key, bool Transparent = TransparentKey<Key>::value>
+struct KeyLess
+{
+    template <typename A, typename B>
+    constexpr bool operator()(const A& a, const B& b) const
+        requires requires { a < b; }
+    {
+        return a < b;
+    }
+};
+
+template <typename Key>
+struct KeyLess<Key, true> : KeyLess<Key, false>
+{
+    using is_transparent = void;
+
+    // Normalized prefix of 'std::string' keys (see 'KeyPrefixCompare'): their first 8 bytes, big
+    // endian, so they compare as 'std::char_traits<char>' does (unsigned).
+    static uint64_t prefix(std::string_view key)
+        requires std::same_as<Key, std::string>
+    {
+        uint64_t result = 0;
+        const size_t length = key.size() < 8 ? key.size() : 8;
+
+        for (size_t i = 0; i < length; ++i)
+            result |= uint64_t(static_cast<unsigned char>(key[i])) << (56 - 8 * i);
+
+        return result;
+    }
+};
+
+// Key normalization hook. A comparator may also map keys (and the types it looks up) to unsigned
+// 64 bit prefixes which keep their order: 'comp(a, b)' implies 'prefix(a) <= prefix(b)', and
+// equivalent keys have the same prefix. Nodes may store them beside the keys and compare them first;
+// only equal prefixes need a full comparison. 'prefix' is static, as it may only depend on the key.
+template <typename Compare, typename Key>
+concept KeyPrefixCompare = requires(const Key& key) {
+    { Compare::prefix(key) } -> std::same_as<uint64_t>;
+};
+
+// Comparators which order the keys as 'operator<' does, so that they can be searched with SIMD
+// compares.
+template <typename Compare, typename Key>
+constexpr bool isNaturalOrder()
+{
+    return std::is_same_v<Compare, KeyLess<Key>> || std::is_same_v<Compare, std::less<Key>> ||
+           std::is_same_v<Compare, std::less<>>;
+}
+
+/*
+ * Search strategies for the keys of a single B-Tree node.
+ *
+ * - Linear: the classic scan. Hard to beat on very small nodes.
+ * - Binary: branchless binary search. Used for generic keys on medium / large nodes, where the number
+ *   of (possibly expensive) comparisons matters more than the access pattern.
+ * - Simd:   arithmetic keys in their natural order. Narrows the window with branchless binary steps
+ *   and then counts the keys below the searched one with vector compares + popcount.
+ *
+ * Defining COLL_BTREE_SCALAR_SEARCH forces the linear scan for every key type, which is useful to
+ * compare against the previous behavior in benchmarks.
+ */
+enum class NodeSearchKind
+{
+    Linear,
+    Binary,
+    Simd
+};
+
+template <typename Key>
+constexpr bool isSimdSearchKey()
+{
+    if constexpr (std::is_same_v<Key, bool> || !std::is_arithmetic_v<Key>)
+        return false;
+    else if constexpr (std::is_floating_point_v<Key>)
+        return std::is_same_v<Key, float> || std::is_same_v<Key, double>;
+    else
+        return sizeof(Key) == 4 || sizeof(Key) == 8;
+}
+
+template <typename Key, byte_size Order, typename Compare>
+constexpr NodeSearchKind selectNodeSearch()
+{
+#if defined(COLL_BTREE_SCALAR_SEARCH)
+    return NodeSearchKind::Linear;
+#else
+    if constexpr (isSimdSearchKey<Key>() && isNaturalOrder<Compare, Key>())
+        return NodeSearchKind::Simd;
+    else if constexpr (Order <= 8)
+        return NodeSearchKind::Linear;
+    else
+        return NodeSearchKind::Binary;
+#endif
+}
+
+template <typename Key, byte_size Order, typename Compare = KeyLess<Key>>
+class NodeSearch
+{
+public:
+    static constexpr NodeSearchKind Kind = selectNodeSearch<Key, Order, Compare>();
+
+    // Index of the first key which is not less than 'key', which may be of any type that 'comp'
+    // compares with 'Key'. Only 'Key' itself takes the SIMD path, as others may not compare like it.
+    template <typename K>
+    static count_t lower_bound(
+        const Key* keys,
+        count_t count,
+        const K& key,
+        const Compare& comp = Compare()
+    )
+    {
+        if constexpr (Kind == NodeSearchKind::Simd && std::is_same_v<K, Key>)
+            return simd_search<false>(keys, count, key);
+        else
+        {
+            auto pred = [&key, &comp](const Key& k) { return comp(k, key); };
+
+            if constexpr (Kind == NodeSearchKind::Linear)
+                return linear_search(keys, count, pred);
+            else
+                return binary_search(keys, count, pred);
+        }
+    }
+
+    // Index of the first key which is greater than 'key'.
+    template <typename K>
+    static count_t upper_bound(
+        const Key* keys,
+        count_t count,
+        const K& key,
+        const Compare& comp = Compare()
+    )
+    {
+        if constexpr (Kind == NodeSearchKind::Simd && std::is_same_v<K, Key>)
+            return simd_search<true>(keys, count, key);
+        else
+        {
+            auto pred = [&key, &comp](const Key& k) { return !comp(key, k); };
+
+            if constexpr (Kind == NodeSearchKind::Linear)
+                return linear_search(keys, count, pred);
+            else
+                return binary_search(keys, count, pred);
+        }
+    }
+
+private:
+    // Keys are sorted, so 'pred' is true for a prefix of the array. These functions return the length
+    // of that prefix.
+    template <typename Pred>
+    static count_t linear_search(const Key* keys, count_t count, Pred pred)
+    {
+        count_t i = 0;
+        while (i < count && pred(keys[i]))
+            ++i;
+        return i;
+    }
+
+    template <typename Pred>
+    static count_t binary_search(const Key* keys, count_t count, Pred pred)
+    {
+        if (count == 0)
+            return 0;
+
+        const Key* base = keys;
+        count_t len = count;
+
+        // The result is always in [base, base + len]. Written so the compiler can use a conditional
+        // move instead of a branch.
+        while (len > 1)
+        {
+            const count_t half = len / 2;
+            base = pred(base[half - 1]) ? base + half : base;
+            len -= half;
+        }
+
+        return count_t(base - keys) + (pred(*base) ? 1 : 0);
+    }
+
+    // Windows smaller than this are counted entirely with vector compares. Bigger windows are first
+    // narrowed with binary steps, to avoid touching every cache line of big nodes.
+    static constexpr count_t SimdWindow = 64 / sizeof(Key) * 2;
+
+    template <bool Upper>
+    static count_t simd_search(const Key* keys, count_t count, const Key& key)
+    {
+        const Key* base = keys;
+        count_t len = count;
+
+        while (len > SimdWindow)
+        {
+            const count_t half = len / 2;
+            const Key& probe = base[half - 1];
+            const bool goRight = Upper ? !(key < probe) : (probe < key);
+
+            base = goRight ? base + half : base;
+            len -= half;
+        }
+
+        return count_t(base - keys) + simd_count<Upper>(base, len, key);
+    }
+
+    // Counts the keys which are below 'key' (!Upper) or not above 'key' (Upper).
+    template <bool Upper>
+    static count_t simd_count(const Key* keys, count_t count, const Key& key)
+    {
+        count_t i = 0;
+        count_t result = 0;
+
+#if defined(COLL_SEARCH_AVX2)
+        constexpr count_t Lanes = count_t(32 / sizeof(Key));
+        for (; i + Lanes <= count; i += Lanes)
+            result += avx2_count<Upper>(keys + i, key);
+#elif defined(COLL_SEARCH_SSE2)
+        constexpr count_t Lanes = count_t(16 / sizeof(Key));
+        if constexpr (sse_supported())
+        {
+            for (; i + Lanes <= count; i += Lanes)
+                result += sse_count<Upper>(keys + i, key);
+        }
+#endif
+
+        // Tail (or no SIMD available). Branchless, so the compiler is free to vectorize it.
+        for (; i < count; ++i)
+        {
+            if constexpr (Upper)
+                result += !(key < keys[i]) ? 1 : 0;
+            else
+                result += (keys[i] < key) ? 1 : 0;
+        }
+
+        return result;
+    }
+
+    // Converts comparison masks into a count of matching lanes. 'ltMask' has the lanes in which
+    // keys[i] < key; 'gtMask' the lanes in which key < keys[i].
+    template <bool Upper>
+    static count_t lanes_count(unsigned ltMask, unsigned gtMask, unsigned lanes)
+    {
+        if constexpr (Upper)
+            return lanes - count_t(std::popcount(gtMask));
+        else
+            return count_t(std::popcount(ltMask));
+    }
+
+#if defined(COLL_SEARCH_AVX2)
+    template <bool Upper>
+    static count_t avx2_count(const Key* keys, const Key& key)
+    {
+        constexpr unsigned Lanes = unsigned(32 / sizeof(Key));
+
+        if constexpr (std::is_same_v<Key, float>)
+        {
+            const __m256 v = _mm256_loadu_ps(keys);
+            const __m256 k = _mm256_set1_ps(key);
+            const unsigned lt = unsigned(_mm256_movemask_ps(_mm256_cmp_ps(v, k, _CMP_LT_OQ)));
+            const unsigned gt = unsigned(_mm256_movemask_ps(_mm256_cmp_ps(k, v, _CMP_LT_OQ)));
+            return lanes_count<Upper>(lt, gt, Lanes);
+        }
+        else if constexpr (std::is_same_v<Key, double>)
+        {
+            const __m256d v = _mm256_loadu_pd(keys);
+            const __m256d k = _mm256_set1_pd(key);
+            const unsigned lt = unsigned(_mm256_movemask_pd(_mm256_cmp_pd(v, k, _CMP_LT_OQ)));
+            const unsigned gt = unsigned(_mm256_movemask_pd(_mm256_cmp_pd(k, v, _CMP_LT_OQ)));
+            return lanes_count<Upper>(lt, gt, Lanes);
+        }
+        else if constexpr (sizeof(Key) == 4)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys));
+            __m256i k = _mm256_set1_epi32(int32_t(key));
+
+            // There are only signed compares. Flipping the sign bit keeps the order of unsigned keys.
+            if constexpr (std::is_unsigned_v<Key>)
+            {
+                const __m256i bias = _mm256_set1_epi32(INT32_MIN);
+                v = _mm256_xor_si256(v, bias);
+                k = _mm256_xor_si256(k, bias);
+            }
+
+            const unsigned lt = unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v))));
+            const unsigned gt = unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, k))));
+            return lanes_count<Upper>(lt, gt, Lanes);
+        }
+        else
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys));
+            __m256i k = _mm256_set1_epi64x(int64_t(key));
+
+            if constexpr (std::is_unsigned_v<Key>)
+            {
+                const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+                v = _mm256_xor_si256(v, bias);
+                k = _mm256_xor_si256(k, bias);
+            }
+
+            const unsigned lt = unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v))));
+            const unsigned gt = unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(v, k))));
+            return lanes_count<Upper>(lt, gt, Lanes);
+        }
+    }
+#endif
+
+#if defined(COLL_SEARCH_SSE2)
+    // 64 bit integer compares require SSE 4.2. Without them, the scalar (auto-vectorized) loop is used.
+    static constexpr bool sse_supported()
+    {
+#if defined(COLL_SEARCH_SSE42)
+        return true;
+#else
+        return std::is_floating_point_v<Key> || sizeof(Key) == 4;
+#endif
+    }
+
+    template <bool Upper>
+    static count_t sse_count(const Key* keys, const Key& key)
+    {
+        constexpr unsigned Lanes = unsigned(16 / sizeof(Key));
+
+        if constexpr (std::is_same_v<Key, float>)
+        {
+            const __m128 v = _mm_loadu_ps(keys);
+            const __m128 k = _mm_set1_ps(key);
+            const unsigned lt = unsigned(_mm_movemask_ps(_mm_cmplt_ps(v, k)));
+            const unsigned gt = unsigned(_mm_movemask_ps(_mm_cmplt_ps(k, v)));
+            return lanes_count<Upper>(lt, gt, Lanes);
+        }
+        else if constexpr (std::is_same_v<Key, double>)
+        {
+            const __m128d v = _mm_loadu_pd(keys);
+            const __m128d k = _mm_set1_pd(key);
+            const unsigned lt = unsigned(_mm_movemask_pd(_mm_cmplt_pd(v, k)));
+            const unsigned gt = unsigned(_mm_movemask_pd(_mm_cmplt_pd(k, v)));
+            return lanes_count<Upper>(lt, gt, Lanes);
+        }
+        else if constexpr (sizeof(Key) == 4)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys));
+            __m128i k = _mm_set1_epi32(int32_t(key));
+
+            if constexpr (std::is_unsigned_v<Key>)
+            {
+                const __m128i bias = _mm_set1_epi32(INT32_MIN);
+                v = _mm_xor_si128(v, bias);
+                k = _mm_xor_si128(k, bias);
+            }
+
+            const unsigned lt = unsigned(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(k, v))));
+            const unsigned gt = unsigned(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, k))));
+            return lanes_count<Upper>(lt, gt, Lanes);
+        }
+        else
+        {
+#if defined(COLL_SEARCH_SSE42)
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys));
+            __m128i k = _mm_set1_epi64x(int64_t(key));
+
+            if constexpr (std::is_unsigned_v<Key>)
+            {
+                const __m128i bias = _mm_set1_epi64x(INT64_MIN);
+                v = _mm_xor_si128(v, bias);
+                k = _mm_xor_si128(k, bias);
+            }
+
+            const unsigned lt = unsigned(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(k, v))));
+            const unsigned gt = unsigned(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(v, k))));
+            return lanes_count<Upper>(lt, gt, Lanes);
+#else
+            return 0;
+#endif
+        }
+    }
+#endif
+};
+
+} // namespace coll
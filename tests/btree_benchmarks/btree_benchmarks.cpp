@@ -21,13 +21,21 @@
  */
 
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <random>
+#include <shared_mutex>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 
+#include "allocators/region_locked_lean_tree_allocator.h"
 #include "bmap.h"
+#include "concurrent_bmap.h"
+#include "string_bmap.h"
 
 using namespace coll;
 
@@ -56,12 +64,43 @@ inline bool map_find(const Map& m, const Key& key)
 }
 
 // Especialización para bmap: find devuelve Handle, convertimos a bool con has_value()
-template <typename Key, typename Value, size_t Order>
-inline bool map_find(const bmap<Key, Value, Order>& m, const Key& key)
+template <typename Key, typename Value, size_t Order, BMapOptions Options>
+inline bool map_find(const bmap<Key, Value, Order, Options>& m, const Key& key)
 {
     return m.find(key).has_value();
 }
 
+// Especialización para string_bmap
+template <typename Value, size_t Order, size_t HeapBytes>
+inline bool map_find(const string_bmap<Value, Order, HeapBytes>& m, const std::string& key)
+{
+    return m.find(key).has_value();
+}
+
+// Adaptador genérico para búsqueda por lotes (devuelve el número de claves encontradas)
+template <typename Map, typename Key>
+inline size_t map_find_batch(const Map& m, const Key* keys, size_t count)
+{
+    size_t found = 0;
+    for (size_t i = 0; i < count; ++i)
+        found += map_find(m, keys[i]) ? 1 : 0;
+    return found;
+}
+
+// Especialización para bmap: usa find_batch
+template <typename Key, typename Value, size_t Order, BMapOptions Options>
+inline size_t map_find_batch(const bmap<Key, Value, Order, Options>& m, const Key* keys, size_t count)
+{
+    thread_local std::vector<typename bmap<Key, Value, Order, Options>::Handle> results;
+    results.resize(count);
+    m.find_batch(span<const Key>(keys, count_t(count)), make_span(results.data(), count_t(count)));
+
+    size_t found = 0;
+    for (const auto& handle : results)
+        found += handle.has_value() ? 1 : 0;
+    return found;
+}
+
 // Adaptador genérico para inserción
 template <typename Map, typename Key, typename Value>
 inline void map_insert(Map& m, const Key& key, const Value& value)
@@ -70,12 +109,38 @@ inline void map_insert(Map& m, const Key& key, const Value& value)
 }
 
 // Especialización para bmap (insert overload es distinta)
-template <typename Key, typename Value, size_t Order>
-inline void map_insert(bmap<Key, Value, Order>& m, const Key& key, const Value& value)
+template <typename Key, typename Value, size_t Order, BMapOptions Options>
+inline void map_insert(bmap<Key, Value, Order, Options>& m, const Key& key, const Value& value)
+{
+    m.insert(key, value);
+}
+
+// Especialización para string_bmap
+template <typename Value, size_t Order, size_t HeapBytes>
+inline void map_insert(
+    string_bmap<Value, Order, HeapBytes>& m,
+    const std::string& key,
+    const Value& value
+)
 {
     m.insert(key, value);
 }
 
+// Adaptador genérico para construir desde datos ordenados
+template <typename Map, typename Entries>
+inline Map map_from_sorted(const Entries& entries)
+{
+    return Map(entries.begin(), entries.end());
+}
+
+// Especialización para bmap (carga masiva)
+template <typename Map, typename Entries>
+    requires requires(const Entries& e) { Map::from_sorted(e); }
+inline Map map_from_sorted(const Entries& entries)
+{
+    return Map::from_sorted(entries);
+}
+
 // Adaptador genérico para borrado (erase)
 template <typename Map, typename Key>
 inline bool map_erase(Map& m, const Key& key)
@@ -84,12 +149,40 @@ inline bool map_erase(Map& m, const Key& key)
 }
 
 // Especialización para bmap (erase devuelve bool directamente)
-template <typename Key, typename Value, size_t Order>
-inline bool map_erase(bmap<Key, Value, Order>& m, const Key& key)
+template <typename Key, typename Value, size_t Order, BMapOptions Options>
+inline bool map_erase(bmap<Key, Value, Order, Options>& m, const Key& key)
 {
     return m.erase(key);
 }
 
+// Adaptadores genéricos para aplicar lotes ordenados de cambios
+template <typename Map, typename Entries>
+inline void map_insert_sorted(Map& m, const Entries& entries)
+{
+    for (const auto& entry : entries)
+        map_insert(m, entry.first, entry.second);
+}
+
+template <typename Map, typename Keys>
+inline void map_erase_sorted(Map& m, const Keys& keys)
+{
+    for (const auto& key : keys)
+        map_erase(m, key);
+}
+
+// Especialización para bmap (cursor de modificaciones ordenadas)
+template <typename Key, typename Value, size_t Order, BMapOptions Options, typename Entries>
+inline void map_insert_sorted(bmap<Key, Value, Order, Options>& m, const Entries& entries)
+{
+    m.insert_sorted(entries);
+}
+
+template <typename Key, typename Value, size_t Order, BMapOptions Options, typename Keys>
+inline void map_erase_sorted(bmap<Key, Value, Order, Options>& m, const Keys& keys)
+{
+    m.erase_sorted(keys);
+}
+
 // Adaptador para std::map (pair<const Key, Value>)
 template <typename Pair>
 inline auto get_value(const Pair& p) -> decltype(p.second)
@@ -104,6 +197,28 @@ inline auto get_value(const Entry& e) -> decltype(e.value)
     return e.value;
 }
 
+// Adaptador genérico para sumar todos los valores, entrada a entrada
+template <typename Map>
+inline auto map_sum_values(const Map& m)
+{
+    typename Map::mapped_type sum {};
+    for (const auto& kv : m)
+        sum += get_value(kv);
+    return sum;
+}
+
+// Especialización para bmap: suma los valores de cada hoja de una vez
+template <typename Key, typename Value, size_t Order, BMapOptions Options>
+inline Value map_sum_values(const bmap<Key, Value, Order, Options>& m)
+{
+    Value sum {};
+    m.for_each_leaf_chunk([&sum](span<const Key>, span<const Value> values) {
+        for (const Value& value : values)
+            sum += value;
+    });
+    return sum;
+}
+
 class TestBase
 {
 public:
@@ -195,7 +310,7 @@ public:
         TestBase::setup(config);
 
         for (size_t i = 0; i < config.map_size; ++i)
-            map_insert(m_map, static_cast<Key>(i), static_cast<Key>(i));
+            map_insert(m_map, static_cast<Key>(i), static_cast<Value>(i));
 
         m_rng = std::mt19937_64(12345);
         m_dist = std::uniform_int_distribution<Key>(0, static_cast<Key>(config.map_size - 1));
@@ -222,6 +337,51 @@ private:
     std::uniform_int_distribution<Key> m_dist;
 };
 
+// Random lookups in batches, like 'FindTest'. The 'Sorted' variant sorts each batch first.
+template <typename MapType, bool Sorted>
+class FindBatchTest : public TestBase
+{
+public:
+    using Key = MapType::key_type;
+    using Value = MapType::mapped_type;
+
+    static constexpr size_t BatchSize = 256;
+
+    void setup(const TestConfig& config)
+    {
+        TestBase::setup(config);
+
+        for (size_t i = 0; i < config.map_size; ++i)
+            map_insert(m_map, static_cast<Key>(i), static_cast<Key>(i));
+
+        std::mt19937_64 rng(12345);
+        std::uniform_int_distribution<Key> dist(0, static_cast<Key>(config.map_size - 1));
+
+        for (size_t i = 0; i < config.op_count; ++i)
+            m_keys.push_back(dist(rng));
+
+        if constexpr (Sorted)
+        {
+            for (size_t i = 0; i < m_keys.size(); i += BatchSize)
+                std::sort(m_keys.begin() + i, m_keys.begin() + std::min(i + BatchSize, m_keys.size()));
+        }
+    }
+
+    void run()
+    {
+        size_t found = 0;
+
+        for (size_t i = 0; i < m_keys.size(); i += BatchSize)
+            found += map_find_batch(m_map, m_keys.data() + i, std::min(BatchSize, m_keys.size() - i));
+
+        volatile auto dummy = found;
+    }
+
+private:
+    MapType m_map;
+    std::vector<Key> m_keys;
+};
+
 template <typename MapType>
 class EraseTest : public TestBase
 {
@@ -315,6 +475,314 @@ private:
     size_t m_reps = 1;
 };
 
+// Sums all the values of the map, which bmap does one leaf at a time.
+template <typename MapType>
+class ChunkedReadTest : public TestBase
+{
+public:
+    using Key = MapType::key_type;
+    using Value = MapType::mapped_type;
+
+    void setup(const TestConfig& config)
+    {
+        TestBase::setup(config);
+
+        for (size_t i = 0; i < config.map_size; ++i)
+            map_insert(m_map, static_cast<Key>(i), static_cast<Value>(i));
+
+        // Same repetitions as 'SeqReadTest', to compare both.
+        m_reps = std::max(size_t(1), m_config.op_count / m_config.map_size) * 20;
+    }
+
+    void run()
+    {
+        volatile Value sink;
+        for (size_t j = 0; j < m_reps; ++j)
+            sink = map_sum_values(m_map);
+    }
+
+private:
+    MapType m_map;
+    size_t m_reps = 1;
+};
+
+// Builds the whole map from already sorted entries.
+template <typename MapType>
+class SortedLoadTest : public TestBase
+{
+public:
+    using Key = MapType::key_type;
+    using Value = MapType::mapped_type;
+
+    void setup(const TestConfig& config)
+    {
+        TestBase::setup(config);
+
+        for (size_t i = 0; i < config.map_size; ++i)
+            m_entries.emplace_back(static_cast<Key>(i), static_cast<Value>(i));
+    }
+
+    void pre_run()
+    {
+        m_reps = m_config.op_count / m_config.map_size;
+        m_reps = std::max(size_t(1), m_reps);
+    }
+
+    void run()
+    {
+        volatile size_t sink;
+        for (size_t j = 0; j < m_reps; ++j)
+            sink = map_from_sorted<MapType>(m_entries).size();
+    }
+
+private:
+    std::vector<std::pair<Key, Value>> m_entries;
+    size_t m_reps = 1;
+};
+
+// Copies a whole map, which bmap does node by node.
+template <typename MapType>
+class CopyTest : public TestBase
+{
+public:
+    using Key = MapType::key_type;
+    using Value = MapType::mapped_type;
+
+    void setup(const TestConfig& config)
+    {
+        TestBase::setup(config);
+
+        for (size_t i = 0; i < config.map_size; ++i)
+            map_insert(m_map, static_cast<Key>(i), static_cast<Value>(i));
+    }
+
+    void pre_run()
+    {
+        m_reps = m_config.op_count / m_config.map_size;
+        m_reps = std::max(size_t(1), m_reps);
+    }
+
+    void run()
+    {
+        volatile size_t sink;
+        for (size_t j = 0; j < m_reps; ++j)
+        {
+            const MapType copy(m_map);
+            sink = copy.size();
+        }
+    }
+
+private:
+    MapType m_map;
+    size_t m_reps = 1;
+};
+
+// Inserts a sorted batch of keys interleaved with the existing ones, and erases it again.
+template <typename MapType>
+class SortedBatchTest : public TestBase
+{
+public:
+    using Key = MapType::key_type;
+    using Value = MapType::mapped_type;
+
+    void setup(const TestConfig& config)
+    {
+        TestBase::setup(config);
+
+        for (size_t i = 0; i < config.map_size; ++i)
+            map_insert(m_map, static_cast<Key>(i * 2), static_cast<Value>(i));
+
+        for (size_t i = 0; i < config.op_count; ++i)
+        {
+            const auto key = static_cast<Key>(i * config.map_size / config.op_count * 2 + 1);
+            if (m_keys.empty() || m_keys.back() != key)
+            {
+                m_keys.push_back(key);
+                m_entries.emplace_back(key, static_cast<Value>(i));
+            }
+        }
+    }
+
+    void run()
+    {
+        map_insert_sorted(m_map, m_entries);
+        map_erase_sorted(m_map, m_keys);
+    }
+
+private:
+    MapType m_map;
+    std::vector<Key> m_keys;
+    std::vector<std::pair<Key, Value>> m_entries;
+};
+
+// Value of 'Bytes' bytes, for the value layout benchmarks.
+template <size_t Bytes>
+struct Blob
+{
+    int data[Bytes / sizeof(int)];
+
+    Blob(int value = 0) { std::fill(std::begin(data), std::end(data), value); }
+};
+
+// Iterates the whole map reading only the keys.
+template <typename MapType>
+class KeyScanTest : public TestBase
+{
+public:
+    using Key = MapType::key_type;
+    using Value = MapType::mapped_type;
+
+    void setup(const TestConfig& config)
+    {
+        TestBase::setup(config);
+
+        for (size_t i = 0; i < config.map_size; ++i)
+            map_insert(m_map, static_cast<Key>(i), static_cast<Value>(i));
+
+        m_reps = std::max(size_t(1), m_config.op_count / m_config.map_size) * 20;
+    }
+
+    void run()
+    {
+        volatile Key sink;
+        for (size_t j = 0; j < m_reps; ++j)
+        {
+            for (const auto entry : m_map)
+                sink = entry.key;
+        }
+    }
+
+private:
+    MapType m_map;
+    size_t m_reps = 1;
+};
+
+// URL-like key, for the string key benchmarks. Keys share long prefixes.
+std::string make_url_key(size_t i)
+{
+    static const char* const sections[] = {
+        "catalog/books/fiction", "catalog/books/science", "catalog/music", "users/profiles", "static/img"
+    };
+
+    return "https://www.example.com/" + std::string(sections[i % 5]) + "/item-" + std::to_string(i / 5);
+}
+
+// Random lookups with string keys.
+template <typename MapType>
+class StringFindTest : public TestBase
+{
+public:
+    void setup(const TestConfig& config)
+    {
+        TestBase::setup(config);
+
+        for (size_t i = 0; i < config.map_size; ++i)
+            map_insert(m_map, make_url_key(i), int(i));
+
+        std::mt19937_64 rng(12345);
+        std::uniform_int_distribution<size_t> dist(0, config.map_size - 1);
+
+        for (size_t i = 0; i < ProbeCount; ++i)
+            m_probes.push_back(make_url_key(dist(rng)));
+    }
+
+    void run()
+    {
+        size_t found = 0;
+
+        for (size_t i = 0; i < m_config.op_count; ++i)
+            found += map_find(m_map, m_probes[i % ProbeCount]) ? 1 : 0;
+
+        volatile auto dummy = found;
+    }
+
+private:
+    static constexpr size_t ProbeCount = 4096;
+
+    MapType m_map;
+    std::vector<std::string> m_probes;
+};
+
+// Insertion of string keys in random order.
+template <typename MapType>
+class StringInsertionTest : public TestBase
+{
+public:
+    void setup(const TestConfig& config)
+    {
+        TestBase::setup(config);
+
+        for (size_t i = 0; i < config.map_size; ++i)
+            m_keys.push_back(make_url_key(i));
+
+        std::shuffle(m_keys.begin(), m_keys.end(), std::mt19937_64(12345));
+        m_reps = std::max(size_t(1), m_config.op_count / m_config.map_size);
+    }
+
+    void run()
+    {
+        for (size_t j = 0; j < m_reps; ++j)
+        {
+            MapType m;
+            for (const auto& key : m_keys)
+                map_insert(m, key, 0);
+        }
+    }
+
+private:
+    std::vector<std::string> m_keys;
+    size_t m_reps = 1;
+};
+
+// Search inside a single node, isolated from the rest of the tree. The linear variant is the scan
+// BTreeCore used before NodeSearch, kept as a reference.
+template <byte_size Order, bool Linear>
+class NodeSearchTest : public TestBase
+{
+public:
+    void setup(const TestConfig& config)
+    {
+        TestBase::setup(config);
+
+        for (int i = 0; i < int(Order); ++i)
+            m_keys[i] = i * 2;
+
+        std::mt19937_64 rng(12345);
+        std::uniform_int_distribution<int> dist(-1, int(Order) * 2);
+
+        for (size_t i = 0; i < ProbeCount; ++i)
+            m_probes.push_back(dist(rng));
+    }
+
+    void run()
+    {
+        size_t acc = 0;
+
+        for (size_t i = 0; i < m_config.op_count; ++i)
+        {
+            const int key = m_probes[i & (ProbeCount - 1)];
+
+            if constexpr (Linear)
+            {
+                count_t j = 0;
+                while (j < Order && !(key < m_keys[j]))
+                    ++j;
+                acc += j;
+            }
+            else
+                acc += NodeSearch<int, Order>::upper_bound(m_keys, count_t(Order), key);
+        }
+
+        volatile auto dummy = acc;
+    }
+
+private:
+    static constexpr size_t ProbeCount = 4096;
+
+    int m_keys[Order];
+    std::vector<int> m_probes;
+};
+
 size_t calc_repetitions(size_t size)
 {
     const double maxReps = 299;
@@ -408,8 +876,14 @@ std::vector<BenchmarkResult> run_all_benchmarks(
         results.push_back(run_benchmark<InsertionTest<MapT>>(config, "insertion"));
         results.push_back(run_benchmark<RandomInsertionTest<MapT>>(config, "insertion_random"));
         results.push_back(run_benchmark<FindTest<MapT>>(config, "find"));
+        results.push_back(run_benchmark<FindBatchTest<MapT, false>>(config, "find_batch"));
+        results.push_back(run_benchmark<FindBatchTest<MapT, true>>(config, "find_batch_sorted"));
         results.push_back(run_benchmark<EraseTest<MapT>>(config, "erase"));
         results.push_back(run_benchmark<SeqReadTest<MapT>>(config, "sequential_read"));
+        results.push_back(run_benchmark<ChunkedReadTest<MapT>>(config, "chunked_read"));
+        results.push_back(run_benchmark<SortedLoadTest<MapT>>(config, "sorted_load"));
+        results.push_back(run_benchmark<SortedBatchTest<MapT>>(config, "sorted_batch"));
+        results.push_back(run_benchmark<CopyTest<MapT>>(config, "copy"));
     };
 
     size_t idx = 0;
@@ -418,6 +892,89 @@ std::vector<BenchmarkResult> run_all_benchmarks(
     return results;
 }
 
+// Runs the in-node search benchmark for each given node order. 'map_size' holds the order.
+template <byte_size... Orders>
+std::vector<BenchmarkResult> run_node_search_benchmarks(size_t op_count)
+{
+    std::vector<BenchmarkResult> results;
+
+    auto run_for_order = [&](auto order)
+    {
+        constexpr byte_size Order = decltype(order)::value;
+        TestConfig config {"", "", Order, op_count};
+
+        config.map_name = "linear scan";
+        results.push_back(run_benchmark<NodeSearchTest<Order, true>>(config, "node_search"));
+
+        config.map_name = "node search";
+        results.push_back(run_benchmark<NodeSearchTest<Order, false>>(config, "node_search"));
+    };
+
+    (run_for_order(std::integral_constant<byte_size, Orders> {}), ...);
+
+    return results;
+}
+
+// Compares inline values against 'SeparateValues' leaves, with big values.
+std::vector<BenchmarkResult> run_value_layout_benchmarks(const std::vector<size_t>& map_sizes)
+{
+    std::vector<BenchmarkResult> results;
+
+    auto run_for_map = [&](auto map_type, const std::string& name)
+    {
+        using MapT = decltype(map_type);
+
+        for (size_t map_size : map_sizes)
+        {
+            TestConfig config {name, "", map_size, 100'000};
+
+            results.push_back(run_benchmark<FindTest<MapT>>(config, "layout_find"));
+            results.push_back(run_benchmark<KeyScanTest<MapT>>(config, "layout_key_scan"));
+            results.push_back(
+                run_benchmark<RandomInsertionTest<MapT>>(config, "layout_insertion_random")
+            );
+        }
+    };
+
+    constexpr BMapOptions Separate {.SeparateValues = true};
+
+    run_for_map(bmap<int, Blob<64>, 16> {}, "64B inline");
+    run_for_map(bmap<int, Blob<64>, 16, Separate> {}, "64B separate");
+    run_for_map(bmap<int, Blob<256>, 16> {}, "256B inline");
+    run_for_map(bmap<int, Blob<256>, 16, Separate> {}, "256B separate");
+
+    return results;
+}
+
+// Compares 'string_bmap' compressed keys against 'std::string' keys, with and without key prefixes.
+std::vector<BenchmarkResult> run_string_key_benchmarks(const std::vector<size_t>& map_sizes)
+{
+    constexpr BMapOptions Prefixes {.KeyPrefixes = true};
+    std::vector<BenchmarkResult> results;
+
+    auto run_for_map = [&](auto map_type, const std::string& name)
+    {
+        using MapT = typename decltype(map_type)::type;
+
+        for (size_t map_size : map_sizes)
+        {
+            TestConfig config {name, "", map_size, 100'000};
+
+            results.push_back(run_benchmark<StringFindTest<MapT>>(config, "string_find"));
+            results.push_back(
+                run_benchmark<StringInsertionTest<MapT>>(config, "string_insertion_random")
+            );
+        }
+    };
+
+    run_for_map(std::type_identity<std::map<std::string, int>> {}, "std::map");
+    run_for_map(std::type_identity<bmap<std::string, int, 16>> {}, "bmap order 16");
+    run_for_map(std::type_identity<bmap<std::string, int, 16, Prefixes>> {}, "bmap key prefixes");
+    run_for_map(std::type_identity<string_bmap<int>> {}, "string_bmap");
+
+    return results;
+}
+
 const BenchmarkResult* find_result(
     const std::vector<BenchmarkResult>& results,
     const std::string& map_name,
@@ -513,8 +1070,344 @@ void print_results_csv(
     }
 }
 
-int main()
+// ------------------------------------------------------------
+// Multi-threaded benchmarks ('--concurrent')
+// ------------------------------------------------------------
+
+// The usual way to share a bmap between threads, used as the reference.
+template <typename Key, typename Value, byte_size Order>
+class SharedMutexMap
+{
+public:
+    std::optional<Value> find(const Key& key) const
+    {
+        std::shared_lock lock(m_mutex);
+        auto h = m_map.find(key);
+        return h ? std::optional<Value>(h.value()) : std::nullopt;
+    }
+
+    bool insert(const Key& key, const Value& value)
+    {
+        std::unique_lock lock(m_mutex);
+        return m_map.insert(key, value).inserted;
+    }
+
+    bool erase(const Key& key)
+    {
+        std::unique_lock lock(m_mutex);
+        return m_map.erase(key);
+    }
+
+private:
+    mutable std::shared_mutex m_mutex;
+    bmap<Key, Value, Order> m_map;
+};
+
+// Time taken by 'readers' threads to make 'op_count' lookups each, while 'writers' threads keep
+// inserting and erasing keys. 'map_size' keys (the even ones) are present all the time.
+template <typename MapType>
+double run_concurrent_test(size_t map_size, size_t op_count, unsigned readers, unsigned writers)
 {
+    MapType m;
+    for (size_t i = 0; i < map_size; ++i)
+        m.insert(int(i * 2), int(i));
+
+    std::atomic<bool> start {false};
+    std::atomic<bool> stop {false};
+    std::atomic<size_t> found {0};
+    std::vector<std::thread> threads;
+
+    for (unsigned w = 0; w < writers; ++w)
+    {
+        threads.emplace_back(
+            [&, w]()
+            {
+                std::mt19937_64 rng(w + 1000);
+                std::uniform_int_distribution<size_t> dist(0, map_size - 1);
+
+                while (!start.load())
+                    std::this_thread::yield();
+
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    const int key = int(dist(rng) * 2 + 1);
+                    m.insert(key, key);
+                    m.erase(key);
+                }
+            }
+        );
+    }
+
+    std::vector<std::thread> reader_threads;
+    for (unsigned r = 0; r < readers; ++r)
+    {
+        reader_threads.emplace_back(
+            [&, r]()
+            {
+                std::mt19937_64 rng(r);
+                std::uniform_int_distribution<size_t> dist(0, map_size * 2 - 1);
+                size_t local = 0;
+
+                while (!start.load())
+                    std::this_thread::yield();
+
+                for (size_t i = 0; i < op_count; ++i)
+                    local += m.find(int(dist(rng))).has_value();
+
+                found += local;
+            }
+        );
+    }
+
+    auto begin = std::chrono::high_resolution_clock::now();
+    start = true;
+
+    for (auto& t : reader_threads)
+        t.join();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    stop = true;
+
+    for (auto& t : threads)
+        t.join();
+
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+int run_concurrent_benchmarks()
+{
+    const size_t map_size = 1'000'000;
+    const size_t op_count = 1'000'000;
+    const std::vector<size_t> reader_counts {1, 2, 4, 8};
+    const std::vector<std::string> writer_ops {
+        "concurrent_find_w0", "concurrent_find_w1", "concurrent_find_w2", "concurrent_find_w4"
+    };
+    const std::vector<unsigned> writer_counts {0, 1, 2, 4};
+    const std::vector<std::string> map_names {"shared_mutex bmap", "concurrent_bmap"};
+
+    std::vector<BenchmarkResult> results;
+
+    for (size_t w = 0; w < writer_counts.size(); ++w)
+    {
+        for (size_t readers : reader_counts)
+        {
+            std::cerr << "Running concurrent tests (" << readers << " readers, " << writer_counts[w]
+                      << " writers)...\n";
+
+            auto add_result = [&](const std::string& name, double ms)
+            {
+                BenchmarkResult result;
+                result.config = {name, writer_ops[w], readers, op_count};
+                result.duration_ms = ms;
+                results.push_back(result);
+            };
+
+            using SharedMap = SharedMutexMap<int, int, 64>;
+            using ConcurrentMap = concurrent_bmap<int, int, 64>;
+            const unsigned writers = writer_counts[w];
+
+            add_result(
+                map_names[0],
+                run_concurrent_test<SharedMap>(map_size, op_count, unsigned(readers), writers)
+            );
+            add_result(
+                map_names[1],
+                run_concurrent_test<ConcurrentMap>(map_size, op_count, unsigned(readers), writers)
+            );
+        }
+    }
+
+    std::cout << "\n--- CSV ---\n\n";
+    print_results_csv_header(std::cout);
+
+    for (auto& op : writer_ops)
+        print_results_csv(results, op, map_names, reader_counts, std::cout);
+
+    std::cout << "\n--- FORMATTED ---\n";
+
+    for (auto& op : writer_ops)
+        print_results_table(results, op, map_names, reader_counts, std::cout);
+
+    return 0;
+}
+
+// ------------------------------------------------------------
+// Allocator contention benchmarks ('--allocators')
+// ------------------------------------------------------------
+
+// The usual way to share a LeanTreeAllocator between threads, used as the reference.
+class MutexLeanTreeAllocator : public IAllocator
+{
+public:
+    MutexLeanTreeAllocator(IAllocator& backing, const LeanTreeAllocator::Parameters& params)
+        : m_alloc(backing, params)
+    {
+    }
+
+    SAllocResult alloc(byte_size bytes, align a) override
+    {
+        std::lock_guard lock(m_mutex);
+        return m_alloc.alloc(bytes, a);
+    }
+
+    byte_size tryExpand(byte_size bytes, void* buffer) override
+    {
+        std::lock_guard lock(m_mutex);
+        return m_alloc.tryExpand(bytes, buffer);
+    }
+
+    void free(void* buffer) override
+    {
+        std::lock_guard lock(m_mutex);
+        m_alloc.free(buffer);
+    }
+
+private:
+    std::mutex m_mutex;
+    LeanTreeAllocator m_alloc;
+};
+
+// Time taken by 'threads' threads to make 'op_count' allocations each, and to free them. Every
+// thread keeps a window of live blocks, and one block out of 'remote_ratio' is freed by the next
+// thread instead of its owner.
+double run_allocator_test(IAllocator& allocator, size_t op_count, unsigned threads, unsigned remote_ratio)
+{
+    constexpr size_t window = 64;
+
+    std::atomic<bool> start {false};
+    std::vector<std::atomic<void*>> mailboxes(threads);
+    std::vector<std::thread> workers;
+
+    for (auto& mailbox : mailboxes)
+        mailbox = nullptr;
+
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        workers.emplace_back(
+            [&, t]()
+            {
+                std::mt19937 rng(t);
+                std::uniform_int_distribution<size_t> size_dist(16, 512);
+                std::array<void*, window> live {};
+
+                while (!start.load())
+                    std::this_thread::yield();
+
+                for (size_t i = 0; i < op_count; ++i)
+                {
+                    void*& slot = live[i % window];
+                    if (slot != nullptr)
+                        allocator.free(slot);
+
+                    slot = allocator.alloc(size_dist(rng), align::system()).buffer;
+
+                    if (slot != nullptr && i % remote_ratio == 0)
+                    {
+                        void* previous = mailboxes[(t + 1) % threads].exchange(slot);
+                        if (previous != nullptr)
+                            allocator.free(previous);
+                        slot = nullptr;
+                    }
+                }
+
+                for (void* block : live)
+                {
+                    if (block != nullptr)
+                        allocator.free(block);
+                }
+            }
+        );
+    }
+
+    auto begin = std::chrono::high_resolution_clock::now();
+    start = true;
+
+    for (auto& t : workers)
+        t.join();
+
+    for (auto& mailbox : mailboxes)
+    {
+        if (void* block = mailbox.exchange(nullptr))
+            allocator.free(block);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+int run_allocator_benchmarks()
+{
+    const size_t op_count = 1'000'000;
+    const std::vector<size_t> thread_counts {1, 2, 4, 8};
+    const std::vector<std::string> operations {"alloc_free_local", "alloc_free_remote"};
+    const std::vector<unsigned> remote_ratios {1'000'000, 4};
+    const std::vector<std::string> allocator_names {"mutex LeanTree", "RegionLockedLeanTree"};
+
+    LeanTreeAllocator::Parameters params;
+    params.totalSize = Power2::round_up(8 * 1024 * 1024);
+    params.maxAllocSize = Power2::round_up(256 * 1024);
+
+    std::vector<BenchmarkResult> results;
+
+    for (size_t op = 0; op < operations.size(); ++op)
+    {
+        for (size_t threads : thread_counts)
+        {
+            std::cerr << "Running allocator tests (" << operations[op] << ", " << threads
+                      << " threads)...\n";
+
+            auto add_result = [&](const std::string& name, double ms)
+            {
+                BenchmarkResult result;
+                result.config = {name, operations[op], threads, op_count};
+                result.duration_ms = ms;
+                results.push_back(result);
+            };
+
+            {
+                MutexLeanTreeAllocator allocator(defaultAllocator(), params);
+                add_result(
+                    allocator_names[0],
+                    run_allocator_test(allocator, op_count, unsigned(threads), remote_ratios[op])
+                );
+            }
+            {
+                RegionLockedLeanTreeAllocator allocator(
+                    defaultAllocator(),
+                    {params, count_t(threads)}
+                );
+                add_result(
+                    allocator_names[1],
+                    run_allocator_test(allocator, op_count, unsigned(threads), remote_ratios[op])
+                );
+            }
+        }
+    }
+
+    std::cout << "\n--- CSV ---\n\n";
+    print_results_csv_header(std::cout);
+
+    for (auto& op : operations)
+        print_results_csv(results, op, allocator_names, thread_counts, std::cout);
+
+    std::cout << "\n--- FORMATTED ---\n";
+
+    for (auto& op : operations)
+        print_results_table(results, op, allocator_names, thread_counts, std::cout);
+
+    return 0;
+}
+
+// Pass '--concurrent' to run the multi-threaded benchmarks instead of the default ones, or
+// '--allocators' for the allocator contention ones.
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && std::string_view(argv[1]) == "--concurrent")
+        return run_concurrent_benchmarks();
+
+    if (argc > 1 && std::string_view(argv[1]) == "--allocators")
+        return run_allocator_benchmarks();
+
     // clang-format off
     std::vector<TestConfig> base_configs = 
     {
@@ -579,7 +1472,44 @@ int main()
         std::cerr << std::setprecision(3) << " (" << seconds << "s)\n";
     }
 
-    std::array operations {"insertion", "insertion_random", "find", "erase", "sequential_read"};
+    std::cerr << "Running node search tests...";
+    const std::vector<size_t> node_orders {4, 16, 32, 64, 256};
+    const std::vector<std::string> search_names {"linear scan", "node search"};
+    const auto search_results = run_node_search_benchmarks<4, 16, 32, 64, 256>(10'000'000);
+    std::cerr << "\n";
+
+    std::cerr << "Running value layout tests...";
+    const std::vector<size_t> layout_sizes {1'000, 100'000, 1'000'000};
+    const std::vector<std::string> layout_names {
+        "64B inline", "64B separate", "256B inline", "256B separate"
+    };
+    const auto layout_results = run_value_layout_benchmarks(layout_sizes);
+    std::cerr << "\n";
+
+    std::cerr << "Running string key tests...";
+    const std::vector<size_t> string_sizes {1'000, 100'000, 1'000'000};
+    const std::vector<std::string> string_names {
+        "std::map", "bmap order 16", "bmap key prefixes", "string_bmap"
+    };
+    const auto string_results = run_string_key_benchmarks(string_sizes);
+    std::cerr << "\n";
+
+    std::array layout_operations {"layout_find", "layout_key_scan", "layout_insertion_random"};
+    std::array string_operations {"string_find", "string_insertion_random"};
+
+    std::array operations {
+        "insertion",
+        "insertion_random",
+        "find",
+        "find_batch",
+        "find_batch_sorted",
+        "erase",
+        "sequential_read",
+        "chunked_read",
+        "sorted_load",
+        "sorted_batch",
+        "copy"
+    };
 
     std::cout << "\n--- CSV ---\n\n";
     print_results_csv_header(std::cout);
@@ -587,10 +1517,26 @@ int main()
     for (auto& op : operations)
         print_results_csv(all_results, op, map_names, map_sizes, std::cout);
 
+    print_results_csv(search_results, "node_search", search_names, node_orders, std::cout);
+
+    for (auto& op : layout_operations)
+        print_results_csv(layout_results, op, layout_names, layout_sizes, std::cout);
+
+    for (auto& op : string_operations)
+        print_results_csv(string_results, op, string_names, string_sizes, std::cout);
+
     std::cout << "\n--- FORMATTED ---\n";
 
     for (auto& op : operations)
         print_results_table(all_results, op, map_names, map_sizes, std::cout);
 
+    print_results_table(search_results, "node_search", search_names, node_orders, std::cout);
+
+    for (auto& op : layout_operations)
+        print_results_table(layout_results, op, layout_names, layout_sizes, std::cout);
+
+    for (auto& op : string_operations)
+        print_results_table(string_results, op, string_names, string_sizes, std::cout);
+
     return 0;
 }
\ No newline at end of file
@@ -22,6 +22,7 @@
 
 #include "pch-collib-tests.h"
 #include "allocators/arena_allocator.h"
+#include "darray.h"
 #include <vector>
 #include <cstring>
 
@@ -175,6 +176,21 @@ TEST_CASE("ArenaAllocator free behavior", "[ArenaAllocator][free]")
         REQUIRE(fallback.freedBlocks.empty());
     }
 
+    SECTION("Free the last arena block returns it to the arena")
+    {
+        auto first = arena.alloc(16, align::system());
+        const byte_size used = arena.usedBytes();
+        auto second = arena.alloc(16, align::system());
+
+        // Not the last block: nothing is done.
+        arena.free(first.buffer);
+        CHECK(arena.usedBytes() > used);
+
+        arena.free(second.buffer);
+        CHECK(arena.usedBytes() == used);
+        REQUIRE(fallback.freedBlocks.empty());
+    }
+
     SECTION("Free fallback memory delegates to fallback")
     {
         auto fallbackResult = fallback.alloc(16, align::system());
@@ -191,11 +207,185 @@ TEST_CASE("ArenaAllocator tryExpand", "[ArenaAllocator][tryExpand]")
     span<uint8_t> backing(buffer, 1024);
     ArenaAllocator arena(backing, fallback);
 
-    SECTION("tryExpand always returns 0")
+    SECTION("The last allocation grows in place")
     {
         auto result = arena.alloc(16, align::system());
-        REQUIRE(arena.tryExpand(32, result.buffer) == 0);
-        REQUIRE(arena.tryExpand(0, nullptr) == 0);
+        const byte_size used = arena.usedBytes();
+
+        REQUIRE(arena.tryExpand(100, result.buffer) == 100);
+        CHECK(arena.usedBytes() == used + 84);
+
+        // Next allocations go after the expanded block.
+        auto next = arena.alloc(16, align::system());
+        CHECK(static_cast<uint8_t*>(next.buffer) >= static_cast<uint8_t*>(result.buffer) + 100);
+    }
+
+    SECTION("Smaller sizes keep the current one")
+    {
+        auto result = arena.alloc(64, align::system());
+        CHECK(arena.tryExpand(32, result.buffer) == 64);
+        CHECK(arena.tryExpand(64, result.buffer) == 64);
+    }
+
+    SECTION("Growth beyond the arena keeps the current size")
+    {
+        auto result = arena.alloc(16, align::system());
+        const byte_size used = arena.usedBytes();
+
+        CHECK(arena.tryExpand(2048, result.buffer) == 16);
+        CHECK(arena.usedBytes() == used);
+    }
+
+    SECTION("Other arena blocks do not grow")
+    {
+        auto first = arena.alloc(16, align::system());
+        arena.alloc(16, align::system());
+
+        CHECK(arena.tryExpand(32, first.buffer) == 0);
+        CHECK(arena.tryExpand(0, nullptr) == 0);
+    }
+
+    SECTION("Fallback blocks delegate to the fallback allocator")
+    {
+        auto fallbackResult = fallback.alloc(16, align::system());
+        CHECK(arena.tryExpand(32, fallbackResult.buffer) == 0);
+        arena.free(fallbackResult.buffer);
+    }
+}
+
+TEST_CASE("ArenaAllocator lets darray grow in place", "[ArenaAllocator][tryExpand][darray]")
+{
+    MockFallbackAllocator fallback;
+    uint8_t buffer[4096] = {0};
+    ArenaAllocator arena(span<uint8_t>(buffer, 4096), fallback);
+
+    darray<int> values(arena);
+    values.push_back(0);
+    const int* data = values.data();
+
+    while (values.size() < 512)
+        values.push_back(int(values.size()));
+
+    CHECK(values.data() == data);
+    CHECK(values[100] == 100);
+
+    // The arena is exhausted: the items move to the fallback allocator.
+    while (values.size() < 2048)
+        values.push_back(int(values.size()));
+
+    CHECK(fallback.allocatedBlocks.size() == 1);
+    CHECK(values[100] == 100);
+    CHECK(values.back() == 2047);
+
+    // The arena block was the last one, so it has been returned.
+    CHECK(arena.usedBytes() == 0);
+}
+
+TEST_CASE("ArenaAllocator grows darray to the required size", "[ArenaAllocator][tryExpand][darray]")
+{
+    MockFallbackAllocator fallback;
+    uint8_t buffer[4096] = {0};
+    ArenaAllocator arena(span<uint8_t>(buffer, 4096), fallback);
+
+    darray<int> values(arena);
+    values.reserve(600);
+    const int* data = values.data();
+
+    // Twice the capacity does not fit in the arena, but the required size does.
+    values.reserve(1000);
+
+    CHECK(values.data() == data);
+    CHECK(values.capacity() >= 1000);
+    CHECK(fallback.allocatedBlocks.empty());
+}
+
+TEST_CASE("ArenaAllocator mark and rewind", "[ArenaAllocator][rewind]")
+{
+    MockFallbackAllocator fallback;
+    uint8_t buffer[1024] = {0};
+    span<uint8_t> backing(buffer, 1024);
+    ArenaAllocator arena(backing, fallback);
+
+    auto outer = arena.alloc(16, align::system());
+
+    SECTION("Rewind releases the later allocations")
+    {
+        const ArenaAllocator::Mark mark = arena.mark();
+        auto first = arena.alloc(100, align::system());
+        arena.alloc(200, align::system());
+
+        arena.rewind(mark);
+        CHECK(arena.usedBytes() == mark.usedBytes);
+
+        auto reused = arena.alloc(100, align::system());
+        CHECK(reused.buffer == first.buffer);
+    }
+
+    SECTION("Rewind restores the last block")
+    {
+        const ArenaAllocator::Mark mark = arena.mark();
+        arena.alloc(100, align::system());
+        arena.rewind(mark);
+
+        CHECK(arena.tryExpand(32, outer.buffer) == 32);
+    }
+
+    SECTION("Nested scopes")
+    {
+        const byte_size initialUsed = arena.usedBytes();
+        {
+            ArenaAllocator::Scope stage1(arena);
+            arena.alloc(100, align::system());
+            const byte_size stage1Used = arena.usedBytes();
+            {
+                ArenaAllocator::Scope stage2(arena);
+                arena.alloc(200, align::system());
+                CHECK(arena.usedBytes() > stage1Used);
+            }
+            CHECK(arena.usedBytes() == stage1Used);
+        }
+        CHECK(arena.usedBytes() == initialUsed);
+    }
+
+    SECTION("The last block does not grow inside a scope")
+    {
+        const ArenaAllocator::Mark mark = arena.mark();
+        CHECK(arena.tryExpand(64, outer.buffer) == 0);
+
+        auto inner = arena.alloc(16, align::system());
+        CHECK(static_cast<uint8_t*>(inner.buffer) >= static_cast<uint8_t*>(outer.buffer) + outer.bytes);
+
+        arena.rewind(mark);
+        CHECK(arena.usedBytes() == mark.usedBytes);
+        CHECK(arena.tryExpand(64, outer.buffer) == 64);
+    }
+
+    SECTION("Freeing the last block inside a scope")
+    {
+        const byte_size initialUsed = arena.usedBytes();
+        {
+            ArenaAllocator::Scope stage(arena);
+            arena.free(outer.buffer);
+            CHECK(arena.usedBytes() == initialUsed);
+
+            auto inner = arena.alloc(8, align::system());
+            CHECK(inner.buffer != outer.buffer);
+        }
+        CHECK(arena.usedBytes() == initialUsed);
+
+        auto next = arena.alloc(8, align::system());
+        CHECK(static_cast<uint8_t*>(next.buffer) >= static_cast<uint8_t*>(outer.buffer) + outer.bytes);
+    }
+
+    SECTION("Fallback blocks are not released")
+    {
+        {
+            ArenaAllocator::Scope stage(arena);
+            auto big = arena.alloc(2048, align::system());
+            CHECK(fallback.allocatedBlocks.size() == 1);
+            arena.free(big.buffer);
+        }
+        CHECK(fallback.freedBlocks.size() == 1);
     }
 }
 
@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2026 Guillermo Hernan Martin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "pch-collib-tests.h"
+#include "allocators/growable_lean_tree_allocator.h"
+#include "darray.h"
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace coll;
+
+static GrowableLeanTreeAllocator::Parameters makeParams(count_t maxRegions, count_t emptyRegionsKept = 1)
+{
+    GrowableLeanTreeAllocator::Parameters params;
+    params.tree.basicBlockSize = Power2::round_up(16);
+    params.tree.totalSize = Power2::round_up(64 * 1024);
+    params.tree.maxAllocSize = Power2::round_up(8 * 1024);
+    params.maxRegions = maxRegions;
+    params.emptyRegionsKept = emptyRegionsKept;
+
+    return params;
+}
+
+// Allocates 'maxAllocSize' blocks until 'regions' regions are in use. The last one holds a
+// single block, and the other ones are full.
+static std::vector<void*> fillRegions(GrowableLeanTreeAllocator& allocator, count_t regions)
+{
+    const byte_size blockSize = allocator.params().tree.maxAllocSize.value();
+    std::vector<void*> blocks;
+
+    while (allocator.regionCount() < regions || blocks.empty())
+    {
+        const SAllocResult r = allocator.alloc(blockSize, align::system());
+        if (r.buffer == nullptr)
+            break;
+
+        blocks.push_back(r.buffer);
+    }
+
+    return blocks;
+}
+
+TEST_CASE("GrowableLeanTreeAllocator construction", "[allocator][lean_tree][growable]")
+{
+    GrowableLeanTreeAllocator allocator(defaultAllocator(), makeParams(4));
+
+    CHECK(allocator.regionCount() == 1);
+    CHECK(allocator.stats().bytesUsed == 0);
+    CHECK(allocator.stats().totalBytes == 64 * 1024);
+    CHECK(allocator.validate(std::cerr));
+
+    SECTION("The documented configuration")
+    {
+        GrowableLeanTreeAllocator::Parameters params;
+        params.tree.totalSize = Power2::round_up(1024 * 1024);
+        params.tree.maxAllocSize = Power2::round_up(64 * 1024);
+        params.maxRegions = 16;
+
+        GrowableLeanTreeAllocator documented(defaultAllocator(), params);
+        std::vector<void*> blocks = fillRegions(documented, 2);
+        CHECK(documented.regionCount() == 2);
+        CHECK(documented.validate(std::cerr));
+
+        for (void* block : blocks)
+            documented.free(block);
+        CHECK(documented.stats().bytesUsed == 0);
+    }
+
+    SECTION("Parameters are corrected like LeanTreeAllocator ones")
+    {
+        auto params = makeParams(0);
+        params.tree.maxAllocSize = Power2::round_up(128 * 1024);
+
+        GrowableLeanTreeAllocator corrected(defaultAllocator(), params);
+        CHECK(corrected.params().maxRegions == 1);
+        CHECK(corrected.params().tree.maxAllocSize.value() == 64 * 1024);
+    }
+}
+
+TEST_CASE("GrowableLeanTreeAllocator grows", "[allocator][lean_tree][growable]")
+{
+    GrowableLeanTreeAllocator allocator(defaultAllocator(), makeParams(4));
+
+    SECTION("New regions are added on demand")
+    {
+        std::vector<void*> blocks = fillRegions(allocator, 3);
+        CHECK(allocator.regionCount() == 3);
+        CHECK(allocator.stats().totalBytes == 3 * 64 * 1024);
+        CHECK(allocator.stats().bytesUsed == blocks.size() * 8 * 1024);
+        CHECK(allocator.validate(std::cerr));
+
+        for (size_t i = 0; i < blocks.size(); ++i)
+            memset(blocks[i], int(i), 8 * 1024);
+
+        for (size_t i = 0; i < blocks.size(); ++i)
+        {
+            REQUIRE(*static_cast<uint8_t*>(blocks[i]) == uint8_t(i));
+            allocator.free(blocks[i]);
+        }
+
+        CHECK(allocator.stats().bytesUsed == 0);
+        CHECK(allocator.validate(std::cerr));
+    }
+
+    SECTION("Up to maxRegions")
+    {
+        std::vector<void*> blocks = fillRegions(allocator, 10);
+        CHECK(allocator.regionCount() == 4);
+        CHECK(allocator.stats().bytesUsed == allocator.stats().totalBytes - 4 * 8 * 1024);
+
+        const SAllocResult r = allocator.alloc(8 * 1024, align::system());
+        CHECK(r.buffer == nullptr);
+        CHECK(r.bytes == 0);
+
+        for (void* block : blocks)
+            allocator.free(block);
+        CHECK(allocator.validate(std::cerr));
+    }
+
+    SECTION("Requests larger than maxAllocSize fail")
+    {
+        const SAllocResult r = allocator.alloc(8 * 1024 + 1, align::system());
+        CHECK(r.buffer == nullptr);
+        CHECK(allocator.regionCount() == 1);
+    }
+
+    SECTION("Oldest regions are filled first")
+    {
+        std::vector<void*> blocks = fillRegions(allocator, 2);
+        REQUIRE(allocator.regionCount() == 2);
+
+        // A hole in the first region is reused before the second region.
+        allocator.free(blocks.front());
+        const SAllocResult r = allocator.alloc(8 * 1024, align::system());
+        CHECK(r.buffer == blocks.front());
+
+        blocks.front() = r.buffer;
+        for (void* block : blocks)
+            allocator.free(block);
+    }
+}
+
+TEST_CASE("GrowableLeanTreeAllocator stats", "[allocator][lean_tree][growable]")
+{
+    GrowableLeanTreeAllocator allocator(defaultAllocator(), makeParams(4));
+
+    // Only the first top level block holds the metadata.
+    CHECK(allocator.stats().largestFreeBlock == 8 * 1024);
+
+    std::vector<void*> blocks = fillRegions(allocator, 2);
+    REQUIRE(allocator.regionCount() == 2);
+
+    std::vector<void*> small;
+    for (int i = 0; i < 4; ++i)
+        small.push_back(allocator.alloc(1024, align::system()).buffer);
+
+    allocator.free(blocks.back());
+    allocator.free(small[1]);
+    blocks.pop_back();
+
+    const GrowableLeanTreeAllocator::Stats stats = allocator.stats();
+    CHECK(stats.largestFreeBlock > 0);
+    CHECK(stats.largestFreeBlock <= 8 * 1024);
+    CHECK(allocator.alloc(stats.largestFreeBlock, align::system()).buffer != nullptr);
+
+    for (void* block : blocks)
+        allocator.free(block);
+}
+
+TEST_CASE("GrowableLeanTreeAllocator alignment", "[allocator][lean_tree][growable]")
+{
+    auto params = makeParams(4);
+    params.tree.a = align::from_bytes(256);
+
+    GrowableLeanTreeAllocator allocator(defaultAllocator(), params);
+    std::vector<void*> blocks;
+
+    SECTION("Blocks are aligned up to the buffer alignment")
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            blocks.push_back(allocator.alloc(16, align::system()).buffer);
+
+            const SAllocResult r = allocator.alloc(16, align::from_bytes(128));
+            REQUIRE(r.buffer != nullptr);
+            CHECK(reinterpret_cast<uintptr_t>(r.buffer) % 128 == 0);
+            CHECK(r.bytes >= 128);
+            blocks.push_back(r.buffer);
+        }
+    }
+
+    SECTION("Larger alignments fail")
+    {
+        const SAllocResult r = allocator.alloc(16, align::from_bytes(512));
+        CHECK(r.buffer == nullptr);
+        CHECK(allocator.regionCount() == 1);
+    }
+
+    for (void* block : blocks)
+        allocator.free(block);
+    CHECK(allocator.validate(std::cerr));
+}
+
+TEST_CASE("GrowableLeanTreeAllocator releases empty regions", "[allocator][lean_tree][growable]")
+{
+    SECTION("All but 'emptyRegionsKept' empty regions are released")
+    {
+        GrowableLeanTreeAllocator allocator(defaultAllocator(), makeParams(4, 1));
+        std::vector<void*> blocks = fillRegions(allocator, 4);
+        REQUIRE(allocator.regionCount() == 4);
+
+        for (void* block : blocks)
+            allocator.free(block);
+
+        CHECK(allocator.regionCount() == 1);
+        CHECK(allocator.stats().totalBytes == 64 * 1024);
+        CHECK(allocator.validate(std::cerr));
+    }
+
+    SECTION("More empty regions kept")
+    {
+        GrowableLeanTreeAllocator allocator(defaultAllocator(), makeParams(4, 2));
+        std::vector<void*> blocks = fillRegions(allocator, 4);
+
+        for (void* block : blocks)
+            allocator.free(block);
+
+        CHECK(allocator.regionCount() == 2);
+        CHECK(allocator.validate(std::cerr));
+    }
+
+    SECTION("Load around a region boundary does not release the region")
+    {
+        GrowableLeanTreeAllocator allocator(defaultAllocator(), makeParams(4, 1));
+        std::vector<void*> blocks = fillRegions(allocator, 2);
+        REQUIRE(allocator.regionCount() == 2);
+
+        for (int i = 0; i < 10; ++i)
+        {
+            allocator.free(blocks.back());
+            CHECK(allocator.regionCount() == 2);
+
+            const SAllocResult r = allocator.alloc(8 * 1024, align::system());
+            REQUIRE(r.buffer != nullptr);
+            blocks.back() = r.buffer;
+            CHECK(allocator.regionCount() == 2);
+        }
+
+        for (void* block : blocks)
+            allocator.free(block);
+        CHECK(allocator.validate(std::cerr));
+    }
+
+    SECTION("Remaining regions are still reachable")
+    {
+        GrowableLeanTreeAllocator allocator(defaultAllocator(), makeParams(4, 0));
+        std::vector<void*> blocks = fillRegions(allocator, 3);
+        REQUIRE(allocator.regionCount() == 3);
+
+        // Releases the second region, so the third one takes its place.
+        const size_t blocksPerRegion = (blocks.size() - 1) / 2;
+        for (size_t i = blocksPerRegion; i < 2 * blocksPerRegion; ++i)
+            allocator.free(blocks[i]);
+
+        CHECK(allocator.regionCount() == 2);
+        CHECK(allocator.validate(std::cerr));
+
+        blocks.erase(blocks.begin() + blocksPerRegion, blocks.begin() + 2 * blocksPerRegion);
+        for (void* block : blocks)
+            allocator.free(block);
+
+        CHECK(allocator.stats().bytesUsed == 0);
+        CHECK(allocator.regionCount() == 1);
+    }
+}
+
+TEST_CASE("GrowableLeanTreeAllocator errors", "[allocator][lean_tree][growable]")
+{
+    GrowableLeanTreeAllocator allocator(defaultAllocator(), makeParams(4));
+    int notManaged = 0;
+
+    CHECK_THROWS(allocator.free(&notManaged));
+    CHECK_THROWS(allocator.tryExpand(64, &notManaged));
+    CHECK_THROWS(allocator.free(nullptr));
+    CHECK(allocator.tryExpand(64, nullptr) == 0);
+
+    const SAllocResult r = allocator.alloc(64, align::system());
+    CHECK_THROWS(allocator.free(static_cast<uint8_t*>(r.buffer) + 16));
+    allocator.free(r.buffer);
+}
+
+TEST_CASE("GrowableLeanTreeAllocator tryExpand", "[allocator][lean_tree][growable]")
+{
+    GrowableLeanTreeAllocator allocator(defaultAllocator(), makeParams(4));
+    std::vector<void*> blocks = fillRegions(allocator, 2);
+    REQUIRE(allocator.regionCount() == 2);
+
+    // Fills the free space beside the metadata of both regions, so the next small block starts
+    // a top level block of the second region.
+    for (int i = 0; i < 2; ++i)
+    {
+        for (byte_size bytes : {2048, 4096})
+        {
+            const SAllocResult r = allocator.alloc(bytes, align::system());
+            REQUIRE(r.buffer != nullptr);
+            blocks.push_back(r.buffer);
+        }
+    }
+
+    const byte_size usedBytes = allocator.stats().bytesUsed;
+    const SAllocResult r = allocator.alloc(64, align::system());
+    REQUIRE(allocator.regionCount() == 2);
+
+    CHECK(allocator.tryExpand(8 * 1024, r.buffer) == 8 * 1024);
+    CHECK(allocator.tryExpand(16 * 1024, r.buffer) == 8 * 1024);
+    CHECK(allocator.stats().bytesUsed == usedBytes + 8 * 1024);
+    CHECK(allocator.validate(std::cerr));
+
+    allocator.free(r.buffer);
+    for (void* block : blocks)
+        allocator.free(block);
+    CHECK(allocator.stats().bytesUsed == 0);
+}
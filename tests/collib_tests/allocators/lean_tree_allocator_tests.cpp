@@ -296,16 +296,140 @@ TEST_CASE("Coalesce freed blocks", "[allocator][lean_tree][coalesce]")
 }
 
 // -------------------------------------------------------------
-//  tryExpand (stub)
+//  tryExpand
 // -------------------------------------------------------------
-TEST_CASE("LeanTreeAllocator tryExpand default behavior", "[allocator][lean_tree][tryExpand]")
+
+// Allocates everything but a single block of maxAllocSize, and returns its address. The
+// allocated blocks are added to 'fillers'.
+static void* isolateTopBlock(LeanTreeAllocator& allocator, std::vector<void*>& fillers)
+{
+    const auto maxAllocSize = allocator.params().maxAllocSize.value();
+
+    for (byte_size size : {maxAllocSize, byte_size(1)})
+    {
+        while (true)
+        {
+            const auto r = allocator.alloc(size, align::system());
+            if (r.buffer == nullptr)
+                break;
+
+            fillers.push_back(r.buffer);
+        }
+    }
+
+    void* result = fillers.front();
+    allocator.free(result);
+    fillers.erase(fillers.begin());
+
+    return result;
+}
+
+TEST_CASE("LeanTreeAllocator tryExpand", "[allocator][lean_tree][tryExpand]")
 {
     DummyAllocator backing;
     LeanTreeAllocator allocator(backing);
 
-    auto result = allocator.alloc(64, align::system());
-    CHECK(allocator.tryExpand(128, result.buffer) == 0);
-    CHECK(allocator.tryExpand(0, nullptr) == 0);
+    const auto maxAllocSize = allocator.params().maxAllocSize.value();
+    const auto initialStats = allocator.stats();
+
+    std::vector<void*> fillers;
+    void* freeBlock = isolateTopBlock(allocator, fillers);
+    const auto baseUsed = allocator.stats().bytesUsed;
+
+    auto r = allocator.alloc(64, align::system());
+    REQUIRE(r.buffer == freeBlock);
+    memset(r.buffer, 0x5A, r.bytes);
+
+    SECTION("Grows over free buddies without moving")
+    {
+        CHECK(allocator.tryExpand(100, r.buffer) == 128);
+        CHECK(allocator.tryExpand(1000, r.buffer) == 1024);
+        CHECK(allocator.stats().bytesUsed == baseUsed + 1024);
+        CHECK(allocator.validate(std::cerr));
+
+        const uint8_t* data = static_cast<uint8_t*>(r.buffer);
+        CHECK(data[0] == 0x5A);
+        CHECK(data[63] == 0x5A);
+
+        // The grown block is released as a whole.
+        allocator.free(r.buffer);
+        CHECK(allocator.stats().bytesUsed == baseUsed);
+    }
+
+    SECTION("Smaller sizes return the current size")
+    {
+        CHECK(allocator.tryExpand(10, r.buffer) == 64);
+        CHECK(allocator.tryExpand(64, r.buffer) == 64);
+        allocator.free(r.buffer);
+    }
+
+    SECTION("Allocated buddy prevents growth")
+    {
+        auto buddy = allocator.alloc(64, align::system());
+        REQUIRE(static_cast<uint8_t*>(buddy.buffer) == static_cast<uint8_t*>(r.buffer) + 64);
+
+        CHECK(allocator.tryExpand(128, r.buffer) == 64);
+        CHECK(allocator.stats().bytesUsed == baseUsed + 128);
+        CHECK(allocator.validate(std::cerr));
 
-    allocator.free(result.buffer);
+        // A right buddy cannot grow either: its left neighbour would have to move.
+        allocator.free(r.buffer);
+        CHECK(allocator.tryExpand(128, buddy.buffer) == 64);
+        allocator.free(buddy.buffer);
+    }
+
+    SECTION("Does not grow partially, nor beyond maxAllocSize")
+    {
+        auto far = allocator.alloc(maxAllocSize / 2, align::system());
+        REQUIRE(static_cast<uint8_t*>(far.buffer) == static_cast<uint8_t*>(r.buffer) + maxAllocSize / 2);
+
+        CHECK(allocator.tryExpand(maxAllocSize, r.buffer) == 64);
+        allocator.free(far.buffer);
+
+        CHECK(allocator.tryExpand(maxAllocSize * 2, r.buffer) == 64);
+        CHECK(allocator.tryExpand(maxAllocSize, r.buffer) == maxAllocSize);
+        CHECK(allocator.validate(std::cerr));
+        allocator.free(r.buffer);
+    }
+
+    SECTION("Invalid pointers")
+    {
+        CHECK(allocator.tryExpand(128, nullptr) == 0);
+        REQUIRE_THROWS_AS(
+            allocator.tryExpand(128, static_cast<uint8_t*>(r.buffer) + 16),
+            std::runtime_error
+        );
+        allocator.free(r.buffer);
+    }
+
+    for (void* buffer : fillers)
+        allocator.free(buffer);
+
+    CHECK(allocator.stats() == initialStats);
+    CHECK(allocator.validate(std::cerr));
+}
+
+TEST_CASE("LeanTreeAllocator lets darray grow in place", "[allocator][lean_tree][tryExpand]")
+{
+    DummyAllocator backing;
+    LeanTreeAllocator allocator(backing);
+
+    std::vector<void*> fillers;
+    void* freeBlock = isolateTopBlock(allocator, fillers);
+
+    {
+        darray<int> values(allocator);
+        values.push_back(0);
+        CHECK(values.data() == freeBlock);
+
+        for (int i = 1; i < 1024; ++i)
+            values.push_back(i);
+
+        CHECK(values.data() == freeBlock);
+        CHECK(values[1000] == 1000);
+        CHECK(allocator.validate(std::cerr));
+    }
+
+    for (void* buffer : fillers)
+        allocator.free(buffer);
 }
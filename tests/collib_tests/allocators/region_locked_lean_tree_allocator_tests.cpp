@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2026 Guillermo Hernan Martin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "pch-collib-tests.h"
+#include "allocators/region_locked_lean_tree_allocator.h"
+#include "darray.h"
+
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace coll;
+
+static RegionLockedLeanTreeAllocator::Parameters makeParams(count_t regions)
+{
+    RegionLockedLeanTreeAllocator::Parameters params;
+    params.tree.basicBlockSize = Power2::round_up(16);
+    params.tree.totalSize = Power2::round_up(256 * 1024);
+    params.tree.maxAllocSize = Power2::round_up(8 * 1024);
+    params.regions = regions;
+
+    return params;
+}
+
+TEST_CASE("RegionLockedLeanTreeAllocator construction", "[allocator][lean_tree][region_locked]")
+{
+    SECTION("Regions are clamped to the top level blocks")
+    {
+        RegionLockedLeanTreeAllocator allocator(defaultAllocator(), makeParams(1000));
+        CHECK(allocator.regionCount() == 32);
+        CHECK(allocator.homeRegion() < allocator.regionCount());
+    }
+
+    SECTION("Top level blocks are spread evenly among regions")
+    {
+        RegionLockedLeanTreeAllocator allocator(defaultAllocator(), makeParams(5));
+        CHECK(allocator.regionCount() == 5);
+    }
+
+    SECTION("The documented configuration")
+    {
+        RegionLockedLeanTreeAllocator::Parameters params;
+        params.tree.totalSize = Power2::round_up(1024 * 1024);
+        params.tree.maxAllocSize = Power2::round_up(64 * 1024);
+        params.regions = 8;
+
+        RegionLockedLeanTreeAllocator allocator(defaultAllocator(), params);
+        CHECK(allocator.regionCount() == 8);
+
+        auto r = allocator.alloc(64 * 1024, align::system());
+        CHECK(r.buffer != nullptr);
+        allocator.free(r.buffer);
+        CHECK(allocator.validate(std::cerr));
+    }
+
+    SECTION("More than 64 top level blocks")
+    {
+        RegionLockedLeanTreeAllocator::Parameters params;
+        params.tree.basicBlockSize = Power2::round_up(256);
+        params.tree.totalSize = Power2::round_up(2 * 1024 * 1024);
+        params.tree.maxAllocSize = Power2::round_up(16 * 1024);
+        params.regions = 1000;
+
+        RegionLockedLeanTreeAllocator allocator(defaultAllocator(), params);
+        const auto initialStats = allocator.stats();
+        CHECK(allocator.regionCount() == 64);
+
+        // Every top level block but the metadata one, in every region.
+        darray<void*> allocations;
+        while (true)
+        {
+            const auto [buffer, size] = allocator.alloc(16 * 1024, align::system());
+            if (buffer == nullptr)
+                break;
+
+            allocations.push_back(buffer);
+        }
+
+        CHECK(allocations.size() == 127);
+        CHECK(allocator.validate(std::cerr));
+
+        for (void* buffer : allocations)
+            allocator.free(buffer);
+
+        CHECK(allocator.stats() == initialStats);
+        CHECK(allocator.validate(std::cerr));
+    }
+
+    SECTION("Basic blocks can hold a pointer")
+    {
+        RegionLockedLeanTreeAllocator::Parameters params;
+        params.tree.basicBlockSize = Power2::round_up(4);
+        params.regions = 4;
+
+        RegionLockedLeanTreeAllocator allocator(defaultAllocator(), params);
+        CHECK(allocator.params().tree.basicBlockSize.value() >= sizeof(void*));
+        CHECK(allocator.stats().bytesUsed == 0);
+        CHECK(allocator.validate(std::cerr));
+    }
+}
+
+TEST_CASE("RegionLockedLeanTreeAllocator alloc and free", "[allocator][lean_tree][region_locked]")
+{
+    RegionLockedLeanTreeAllocator allocator(defaultAllocator(), makeParams(8));
+    const auto initialStats = allocator.stats();
+
+    SECTION("Basic allocations")
+    {
+        auto r1 = allocator.alloc(64, align::system());
+        auto r2 = allocator.alloc(1000, align::system());
+        REQUIRE(r1.buffer != nullptr);
+        REQUIRE(r2.buffer != nullptr);
+        CHECK(r1.bytes == 64);
+        CHECK(r2.bytes == 1024);
+        CHECK(allocator.stats().bytesUsed == 64 + 1024);
+        CHECK(allocator.validate(std::cerr));
+
+        allocator.free(r1.buffer);
+        allocator.free(r2.buffer);
+        CHECK(allocator.stats() == initialStats);
+        CHECK(allocator.validate(std::cerr));
+    }
+
+    SECTION("Allocations come from the home region while it has room")
+    {
+        const auto params = allocator.params();
+        const byte_size regionBytes = params.tree.totalSize.value() / allocator.regionCount();
+
+        auto r1 = allocator.alloc(64, align::system());
+        auto r2 = allocator.alloc(64, align::system());
+        REQUIRE(r1.buffer != nullptr);
+
+        const uint8_t* p1 = static_cast<uint8_t*>(r1.buffer);
+        const uint8_t* p2 = static_cast<uint8_t*>(r2.buffer);
+        CHECK(byte_size(p2 > p1 ? p2 - p1 : p1 - p2) < regionBytes);
+
+        allocator.free(r1.buffer);
+        allocator.free(r2.buffer);
+    }
+
+    SECTION("Invalid pointers throw")
+    {
+        uint8_t buffer;
+        REQUIRE_THROWS_AS(allocator.free(&buffer), std::runtime_error);
+
+        auto r = allocator.alloc(64, align::system());
+        REQUIRE_THROWS_AS(allocator.free(static_cast<uint8_t*>(r.buffer) + 1), std::runtime_error);
+        allocator.free(r.buffer);
+    }
+
+    SECTION("Exhaustion uses every region")
+    {
+        darray<void*> allocations;
+
+        while (true)
+        {
+            const auto [buffer, size] = allocator.alloc(1024, align::system());
+            if (buffer == nullptr)
+                break;
+
+            allocations.push_back(buffer);
+        }
+
+        const auto params = allocator.params();
+        const byte_size usable = params.tree.totalSize.value() - initialStats.metaDataSize;
+        CHECK(allocations.size() * 1024 >= usable - 1024);
+        CHECK(allocator.validate(std::cerr));
+
+        for (void* buffer : allocations)
+            allocator.free(buffer);
+
+        CHECK(allocator.stats() == initialStats);
+        CHECK(allocator.validate(std::cerr));
+    }
+}
+
+TEST_CASE("RegionLockedLeanTreeAllocator from several threads", "[allocator][lean_tree][region_locked]")
+{
+    constexpr int threadCount = 4;
+    constexpr int rounds = 2000;
+
+    RegionLockedLeanTreeAllocator allocator(defaultAllocator(), makeParams(threadCount));
+    const auto initialStats = allocator.stats();
+
+    // Every thread hands its blocks to the next one, which frees them (remote frees, mostly).
+    std::vector<std::atomic<void*>> mailboxes(threadCount);
+    std::vector<std::thread> threads;
+    std::atomic<bool> ok = true;
+
+    for (auto& mailbox : mailboxes)
+        mailbox = nullptr;
+
+    for (int t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back(
+            [&, t]()
+            {
+                std::vector<SAllocResult> own;
+
+                for (int i = 0; i < rounds; ++i)
+                {
+                    const byte_size bytes = 16 + (i * 37 + t * 11) % 2000;
+                    const SAllocResult r = allocator.alloc(bytes, align::system());
+
+                    if (r.buffer != nullptr)
+                    {
+                        memset(r.buffer, t + 1, r.bytes);
+
+                        void* previous = mailboxes[(t + 1) % threadCount].exchange(r.buffer);
+                        if (previous != nullptr)
+                            allocator.free(previous);
+                    }
+
+                    void* received = mailboxes[t].exchange(nullptr);
+                    if (received != nullptr)
+                    {
+                        const uint8_t sender = uint8_t((t + threadCount - 1) % threadCount + 1);
+                        if (*static_cast<uint8_t*>(received) != sender)
+                            ok = false;
+                        allocator.free(received);
+                    }
+
+                    if (i % 3 == 0)
+                        own.push_back(allocator.alloc(64, align::system()));
+
+                    if (own.size() > 16)
+                    {
+                        for (auto& block : own)
+                        {
+                            if (block.buffer != nullptr)
+                                allocator.free(block.buffer);
+                        }
+                        own.clear();
+                    }
+                }
+
+                for (auto& block : own)
+                {
+                    if (block.buffer != nullptr)
+                        allocator.free(block.buffer);
+                }
+            }
+        );
+    }
+
+    // Stats may be read while the other threads work.
+    std::atomic<int> running = threadCount;
+    std::thread monitor(
+        [&]()
+        {
+            while (running.load() > 0)
+            {
+                const auto stats = allocator.stats();
+                if (stats.bytesUsed > stats.totalBytes)
+                    ok = false;
+            }
+        }
+    );
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+        --running;
+    }
+    monitor.join();
+
+    for (auto& mailbox : mailboxes)
+    {
+        if (void* buffer = mailbox.exchange(nullptr))
+            allocator.free(buffer);
+    }
+
+    CHECK(ok);
+    CHECK(allocator.validate(std::cerr));
+    CHECK(allocator.stats() == initialStats);
+}
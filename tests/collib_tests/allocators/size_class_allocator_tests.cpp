@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2026 Guillermo Hernan Martin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch-collib-tests.h"
+#include "allocators/size_class_allocator.h"
+#include "darray.h"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace coll;
+
+static bool isAligned(const void* ptr, byte_size bytes)
+{
+    return reinterpret_cast<uintptr_t>(ptr) % bytes == 0;
+}
+
+TEST_CASE("SizeClassAllocator is the default allocator", "[SizeClassAllocator]")
+{
+    CHECK(&defaultAllocator() == &SizeClassAllocator::instance());
+}
+
+TEST_CASE("SizeClassAllocator small blocks", "[SizeClassAllocator][alloc]")
+{
+    SizeClassAllocator& allocator = SizeClassAllocator::instance();
+
+    SECTION("Reports the usable size of the size class")
+    {
+        for (byte_size bytes : {1, 16, 17, 100, 129, 200, 1000, 5000, 8192})
+        {
+            const SAllocResult r = allocator.alloc(bytes, align::system());
+            REQUIRE(r.buffer != nullptr);
+            CHECK(r.bytes >= bytes);
+            CHECK(r.bytes <= bytes + bytes / 4 + 16);
+            CHECK(allocator.usableSize(r.buffer) == r.bytes);
+
+            // The whole usable size can be written.
+            memset(r.buffer, 0xAB, r.bytes);
+            allocator.free(r.buffer);
+        }
+    }
+
+    SECTION("Honors the requested alignment")
+    {
+        for (byte_size alignBytes = 1; alignBytes <= SizeClassAllocator::Limits::maxAlign.bytes(); alignBytes *= 2)
+        {
+            for (byte_size bytes : {1, 24, 100, 3000})
+            {
+                const SAllocResult r = allocator.alloc(bytes, align::from_bytes(alignBytes));
+                REQUIRE(r.buffer != nullptr);
+                CHECK(isAligned(r.buffer, alignBytes));
+                CHECK(isAligned(r.buffer, 16));
+                CHECK(r.bytes >= bytes);
+                allocator.free(r.buffer);
+            }
+        }
+    }
+
+    SECTION("Freed blocks are reused")
+    {
+        const SAllocResult r1 = allocator.alloc(48, align::system());
+        allocator.free(r1.buffer);
+
+        const SAllocResult r2 = allocator.alloc(40, align::system());
+        CHECK(r2.buffer == r1.buffer);
+        allocator.free(r2.buffer);
+    }
+
+    SECTION("Alignments beyond the limits fail")
+    {
+        const align tooLarge = align::from_bytes(SizeClassAllocator::Limits::chunkSize);
+        const SAllocResult r = allocator.alloc(16, tooLarge);
+        CHECK(r.buffer == nullptr);
+        CHECK(r.bytes == 0);
+    }
+
+    SECTION("Many blocks of every size")
+    {
+        std::vector<SAllocResult> blocks;
+        for (int i = 0; i < 5000; ++i)
+        {
+            const byte_size bytes = 1 + (i * 37) % SizeClassAllocator::Limits::maxSmallSize;
+            const SAllocResult r = allocator.alloc(bytes, align::system());
+            REQUIRE(r.buffer != nullptr);
+            memset(r.buffer, i & 0xFF, bytes);
+            blocks.push_back(r);
+        }
+
+        for (int i = 0; i < 5000; ++i)
+        {
+            const byte_size bytes = 1 + (i * 37) % SizeClassAllocator::Limits::maxSmallSize;
+            const uint8_t* data = static_cast<const uint8_t*>(blocks[i].buffer);
+            REQUIRE(data[0] == uint8_t(i & 0xFF));
+            REQUIRE(data[bytes - 1] == uint8_t(i & 0xFF));
+            allocator.free(blocks[i].buffer);
+        }
+    }
+}
+
+TEST_CASE("SizeClassAllocator medium blocks", "[SizeClassAllocator][alloc]")
+{
+    SizeClassAllocator& allocator = SizeClassAllocator::instance();
+    const SizeClassAllocator::Stats before = allocator.stats();
+
+    SECTION("Reports the usable size of the size class")
+    {
+        for (byte_size bytes : {8193, 10'000, 50'000, 100'000, 200'000, 256 * 1024})
+        {
+            const SAllocResult r = allocator.alloc(bytes, align::system());
+            REQUIRE(r.buffer != nullptr);
+            CHECK(r.bytes >= bytes);
+            CHECK(r.bytes <= bytes + bytes / 4 + 16);
+            CHECK(allocator.usableSize(r.buffer) == r.bytes);
+            CHECK(allocator.tryExpand(r.bytes + 1, r.buffer) == r.bytes);
+
+            memset(r.buffer, 0xAB, r.bytes);
+            allocator.free(r.buffer);
+        }
+    }
+
+    SECTION("Honors the requested alignment")
+    {
+        const byte_size maxAlign = SizeClassAllocator::Limits::maxAlign.bytes();
+
+        for (byte_size alignBytes = 1; alignBytes <= maxAlign; alignBytes *= 2)
+        {
+            for (byte_size bytes : {9000, 70'000, 256 * 1024})
+            {
+                const SAllocResult r = allocator.alloc(bytes, align::from_bytes(alignBytes));
+                REQUIRE(r.buffer != nullptr);
+                CHECK(isAligned(r.buffer, alignBytes));
+                CHECK(r.bytes >= bytes);
+                allocator.free(r.buffer);
+            }
+        }
+    }
+
+    SECTION("Freed blocks are reused")
+    {
+        const SAllocResult r1 = allocator.alloc(100'000, align::system());
+        allocator.free(r1.buffer);
+
+        const SAllocResult r2 = allocator.alloc(99'000, align::system());
+        CHECK(r2.buffer == r1.buffer);
+        allocator.free(r2.buffer);
+    }
+
+    SECTION("Many blocks share their spans")
+    {
+        std::vector<SAllocResult> blocks;
+        byte_size usedBytes = 0;
+
+        for (int i = 0; i < 2000; ++i)
+        {
+            const byte_size bytes = 8 * 1024 + 1 + (i * 7919) % (64 * 1024);
+            const SAllocResult r = allocator.alloc(bytes, align::system());
+            REQUIRE(r.buffer != nullptr);
+            memset(r.buffer, i & 0xFF, bytes);
+            blocks.push_back(r);
+            usedBytes += r.bytes;
+        }
+
+        // No block got its own mapping, and the spans are mostly used.
+        const SizeClassAllocator::Stats allocated = allocator.stats();
+        CHECK(allocated.largeBlocks == before.largeBlocks);
+        CHECK(allocated.spanBytes - before.spanBytes <= usedBytes + usedBytes / 4);
+
+        for (int i = 0; i < 2000; ++i)
+        {
+            REQUIRE(*static_cast<const uint8_t*>(blocks[i].buffer) == uint8_t(i & 0xFF));
+            allocator.free(blocks[i].buffer);
+        }
+    }
+
+    CHECK(allocator.stats().largeBlocks == before.largeBlocks);
+}
+
+TEST_CASE("SizeClassAllocator large blocks", "[SizeClassAllocator][alloc]")
+{
+    SizeClassAllocator& allocator = SizeClassAllocator::instance();
+    const SizeClassAllocator::Stats before = allocator.stats();
+
+    const SAllocResult r = allocator.alloc(1'000'000, align::from_bytes(4096));
+    REQUIRE(r.buffer != nullptr);
+    CHECK(isAligned(r.buffer, 4096));
+    CHECK(r.bytes >= 1'000'000);
+    CHECK(allocator.usableSize(r.buffer) == r.bytes);
+    memset(r.buffer, 0x5A, r.bytes);
+
+    const SizeClassAllocator::Stats allocated = allocator.stats();
+    CHECK(allocated.largeBlocks == before.largeBlocks + 1);
+    CHECK(allocated.largeBytes >= before.largeBytes + r.bytes);
+
+    allocator.free(r.buffer);
+    const SizeClassAllocator::Stats freed = allocator.stats();
+    CHECK(freed.largeBlocks == before.largeBlocks);
+    CHECK(freed.largeBytes == before.largeBytes);
+    CHECK(freed.cachedBytes > 0);
+
+    // The freed mapping, or another cached one, is reused.
+    const SAllocResult reused = allocator.alloc(1'000'000, align::from_bytes(4096));
+    REQUIRE(reused.buffer != nullptr);
+    CHECK(reused.bytes >= 1'000'000);
+    CHECK(allocator.stats().cachedBytes < freed.cachedBytes);
+    memset(reused.buffer, 0xA5, reused.bytes);
+
+    allocator.free(reused.buffer);
+    CHECK(allocator.stats().largeBlocks == before.largeBlocks);
+}
+
+TEST_CASE("SizeClassAllocator tryExpand", "[SizeClassAllocator][tryExpand]")
+{
+    SizeClassAllocator& allocator = SizeClassAllocator::instance();
+
+    SECTION("Small blocks expand within their size class")
+    {
+        const SAllocResult r = allocator.alloc(100, align::system());
+        CHECK(allocator.tryExpand(r.bytes, r.buffer) == r.bytes);
+
+        // Does not fit: keeps the original size.
+        CHECK(allocator.tryExpand(r.bytes + 1, r.buffer) == r.bytes);
+        allocator.free(r.buffer);
+    }
+
+    SECTION("Large blocks expand in place")
+    {
+        const byte_size bytes = SizeClassAllocator::Limits::maxMediumSize + 1;
+        const SAllocResult r = allocator.alloc(bytes, align::system());
+        REQUIRE(r.buffer != nullptr);
+        memset(r.buffer, 0x11, r.bytes);
+
+        const byte_size expanded = allocator.tryExpand(4 * r.bytes, r.buffer);
+        REQUIRE(expanded >= 4 * r.bytes);
+        CHECK(allocator.usableSize(r.buffer) == expanded);
+
+        uint8_t* data = static_cast<uint8_t*>(r.buffer);
+        CHECK(data[r.bytes - 1] == 0x11);
+        memset(data, 0x22, expanded);
+
+        // Beyond the reserved address space: keeps the current size.
+        CHECK(allocator.tryExpand(byte_size(64) << 30, r.buffer) == expanded);
+        allocator.free(r.buffer);
+    }
+
+    SECTION("Null buffer")
+    {
+        CHECK(allocator.tryExpand(16, nullptr) == 0);
+    }
+}
+
+TEST_CASE("SizeClassAllocator lets darray grow in place", "[SizeClassAllocator][darray]")
+{
+    darray<uint64_t> values;
+
+    while (values.capacity() * sizeof(uint64_t) <= SizeClassAllocator::Limits::maxMediumSize)
+        values.push_back(values.size());
+    values.push_back(values.size());
+
+    // Already on a large block: it grows without moving.
+    const uint64_t* data = values.data();
+    while (values.size() < 256 * 1024)
+        values.push_back(values.size());
+
+    CHECK(values.data() == data);
+    CHECK(values[1000] == 1000);
+    CHECK(values.back() == 256 * 1024 - 1);
+}
+
+TEST_CASE("SizeClassAllocator from several threads", "[SizeClassAllocator][threads]")
+{
+    SizeClassAllocator& allocator = SizeClassAllocator::instance();
+    constexpr int threadCount = 4;
+    constexpr int blocksPerThread = 20'000;
+
+    std::vector<std::vector<void*>> produced(threadCount);
+    std::vector<std::thread> threads;
+
+    // Every thread allocates its blocks...
+    for (int t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back(
+            [&, t]()
+            {
+                for (int i = 0; i < blocksPerThread; ++i)
+                {
+                    const byte_size bytes = 8 + (i * 13 + t) % 2000;
+                    const SAllocResult r = allocator.alloc(bytes, align::system());
+                    if (r.buffer == nullptr)
+                        break;
+                    memset(r.buffer, t, bytes);
+                    produced[t].push_back(r.buffer);
+                }
+            }
+        );
+    }
+    for (auto& thread : threads)
+        thread.join();
+    threads.clear();
+
+    // ... and the next one releases them.
+    std::atomic<bool> ok = true;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        REQUIRE(produced[t].size() == blocksPerThread);
+        threads.emplace_back(
+            [&, t]()
+            {
+                const int owner = (t + 1) % threadCount;
+                for (void* block : produced[owner])
+                {
+                    if (*static_cast<uint8_t*>(block) != uint8_t(owner))
+                        ok = false;
+                    allocator.free(block);
+                }
+            }
+        );
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    CHECK(ok);
+}
@@ -27,6 +27,11 @@
 #include "life_cycle_object.h"
 #include "mem_check_fixture.h"
 
+#include <algorithm>
+#include <cctype>
+#include <functional>
+#include <thread>
+
 using namespace coll;
 
 template <typename Map>
@@ -150,6 +155,94 @@ TEST_CASE_METHOD(BTreeTests, "Constructores y operadores de bmap", "[std_map][co
     }
 }
 
+// Valor cuya copia falla después de un número dado de copias.
+struct ThrowingCopy
+{
+    static inline int copiesLeft = -1;
+
+    int value = 0;
+
+    ThrowingCopy(int v)
+        : value(v)
+    {
+    }
+    ThrowingCopy(const ThrowingCopy& rhs)
+        : value(rhs.value)
+    {
+        if (copiesLeft == 0)
+            throw std::runtime_error("ThrowingCopy");
+        if (copiesLeft > 0)
+            --copiesLeft;
+    }
+    ThrowingCopy(ThrowingCopy&&) = default;
+};
+
+TEST_CASE_METHOD(BTreeTests, "Copia de bmap nodo a nodo", "[std_map][copy_move]")
+{
+    // Tamaños de las hojas en orden, que la copia debe conservar.
+    auto leafSizes = [](const auto& m)
+    {
+        std::vector<count_t> sizes;
+        m.for_each_leaf_chunk([&sizes](auto keys, auto) { sizes.push_back(keys.size()); });
+        return sizes;
+    };
+
+    auto testCopy = [&](auto m)
+    {
+        for (int i = 0; i < 3000; ++i)
+            m.insert((i * 7919) % 5000, std::to_string(i));
+        for (int i = 0; i < 5000; i += 3)
+            m.erase(i);
+
+        const auto copy(m);
+        CHECK(checkMap(copy));
+        CHECK(copy == m);
+        CHECK(leafSizes(copy) == leafSizes(m));
+
+        // La copia es independiente del original.
+        m[1] = "cambiado";
+        CHECK(copy.at(1) != "cambiado");
+
+        auto target = decltype(m) {{1, "uno"}, {2, "dos"}};
+        target = copy;
+        CHECK(checkMap(target));
+        CHECK(target == copy);
+
+        target = decltype(m) {};
+        target = decltype(m)(target);
+        CHECK(target.empty());
+    };
+
+    testCopy(bmap<int, std::string, 3> {});
+    testCopy(bmap<int, std::string, 16> {});
+    testCopy(bmap<int, std::string, 4, BMapOptions {.SeparateValues = true}> {});
+    testCopy(bmap<int, std::string, 4, BMapOptions {.OrderStatistics = true}> {});
+    testCopy(bmap<int, std::string, 4, BMapOptions {.Snapshots = true}> {});
+
+    SECTION("Una copia que falla no pierde memoria ni cambia el destino")
+    {
+        using Map = bmap<int, ThrowingCopy, 4>;
+
+        Map source;
+        for (int i = 0; i < 500; ++i)
+            source.insert(i, ThrowingCopy(i));
+
+        Map target;
+        target.insert(-1, ThrowingCopy(-1));
+
+        ThrowingCopy::copiesLeft = 250;
+        CHECK_THROWS_AS(Map(source), std::runtime_error);
+
+        ThrowingCopy::copiesLeft = 100;
+        CHECK_THROWS_AS(target = source, std::runtime_error);
+        ThrowingCopy::copiesLeft = -1;
+
+        CHECK(target.size() == 1);
+        CHECK(target.at(-1).value == -1);
+        CHECK(checkMap(target));
+    }
+}
+
 TEST_CASE_METHOD(
     BTreeTests,
     "Recorrido con range for de bmap: valores, directo e inverso",
@@ -669,3 +762,1754 @@ TEST_CASE_METHOD(
             CHECK(!it);
     }
 }
+
+template <typename Key, byte_size Order>
+static void checkNodeSearch(std::mt19937_64& rng)
+{
+    using Search = NodeSearch<Key, Order>;
+
+    // Los nodos pueden estar parcialmente llenos: se prueban todos los tamaños.
+    for (count_t count = 0; count <= Order; ++count)
+    {
+        std::vector<Key> keys;
+        for (count_t i = 0; i < count; ++i)
+            keys.push_back(Key(i * 3 + 1));
+
+        if constexpr (std::is_signed_v<Key>)
+        {
+            for (auto& key : keys)
+                key = key - Key(Order);
+        }
+
+        std::vector<Key> probes(keys.begin(), keys.end());
+        std::uniform_int_distribution<int> dist(-int(Order) * 2, int(Order) * 4);
+        for (int i = 0; i < 64; ++i)
+            probes.push_back(Key(dist(rng)));
+
+        for (const Key& probe : probes)
+        {
+            count_t lower = 0;
+            while (lower < count && keys[lower] < probe)
+                ++lower;
+
+            count_t upper = 0;
+            while (upper < count && !(probe < keys[upper]))
+                ++upper;
+
+            REQUIRE(Search::lower_bound(keys.data(), count, probe) == lower);
+            REQUIRE(Search::upper_bound(keys.data(), count, probe) == upper);
+        }
+    }
+}
+
+TEST_CASE_METHOD(BTreeTests, "NodeSearch coincide con la búsqueda lineal", "[btree][node_search]")
+{
+    std::mt19937_64 rng(12345);
+
+    checkNodeSearch<int, 4>(rng);
+    checkNodeSearch<int, 16>(rng);
+    checkNodeSearch<int, 64>(rng);
+    checkNodeSearch<int, 255>(rng);
+    checkNodeSearch<unsigned, 33>(rng);
+    checkNodeSearch<int64_t, 64>(rng);
+    checkNodeSearch<uint64_t, 17>(rng);
+    checkNodeSearch<float, 64>(rng);
+    checkNodeSearch<double, 31>(rng);
+    checkNodeSearch<short, 64>(rng);
+    checkNodeSearch<LifeCycleObject, 40>(rng);
+}
+
+template <typename Key>
+static void checkSimdKeyMap(const std::vector<Key>& keys)
+{
+    bmap<Key, int, 64> m;
+
+    for (size_t i = 0; i < keys.size(); ++i)
+        m[keys[i]] = int(i);
+
+    CHECK(checkMap(m));
+    REQUIRE(m.size() == keys.size());
+
+    for (size_t i = 0; i < keys.size(); ++i)
+        CHECK(m.at(keys[i]) == int(i));
+
+    for (size_t i = 0; i < keys.size(); i += 2)
+        CHECK(m.erase(keys[i]));
+
+    CHECK(checkMap(m));
+    for (size_t i = 0; i < keys.size(); ++i)
+        CHECK(m.contains(keys[i]) == (i % 2 != 0));
+}
+
+TEST_CASE_METHOD(BTreeTests, "bmap con claves aptas para SIMD", "[btree][node_search]")
+{
+    std::mt19937_64 rng(12345);
+    const int count = 3000;
+
+    SECTION("uint32_t por encima de INT32_MAX")
+    {
+        std::vector<uint32_t> keys;
+        for (int i = 0; i < count; ++i)
+            keys.push_back(uint32_t(rng()) | (i % 2 == 0 ? 0x80000000u : 0u));
+
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        std::shuffle(keys.begin(), keys.end(), rng);
+        checkSimdKeyMap(keys);
+    }
+
+    SECTION("int64_t con negativos")
+    {
+        std::vector<int64_t> keys;
+        for (int64_t i = 0; i < count; ++i)
+            keys.push_back((i - count / 2) * 0x100000001LL);
+
+        std::shuffle(keys.begin(), keys.end(), rng);
+        checkSimdKeyMap(keys);
+    }
+
+    SECTION("double y float")
+    {
+        std::vector<double> dkeys;
+        std::vector<float> fkeys;
+        for (int i = 0; i < count; ++i)
+        {
+            dkeys.push_back((i - count / 2) * 0.25);
+            fkeys.push_back(float(i - count / 2) * 0.5f);
+        }
+
+        std::shuffle(dkeys.begin(), dkeys.end(), rng);
+        std::shuffle(fkeys.begin(), fkeys.end(), rng);
+        checkSimdKeyMap(dkeys);
+        checkSimdKeyMap(fkeys);
+    }
+}
+
+TEST_CASE_METHOD(BTreeTests, "bmap range() y count()", "[std_map][range][count]")
+{
+    bmap<int, int, 4> m;
+    const int total = 500;
+
+    // Solo claves pares, para que haya huecos entre ellas.
+    for (int i = 0; i < total; ++i)
+        m[i * 2] = i;
+
+    auto collect = [](auto range)
+    {
+        std::vector<int> keys;
+        for (const auto entry : range)
+            keys.push_back(entry.key);
+        return keys;
+    };
+
+    auto expected = [total](int first, int last)
+    {
+        std::vector<int> keys;
+        for (int k = std::max(first + (first & 1), 0); k < std::min(last, total * 2); k += 2)
+            keys.push_back(k);
+        return keys;
+    };
+
+    SECTION("Rango semiabierto [keyLeft, keyRight)")
+    {
+        CHECK(collect(m.range(10, 20)) == expected(10, 20));
+        CHECK(collect(m.range(11, 21)) == expected(12, 22));
+        CHECK(collect(m.range(-100, 7)) == expected(-100, 7));
+        CHECK(collect(m.range(990, 5000)) == expected(990, 5000));
+    }
+
+    SECTION("Rangos que cruzan muchas hojas")
+    {
+        for (int left = -3; left < total * 2 + 3; left += 37)
+            for (int right = left; right < total * 2 + 3; right += 53)
+                REQUIRE(collect(m.range(left, right)) == expected(left, right));
+    }
+
+    SECTION("Rangos vacíos")
+    {
+        CHECK(m.range(20, 20).empty());
+        CHECK(m.range(21, 22).empty());
+        CHECK(m.range(20, 10).empty());
+        CHECK(m.range(5000, 6000).empty());
+    }
+
+    SECTION("count()")
+    {
+        for (int k = -2; k < total * 2 + 2; ++k)
+            REQUIRE(m.count(k) == ((k >= 0 && k < total * 2 && k % 2 == 0) ? 1u : 0u));
+    }
+}
+
+TEST_CASE_METHOD(BTreeTests, "bmap find_batch()", "[std_map][find][find_batch]")
+{
+    using Map = bmap<int, std::string, 4>;
+
+    Map m;
+    const int total = 3000;
+
+    // Claves múltiplo de 3, para que la mitad de las búsquedas fallen.
+    for (int i = 0; i < total; ++i)
+        m[i * 3] = std::to_string(i);
+
+    auto checkBatch = [&m](const std::vector<int>& keys)
+    {
+        std::vector<Map::Handle> results(keys.size());
+        const span<const int> keySpan(keys.data(), keys.size());
+        m.find_batch(keySpan, make_span(results.data(), results.size()));
+
+        for (size_t i = 0; i < keys.size(); ++i)
+            REQUIRE(results[i] == m.find(keys[i]));
+    };
+
+    SECTION("Claves desordenadas")
+    {
+        std::vector<int> keys;
+        for (int i = 0; i < 1000; ++i)
+            keys.push_back((i * 7919) % (total * 4) - 10);
+
+        checkBatch(keys);
+    }
+
+    SECTION("Claves ordenadas, con repeticiones y saltos")
+    {
+        std::vector<int> keys;
+        for (int k = -5; k < total * 3 + 5; k += (k % 50 == 0) ? 400 : 1)
+            keys.push_back(k);
+        keys.push_back(keys.back());
+
+        checkBatch(keys);
+    }
+
+    SECTION("Lotes pequeños y mapa vacío")
+    {
+        checkBatch({});
+        checkBatch({3});
+        checkBatch({6, 3});
+
+        m.clear();
+        checkBatch({1, 2, 3});
+    }
+
+    SECTION("El resultado debe tener sitio para todas las claves")
+    {
+        const int keys[] = {1, 2, 3};
+        Map::Handle results[2];
+
+        CHECK_THROWS_AS(
+            m.find_batch(span<const int>(keys, 3), make_span(results, 2)),
+            std::invalid_argument
+        );
+    }
+}
+
+TEST_CASE_METHOD(BTreeTests, "bmap insert_sorted() y erase_sorted()", "[btree][sorted_batch]")
+{
+    auto checkSame = [](const auto& m, const std::map<int, std::string>& expected)
+    {
+        REQUIRE(m.size() == expected.size());
+
+        auto it = expected.begin();
+        for (const auto entry : m)
+        {
+            REQUIRE(entry.key == it->first);
+            REQUIRE(entry.value == it->second);
+            ++it;
+        }
+    };
+
+    auto makeEntries = [](int first, int last, int step)
+    {
+        std::vector<std::pair<int, std::string>> entries;
+        for (int k = first; k < last; k += step)
+            entries.emplace_back(k, std::to_string(k));
+        return entries;
+    };
+
+    auto testOrder = [&](auto m)
+    {
+        std::map<int, std::string> expected;
+
+        auto insertSorted = [&](const std::vector<std::pair<int, std::string>>& entries)
+        {
+            size_t newEntries = 0;
+            for (const auto& entry : entries)
+                newEntries += expected.insert(entry).second ? 1 : 0;
+
+            CHECK(m.insert_sorted(entries) == newEntries);
+            CHECK(checkMap(m));
+            checkSame(m, expected);
+        };
+
+        auto eraseSorted = [&](const std::vector<int>& keys)
+        {
+            size_t erased = 0;
+            for (int key : keys)
+                erased += expected.erase(key);
+
+            CHECK(m.erase_sorted(keys) == erased);
+            CHECK(checkMap(m));
+            checkSame(m, expected);
+        };
+
+        // Mapa vacío, huecos y entradas intercaladas con las existentes.
+        insertSorted(makeEntries(0, 3000, 3));
+        insertSorted(makeEntries(1, 3000, 3));
+        insertSorted(makeEntries(-500, 4000, 7));
+
+        // Claves repetidas y ya existentes no sobrescriben el valor.
+        insertSorted({{5, "x"}, {5, "y"}, {6, "z"}});
+        CHECK(m.at(6) == "6");
+
+        // Orden arbitrario: mismo resultado, sólo más lento.
+        insertSorted({{9000, "a"}, {-9000, "b"}, {4500, "c"}, {-4500, "d"}});
+
+        std::vector<int> keys;
+        for (int k = -600; k < 4100; k += 2)
+            keys.push_back(k);
+        eraseSorted(keys);
+
+        eraseSorted({9000, 3, -9000, 1, 4500});
+
+        // Vaciar el árbol, y seguir borrando con el mismo cursor.
+        keys.clear();
+        for (int k = -10000; k < 10000; ++k)
+            keys.push_back(k);
+        eraseSorted(keys);
+        CHECK(m.empty());
+
+        insertSorted(makeEntries(0, 100, 1));
+    };
+
+    testOrder(bmap<int, std::string, 3> {});
+    testOrder(bmap<int, std::string, 4> {});
+    testOrder(bmap<int, std::string, 5> {});
+    testOrder(bmap<int, std::string, 16> {});
+
+    constexpr BMapOptions Counted {.OrderStatistics = true};
+    testOrder(bmap<int, std::string, 3, Counted> {});
+    testOrder(bmap<int, std::string, 4, Counted> {});
+}
+
+TEST_CASE_METHOD(BTreeTests, "bmap from_sorted()", "[btree][bulk_load]")
+{
+    auto makeEntries = [](int count)
+    {
+        std::vector<std::pair<int, std::string>> entries;
+        for (int i = 0; i < count; ++i)
+            entries.emplace_back(i * 3, std::to_string(i));
+        return entries;
+    };
+
+    auto checkContents = [](const auto& m, const auto& entries)
+    {
+        REQUIRE(m.size() == entries.size());
+
+        size_t i = 0;
+        for (const auto entry : m)
+        {
+            REQUIRE(entry.key == entries[i].first);
+            REQUIRE(entry.value == entries[i].second);
+            ++i;
+        }
+    };
+
+    SECTION("Distintos tamaños y factores de llenado")
+    {
+        for (int count : {0, 1, 2, 3, 4, 5, 7, 8, 9, 17, 100, 1000, 4097})
+        {
+            const auto entries = makeEntries(count);
+
+            for (float fill : {1.0f, 0.75f, 0.5f, 0.0f})
+            {
+                auto m = bmap<int, std::string, 4>::from_sorted(entries, fill);
+                CHECK(checkMap(m));
+                checkContents(m, entries);
+
+                auto m16 = bmap<int, std::string, 16>::from_sorted(entries, fill);
+                CHECK(checkMap(m16));
+                checkContents(m16, entries);
+            }
+        }
+    }
+
+    SECTION("Desde otro bmap")
+    {
+        bmap<int, std::string> source;
+        for (int i = 0; i < 300; ++i)
+            source[i * 7] = std::to_string(i);
+
+        const auto copy = bmap<int, std::string>::from_sorted(source);
+        CHECK(checkMap(copy));
+        CHECK(copy == source);
+    }
+
+    SECTION("El árbol admite modificaciones tras la carga")
+    {
+        const auto entries = makeEntries(2000);
+        auto m = bmap<LifeCycleObject, std::string, 5>::from_sorted(entries);
+
+        for (int i = 0; i < 2000; i += 2)
+            CHECK(m.erase(i * 3));
+        CHECK(checkMap(m));
+
+        for (int i = 0; i < 2000; ++i)
+            m[i * 3 + 1] = "new";
+        CHECK(checkMap(m));
+        CHECK(m.size() == 3000);
+
+        for (int i = 0; i < 2000; ++i)
+        {
+            m.erase(i * 3);
+            m.erase(i * 3 + 1);
+        }
+        CHECK(m.empty());
+        CHECK(checkMap(m));
+    }
+
+    SECTION("Claves repetidas y desordenadas")
+    {
+        std::vector<std::pair<int, LifeCycleObject>> repeated {{1, 10}, {1, 11}, {2, 20}, {2, 21}, {3, 30}};
+        auto m = bmap<int, LifeCycleObject>::from_sorted(repeated);
+
+        CHECK(m.size() == 3);
+        CHECK(m.at(1) == 10);
+        CHECK(m.at(2) == 20);
+        CHECK(m.at(3) == 30);
+
+        std::vector<std::pair<int, LifeCycleObject>> unsorted;
+        for (int i = 0; i < 100; ++i)
+            unsorted.emplace_back(i, i);
+        unsorted.emplace_back(50, 50);
+
+        CHECK_THROWS_AS((bmap<int, LifeCycleObject>::from_sorted(unsorted)), std::invalid_argument);
+    }
+
+    SECTION("La copia de una clave falla")
+    {
+        // Clave cuya copia falla; el valor ya construido para ella no debe perderse.
+        struct Key
+        {
+            ThrowingCopy id;
+
+            Key(int v)
+                : id(v)
+            {
+            }
+            Key(const Key&) = default;
+            Key(Key&&) = default;
+            Key& operator=(const Key& rhs)
+            {
+                id.value = rhs.id.value;
+                return *this;
+            }
+            bool operator<(const Key& rhs) const { return id.value < rhs.id.value; }
+        };
+
+        std::vector<std::pair<Key, LifeCycleObject>> entries;
+        for (int i = 0; i < 100; ++i)
+            entries.emplace_back(Key(i), i);
+
+        for (int copies : {0, 1, 4, 5, 50, 99})
+        {
+            ThrowingCopy::copiesLeft = copies;
+            CHECK_THROWS_AS((bmap<Key, LifeCycleObject, 4>::from_sorted(entries)), std::runtime_error);
+            ThrowingCopy::copiesLeft = -1;
+        }
+
+        entries.clear();
+        CHECK(LifeCycleObject::all_destroyed());
+    }
+}
+
+// Cuenta los bloques pedidos al asignador por defecto.
+class CountingAllocator : public IAllocator
+{
+public:
+    int allocs = 0;
+    int frees = 0;
+
+    SAllocResult alloc(byte_size bytes, align a) override
+    {
+        ++allocs;
+        return defaultAllocator().alloc(bytes, a);
+    }
+
+    void free(void* block) override
+    {
+        ++frees;
+        defaultAllocator().free(block);
+    }
+
+    byte_size tryExpand(byte_size bytes, void* block) override
+    {
+        return defaultAllocator().tryExpand(bytes, block);
+    }
+};
+
+TEST_CASE_METHOD(BTreeTests, "NodePool", "[btree][node_pool]")
+{
+    CountingAllocator counter;
+
+    SECTION("Reutiliza los huecos liberados")
+    {
+        NodePool pool(counter, 24, align::of<uint64_t>());
+
+        void* a = pool.alloc();
+        void* b = pool.alloc();
+        CHECK(a != b);
+
+        pool.free(a);
+        CHECK(pool.alloc() == a);
+
+        pool.free(b);
+        pool.release();
+        CHECK(counter.allocs == counter.frees);
+    }
+
+    SECTION("Respeta el alineamiento y agrupa los nodos en bloques")
+    {
+        struct alignas(64) Big
+        {
+            char data[100];
+        };
+
+        NodePool pool(counter, sizeof(Big), align::of<Big>());
+        std::vector<void*> slots;
+
+        for (int i = 0; i < 200; ++i)
+        {
+            slots.push_back(pool.alloc());
+            CHECK(align::of<Big>().isAligned(slots.back()));
+        }
+
+        std::sort(slots.begin(), slots.end());
+        CHECK(std::adjacent_find(slots.begin(), slots.end()) == slots.end());
+        CHECK(counter.allocs < 20);
+
+        pool.release();
+        CHECK(counter.allocs == counter.frees);
+    }
+
+    SECTION("bmap toma sus nodos del pool")
+    {
+        {
+            bmap<int, int, 4> m(counter);
+
+            for (int i = 0; i < 10000; ++i)
+                m[i] = i;
+
+            // Un bloque por página (o menos), no uno por nodo.
+            CHECK(counter.allocs < 10000 / 4 / 8);
+            CHECK(checkMap(m));
+
+            for (int i = 0; i < 10000; i += 2)
+                m.erase(i);
+
+            const int allocsBefore = counter.allocs;
+            for (int i = 0; i < 10000; i += 2)
+                m[i] = i;
+
+            // Los nodos liberados se reutilizan.
+            CHECK(counter.allocs - allocsBefore < 10);
+            CHECK(checkMap(m));
+
+            m.clear();
+            CHECK(counter.allocs == counter.frees);
+
+            m[1] = 1;
+            bmap<int, int, 4> moved(std::move(m));
+            CHECK(moved.at(1) == 1);
+
+            m = std::move(moved);
+            CHECK(m.at(1) == 1);
+        }
+
+        CHECK(counter.allocs == counter.frees);
+    }
+}
+
+TEST_CASE_METHOD(BTreeTests, "bmap con los valores fuera de las hojas", "[btree][separate_values]")
+{
+    constexpr BMapOptions Separate {.SeparateValues = true};
+
+    SECTION("Mismo comportamiento que con los valores en las hojas")
+    {
+        bmap<int, std::string, 4, Separate> m;
+        std::map<int, std::string> expected;
+
+        for (int i = 0; i < 5000; ++i)
+        {
+            const int key = (i * 7919) % 2000;
+
+            if (i % 3 == 2)
+                CHECK(m.erase(key) == (expected.erase(key) > 0));
+            else
+                m[key] = expected[key] = std::to_string(i);
+        }
+
+        CHECK(checkMap(m));
+        REQUIRE(m.size() == expected.size());
+
+        auto it = expected.begin();
+        for (const auto entry : m)
+        {
+            REQUIRE(entry.key == it->first);
+            REQUIRE(entry.value == it->second);
+            ++it;
+        }
+
+        const auto loaded = bmap<int, std::string, 4, Separate>::from_sorted(expected);
+        CHECK(checkMap(loaded));
+        CHECK(loaded == m);
+    }
+
+    SECTION("Construye, mueve y destruye los valores")
+    {
+        bmap<int, LifeCycleObject, 4, Separate> m;
+
+        for (int i = 0; i < 1000; ++i)
+            m.insert(i, LifeCycleObject(i));
+
+        for (int i = 0; i < 1000; i += 2)
+            m.erase(i);
+
+        CHECK(checkMap(m));
+        CHECK(m.at(1) == LifeCycleObject(1));
+        CHECK(m.at(999) == LifeCycleObject(999));
+
+        bmap<int, LifeCycleObject, 4, Separate> moved(std::move(m));
+        CHECK(moved.size() == 500);
+    }
+}
+
+TEST_CASE_METHOD(BTreeTests, "bmap nth(), rank() y count() entre claves", "[btree][order_statistics]")
+{
+    constexpr BMapOptions Counted {.OrderStatistics = true};
+
+    auto checkPositions = [](const auto& m, const std::vector<int>& expected)
+    {
+        REQUIRE(checkMap(m));
+        REQUIRE(m.size() == expected.size());
+
+        for (count_t i = 0; i < expected.size(); ++i)
+        {
+            REQUIRE(m.nth(i).key() == expected[i]);
+            REQUIRE(m.rank(expected[i]) == i);
+            REQUIRE(m.rank(expected[i] + 1) == i + 1);
+        }
+
+        CHECK(!m.nth(count_t(expected.size())).has_value());
+    };
+
+    auto testOrder = [&](auto m)
+    {
+        CHECK(!m.nth(0).has_value());
+        CHECK(m.rank(5) == 0);
+        CHECK(m.count(0, 10) == 0);
+
+        // Claves pares, insertadas en orden aleatorio.
+        std::vector<int> keys;
+        for (int k = 0; k < 2000; k += 2)
+            keys.push_back(k);
+
+        std::vector<int> shuffled = keys;
+        std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(1234));
+        for (int key : shuffled)
+            m.insert(key, key);
+
+        checkPositions(m, keys);
+        CHECK(m.rank(-1) == 0);
+        CHECK(m.rank(5000) == keys.size());
+        CHECK(m.count(100, 200) == 50);
+        CHECK(m.count(101, 199) == 49);
+        CHECK(m.count(200, 100) == 0);
+        CHECK(m.count(-1000, 5000) == keys.size());
+
+        // Borrados con redistribución y fusión de nodos.
+        for (int i = 0; i < 1000; i += 3)
+            m.erase(shuffled[i]);
+
+        std::vector<int> remaining;
+        for (const auto entry : m)
+            remaining.push_back(entry.key);
+        checkPositions(m, remaining);
+
+        const count_t first = m.rank(600);
+        const count_t last = m.rank(1400);
+        CHECK(m.count(600, 1400) == last - first);
+
+        // Las cargas masivas también mantienen los tamaños.
+        std::vector<std::pair<int, int>> entries;
+        for (int k : keys)
+            entries.emplace_back(k, k);
+
+        const auto loaded = decltype(m)::from_sorted(entries, 0.7f);
+        checkPositions(loaded, keys);
+    };
+
+    testOrder(bmap<int, int, 3, Counted> {});
+    testOrder(bmap<int, int, 4, Counted> {});
+    testOrder(bmap<int, int, 16, Counted> {});
+
+    // Sin 'OrderStatistics', count() entre claves recorre las hojas.
+    bmap<int, int, 4> plain;
+    for (int k = 0; k < 1000; ++k)
+        plain.insert(k, k);
+    CHECK(plain.count(100, 300) == 200);
+    CHECK(plain.count(990, 2000) == 10);
+}
+
+TEST_CASE_METHOD(BTreeTests, "bmap for_each_leaf_chunk()", "[btree][leaf_chunk]")
+{
+    auto testChunks = [](auto m)
+    {
+        int calls = 0;
+        m.for_each_leaf_chunk([&calls](auto, auto) { ++calls; });
+        CHECK(calls == 0);
+
+        std::map<int, std::string> expected;
+        for (int i = 0; i < 3000; ++i)
+        {
+            const int key = (i * 7919) % 1500;
+
+            if (i % 4 == 3)
+                CHECK(m.erase(key) == (expected.erase(key) > 0));
+            else
+                m[key] = expected[key] = std::to_string(i);
+        }
+
+        // Trozos no vacíos que recorren todas las entradas en orden.
+        auto it = expected.begin();
+        m.for_each_leaf_chunk([&](span<const int> keys, span<const std::string> values) {
+            REQUIRE(!keys.empty());
+            REQUIRE(keys.size() == values.size());
+
+            for (count_t i = 0; i < keys.size(); ++i)
+            {
+                REQUIRE(it != expected.end());
+                REQUIRE(keys[i] == it->first);
+                REQUIRE(values[i] == it->second);
+                ++it;
+            }
+        });
+        CHECK(it == expected.end());
+
+        // Recorrido inverso, que hace prefetch de las hojas anteriores.
+        auto rit = expected.rbegin();
+        for (auto range = m.rbegin(); !range.empty(); ++range, ++rit)
+            REQUIRE(range.front().key == rit->first);
+        CHECK(rit == expected.rend());
+    };
+
+    testChunks(bmap<int, std::string, 4> {});
+    testChunks(bmap<int, std::string, 16> {});
+    testChunks(bmap<int, std::string, 16, BMapOptions {.SeparateValues = true}> {});
+}
+
+TEST_CASE_METHOD(BTreeTests, "bmap snapshot()", "[btree][snapshot]")
+{
+    constexpr BMapOptions Shared {.Snapshots = true};
+
+    auto checkSnapshot = [](const auto& snapshot, const std::map<int, std::string>& expected)
+    {
+        REQUIRE(snapshot.size() == expected.size());
+
+        auto it = expected.begin();
+        for (const auto entry : snapshot)
+        {
+            REQUIRE(it != expected.end());
+            REQUIRE(entry.key == it->first);
+            REQUIRE(entry.value == it->second);
+            ++it;
+        }
+        REQUIRE(it == expected.end());
+
+        for (const auto& [key, value] : expected)
+            REQUIRE(snapshot.at(key) == value);
+        CHECK(!snapshot.contains(-1));
+    };
+
+    auto testSnapshots = [&](auto m)
+    {
+        CHECK(m.snapshot().empty());
+
+        std::map<int, std::string> expected;
+        for (int i = 0; i < 1000; ++i)
+            m[i] = expected[i] = std::to_string(i);
+
+        const auto first = m.snapshot();
+        const auto firstExpected = expected;
+
+        // Borrados (con fusiones), inserciones y cambios de valores en el mapa.
+        for (int i = 0; i < 1000; i += 2)
+        {
+            m.erase(i);
+            expected.erase(i);
+        }
+        for (int i = 1000; i < 1500; ++i)
+            m[i] = expected[i] = std::to_string(i);
+
+        auto second = m.snapshot();
+        const auto secondExpected = expected;
+
+        for (int i = 1; i < 1500; i += 3)
+            m.insert_or_assign(i, expected[i] = "x" + std::to_string(i));
+
+        std::vector<std::pair<int, std::string>> sorted;
+        for (int i = 2000; i < 2300; ++i)
+            sorted.emplace_back(i, expected[i] = std::to_string(i));
+        m.insert_sorted(sorted);
+
+        CHECK(checkMap(m));
+        checkSnapshot(first, firstExpected);
+        checkSnapshot(second, secondExpected);
+
+        // Las instantáneas sobreviven al mapa.
+        auto copy = second;
+        m.clear();
+        CHECK(m.snapshot().empty());
+        checkSnapshot(copy, secondExpected);
+
+        second = {};
+        CHECK(second.empty());
+        checkSnapshot(copy, secondExpected);
+    };
+
+    testSnapshots(bmap<int, std::string, 3, Shared> {});
+    testSnapshots(bmap<int, std::string, 16, Shared> {});
+    testSnapshots(bmap<int, std::string, 4, BMapOptions {.SeparateValues = true, .Snapshots = true}> {});
+    testSnapshots(bmap<int, std::string, 4, BMapOptions {.OrderStatistics = true, .Snapshots = true}> {});
+
+    SECTION("Libera los valores de todas las versiones")
+    {
+        LifeCycleObject::reset_counters();
+        {
+            bmap<int, LifeCycleObject, 4, Shared> m;
+            for (int i = 0; i < 300; ++i)
+                m.insert(i, LifeCycleObject(i));
+
+            const auto snapshot = m.snapshot();
+            for (int i = 0; i < 300; i += 2)
+                m.erase(i);
+
+            CHECK(snapshot.size() == 300);
+            CHECK(snapshot.at(0) == LifeCycleObject(0));
+        }
+        CHECK(LifeCycleObject::all_destroyed());
+    }
+
+    SECTION("Insertar claves existentes no copia nodos")
+    {
+        CountingAllocator counter;
+        {
+            bmap<int, std::string, 4, Shared> m(counter);
+            for (int i = 0; i < 500; ++i)
+                m.insert(i, std::to_string(i));
+
+            const auto snapshot = m.snapshot();
+            const int allocs = counter.allocs;
+
+            for (int i = 0; i < 500; ++i)
+            {
+                CHECK(!m.insert(i, "x").inserted);
+                CHECK(!m.emplace(i, "x").inserted);
+            }
+            CHECK(counter.allocs == allocs);
+
+            // Las asignaciones sí copian el camino a la clave.
+            m.insert_or_assign(250, "x");
+            CHECK(counter.allocs > allocs);
+            CHECK(m.at(250) == "x");
+            CHECK(snapshot.at(250) == "250");
+            CHECK(checkMap(m));
+        }
+        CHECK(counter.allocs == counter.frees);
+    }
+
+    SECTION("Lectura desde otro hilo mientras se modifica el mapa")
+    {
+        bmap<int, int, 16, Shared> m;
+        for (int i = 0; i < 5000; ++i)
+            m.insert(i, i);
+
+        const auto snapshot = m.snapshot();
+        long long sum = 0;
+
+        std::thread reader([&snapshot, &sum] {
+            for (int round = 0; round < 20; ++round)
+            {
+                for (const auto entry : snapshot)
+                    sum += entry.value;
+            }
+        });
+
+        for (int i = 0; i < 5000; i += 2)
+            m.erase(i);
+        for (int i = 5000; i < 8000; ++i)
+            m.insert(i, -i);
+
+        reader.join();
+        CHECK(sum == 20LL * 4999 * 5000 / 2);
+        CHECK(m.size() == 5500);
+    }
+}
+
+TEST_CASE_METHOD(BTreeTests, "bmap merge() y operaciones de conjuntos", "[btree][set_ops]")
+{
+    using Map = bmap<int, std::string, 4>;
+
+    // Claves múltiplo de 2 / de 3, con valores que indican su origen.
+    Map evens;
+    Map threes;
+    std::map<int, std::string> expectedEvens;
+    std::map<int, std::string> expectedThrees;
+
+    for (int i = 0; i < 3000; i += 2)
+        evens[i] = expectedEvens[i] = "a" + std::to_string(i);
+    for (int i = 0; i < 3000; i += 3)
+        threes[i] = expectedThrees[i] = "b" + std::to_string(i);
+
+    auto checkSame = [](const Map& m, const std::map<int, std::string>& expected)
+    {
+        REQUIRE(checkMap(m));
+        REQUIRE(m.size() == expected.size());
+
+        auto it = expected.begin();
+        for (const auto entry : m)
+        {
+            REQUIRE(entry.key == it->first);
+            REQUIRE(entry.value == it->second);
+            ++it;
+        }
+    };
+
+    SECTION("Operaciones de conjuntos")
+    {
+        std::map<int, std::string> expectedUnion = expectedThrees;
+        std::map<int, std::string> expectedIntersection;
+        std::map<int, std::string> expectedDifference;
+
+        for (const auto& [key, value] : expectedEvens)
+        {
+            expectedUnion[key] = value;
+            if (expectedThrees.contains(key))
+                expectedIntersection[key] = value;
+            else
+                expectedDifference[key] = value;
+        }
+
+        checkSame(Map::set_union(evens, threes), expectedUnion);
+        checkSame(Map::set_intersection(evens, threes), expectedIntersection);
+        checkSame(Map::set_difference(evens, threes), expectedDifference);
+
+        const Map empty;
+        checkSame(Map::set_union(evens, empty), expectedEvens);
+        checkSame(Map::set_union(empty, threes), expectedThrees);
+        CHECK(Map::set_intersection(evens, empty).empty());
+        CHECK(Map::set_difference(evens, evens).empty());
+        checkSame(Map::set_difference(evens, empty), expectedEvens);
+    }
+
+    SECTION("merge() con las distintas políticas")
+    {
+        std::map<int, std::string> expected = expectedThrees;
+        for (const auto& [key, value] : expectedEvens)
+            expected.emplace(key, value);
+
+        Map kept = threes;
+        kept.merge(evens);
+        checkSame(kept, expected);
+
+        for (const auto& [key, value] : expectedEvens)
+            expected[key] = value;
+
+        Map overwritten = threes;
+        overwritten.merge(evens, MergePolicy::Overwrite);
+        checkSame(overwritten, expected);
+
+        for (const auto& [key, value] : expectedEvens)
+        {
+            if (expectedThrees.contains(key))
+                expected[key] = expectedThrees.at(key) + "+" + value;
+        }
+
+        Map combined = threes;
+        combined.merge(evens, [](const std::string& existing, const std::string& other) {
+            return existing + "+" + other;
+        });
+        checkSame(combined, expected);
+
+        // Mezclar un mapa consigo mismo no lo cambia.
+        combined.merge(combined);
+        checkSame(combined, expected);
+
+        // Se puede seguir modificando el resultado.
+        for (int i = 0; i < 3000; ++i)
+        {
+            combined.erase(i);
+            expected.erase(i);
+        }
+        checkSame(combined, expected);
+    }
+}
+
+TEST_CASE_METHOD(BTreeTests, "bmap split_at() y join()", "[btree][split_join]")
+{
+    auto checkSame = [](const auto& m, const std::map<int, int>& expected)
+    {
+        REQUIRE(checkMap(m));
+        REQUIRE(m.size() == expected.size());
+
+        auto it = expected.begin();
+        for (const auto entry : m)
+        {
+            REQUIRE(entry.key == it->first);
+            REQUIRE(entry.value == it->second);
+            ++it;
+        }
+    };
+
+    std::map<int, int> expected;
+    for (int i = 0; i < 2000; ++i)
+        expected[3 * i] = i;
+
+    SECTION("Cortes en cualquier punto, y vuelta a unir")
+    {
+        for (int cut : {-10, 0, 1, 3, 299, 300, 3000, 4500, 5997, 5998, 10000})
+        {
+            bmap<int, int, 4> left;
+            for (const auto& [key, value] : expected)
+                left[key] = value;
+
+            bmap<int, int, 4> right = left.split_at(cut);
+
+            std::map<int, int> expectedLeft(expected.begin(), expected.lower_bound(cut));
+            std::map<int, int> expectedRight(expected.lower_bound(cut), expected.end());
+            checkSame(left, expectedLeft);
+            checkSame(right, expectedRight);
+
+            // Ambas mitades siguen siendo modificables.
+            left[-1] = -1;
+            right[100000] = 100000;
+            CHECK(left.erase(-1));
+            CHECK(right.erase(100000));
+
+            left.join(std::move(right));
+            CHECK(right.empty());
+            checkSame(left, expected);
+        }
+    }
+
+    SECTION("Unión de árboles de alturas distintas")
+    {
+        for (int smallSize : {1, 2, 5, 40})
+        {
+            bmap<int, int, 4> big;
+            bmap<int, int, 4> small;
+            std::map<int, int> all;
+
+            for (int i = 0; i < 3000; ++i)
+                big[i] = all[i] = i;
+            for (int i = 0; i < smallSize; ++i)
+                small[5000 + i] = all[5000 + i] = i;
+
+            bmap<int, int, 4> bigCopy = big;
+
+            // Pequeño a la derecha del grande, y grande a la derecha del pequeño.
+            big.join(std::move(small));
+            checkSame(big, all);
+
+            std::map<int, int> reversed;
+            bmap<int, int, 4> low;
+            for (int i = 0; i < smallSize; ++i)
+                low[-1 - i] = reversed[-1 - i] = i;
+            for (int i = 0; i < 3000; ++i)
+                reversed[i] = i;
+
+            low.join(std::move(bigCopy));
+            checkSame(low, reversed);
+        }
+    }
+
+    SECTION("Claves desordenadas")
+    {
+        bmap<int, int, 4> a {{1, 1}, {5, 5}};
+        bmap<int, int, 4> b {{5, 50}, {7, 70}};
+
+        CHECK_THROWS_AS(a.join(std::move(b)), std::invalid_argument);
+        CHECK(a.size() == 2);
+        CHECK(b.size() == 2);
+        CHECK(a.at(5) == 5);
+        CHECK(b.at(5) == 50);
+
+        // Unir mapas vacíos.
+        bmap<int, int, 4> empty;
+        a.join(std::move(empty));
+        CHECK(a.size() == 2);
+        empty.join(std::move(a));
+        CHECK(empty.size() == 2);
+        CHECK(a.empty());
+    }
+
+    SECTION("Ventana deslizante: se corta el principio y se añade al final")
+    {
+        bmap<int, LifeCycleObject, 8> window;
+        std::map<int, int> expectedWindow;
+
+        LifeCycleObject::reset_counters();
+        for (int batch = 0; batch < 40; ++batch)
+        {
+            bmap<int, LifeCycleObject, 8> incoming;
+            for (int i = 0; i < 250; ++i)
+            {
+                const int key = batch * 250 + i;
+                incoming.emplace(key, key);
+                expectedWindow[key] = key;
+            }
+            window.join(std::move(incoming));
+
+            const int oldest = (batch - 3) * 250;
+            bmap<int, LifeCycleObject, 8> kept = window.split_at(oldest);
+            const auto expired = window.size();
+
+            window = std::move(kept);
+            expectedWindow.erase(expectedWindow.begin(), expectedWindow.lower_bound(oldest));
+
+            REQUIRE(checkMap(window));
+            REQUIRE(window.size() == expectedWindow.size());
+            REQUIRE(expired == (batch >= 4 ? 250 : 0));
+        }
+
+        for (const auto& [key, value] : expectedWindow)
+            REQUIRE(window.at(key).value() == value);
+
+        window.clear();
+        CHECK(LifeCycleObject::all_destroyed());
+    }
+
+    SECTION("Mapas con nodos de otros mapas o de otros asignadores")
+    {
+        CountingAllocator counter;
+        {
+            bmap<int, int, 4> a;
+            bmap<int, int, 4> b;
+            for (const auto& [key, value] : expected)
+            {
+                a[key] = value;
+                b[key + 100000] = value;
+            }
+
+            // Las dos mitades de cada uno comparten sus nodos.
+            bmap<int, int, 4> aHigh = a.split_at(3000);
+            bmap<int, int, 4> bHigh = b.split_at(103000);
+
+            a.join(std::move(bHigh));
+            CHECK(bHigh.empty());
+            CHECK(a.size() == 1000 + 1000);
+            CHECK(checkMap(a));
+
+            // Con otro asignador, los valores pasan a nodos nuevos.
+            bmap<int, int, 4> other(counter);
+            for (int i = 0; i < 500; ++i)
+                other[200000 + i] = i;
+
+            a.join(std::move(other));
+            CHECK(other.empty());
+            CHECK(a.size() == 2500);
+            CHECK(checkMap(a));
+            CHECK(a.at(200499) == 499);
+
+            aHigh.join(std::move(b));
+            CHECK(aHigh.size() == 2000);
+            CHECK(checkMap(aHigh));
+
+            aHigh.clear();
+            a.clear();
+        }
+        CHECK(counter.allocs == counter.frees);
+    }
+
+    SECTION("Las partes se modifican en hilos distintos")
+    {
+        constexpr BMapOptions Options {.SeparateValues = true};
+        bmap<int, int, 4, Options> m;
+        for (int i = 0; i < 8000; ++i)
+            m[i] = i;
+
+        // Cuatro partes, que tienen nodos en los bloques de las demás.
+        std::vector<bmap<int, int, 4, Options>> shards;
+        for (int cut : {6000, 4000, 2000})
+            shards.push_back(m.split_at(cut));
+        shards.push_back(std::move(m));
+
+        std::vector<std::thread> threads;
+        for (size_t s = 0; s < shards.size(); ++s)
+        {
+            threads.emplace_back([&shard = shards[s], s] {
+                const int first = int(3 - s) * 2000;
+
+                for (int round = 0; round < 20; ++round)
+                {
+                    for (int i = 0; i < 2000; i += 2)
+                        shard.erase(first + i);
+                    for (int i = 0; i < 2000; i += 2)
+                        shard[first + i] = round;
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        // Dos de ellas se vacían con nodos de las otras aún en uso.
+        shards[0].clear();
+        shards[2].clear();
+        CHECK(shards[1].size() == 2000);
+        CHECK(shards[1].at(4000) == 19);
+        CHECK(shards[1].at(4001) == 4001);
+        CHECK(checkMap(shards[1]));
+
+        shards[3].join(std::move(shards[1]));
+        CHECK(shards[3].size() == 4000);
+        CHECK(checkMap(shards[3]));
+    }
+
+    SECTION("Con estadísticos de orden y valores fuera de las hojas")
+    {
+        constexpr BMapOptions Options {.SeparateValues = true, .OrderStatistics = true};
+        bmap<int, std::string, 4, Options> m;
+
+        for (const auto& [key, value] : expected)
+            m[key] = std::to_string(value);
+
+        auto high = m.split_at(2500);
+        CHECK(m.size() == 834);
+        CHECK(high.size() == 2000 - 834);
+        CHECK(checkMap(m));
+        CHECK(checkMap(high));
+        CHECK(high.nth(0).key() == 2502);
+        CHECK(high.rank(3000) == 166);
+        CHECK(m.nth(833).key() == 2499);
+
+        m.join(std::move(high));
+        CHECK(checkMap(m));
+        CHECK(m.nth(1000).key() == 3000);
+        CHECK(m.at(3000) == "1000");
+    }
+
+    SECTION("Con instantáneas")
+    {
+        constexpr BMapOptions Options {.Snapshots = true};
+        bmap<int, int, 4, Options> m;
+
+        for (const auto& [key, value] : expected)
+            m[key] = value;
+
+        const auto before = m.snapshot();
+        auto high = m.split_at(3000);
+        const auto afterSplit = high.snapshot();
+
+        CHECK(checkMap(m));
+        CHECK(checkMap(high));
+        CHECK(before.size() == 2000);
+        CHECK(before.at(2997) == 999);
+        CHECK(before.at(3000) == 1000);
+
+        bmap<int, int, 4, Options> low;
+        low[-5] = -5;
+        low.join(std::move(m));
+        low.join(std::move(high));
+        CHECK(checkMap(low));
+        CHECK(low.size() == 2001);
+        CHECK(afterSplit.size() == 1000);
+        CHECK(!afterSplit.contains(2997));
+
+        int count = 0;
+        for (auto entry : before)
+        {
+            REQUIRE(entry.key == 3 * count);
+            ++count;
+        }
+        CHECK(count == 2000);
+    }
+}
+
+TEST_CASE_METHOD(BTreeTests, "bmap erase_range() y erase_prefix()", "[btree][erase_range]")
+{
+    auto checkSame = [](const auto& m, const std::map<int, int>& expected)
+    {
+        REQUIRE(checkMap(m));
+        REQUIRE(m.size() == expected.size());
+
+        auto it = expected.begin();
+        for (const auto entry : m)
+        {
+            REQUIRE(entry.key == it->first);
+            REQUIRE(entry.value == it->second);
+            ++it;
+        }
+    };
+
+    std::map<int, int> expected;
+    for (int i = 0; i < 3000; ++i)
+        expected[2 * i] = i;
+
+    SECTION("Rangos aleatorios, comparado con std::map")
+    {
+        bmap<int, int, 4> m;
+        for (const auto& [key, value] : expected)
+            m[key] = value;
+
+        std::mt19937 rng(16);
+        while (!expected.empty())
+        {
+            const int keyLeft = int(rng() % 6100) - 50;
+            const int keyRight = keyLeft + int(rng() % 400);
+            const auto first = expected.lower_bound(keyLeft);
+            const auto last = expected.lower_bound(keyRight);
+            const auto count = std::distance(first, last);
+
+            expected.erase(first, last);
+            REQUIRE(m.erase_range(keyLeft, keyRight) == count);
+            checkSame(m, expected);
+
+            if (rng() % 8 == 0)
+            {
+                const int key = int(rng() % 6000);
+                m[key] = key;
+                expected[key] = key;
+            }
+            if (expected.size() < 100 && rng() % 4 == 0)
+            {
+                CHECK(m.erase_range(-1, 10000) == expected.size());
+                expected.clear();
+            }
+        }
+        CHECK(m.empty());
+        CHECK(m.begin() == m.end());
+    }
+
+    SECTION("Rangos vacíos o invertidos")
+    {
+        bmap<int, int, 4> m;
+        for (const auto& [key, value] : expected)
+            m[key] = value;
+
+        CHECK(m.erase_range(7, 8) == 0);
+        CHECK(m.erase_range(100, 100) == 0);
+        CHECK(m.erase_range(200, 100) == 0);
+        CHECK(m.erase_range(6000, 7000) == 0);
+        CHECK(m.erase_prefix(0) == 0);
+        checkSame(m, expected);
+
+        bmap<int, int, 4> empty;
+        CHECK(empty.erase_range(0, 10) == 0);
+        CHECK(empty.erase_prefix(10) == 0);
+    }
+
+    SECTION("Borrado de los datos más antiguos")
+    {
+        bmap<int, LifeCycleObject, 8> m;
+
+        LifeCycleObject::reset_counters();
+        for (int i = 0; i < 5000; ++i)
+            m.emplace(i, i);
+
+        for (int limit = 250; limit <= 5000; limit += 250)
+        {
+            CHECK(m.erase_prefix(limit) == 250);
+            REQUIRE(checkMap(m));
+            REQUIRE(m.size() == count_t(5000 - limit));
+            if (!m.empty())
+                REQUIRE(m.begin().key() == limit);
+
+            for (int i = 0; i < 100; ++i)
+                m.emplace(10000 + limit * 100 + i, i);
+            CHECK(m.erase_range(10000 + limit * 100, 10000 + limit * 100 + 100) == 100);
+        }
+        CHECK(m.empty());
+        CHECK(LifeCycleObject::all_destroyed());
+    }
+
+    SECTION("Con estadísticos de orden y valores fuera de las hojas")
+    {
+        constexpr BMapOptions Options {.SeparateValues = true, .OrderStatistics = true};
+        bmap<int, std::string, 4, Options> m;
+
+        for (const auto& [key, value] : expected)
+            m[key] = std::to_string(value);
+
+        CHECK(m.erase_range(1000, 5000) == 2000);
+        CHECK(checkMap(m));
+        CHECK(m.size() == 1000);
+        CHECK(m.nth(499).key() == 998);
+        CHECK(m.nth(500).key() == 5000);
+        CHECK(m.rank(5000) == 500);
+        CHECK(m.at(5000) == "2500");
+
+        CHECK(m.erase_prefix(998) == 499);
+        CHECK(checkMap(m));
+        CHECK(m.nth(0).key() == 998);
+        CHECK(m.count(0, 6000) == 501);
+    }
+
+    SECTION("Con instantáneas")
+    {
+        constexpr BMapOptions Options {.Snapshots = true};
+        bmap<int, int, 4, Options> m;
+
+        for (const auto& [key, value] : expected)
+            m[key] = value;
+
+        const auto before = m.snapshot();
+
+        CHECK(m.erase_range(101, 4001) == 1950);
+        CHECK(m.erase_prefix(50) == 25);
+        CHECK(checkMap(m));
+        CHECK(m.size() == 3000 - 1975);
+        CHECK(!m.contains(2000));
+        CHECK(m.at(4002) == 2001);
+
+        CHECK(before.size() == 3000);
+        CHECK(before.at(2000) == 1000);
+
+        int count = 0;
+        for (auto entry : before)
+        {
+            REQUIRE(entry.key == 2 * count);
+            ++count;
+        }
+        CHECK(count == 3000);
+    }
+}
+
+namespace
+{
+// Clave que cuenta sus construcciones, y que se puede buscar con 'KeyProbe' sin construir una.
+struct CountedKey
+{
+    static inline int constructed = 0;
+
+    CountedKey(int v)
+        : value(v)
+    {
+        ++constructed;
+    }
+    CountedKey(const CountedKey& other)
+        : value(other.value)
+    {
+        ++constructed;
+    }
+
+    bool operator<(const CountedKey& rhs) const { return value < rhs.value; }
+    bool operator==(const CountedKey& rhs) const { return value == rhs.value; }
+
+    int value;
+};
+
+struct KeyProbe
+{
+    int value;
+};
+
+bool operator<(const KeyProbe& a, const CountedKey& b) { return a.value < b.value; }
+bool operator<(const CountedKey& a, const KeyProbe& b) { return a.value < b.value; }
+bool operator<(const KeyProbe& a, const KeyProbe& b) { return a.value < b.value; }
+} // namespace
+
+namespace coll
+{
+template <>
+struct TransparentKey<CountedKey> : std::true_type
+{
+};
+} // namespace coll
+
+TEST_CASE_METHOD(BTreeTests, "bmap búsquedas con otros tipos de clave", "[btree][transparent]")
+{
+    SECTION("Claves std::string con std::string_view y const char*")
+    {
+        constexpr BMapOptions Options {.OrderStatistics = true};
+        bmap<std::string, int, 4, Options> m;
+        for (int i = 0; i < 500; ++i)
+            m[std::to_string(1000 + i)] = i;
+
+        const std::string_view key = "1234";
+        REQUIRE(m.find(key));
+        CHECK(m.find(key).value() == 234);
+        CHECK(m.contains("1499"));
+        CHECK_FALSE(m.contains("1500"));
+        CHECK_FALSE(m.contains(std::string_view("123")));
+        CHECK(m.count(key) == 1);
+        CHECK(m.at("1010") == 10);
+        CHECK_THROWS_AS(m.at(std::string_view("0")), std::out_of_range);
+        CHECK(m.rank(key) == 234);
+        CHECK(m.count(std::string_view("1100"), std::string_view("1200")) == 100);
+        CHECK(m.lower_bound("1234x").key() == "1235");
+        CHECK(m.lower_bound(std::string_view("2")).empty());
+
+        int count = 0;
+        for (auto entry : m.range(std::string_view("1490"), std::string_view("9")))
+        {
+            CHECK(entry.value == 490 + count);
+            ++count;
+        }
+        CHECK(count == 10);
+    }
+
+    SECTION("Sin construir claves")
+    {
+        bmap<CountedKey, int, 8> m;
+        for (int i = 0; i < 1000; ++i)
+            m.insert(CountedKey(2 * i), i);
+
+        const int constructed = CountedKey::constructed;
+        for (int i = 0; i < 2000; ++i)
+        {
+            CHECK(m.contains(KeyProbe {i}) == (i % 2 == 0));
+            CHECK(m.count(KeyProbe {i}) == (i % 2 == 0 ? 1 : 0));
+        }
+        CHECK(m.find(KeyProbe {500}).value() == 250);
+        CHECK(m.count(KeyProbe {100}, KeyProbe {200}) == 50);
+        CHECK(m.lower_bound(KeyProbe {1997}).key().value == 1998);
+        CHECK(CountedKey::constructed == constructed);
+
+        // Los tipos que no se pueden comparar con la clave se convierten a ella, una vez por búsqueda.
+        CHECK(m.contains(600));
+        CHECK(CountedKey::constructed == constructed + 1);
+    }
+
+    SECTION("Instantáneas")
+    {
+        constexpr BMapOptions Options {.Snapshots = true};
+        bmap<std::string, int, 4, Options> m;
+        m["uno"] = 1;
+        m["dos"] = 2;
+
+        const auto snapshot = m.snapshot();
+        m.erase("uno");
+
+        CHECK(snapshot.contains(std::string_view("uno")));
+        CHECK(snapshot.at("dos") == 2);
+        CHECK_FALSE(m.contains("uno"));
+    }
+}
+
+namespace
+{
+// Compares strings ignoring case. Has state, to check that each tree keeps its own copy.
+struct CaseInsensitiveLess
+{
+    int* calls = nullptr;
+
+    bool operator()(const std::string& a, const std::string& b) const
+    {
+        if (calls)
+            ++*calls;
+
+        const size_t length = std::min(a.size(), b.size());
+        for (size_t i = 0; i < length; ++i)
+        {
+            const int ca = std::tolower(static_cast<unsigned char>(a[i]));
+            const int cb = std::tolower(static_cast<unsigned char>(b[i]));
+            if (ca != cb)
+                return ca < cb;
+        }
+        return a.size() < b.size();
+    }
+};
+} // namespace
+
+TEST_CASE_METHOD(BTreeTests, "bmap con comparadores propios", "[btree][compare]")
+{
+    SECTION("Orden inverso")
+    {
+        constexpr BMapOptions Options {.OrderStatistics = true};
+        bmap<int, int, 4, Options, std::greater<int>> m;
+        for (int i = 0; i < 1000; ++i)
+            m.insert((i * 7919) % 1000, i);
+
+        REQUIRE(checkMap(m));
+        CHECK(m.size() == 1000);
+        CHECK(m.begin().key() == 999);
+        CHECK(m.rbegin().key() == 0);
+        CHECK(m.nth(10).key() == 989);
+        CHECK(m.rank(500) == 499);
+        CHECK(m.count(600, 500) == 100);
+
+        int expected = 999;
+        for (auto entry : m)
+            CHECK(entry.key == expected--);
+        CHECK(expected == -1);
+
+        for (int i = 0; i < 1000; i += 2)
+            m.erase(i);
+        REQUIRE(checkMap(m));
+        CHECK(m.size() == 500);
+        CHECK_FALSE(m.contains(500));
+        CHECK(m.contains(501));
+
+        auto copy = m;
+        REQUIRE(checkMap(copy));
+        CHECK(copy == m);
+
+        auto upper = m.split_at(500);
+        REQUIRE(checkMap(m));
+        REQUIRE(checkMap(upper));
+        CHECK(m.rbegin().key() == 501);
+        CHECK(upper.begin().key() == 499);
+    }
+
+    SECTION("Comparador con estado")
+    {
+        int calls = 0;
+        bmap<std::string, int, 4, BMapOptions {}, CaseInsensitiveLess> m(CaseInsensitiveLess {&calls});
+
+        m["Uno"] = 1;
+        m["dos"] = 2;
+        m["TRES"] = 3;
+        CHECK(m.insert("UNO", 10).inserted == false);
+        for (int i = 0; i < 200; ++i)
+            m["clave" + std::to_string(i)] = i;
+
+        REQUIRE(checkMap(m));
+        CHECK(calls > 0);
+        CHECK(m.key_comp().calls == &calls);
+        CHECK(m.size() == 203);
+        CHECK(m.at("uno") == 1);
+        CHECK(m.contains("Tres"));
+        CHECK(m.find("CLAVE17").value() == 17);
+        CHECK(m.begin().key() == "clave0");
+
+        auto merged = bmap<std::string, int, 4, BMapOptions {}, CaseInsensitiveLess>::set_union(m, m);
+        CHECK(merged.key_comp().calls == &calls);
+        CHECK(merged.size() == m.size());
+    }
+
+    SECTION("Los comparadores vacíos no ocupan espacio")
+    {
+        constexpr BTreeCoreParams Params {4, sizeof(int), alignof(int)};
+        using Core = BTreeCore<int, Params>;
+        using ReverseCore = BTreeCore<int, Params, std::greater<int>>;
+
+        CHECK(sizeof(ReverseCore) == sizeof(Core));
+        CHECK(sizeof(bmap<int, int, 4, BMapOptions {}, std::greater<int>>) == sizeof(bmap<int, int>));
+    }
+}
+
+namespace
+{
+struct OrderLine
+{
+    uint32_t order;
+    std::string product;
+};
+
+// Ordena por 'order' y después por 'product'. Su prefijo junta 'order' y los 4 primeros bytes de
+// 'product'.
+struct OrderLineLess
+{
+    bool operator()(const OrderLine& a, const OrderLine& b) const
+    {
+        if (a.order != b.order)
+            return a.order < b.order;
+        return a.product < b.product;
+    }
+
+    static uint64_t prefix(const OrderLine& key)
+    {
+        return (uint64_t(key.order) << 32) | (KeyLess<std::string>::prefix(key.product) >> 32);
+    }
+};
+} // namespace
+
+TEST_CASE_METHOD(BTreeTests, "bmap con prefijos de clave", "[btree][key_prefixes]")
+{
+    SECTION("Claves std::string")
+    {
+        constexpr BMapOptions Options {.KeyPrefixes = true};
+        bmap<std::string, int, 8, Options> m;
+        std::map<std::string, int> expected;
+
+        // Muchas claves comparten sus 8 primeros bytes, algunas son más cortas y otras tienen bytes
+        // por encima de 127.
+        std::mt19937_64 rng(12345);
+        std::uniform_int_distribution<int> dist(0, 3000);
+        for (int i = 0; i < 3000; ++i)
+        {
+            const int n = dist(rng);
+            std::string key;
+            switch (n % 4)
+            {
+            case 0: key = "clientes/" + std::to_string(n); break;
+            case 1: key = std::to_string(n); break;
+            case 2: key = "\xC3\xA1rbol" + std::to_string(n); break;
+            default: key = "clientes" + std::string(n % 3, '\0'); break;
+            }
+            CHECK(m.insert(key, n).inserted == expected.emplace(key, n).second);
+        }
+
+        REQUIRE(checkMap(m));
+        REQUIRE(m.size() == expected.size());
+
+        auto it = expected.begin();
+        for (auto entry : m)
+        {
+            CHECK(entry.key == it->first);
+            ++it;
+        }
+
+        for (int n = 0; n < 3100; n += 7)
+        {
+            const std::string key = "clientes/" + std::to_string(n);
+            CHECK(m.contains(key) == (expected.count(key) > 0));
+            CHECK(m.contains(std::string_view(key)) == (expected.count(key) > 0));
+
+            auto lower = m.lower_bound(key);
+            auto expectedLower = expected.lower_bound(key);
+            CHECK(lower.empty() == (expectedLower == expected.end()));
+            if (!lower.empty() && expectedLower != expected.end())
+                CHECK(lower.key() == expectedLower->first);
+        }
+
+        // Erases every other key
+        for (auto entry = expected.begin(); entry != expected.end();)
+        {
+            CHECK(m.erase(entry->first));
+            entry = expected.erase(entry);
+            if (entry != expected.end())
+                ++entry;
+        }
+        REQUIRE(checkMap(m));
+        CHECK(m.size() == expected.size());
+        for (const auto& [key, value] : expected)
+            CHECK(m.at(key) == value);
+    }
+
+    SECTION("Claves compuestas")
+    {
+        constexpr BMapOptions Options {.OrderStatistics = true, .KeyPrefixes = true};
+        bmap<OrderLine, int, 16, Options, OrderLineLess> m;
+
+        for (uint32_t order = 0; order < 50; ++order)
+        {
+            for (int i = 0; i < 40; ++i)
+                m.insert({order, "producto-" + std::to_string(i)}, int(order) * 100 + i);
+        }
+
+        REQUIRE(checkMap(m));
+        CHECK(m.size() == 2000);
+        CHECK(m.at(OrderLine {7, "producto-13"}) == 713);
+        CHECK_FALSE(m.contains(OrderLine {7, "producto-40"}));
+        CHECK(m.rank(OrderLine {1, ""}) == 40);
+        CHECK(m.lower_bound(OrderLine {3, "q"}).key().order == 4);
+
+        const auto copy = m;
+        REQUIRE(checkMap(copy));
+
+        CHECK(m.erase_prefix(OrderLine {10, ""}) == 400);
+        REQUIRE(checkMap(m));
+        CHECK(m.size() == 1600);
+        CHECK(m.begin().key().order == 10);
+        CHECK(copy.size() == 2000);
+    }
+}
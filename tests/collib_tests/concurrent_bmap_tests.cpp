@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2026 Guillermo Hernan Martin
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+ 
+#include "pch-collib-tests.h"
+
+#include "concurrent_bmap.h"
+#include "mem_check_fixture.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace coll;
+
+class ConcurrentBMapTests : public MemCheckFixture
+{
+};
+
+TEST_CASE_METHOD(ConcurrentBMapTests, "concurrent_bmap: operaciones básicas", "[concurrent_bmap]")
+{
+    concurrent_bmap<int, int, 4> m;
+
+    CHECK(m.empty());
+    CHECK(!m.find(1).has_value());
+    CHECK(!m.erase(1));
+
+    const int total = 2000;
+    std::mt19937_64 rng(12345);
+    std::vector<int> keys;
+
+    for (int i = 0; i < total; ++i)
+        keys.push_back(i);
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    for (int key : keys)
+        CHECK(m.insert(key, key * 10));
+
+    CHECK(m.size() == total);
+    CHECK(!m.insert(5, 0));
+    CHECK(m.find(5) == 50);
+
+    CHECK(!m.insert_or_assign(5, 55));
+    CHECK(m.find(5) == 55);
+
+    for (int i = 0; i < total; ++i)
+        REQUIRE(m.contains(i));
+    CHECK(!m.contains(-1));
+    CHECK(!m.contains(total));
+
+    for (int i = 0; i < total; i += 2)
+        CHECK(m.erase(i));
+
+    CHECK(m.size() == total / 2);
+    for (int i = 0; i < total; ++i)
+        REQUIRE(m.contains(i) == (i % 2 != 0));
+
+    // El espacio de las claves borradas se reutiliza.
+    for (int i = 0; i < total; i += 2)
+        CHECK(m.insert(i, i));
+    CHECK(m.size() == total);
+
+    m.clear();
+    CHECK(m.empty());
+    CHECK(!m.contains(1));
+    CHECK(m.insert(1, 1));
+}
+
+TEST_CASE_METHOD(
+    ConcurrentBMapTests,
+    "concurrent_bmap: lectores y escritores concurrentes",
+    "[concurrent_bmap][threads]"
+)
+{
+    concurrent_bmap<int, int, 8> m;
+
+    // Las claves pares están siempre presentes y su valor no cambia. Cada escritor inserta, modifica y
+    // borra las claves impares de su propio tramo.
+    const int total = 20000;
+    const int writerCount = 3;
+
+    for (int i = 0; i < total; i += 2)
+        m.insert(i, i);
+
+    std::atomic<bool> stop {false};
+    std::atomic<int> errors {0};
+    std::vector<std::thread> threads;
+
+    for (int r = 0; r < 4; ++r)
+    {
+        threads.emplace_back(
+            [&, r]()
+            {
+                std::mt19937 rng(r);
+                std::uniform_int_distribution<int> dist(0, total - 1);
+
+                while (!stop.load())
+                {
+                    const int key = dist(rng);
+                    const auto value = m.find(key);
+
+                    if (key % 2 == 0 && value != key)
+                        ++errors;
+                    if (key % 2 != 0 && value.has_value() && *value != key && *value != -key)
+                        ++errors;
+                }
+            }
+        );
+    }
+
+    std::vector<std::thread> writers;
+    for (int w = 0; w < writerCount; ++w)
+    {
+        writers.emplace_back(
+            [&, w]()
+            {
+                for (int round = 0; round < 3; ++round)
+                {
+                    for (int key = 1 + 2 * w; key < total; key += 2 * writerCount)
+                        m.insert(key, key);
+                    for (int key = 1 + 2 * w; key < total; key += 2 * writerCount)
+                        m.insert_or_assign(key, -key);
+                    for (int key = 1 + 2 * w; key < total; key += 4 * writerCount)
+                        m.erase(key);
+                }
+            }
+        );
+    }
+
+    for (auto& writer : writers)
+        writer.join();
+
+    stop = true;
+    for (auto& thread : threads)
+        thread.join();
+
+    CHECK(errors == 0);
+
+    int expected = 0;
+    for (int key = 0; key < total; ++key)
+    {
+        const bool erased = key % 2 != 0 && ((key - 1) / 2) % (2 * writerCount) < writerCount;
+        const auto value = m.find(key);
+
+        if (erased)
+            REQUIRE(!value.has_value());
+        else
+        {
+            REQUIRE(value.has_value());
+            REQUIRE(*value == (key % 2 == 0 ? key : -key));
+            ++expected;
+        }
+    }
+
+    CHECK(m.size() == count_t(expected));
+}
+
+// Cuenta los bloques pedidos al asignador por defecto que siguen vivos.
+class LiveBlocksAllocator : public IAllocator
+{
+public:
+    std::atomic<int> live {0};
+
+    SAllocResult alloc(byte_size bytes, align a) override
+    {
+        ++live;
+        return defaultAllocator().alloc(bytes, a);
+    }
+
+    void free(void* block) override
+    {
+        --live;
+        defaultAllocator().free(block);
+    }
+
+    byte_size tryExpand(byte_size bytes, void* block) override
+    {
+        return defaultAllocator().tryExpand(bytes, block);
+    }
+};
+
+TEST_CASE_METHOD(
+    ConcurrentBMapTests,
+    "concurrent_bmap: los nodos vacíos se fusionan y se reutilizan",
+    "[concurrent_bmap][merge]"
+)
+{
+    LiveBlocksAllocator counter;
+
+    SECTION("Ventana deslizante")
+    {
+        concurrent_bmap<int, int, 8> m(counter);
+        const int window = 1000;
+
+        for (int i = 0; i < window; ++i)
+            m.insert(i, i);
+
+        // Tras dar varias vueltas a la ventana, la memoria no crece con el número de claves insertadas.
+        for (int i = window; i < 5 * window; ++i)
+        {
+            m.insert(i, i);
+            CHECK(m.erase(i - window));
+        }
+        const int blocks = counter.live;
+
+        for (int i = 5 * window; i < 200 * window; ++i)
+        {
+            m.insert(i, i);
+            m.erase(i - window);
+        }
+
+        CHECK(counter.live <= blocks + 2);
+        CHECK(m.size() == window);
+        for (int i = 199 * window; i < 200 * window; ++i)
+            REQUIRE(m.find(i) == i);
+        CHECK(!m.contains(199 * window - 1));
+    }
+
+    SECTION("Borrado de todas las claves")
+    {
+        concurrent_bmap<int, int, 4> m(counter);
+        int blocks = 0;
+
+        // Cada vuelta usa claves nuevas, en desorden.
+        for (int round = 0; round < 20; ++round)
+        {
+            const int base = round * 3000;
+
+            for (int i = 0; i < 3000; ++i)
+                REQUIRE(m.insert(base + (i * 7919) % 3000, i));
+            for (int i = 0; i < 3000; ++i)
+                REQUIRE(m.erase(base + (i * 104729) % 3000));
+            REQUIRE(m.empty());
+
+            if (round == 0)
+                blocks = counter.live;
+        }
+        CHECK(counter.live <= blocks + 2);
+        CHECK(!m.contains(0));
+        CHECK(m.insert(0, 0));
+    }
+
+    SECTION("Lectores concurrentes con una ventana deslizante")
+    {
+        concurrent_bmap<int, int, 8> m(counter);
+        const int window = 2000;
+        const int total = 100000;
+
+        for (int i = 0; i < window; ++i)
+            m.insert(i, -i);
+
+        std::atomic<int> first {0};
+        std::atomic<bool> stop {false};
+        std::atomic<int> errors {0};
+        std::vector<std::thread> readers;
+
+        // Las claves de la ventana, a partir de 'first', están presentes, y su valor no cambia. Si la clave
+        // sigue en la ventana después de buscarla, la búsqueda tiene que haberla encontrado.
+        for (int r = 0; r < 3; ++r)
+        {
+            readers.emplace_back(
+                [&, r]()
+                {
+                    std::mt19937 rng(r);
+
+                    while (!stop.load())
+                    {
+                        const int base = first.load();
+                        const int key = base + int(rng() % (window / 2));
+                        const auto value = m.find(key);
+
+                        if (first.load() <= key && value != -key)
+                            ++errors;
+                    }
+                }
+            );
+        }
+
+        std::thread writer(
+            [&]()
+            {
+                for (int i = window; i < total; ++i)
+                {
+                    m.insert(i, -i);
+                    first.store(i - window + 1);
+                    m.erase(i - window);
+                }
+            }
+        );
+
+        writer.join();
+        stop = true;
+        for (auto& reader : readers)
+            reader.join();
+
+        CHECK(errors == 0);
+        CHECK(m.size() == window);
+        for (int i = total - window; i < total; ++i)
+            REQUIRE(m.find(i) == -i);
+    }
+}
+
+TEST_CASE_METHOD(
+    ConcurrentBMapTests,
+    "concurrent_bmap: cada hilo tiene su propio registro de época",
+    "[concurrent_bmap][threads]"
+)
+{
+    LiveBlocksAllocator counter;
+
+    {
+        concurrent_bmap<int, int, 8> m(counter);
+        const int total = 2000;
+
+        for (int i = 0; i < total; ++i)
+            m.insert(i, -i);
+
+        const int blocks = counter.live;
+        const int readerCount = 24;
+        std::atomic<bool> stop {false};
+        std::atomic<int> started {0};
+        std::atomic<int> errors {0};
+        std::vector<std::thread> readers;
+
+        // Más lectores que los antiguos grupos de contadores, mientras un escritor borra y reinserta las
+        // claves impares, para que las épocas avancen. Cada lector hace una búsqueda antes de contarse
+        // como arrancado, así que ya ha registrado su época.
+        for (int r = 0; r < readerCount; ++r)
+        {
+            readers.emplace_back(
+                [&, r]()
+                {
+                    std::mt19937 rng(r);
+                    bool first = true;
+
+                    do
+                    {
+                        const int key = int(rng() % total);
+                        const auto value = m.find(key);
+
+                        if (key % 2 == 0 && value != -key)
+                            ++errors;
+
+                        if (first)
+                        {
+                            ++started;
+                            first = false;
+                        }
+                    } while (!stop.load());
+                }
+            );
+        }
+
+        while (started.load() < readerCount)
+            std::this_thread::yield();
+
+        for (int round = 0; round < 20; ++round)
+        {
+            for (int i = 1; i < total; i += 2)
+                m.erase(i);
+            for (int i = 1; i < total; i += 2)
+                m.insert(i, -i);
+        }
+
+        stop = true;
+        for (auto& reader : readers)
+            reader.join();
+
+        CHECK(errors == 0);
+        CHECK(m.size() == total);
+
+        // Un registro por hilo, además de los nodos.
+        CHECK(counter.live >= blocks + readerCount);
+    }
+
+    CHECK(counter.live == 0);
+}
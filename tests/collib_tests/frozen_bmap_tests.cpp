@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2026 Guillermo Hernan Martin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch-collib-tests.h"
+
+#include "frozen_bmap.h"
+#include "life_cycle_object.h"
+#include "mem_check_fixture.h"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace coll;
+
+class FrozenBMapTests : public MemCheckFixture
+{
+};
+
+// Compares every lookup against 'std::map', probing the keys and the gaps between them.
+template <typename MapType>
+static void check_same(const MapType& m, const std::map<int, int>& expected)
+{
+    REQUIRE(m.size() == count_t(expected.size()));
+
+    auto it = expected.begin();
+    for (const auto& entry : m)
+    {
+        REQUIRE(it != expected.end());
+        REQUIRE(entry.key == it->first);
+        REQUIRE(entry.value == it->second);
+        ++it;
+    }
+    REQUIRE(it == expected.end());
+
+    const int last = expected.empty() ? 0 : expected.rbegin()->first;
+    for (int key = -1; key <= last + 1; ++key)
+    {
+        const auto lower = expected.lower_bound(key);
+        const auto upper = expected.upper_bound(key);
+
+        REQUIRE(m.contains(key) == (expected.count(key) > 0));
+        REQUIRE(m.lower_bound(key).empty() == (lower == expected.end()));
+        REQUIRE(m.upper_bound(key).empty() == (upper == expected.end()));
+        if (lower != expected.end())
+            REQUIRE(m.lower_bound(key).key() == lower->first);
+        if (upper != expected.end())
+            REQUIRE(m.upper_bound(key).key() == upper->first);
+        REQUIRE(m.rank(key) == count_t(std::distance(expected.begin(), lower)));
+    }
+}
+
+TEST_CASE_METHOD(FrozenBMapTests, "frozen_bmap: operaciones básicas", "[frozen_bmap]")
+{
+    const std::vector<std::pair<int, std::string>> entries {
+        {1, "uno"}, {2, "dos"}, {3, "tres"}, {5, "cinco"}, {8, "ocho"}
+    };
+    frozen_bmap<int, std::string> m(entries);
+
+    CHECK(m.size() == 5);
+    CHECK(m.at(3) == "tres");
+    CHECK(m[8] == "ocho");
+    CHECK(m.contains(5));
+    CHECK_FALSE(m.contains(4));
+    CHECK(m.count(1) == 1);
+    CHECK(m.count(2, 8) == 3);
+    CHECK(m.count(8, 2) == 0);
+    CHECK_THROWS_AS(m.at(4), std::out_of_range);
+
+    CHECK(m.find(2).value() == "dos");
+    CHECK_FALSE(m.find(0));
+    CHECK(m.lower_bound(4).key() == 5);
+    CHECK(m.upper_bound(5).key() == 8);
+    CHECK(m.upper_bound(8).empty());
+    CHECK(m.nth(3).key() == 5);
+    CHECK_FALSE(m.nth(5));
+    CHECK(m.rank(4) == 3);
+
+    std::vector<std::string> values;
+    for (auto entry : m.range(2, 6))
+        values.push_back(entry.value);
+    CHECK(values == std::vector<std::string> {"dos", "tres", "cinco"});
+
+    frozen_bmap<int, std::string> empty;
+    CHECK(empty.empty());
+    CHECK(empty.begin() == empty.end());
+    CHECK_FALSE(empty.contains(1));
+    CHECK(empty.lower_bound(1).empty());
+
+    const std::vector<std::pair<int, int>> unsorted {{1, 1}, {3, 3}, {2, 2}};
+    const std::vector<std::pair<int, int>> repeated {{1, 1}, {1, 2}};
+    CHECK_THROWS_AS((frozen_bmap<int, int>(unsorted)), std::invalid_argument);
+    CHECK_THROWS_AS((frozen_bmap<int, int>(repeated)), std::invalid_argument);
+}
+
+TEST_CASE_METHOD(FrozenBMapTests, "frozen_bmap: comparado con std::map", "[frozen_bmap]")
+{
+    // Sizes around the block size and the number of index layers.
+    using Map = frozen_bmap<int, int>;
+    constexpr count_t B = Map::BlockKeys;
+
+    for (count_t size : {0u, 1u, B - 1, B, B + 1, B * B, B * B + 1, B * B * B + 7, 100'000u})
+    {
+        std::map<int, int> expected;
+        for (count_t i = 0; i < size; ++i)
+            expected[int(i) * 2 + 1] = int(i);
+
+        const Map m(expected);
+        check_same(m, expected);
+    }
+}
+
+TEST_CASE_METHOD(FrozenBMapTests, "frozen_bmap: desde un bmap", "[frozen_bmap]")
+{
+    SECTION("Claves std::string")
+    {
+        bmap<std::string, int, 8> source;
+        for (int i = 0; i < 2000; ++i)
+            source["clave-" + std::to_string(i)] = i;
+
+        const frozen_bmap m(source);
+        CHECK(m.size() == source.size());
+
+        auto it = source.begin();
+        for (auto entry : m)
+        {
+            CHECK(entry.key == it.key());
+            ++it;
+        }
+
+        // Lookups with other string types, as in 'bmap'.
+        CHECK(m.at(std::string_view("clave-1234")) == 1234);
+        CHECK(m.contains("clave-0"));
+        CHECK_FALSE(m.contains("clave-"));
+        CHECK(m.lower_bound("clave-999x").empty());
+    }
+
+    SECTION("Comparador propio")
+    {
+        bmap<int, int, 4, BMapOptions {}, std::greater<int>> source;
+        for (int i = 0; i < 1000; ++i)
+            source.insert(i, -i);
+
+        const frozen_bmap m(source);
+        CHECK(m.begin().key() == 999);
+        CHECK(m.lower_bound(500).key() == 500);
+        CHECK(m.upper_bound(500).key() == 499);
+        CHECK(m.count(600, 500) == 100);
+        CHECK(m.at(7) == -7);
+    }
+}
+
+TEST_CASE_METHOD(FrozenBMapTests, "frozen_bmap: ciclo de vida de los valores", "[frozen_bmap]")
+{
+    LifeCycleObject::reset_counters();
+    {
+        std::vector<std::pair<int, LifeCycleObject>> entries;
+        for (int i = 0; i < 1000; ++i)
+            entries.emplace_back(i, LifeCycleObject(i));
+
+        frozen_bmap<int, LifeCycleObject> m(entries);
+        CHECK(m.at(10).value() == 10);
+
+        frozen_bmap<int, LifeCycleObject> copy(m);
+        CHECK(copy.size() == 1000);
+        CHECK(copy.at(999).value() == 999);
+
+        frozen_bmap<int, LifeCycleObject> moved(std::move(m));
+        CHECK(m.empty());
+        CHECK(moved.at(500).value() == 500);
+
+        m = copy;
+        CHECK(m.size() == 1000);
+        copy = std::move(moved);
+        CHECK(copy.size() == 1000);
+
+        // The entries loaded before the error are destroyed.
+        entries.emplace_back(3, LifeCycleObject(3));
+        CHECK_THROWS_AS((frozen_bmap<int, LifeCycleObject>(entries)), std::invalid_argument);
+    }
+    CHECK(LifeCycleObject::all_destroyed());
+}
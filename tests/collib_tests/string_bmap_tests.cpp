@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2026 Guillermo Hernan Martin
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+ 
+#include "pch-collib-tests.h"
+
+#include "life_cycle_object.h"
+#include "mem_check_fixture.h"
+#include "string_bmap.h"
+
+#include <map>
+#include <string>
+
+using namespace coll;
+
+class StringBMapTests : public MemCheckFixture
+{
+};
+
+// Claves con prefijos largos compartidos, como rutas de URLs.
+static std::string make_path(int i)
+{
+    static const char* const sections[] = {
+        "catalog/books", "catalog/music", "users", "static/img/thumbnails"
+    };
+
+    return "https://www.example.com/" + std::string(sections[i % 4]) + "/item-" + std::to_string(i / 4);
+}
+
+template <typename MapType>
+static void check_same(const MapType& m, const std::map<std::string, int>& expected)
+{
+    REQUIRE(m.size() == count_t(expected.size()));
+
+    auto it = expected.begin();
+    for (const auto& entry : m)
+    {
+        REQUIRE(it != expected.end());
+        REQUIRE(entry.key == it->first);
+        REQUIRE(entry.value == it->second);
+        ++it;
+    }
+    REQUIRE(it == expected.end());
+}
+
+TEST_CASE_METHOD(StringBMapTests, "string_bmap: operaciones básicas", "[string_bmap]")
+{
+    string_bmap<int> m;
+
+    CHECK(m.empty());
+    CHECK(!m.find("a"));
+    CHECK(!m.erase("a"));
+    CHECK(m.begin() == m.end());
+
+    CHECK(m.insert("banana", 2).inserted);
+    CHECK(m.insert("apple", 1).inserted);
+    CHECK(m.insert("cherry", 3).inserted);
+    CHECK(m.insert("", 0).inserted);
+
+    const auto repeated = m.insert("apple", 10);
+    CHECK(!repeated.inserted);
+    CHECK(repeated.location.key() == "apple");
+    CHECK(repeated.location.value() == 1);
+
+    CHECK(!m.insert_or_assign("apple", 11).inserted);
+    CHECK(m.at("apple") == 11);
+    CHECK(m.insert_or_assign("date", 4).inserted);
+
+    m["fig"] = 6;
+    CHECK(m["fig"] == 6);
+    CHECK(m.size() == 6);
+
+    CHECK(m.contains(""));
+    CHECK(!m.contains("app"));
+    CHECK(!m.contains("apples"));
+    CHECK_THROWS_AS(m.at("grape"), std::out_of_range);
+
+    CHECK(m.lower_bound("b").key() == "banana");
+    CHECK(m.lower_bound("banana").key() == "banana");
+    CHECK(m.lower_bound("bananas").key() == "cherry");
+    CHECK(m.lower_bound("z").empty());
+
+    CHECK(m.erase("banana"));
+    CHECK(!m.erase("banana"));
+    CHECK(m.size() == 5);
+
+    std::vector<std::string> keys;
+    for (const auto& entry : m)
+        keys.push_back(entry.key);
+    CHECK(keys == std::vector<std::string> {"", "apple", "cherry", "date", "fig"});
+
+    m.clear();
+    CHECK(m.empty());
+    CHECK(m.insert("x", 1).inserted);
+}
+
+TEST_CASE_METHOD(StringBMapTests, "string_bmap: claves largas", "[string_bmap]")
+{
+    string_bmap<int, 8, 256> m;
+
+    const std::string longest(m.InlineKeyBytes, 'k');
+
+    CHECK(m.insert(longest, 1).inserted);
+    CHECK(m.insert(longest + "k", 2).inserted);
+    CHECK(m.size() == 2);
+    CHECK(m.at(longest + "k") == 2);
+
+    SECTION("Claves de la longitud máxima en los nodos")
+    {
+        // Sólo se diferencian en los dos últimos bytes.
+        std::map<std::string, int> expected {{longest, 1}, {longest + "k", 2}};
+
+        for (int i = 0; i < 200; ++i)
+        {
+            std::string key = longest;
+            key.back() = char('a' + i % 26);
+            key[key.size() - 2] = char('a' + i / 26);
+
+            m.insert_or_assign(key, i);
+            expected[key] = i;
+        }
+
+        check_same(m, expected);
+    }
+
+    SECTION("Claves guardadas fuera de los nodos")
+    {
+        // Rutas más largas que el montículo de un nodo, mezcladas con otras cortas. Muchas comparten
+        // prefijos más largos que 'InlineKeyBytes'.
+        std::map<std::string, int> expected {{longest, 1}, {longest + "k", 2}};
+        std::mt19937 rng(2026);
+        std::uniform_int_distribution<int> dist(0, 599);
+
+        auto make_key = [&](int i)
+        {
+            const std::string path = make_path(i);
+
+            switch (i % 3)
+            {
+            case 0:
+                return path;
+            case 1:
+                return std::string(300 + i % 7 * 100, '/') + path;
+            default:
+                return path + std::string(i % 5 * 200, 'x') + std::to_string(i);
+            }
+        };
+
+        for (int round = 0; round < 3; ++round)
+        {
+            for (int i = 0; i < 600; ++i)
+            {
+                const int n = dist(rng);
+                const std::string key = make_key(n);
+
+                REQUIRE(m.insert(key, n).inserted == expected.emplace(key, n).second);
+            }
+            check_same(m, expected);
+
+            for (int i = 0; i < 500; ++i)
+            {
+                const std::string key = make_key(dist(rng));
+
+                REQUIRE(m.erase(key) == (expected.erase(key) == 1));
+            }
+            check_same(m, expected);
+
+            for (int i = 0; i < 100; ++i)
+            {
+                const std::string key = make_key(dist(rng));
+                const auto range = m.lower_bound(key);
+                const auto it = expected.lower_bound(key);
+
+                REQUIRE(m.contains(key) == (expected.count(key) == 1));
+                REQUIRE(range.empty() == (it == expected.end()));
+                if (it != expected.end())
+                    REQUIRE(range.key() == it->first);
+            }
+        }
+
+        for (const auto& entry : expected)
+            REQUIRE(m.erase(entry.first));
+        CHECK(m.empty());
+    }
+}
+
+TEST_CASE_METHOD(StringBMapTests, "string_bmap: comparado con std::map", "[string_bmap]")
+{
+    // Nodos pequeños para provocar muchas divisiones y fusiones.
+    string_bmap<int, 8, 512> m;
+    std::map<std::string, int> expected;
+
+    std::mt19937 rng(2026);
+    std::uniform_int_distribution<int> dist(0, 1999);
+
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int i = 0; i < 3000; ++i)
+        {
+            const std::string key = make_path(dist(rng));
+
+            REQUIRE(m.insert(key, i).inserted == expected.emplace(key, i).second);
+        }
+        check_same(m, expected);
+
+        for (int i = 0; i < 2000; ++i)
+        {
+            const std::string key = make_path(dist(rng));
+
+            REQUIRE(m.erase(key) == (expected.erase(key) == 1));
+        }
+        check_same(m, expected);
+
+        for (int i = 0; i < 200; ++i)
+        {
+            const std::string key = make_path(dist(rng));
+            const auto range = m.lower_bound(key);
+            const auto it = expected.lower_bound(key);
+
+            REQUIRE(range.empty() == (it == expected.end()));
+            if (it != expected.end())
+                REQUIRE(range.key() == it->first);
+        }
+    }
+
+    // Inserción en orden, que divide siempre la última hoja.
+    for (int i = 0; i < 2000; ++i)
+    {
+        const std::string key = make_path(4 * i);
+
+        m.insert_or_assign(key, i);
+        expected[key] = i;
+    }
+    check_same(m, expected);
+
+    for (const auto& entry : expected)
+        REQUIRE(m.erase(entry.first));
+    CHECK(m.empty());
+    CHECK(m.begin() == m.end());
+}
+
+TEST_CASE_METHOD(StringBMapTests, "string_bmap: ciclo de vida de los valores", "[string_bmap]")
+{
+    LifeCycleObject::reset_counters();
+    {
+        string_bmap<LifeCycleObject, 8, 512> m;
+
+        for (int i = 0; i < 500; ++i)
+            m.emplace(make_path(i), i);
+        for (int i = 0; i < 500; i += 3)
+            m.erase(make_path(i));
+
+        for (int i = 0; i < 500; ++i)
+        {
+            const auto handle = m.find(make_path(i));
+
+            REQUIRE(handle.has_value() == (i % 3 != 0));
+            if (handle)
+                REQUIRE(handle.value().value() == i);
+        }
+
+        string_bmap<LifeCycleObject, 8, 512> moved(std::move(m));
+        CHECK(m.empty());
+        CHECK(moved.size() == 333);
+        CHECK(moved.at(make_path(1)).value() == 1);
+    }
+    CHECK(LifeCycleObject::all_destroyed());
+}